@@ -0,0 +1,271 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "autosave.h"
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <string.h>
+
+#define JOURNAL_MAGIC "notepad-journal"     // 日志第一行：标记、是否保存前的快照、文件哈希、行分隔符、编码
+
+typedef enum
+{
+    JOURNAL_WRITE,
+    JOURNAL_SAVED,
+    JOURNAL_DISCARD
+} JournalJobType;
+
+typedef struct JournalJob
+{
+    JournalJobType type;
+    gchar* filename;        // 文档路径，未命名文档为 NULL
+    gchar* journal;         // 日志路径
+    GBytes* text;           // JOURNAL_WRITE 的内容
+    JournalState state;
+    gboolean sync_file;
+    gboolean waited;        // 提交者在等待完成，由提交者释放
+    gboolean finished;
+} JournalJob;
+
+struct Autosave
+{
+    GThreadPool* pool;      // 只有一个线程，保证同一文档的写入和删除按提交顺序执行
+    GMutex mutex;           // 保护等待中的任务的 finished
+    GCond finished;
+};
+
+// 日志按文档路径的摘要命名，放在用户缓存目录
+static gchar* journal_path(const char* filename)
+{
+    gchar* name = filename ? g_compute_checksum_for_string(G_CHECKSUM_SHA1, filename, -1) : g_strdup("untitled");
+    gchar* basename = g_strconcat(name, ".txt", NULL);
+    gchar* path = g_build_filename(g_get_user_cache_dir(), "notepad", "autosave", basename, NULL);
+    g_free(basename);
+    g_free(name);
+    return path;
+}
+
+// 把文件内容和所在目录的改名记录刷到磁盘
+static void sync_file(const char* filename)
+{
+    int fd = g_open(filename, O_RDWR, 0);
+    if (fd >= 0)
+    {
+        g_fsync(fd);
+        g_close(fd, NULL);
+    }
+
+#ifndef G_OS_WIN32
+    gchar* directory = g_path_get_dirname(filename);
+    fd = g_open(directory, O_RDONLY, 0);
+    if (fd >= 0)
+    {
+        g_fsync(fd);
+        g_close(fd, NULL);
+    }
+    g_free(directory);
+#endif
+}
+
+static void journal_job_free(JournalJob* job)
+{
+    if (job->text)
+        g_bytes_unref(job->text);
+    g_free(job->filename);
+    g_free(job->journal);
+    g_free(job);
+}
+
+// 日志内容前加一行状态，整个日志用 g_file_set_contents 写入临时文件、fsync 后改名，总是完整的
+static void write_journal(JournalJob* job)
+{
+    gchar* directory = g_path_get_dirname(job->journal);
+    g_mkdir_with_parents(directory, 0700);
+    g_free(directory);
+
+    gchar* encoding = encoding_display_name(&job->state.encoding);
+    gchar* header = g_strdup_printf(JOURNAL_MAGIC " %d %016" G_GINT64_MODIFIER "x %s %s\n", job->state.saving ? 1 : 0,
+                                    job->state.file_hash, line_ending_name(job->state.line_ending), encoding);
+    gsize header_length = strlen(header);
+    gsize length;
+    const gchar* text = g_bytes_get_data(job->text, &length);
+    gchar* contents = g_malloc(header_length + length);
+    memcpy(contents, header, header_length);
+    memcpy(contents + header_length, text, length);
+
+    GError* error = NULL;
+    if (!g_file_set_contents(job->journal, contents, (gssize)(header_length + length), &error))
+    {
+        g_warning("无法写入自动保存日志 %s: %s", job->journal, error->message);
+        g_error_free(error);
+    }
+    g_free(contents);
+    g_free(header);
+    g_free(encoding);
+}
+
+static void run_journal_job(gpointer data, gpointer user_data)
+{
+    JournalJob* job = (JournalJob*)data;
+    Autosave* autosave = (Autosave*)user_data;
+
+    if (job->type == JOURNAL_WRITE)
+    {
+        write_journal(job);
+    }
+    else
+    {
+        // 文件落盘之前日志仍是唯一可靠的副本
+        if (job->type == JOURNAL_SAVED && job->sync_file)
+            sync_file(job->filename);
+        g_remove(job->journal);
+    }
+
+    if (!job->waited)
+    {
+        journal_job_free(job);
+        return;
+    }
+    g_mutex_lock(&autosave->mutex);
+    job->finished = TRUE;
+    g_cond_broadcast(&autosave->finished);
+    g_mutex_unlock(&autosave->mutex);
+}
+
+Autosave* autosave_new(void)
+{
+    Autosave* autosave = g_new0(Autosave, 1);
+    g_mutex_init(&autosave->mutex);
+    g_cond_init(&autosave->finished);
+    autosave->pool = g_thread_pool_new(run_journal_job, autosave, 1, FALSE, NULL);
+    return autosave;
+}
+
+void autosave_free(Autosave* autosave)
+{
+    if (!autosave)
+        return;
+    g_thread_pool_free(autosave->pool, FALSE, TRUE);
+    g_mutex_clear(&autosave->mutex);
+    g_cond_clear(&autosave->finished);
+    g_free(autosave);
+}
+
+static JournalJob* new_job(JournalJobType type, const char* filename, GBytes* text, gboolean sync)
+{
+    JournalJob* job = g_new0(JournalJob, 1);
+    job->type = type;
+    job->filename = g_strdup(filename);
+    job->journal = journal_path(filename);
+    job->text = text ? g_bytes_ref(text) : NULL;
+    job->sync_file = sync && filename;
+    return job;
+}
+
+static void push_job(Autosave* autosave, JournalJobType type, const char* filename, GBytes* text, gboolean sync)
+{
+    g_thread_pool_push(autosave->pool, new_job(type, filename, text, sync), NULL);
+}
+
+void autosave_write(Autosave* autosave, const char* filename, GBytes* text, const JournalState* state)
+{
+    JournalJob* job = new_job(JOURNAL_WRITE, filename, text, FALSE);
+    job->state = *state;
+    g_thread_pool_push(autosave->pool, job, NULL);
+}
+
+void autosave_write_now(Autosave* autosave, const char* filename, GBytes* text, const JournalState* state)
+{
+    // 仍通过队列写入，之前提交的删除不会在这次写入之后执行
+    JournalJob* job = new_job(JOURNAL_WRITE, filename, text, FALSE);
+    job->state = *state;
+    job->waited = TRUE;
+    g_thread_pool_push(autosave->pool, job, NULL);
+
+    g_mutex_lock(&autosave->mutex);
+    while (!job->finished)
+        g_cond_wait(&autosave->finished, &autosave->mutex);
+    g_mutex_unlock(&autosave->mutex);
+    journal_job_free(job);
+}
+
+void autosave_saved(Autosave* autosave, const char* filename, gboolean sync)
+{
+    push_job(autosave, JOURNAL_SAVED, filename, NULL, sync);
+}
+
+void autosave_discard(Autosave* autosave, const char* filename)
+{
+    push_job(autosave, JOURNAL_DISCARD, filename, NULL, FALSE);
+}
+
+// 解析日志第一行的状态，没有状态行时返回 FALSE
+static gboolean parse_header(const gchar* line, JournalState* state)
+{
+    gchar** fields = g_strsplit(line, " ", 5);
+    gboolean parsed = g_strv_length(fields) == 5 && strcmp(fields[0], JOURNAL_MAGIC) == 0 &&
+                      encoding_parse_name(fields[4], &state->encoding);
+    if (parsed)
+    {
+        state->saving = strcmp(fields[1], "1") == 0;
+        state->file_hash = g_ascii_strtoull(fields[2], NULL, 16);
+        state->line_ending = LINE_ENDING_DEFAULT;
+        for (LineEnding i = LINE_ENDING_LF; i <= LINE_ENDING_CR; i++)
+            if (strcmp(fields[3], line_ending_name(i)) == 0)
+                state->line_ending = i;
+    }
+    g_strfreev(fields);
+    return parsed;
+}
+
+static gboolean fill_journal_text(EncodingWriter* writer, gpointer data, GError** error)
+{
+    gsize length;
+    const gchar* text = g_bytes_get_data((GBytes*)data, &length);
+    return encoding_writer_write(writer, text, length, error);
+}
+
+// 日志是否已经过时：保存前的快照已完整写入文件；定期写入的日志之后文件又被改变（保存或被其他程序修改）
+static gboolean journal_is_stale(const JournalState* state, GBytes* text, guint64 file_hash)
+{
+    if (!state->saving)
+        return file_hash != state->file_hash;
+
+    // 写了一半或还没落盘就崩溃的文件与日志按原编码写出的字节不同
+    guint64 saved_hash;
+    return encoding_hash(&state->encoding, state->line_ending, fill_journal_text, text, &saved_hash, NULL) &&
+           saved_hash == file_hash;
+}
+
+GBytes* autosave_recover(const char* filename, guint64 file_hash)
+{
+    gchar* journal = journal_path(filename);
+    gchar* contents;
+    gsize length;
+    GBytes* text = NULL;
+
+    if (g_file_get_contents(journal, &contents, &length, NULL))
+    {
+        GBytes* bytes = g_bytes_new_take(contents, length);
+        const gchar* newline = memchr(contents, '\n', length);
+        gchar* line = newline ? g_strndup(contents, (gsize)(newline - contents)) : NULL;
+        JournalState state;
+        if (line && parse_header(line, &state))
+        {
+            gsize offset = (gsize)(newline + 1 - contents);
+            text = g_bytes_new_from_bytes(bytes, offset, length - offset);
+            if (!g_utf8_validate(contents + offset, (gssize)(length - offset), NULL) ||
+                (filename && journal_is_stale(&state, text, file_hash)))
+            {
+                g_bytes_unref(text);
+                text = NULL;
+            }
+        }
+        g_free(line);
+        g_bytes_unref(bytes);
+    }
+
+    g_free(journal);
+    return text;
+}
@@ -0,0 +1,46 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include <glib.h>
+#include "encoding.h"
+
+#define AUTOSAVE_INTERVAL 30    // 写入自动保存日志的间隔（秒）
+
+// 自动保存日志：未保存的内容定期在后台写入缓存目录并 fsync，
+// 使不等待落盘的保存方式在崩溃后也能找回内容。所有磁盘操作按顺序在一个后台线程中执行
+typedef struct Autosave Autosave;
+
+// 日志对应的文档状态，恢复时据此判断日志是否已经过时
+typedef struct JournalState
+{
+    guint64 file_hash;          // 写入日志时磁盘上文件的指纹哈希，没有文件时为 0
+    gboolean saving;            // 保存之前写入的快照：内容正要按下面的编码和行分隔符写入文件
+    TextEncoding encoding;
+    LineEnding line_ending;
+} JournalState;
+
+extern Autosave* autosave_new(void);
+extern void autosave_free(Autosave* autosave);      // 等待队列中的操作完成后释放
+
+// 把文档内容写入日志（filename 为 NULL 表示未命名文档）
+extern void autosave_write(Autosave* autosave, const char* filename, GBytes* text, const JournalState* state);
+
+// 与 autosave_write 相同，但等队列中之前的操作和这次写入都落盘之后才返回。
+// 不等待落盘的保存方式在写文件之前调用，使崩溃时写了一半的文件总能从日志找回
+extern void autosave_write_now(Autosave* autosave, const char* filename, GBytes* text, const JournalState* state);
+
+// 文档已保存到 filename。sync_file 为 TRUE 时先在后台 fsync 该文件，落盘后再删除日志
+extern void autosave_saved(Autosave* autosave, const char* filename, gboolean sync_file);
+
+// 放弃未保存的内容，删除日志
+extern void autosave_discard(Autosave* autosave, const char* filename);
+
+// 若存在没有过时的日志，读取并返回其内容（UTF-8），否则返回 NULL。可在工作线程中调用。
+// file_hash 为文件当前内容的指纹哈希：文件已是日志保存的内容，或在日志之后被改成了别的内容时，日志已经过时
+extern GBytes* autosave_recover(const char* filename, guint64 file_hash);
+
+#endif // AUTOSAVE_H
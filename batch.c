@@ -0,0 +1,412 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "batch.h"
+#include "encoding.h"
+#include "line_ending.h"
+#include "text_search.h"
+#include "doc_stats.h"
+#include <string.h>
+
+typedef enum
+{
+    BATCH_REPLACE,
+    BATCH_CONVERT_EOL,
+    BATCH_CONVERT_ENCODING,
+    BATCH_STATS
+} BatchCommand;
+
+// 所有文件共用的参数，处理期间只读
+typedef struct BatchOptions
+{
+    BatchCommand command;
+    SearchPattern pattern;
+    const char* replacement;
+    gsize replacement_length;
+    LineEnding line_ending;
+    TextEncoding encoding;
+} BatchOptions;
+
+// 一个文件先完整扫描一遍（检测编码、统计、计数匹配和行分隔符），需要修改时再流式读取并写出
+typedef struct BatchFile
+{
+    const BatchOptions* options;
+    const char* filename;
+    TextEncoding encoding;      // 检测到的编码
+    FileFingerprint identity;   // 扫描前的文件身份，写出前后比较以发现其他程序的修改
+    DocStats stats;
+    guint64 matches;
+    guint64 lf, crlf, cr;       // 各种行分隔符的个数
+    gunichar last_char;         // 上一块的最后一个字符，处理跨块的词和 \r\n
+    GString* pending;           // 留到下一块处理的文本
+    GString* output;            // 替换结果的一块
+    EncodingWriter* writer;
+    gboolean skipped;           // 二进制文件
+    gboolean changed;
+    GError* error;
+} BatchFile;
+
+static void batch_file_reset(BatchFile* file)
+{
+    memset(&file->stats, 0, sizeof(file->stats));
+    file->matches = 0;
+    file->lf = file->crlf = file->cr = 0;
+    file->last_char = 0;
+    g_string_truncate(file->pending, 0);
+}
+
+static void count_line_endings(BatchFile* file, const char* text, gsize length)
+{
+    gchar previous = file->last_char == '\r' ? '\r' : 0;
+    for (gsize i = 0; i < length; i++)
+    {
+        if (text[i] == '\n')
+        {
+            if (previous == '\r')
+            {
+                file->crlf++;
+                file->cr--;
+            }
+            else
+            {
+                file->lf++;
+            }
+        }
+        else if (text[i] == '\r')
+        {
+            file->cr++;
+        }
+        previous = text[i];
+    }
+}
+
+static gboolean scan_chunk(const char* text, gsize length, gpointer data, GError** error)
+{
+    BatchFile* file = (BatchFile*)data;
+    if (!text)
+    {
+        batch_file_reset(file);
+        return TRUE;
+    }
+    if (length == 0)
+        return TRUE;
+
+    // 按在上一块末尾之后追加计算统计，跨块的 \r\n 只算一行
+    DocStats delta;
+    doc_stats_edit_delta(file->last_char, text, length, 0, &delta);
+    if (file->last_char == '\r' && text[0] == '\n')
+        delta.lines--;
+    doc_stats_add(&file->stats, &delta, 1);
+    count_line_endings(file, text, length);
+    file->last_char = g_utf8_get_char(g_utf8_prev_char(text + length));
+
+    if (file->options->command == BATCH_REPLACE)
+    {
+        g_string_append_len(file->pending, text, (gssize)length);
+        gsize used = text_search_replace(&file->options->pattern, file->pending->str, file->pending->len, FALSE,
+                                         NULL, 0, NULL, &file->matches);
+        g_string_erase(file->pending, 0, (gssize)used);
+    }
+    return TRUE;
+}
+
+// 处理并写出 pending 中可以确定的部分，at_end 时写出全部
+static gboolean write_pending(BatchFile* file, gboolean at_end, GError** error)
+{
+    const BatchOptions* options = file->options;
+    GString* pending = file->pending;
+
+    if (options->command == BATCH_REPLACE)
+    {
+        guint64 count = 0;
+        g_string_truncate(file->output, 0);
+        gsize used = text_search_replace(&options->pattern, pending->str, pending->len, at_end,
+                                         options->replacement, options->replacement_length, file->output, &count);
+        g_string_erase(pending, 0, (gssize)used);
+        return encoding_writer_write(file->writer, file->output->str, file->output->len, error);
+    }
+
+    if (options->command == BATCH_CONVERT_EOL)
+    {
+        // 末尾的 \r 可能与下一块开头的 \n 组成一个换行，留到下一块
+        gboolean hold_cr = !at_end && pending->len > 0 && pending->str[pending->len - 1] == '\r';
+        if (hold_cr)
+            g_string_truncate(pending, pending->len - 1);
+        gsize length = pending->len;
+        line_ending_normalize(pending->str, &length, LINE_ENDING_LF);
+        gboolean written = encoding_writer_write(file->writer, pending->str, length, error);
+        g_string_truncate(pending, 0);
+        if (hold_cr)
+            g_string_append_c(pending, '\r');
+        return written;
+    }
+
+    gboolean written = encoding_writer_write(file->writer, pending->str, pending->len, error);
+    g_string_truncate(pending, 0);
+    return written;
+}
+
+// 按扫描得到的编码读取，不会从头重新读取，text 不为 NULL
+static gboolean write_chunk(const char* text, gsize length, gpointer data, GError** error)
+{
+    BatchFile* file = (BatchFile*)data;
+    g_string_append_len(file->pending, text, (gssize)length);
+    return write_pending(file, FALSE, error);
+}
+
+static gboolean file_unchanged(const BatchFile* file, GError** error)
+{
+    FileFingerprint current;
+    if (!file_fingerprint_stat(file->filename, &current) ||
+        !file_fingerprint_same_identity(&file->identity, &current))
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "文件在处理期间被修改");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean fill_file(EncodingWriter* writer, gpointer data, GError** error)
+{
+    BatchFile* file = (BatchFile*)data;
+    file->writer = writer;
+    g_string_truncate(file->pending, 0);
+
+    // 按扫描时检测到的编码读取：GBK 文件在扫描时已经过 UTF-8 猜测失败后的重新读取，这里不再重复
+    gboolean filled = file_unchanged(file, error) &&
+                      encoding_stream_file_as(file->filename, &file->encoding, write_chunk, file, NULL, error) &&
+                      file_unchanged(file, error) &&
+                      write_pending(file, TRUE, error);
+    file->writer = NULL;
+    return filled;
+}
+
+static gboolean needs_rewrite(const BatchFile* file)
+{
+    const BatchOptions* options = file->options;
+    switch (options->command)
+    {
+    case BATCH_REPLACE:
+        return file->matches > 0;
+    case BATCH_CONVERT_EOL:
+        if (options->line_ending == LINE_ENDING_LF)
+            return file->crlf + file->cr > 0;
+        if (options->line_ending == LINE_ENDING_CRLF)
+            return file->lf + file->cr > 0;
+        return file->lf + file->crlf > 0;
+    case BATCH_CONVERT_ENCODING:
+        return strcmp(file->encoding.charset, options->encoding.charset) != 0 ||
+               file->encoding.bom != options->encoding.bom;
+    default:
+        return FALSE;
+    }
+}
+
+static void process_file(gpointer data, gpointer user_data)
+{
+    BatchFile* file = (BatchFile*)data;
+    const BatchOptions* options = file->options;
+
+    if (encoding_file_looks_binary(file->filename, NULL))
+    {
+        file->skipped = TRUE;
+        return;
+    }
+
+    if (!file_fingerprint_stat(file->filename, &file->identity))
+    {
+        g_set_error(&file->error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "无法读取文件信息");
+        return;
+    }
+
+    file->pending = g_string_sized_new(ENCODING_CHUNK_SIZE);
+    if (encoding_stream_file(file->filename, &file->encoding, scan_chunk, file, NULL, &file->error) &&
+        needs_rewrite(file))
+    {
+        // 写入同目录的临时文件后改名替换：读取原文件期间不会覆盖它，失败时原文件不变
+        const TextEncoding* encoding = options->command == BATCH_CONVERT_ENCODING ? &options->encoding : &file->encoding;
+        LineEnding line_ending = options->command == BATCH_CONVERT_EOL ? options->line_ending : LINE_ENDING_LF;
+        file->output = g_string_sized_new(ENCODING_CHUNK_SIZE);
+        file->changed = encoding_save_file(file->filename, encoding, line_ending, SAVE_ATOMIC,
+                                           fill_file, file, NULL, NULL, &file->error);
+        g_string_free(file->output, TRUE);
+        file->output = NULL;
+    }
+    g_string_free(file->pending, TRUE);
+    file->pending = NULL;
+}
+
+static void print_result(const BatchFile* file)
+{
+    const BatchOptions* options = file->options;
+    if (file->skipped)
+    {
+        g_printerr("%s：二进制文件，已跳过\n", file->filename);
+        return;
+    }
+    if (file->error)
+    {
+        g_printerr("%s：%s\n", file->filename, file->error->message);
+        return;
+    }
+
+    gchar* from = encoding_display_name(&file->encoding);
+    gchar* to = encoding_display_name(&options->encoding);
+    switch (options->command)
+    {
+    case BATCH_REPLACE:
+        if (file->changed)
+            g_print("%s：已替换 %" G_GUINT64_FORMAT " 个匹配项\n", file->filename, file->matches);
+        else
+            g_print("%s：没有匹配项，未修改\n", file->filename);
+        break;
+    case BATCH_CONVERT_EOL:
+        if (file->changed)
+            g_print("%s：已转换为 %s\n", file->filename, line_ending_name(options->line_ending));
+        else
+            g_print("%s：已经是 %s，未修改\n", file->filename, line_ending_name(options->line_ending));
+        break;
+    case BATCH_CONVERT_ENCODING:
+        if (file->changed)
+            g_print("%s：%s → %s\n", file->filename, from, to);
+        else
+            g_print("%s：已经是 %s，未修改\n", file->filename, to);
+        break;
+    default:
+        g_print("%12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT
+                "  %-10s %s\n", file->stats.lines, file->stats.words, file->stats.chars, file->stats.bytes,
+                from, file->filename);
+        break;
+    }
+    g_free(to);
+    g_free(from);
+}
+
+static void print_usage(void)
+{
+    g_printerr("用法：\n"
+               "  notepad --batch replace [-i] <查找> <替换> <文件>...\n"
+               "  notepad --batch convert-eol lf|crlf|cr <文件>...\n"
+               "  notepad --batch convert-encoding <编码> <文件>...    编码为 UTF-8、GB18030、UTF-16LE、UTF-16BE，"
+               "可加 \" BOM\"\n"
+               "  notepad --batch stats <文件>...\n");
+}
+
+// 解析子命令和参数，返回第一个文件参数的下标，参数错误时返回 -1
+static int parse_options(int argc, char* argv[], BatchOptions* options)
+{
+    if (argc < 1)
+        return -1;
+
+    const char* command = argv[0];
+    int first = 1;
+    if (strcmp(command, "replace") == 0)
+    {
+        gboolean case_sensitive = TRUE;
+        if (first < argc && strcmp(argv[first], "-i") == 0)
+        {
+            case_sensitive = FALSE;
+            first++;
+        }
+        if (first + 2 > argc || argv[first][0] == '\0')
+            return -1;
+        if (!text_search_pattern_supported(argv[first], case_sensitive))
+        {
+            g_printerr("不区分大小写时查找内容只能包含 ASCII 字符\n");
+            return -1;
+        }
+        options->command = BATCH_REPLACE;
+        text_search_pattern_init(&options->pattern, argv[first], strlen(argv[first]), case_sensitive);
+        options->replacement = argv[first + 1];
+        options->replacement_length = strlen(argv[first + 1]);
+        first += 2;
+    }
+    else if (strcmp(command, "convert-eol") == 0)
+    {
+        if (first >= argc)
+            return -1;
+        gboolean found = FALSE;
+        for (LineEnding line_ending = LINE_ENDING_LF; line_ending <= LINE_ENDING_CR && !found; line_ending++)
+        {
+            if (g_ascii_strcasecmp(argv[first], line_ending_name(line_ending)) == 0)
+            {
+                options->line_ending = line_ending;
+                found = TRUE;
+            }
+        }
+        if (!found)
+            return -1;
+        options->command = BATCH_CONVERT_EOL;
+        first++;
+    }
+    else if (strcmp(command, "convert-encoding") == 0)
+    {
+        if (first >= argc || !encoding_parse_name(argv[first], &options->encoding))
+            return -1;
+        options->command = BATCH_CONVERT_ENCODING;
+        first++;
+    }
+    else if (strcmp(command, "stats") == 0)
+    {
+        options->command = BATCH_STATS;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return first < argc ? first : -1;
+}
+
+int batch_run(int argc, char* argv[])
+{
+    BatchOptions options;
+    memset(&options, 0, sizeof(options));
+    encoding_init_default(&options.encoding);
+    int first = parse_options(argc, argv, &options);
+    if (first < 0)
+    {
+        print_usage();
+        return 2;
+    }
+
+    // 每个文件独立处理，线程数与处理器核心数相同
+    int count = argc - first;
+    BatchFile* files = g_new0(BatchFile, count);
+    GThreadPool* pool = g_thread_pool_new(process_file, NULL, (gint)g_get_num_processors(), FALSE, NULL);
+    for (int i = 0; i < count; i++)
+    {
+        files[i].options = &options;
+        files[i].filename = argv[first + i];
+        encoding_init_default(&files[i].encoding);
+        g_thread_pool_push(pool, &files[i], NULL);
+    }
+    g_thread_pool_free(pool, FALSE, TRUE);
+
+    if (options.command == BATCH_STATS)
+        g_print("%12s %12s %12s %12s  %-10s %s\n", "行数", "词数", "字符数", "字节数", "编码", "文件");
+
+    DocStats total;
+    memset(&total, 0, sizeof(total));
+    int failed = 0;
+    for (int i = 0; i < count; i++)
+    {
+        print_result(&files[i]);
+        if (files[i].error)
+        {
+            failed++;
+            g_error_free(files[i].error);
+        }
+        else if (!files[i].skipped)
+        {
+            doc_stats_add(&total, &files[i].stats, 1);
+        }
+    }
+    if (options.command == BATCH_STATS && count > 1)
+        g_print("%12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT
+                "  %-10s %s\n", total.lines, total.words, total.chars, total.bytes, "", "总计");
+
+    g_free(files);
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,17 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef BATCH_H
+#define BATCH_H
+
+// 命令行批处理，不初始化界面：
+//   notepad --batch replace [-i] <查找> <替换> <文件>...
+//   notepad --batch convert-eol lf|crlf|cr <文件>...
+//   notepad --batch convert-encoding <编码> <文件>...
+//   notepad --batch stats <文件>...
+// 使用与编辑器相同的编码检测、全部替换和行分隔符转换，分块流式处理，内存占用与文件大小无关；
+// 多个文件在线程池中并行处理，结果按参数顺序输出。全部成功返回 0，有文件失败返回 1，参数错误返回 2
+extern int batch_run(int argc, char* argv[]);
+
+#endif // BATCH_H
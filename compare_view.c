@@ -0,0 +1,329 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "compare_view.h"
+#include "encoding.h"
+#include "line_ending.h"
+#include "output_exception.h"
+#include "text_diff.h"
+#include <string.h>
+
+typedef struct CompareView
+{
+    GtkWidget* window;
+    GtkWidget* views[2];        // 0 为当前文档，1 为比较的文件
+    GtkTextBuffer* buffers[2];
+    GtkTextTag* tags[2];        // 差异块的背景：左侧为删除的行，右侧为新增的行
+    GtkWidget* previous_button;
+    GtkWidget* next_button;
+    GtkWidget* status_label;
+    GArray* hunks;              // DiffHunk，比较完成前为 NULL
+    gint current;               // 当前差异块，-1 表示尚未跳转
+    gboolean syncing;           // 正在同步另一侧的滚动位置，忽略由此引起的回调
+    GCancellable* cancellable;
+} CompareView;
+
+// 后台比较任务：读取文件、统一换行符、分行哈希并计算差异
+typedef struct CompareJob
+{
+    CompareView* view;
+    gchar* filename;
+    GBytes* document;
+    GString* text;              // 文件内容（UTF-8，只含 \n）
+    GArray* hunks;
+} CompareJob;
+
+static void compare_job_free(CompareJob* job)
+{
+    g_free(job->filename);
+    g_bytes_unref(job->document);
+    if (job->text)
+        g_string_free(job->text, TRUE);
+    if (job->hunks)
+        g_array_unref(job->hunks);
+    g_free(job);
+}
+
+static void compare_job_thread(GTask* task, gpointer source, gpointer task_data, GCancellable* cancellable)
+{
+    CompareJob* job = (CompareJob*)task_data;
+    TextEncoding encoding;
+    GError* error = NULL;
+
+    if (!encoding_load_file(job->filename, &encoding, &job->text, NULL, NULL, NULL, cancellable, &error))
+    {
+        g_task_return_error(task, error);
+        return;
+    }
+    gsize length = job->text->len;
+    line_ending_normalize(job->text->str, &length, LINE_ENDING_DEFAULT);
+    g_string_truncate(job->text, length);
+
+    gsize document_length;
+    const char* document = (const char*)g_bytes_get_data(job->document, &document_length);
+    TextLines* old_lines = text_lines_split(document, document_length);
+    TextLines* new_lines = text_lines_split(job->text->str, job->text->len);
+    job->hunks = text_diff_lines(old_lines, new_lines);
+    text_lines_free(old_lines);
+    text_lines_free(new_lines);
+
+    if (!g_task_return_error_if_cancelled(task))
+        g_task_return_boolean(task, TRUE);
+}
+
+// 把一侧的行号换算为另一侧对应的行号：差异块之间的行一一对应，块内的行对应到块的开头
+static gint map_line(GArray* hunks, gint line, gint side)
+{
+    gint shift = 0;
+    for (guint i = 0; i < hunks->len; i++)
+    {
+        const DiffHunk* hunk = &g_array_index(hunks, DiffHunk, i);
+        gint start = (gint)(side == 0 ? hunk->old_start : hunk->new_start);
+        gint count = (gint)(side == 0 ? hunk->old_count : hunk->new_count);
+        gint other_start = (gint)(side == 0 ? hunk->new_start : hunk->old_start);
+        gint other_count = (gint)(side == 0 ? hunk->new_count : hunk->old_count);
+
+        if (line < start)
+            break;
+        if (line < start + count)
+            return other_start + MIN(line - start, MAX(other_count - 1, 0));
+        shift = (other_start + other_count) - (start + count);
+    }
+    return line + shift;
+}
+
+static void update_status(CompareView* view)
+{
+    guint count = view->hunks->len;
+    gchar* text;
+    if (count == 0)
+        text = g_strdup("内容相同");
+    else if (view->current < 0)
+        text = g_strdup_printf("共 %u 处差异", count);
+    else
+        text = g_strdup_printf("第 %d / %u 处差异", view->current + 1, count);
+    gtk_label_set_text(GTK_LABEL(view->status_label), text);
+    g_free(text);
+
+    gtk_widget_set_sensitive(view->previous_button, count > 0 && view->current > 0);
+    gtk_widget_set_sensitive(view->next_button, count > 0 && view->current + 1 < (gint)count);
+}
+
+// 把 side 一侧滚动到第 line 行，使其位于可见区域顶部偏下
+static void scroll_to_line(CompareView* view, gint side, gint line)
+{
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_line(view->buffers[side], &iter, line);
+    gtk_text_buffer_place_cursor(view->buffers[side], &iter);
+    gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(view->views[side]), &iter, 0.0, TRUE, 0.0, 0.3);
+}
+
+static void show_hunk(CompareView* view, gint index)
+{
+    const DiffHunk* hunk = &g_array_index(view->hunks, DiffHunk, index);
+    view->current = index;
+    view->syncing = TRUE;
+    scroll_to_line(view, 0, (gint)hunk->old_start);
+    scroll_to_line(view, 1, (gint)hunk->new_start);
+    view->syncing = FALSE;
+    update_status(view);
+}
+
+static void on_previous_hunk(GtkWidget* widget, gpointer data)
+{
+    CompareView* view = (CompareView*)data;
+    if (view->hunks && view->current > 0)
+        show_hunk(view, view->current - 1);
+}
+
+static void on_next_hunk(GtkWidget* widget, gpointer data)
+{
+    CompareView* view = (CompareView*)data;
+    if (view->hunks && view->current + 1 < (gint)view->hunks->len)
+        show_hunk(view, view->current + 1);
+}
+
+// 一侧滚动时，把另一侧对应的行放到相同的高度
+static void sync_scroll(CompareView* view, gint side)
+{
+    if (view->syncing || !view->hunks)
+        return;
+
+    GtkTextView* from = GTK_TEXT_VIEW(view->views[side]);
+    GtkTextView* to = GTK_TEXT_VIEW(view->views[1 - side]);
+    GdkRectangle visible;
+    gtk_text_view_get_visible_rect(from, &visible);
+
+    GtkTextIter iter;
+    gint line_top;
+    gtk_text_view_get_line_at_y(from, &iter, visible.y, &line_top);
+    gint line = map_line(view->hunks, gtk_text_iter_get_line(&iter), side);
+
+    gint target_top, height;
+    gtk_text_buffer_get_iter_at_line(view->buffers[1 - side], &iter, line);
+    gtk_text_view_get_line_yrange(to, &iter, &target_top, &height);
+
+    view->syncing = TRUE;
+    gtk_adjustment_set_value(gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(to)),
+                             target_top + (visible.y - line_top));
+    view->syncing = FALSE;
+}
+
+static void on_left_scrolled(GtkAdjustment* adjustment, gpointer data)
+{
+    sync_scroll((CompareView*)data, 0);
+}
+
+static void on_right_scrolled(GtkAdjustment* adjustment, gpointer data)
+{
+    sync_scroll((CompareView*)data, 1);
+}
+
+static void tag_lines(CompareView* view, gint side, guint start, guint count)
+{
+    if (count == 0)
+        return;
+    GtkTextIter begin, end;
+    gtk_text_buffer_get_iter_at_line(view->buffers[side], &begin, (gint)start);
+    gtk_text_buffer_get_iter_at_line(view->buffers[side], &end, (gint)(start + count));
+    if (gtk_text_iter_get_line(&end) < (gint)(start + count))
+        gtk_text_buffer_get_end_iter(view->buffers[side], &end);
+    gtk_text_buffer_apply_tag(view->buffers[side], view->tags[side], &begin, &end);
+}
+
+static void compare_job_done(GObject* source, GAsyncResult* result, gpointer data)
+{
+    CompareJob* job = (CompareJob*)data;
+    GError* error = NULL;
+
+    // 窗口已关闭
+    if (!g_task_propagate_boolean(G_TASK(result), &error) && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        g_error_free(error);
+        compare_job_free(job);
+        return;
+    }
+
+    CompareView* view = job->view;
+    if (error)
+    {
+        gchar* message = g_strdup_printf("无法读取文件：\"%s\":\n%s", job->filename, error->message);
+        show_error_dialog(GTK_WINDOW(view->window), "比较失败", message);
+        g_free(message);
+        g_error_free(error);
+        compare_job_free(job);
+        gtk_widget_destroy(view->window);
+        return;
+    }
+
+    gsize length;
+    const gchar* document = g_bytes_get_data(job->document, &length);
+    gtk_text_buffer_set_text(view->buffers[0], document ? document : "", (gint)length);
+    gtk_text_buffer_set_text(view->buffers[1], job->text->str, (gint)job->text->len);
+
+    view->hunks = job->hunks;
+    job->hunks = NULL;
+    for (guint i = 0; i < view->hunks->len; i++)
+    {
+        const DiffHunk* hunk = &g_array_index(view->hunks, DiffHunk, i);
+        tag_lines(view, 0, hunk->old_start, hunk->old_count);
+        tag_lines(view, 1, hunk->new_start, hunk->new_count);
+    }
+    compare_job_free(job);
+
+    update_status(view);
+    if (view->hunks->len > 0)
+        show_hunk(view, 0);
+}
+
+static void on_compare_view_destroy(GtkWidget* widget, gpointer data)
+{
+    CompareView* view = (CompareView*)data;
+    g_cancellable_cancel(view->cancellable);
+    g_object_unref(view->cancellable);
+    if (view->hunks)
+        g_array_unref(view->hunks);
+    g_free(view);
+}
+
+static GtkWidget* create_pane(CompareView* view, gint side, const char* title, const char* color)
+{
+    GtkWidget* box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 3);
+    GtkWidget* label = gtk_label_new(title);
+    gtk_label_set_ellipsize(GTK_LABEL(label), PANGO_ELLIPSIZE_MIDDLE);
+    gtk_box_pack_start(GTK_BOX(box), label, FALSE, FALSE, 0);
+
+    GtkWidget* scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    view->views[side] = gtk_text_view_new();
+    view->buffers[side] = gtk_text_view_get_buffer(GTK_TEXT_VIEW(view->views[side]));
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(view->views[side]), FALSE);
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(view->views[side]), TRUE);
+    gtk_text_view_set_left_margin(GTK_TEXT_VIEW(view->views[side]), 5);
+    view->tags[side] = gtk_text_buffer_create_tag(view->buffers[side], NULL,
+                                                  "paragraph-background", color, NULL);
+    gtk_container_add(GTK_CONTAINER(scrolled_window), view->views[side]);
+    gtk_box_pack_start(GTK_BOX(box), scrolled_window, TRUE, TRUE, 0);
+    return box;
+}
+
+void compare_view_open(NotepadApp* app, const char* filename)
+{
+    CompareView* view = g_new0(CompareView, 1);
+    view->current = -1;
+    view->cancellable = g_cancellable_new();
+
+    gchar* document_name = app->filename ? g_path_get_basename(app->filename) : g_strdup("未命名");
+    gchar* file_name = g_path_get_basename(filename);
+    gchar* title = g_strdup_printf("比较 - %s 与 %s", document_name, file_name);
+    view->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(view->window), title);
+    gtk_window_set_transient_for(GTK_WINDOW(view->window), GTK_WINDOW(app->ui->window));
+    gtk_window_set_default_size(GTK_WINDOW(view->window), 1200, 720);
+    g_free(title);
+
+    GtkWidget* vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    gtk_container_add(GTK_CONTAINER(view->window), vbox);
+
+    // 工具栏：在差异块之间跳转
+    GtkWidget* toolbar = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+    gtk_container_set_border_width(GTK_CONTAINER(toolbar), 5);
+    view->previous_button = gtk_button_new_with_mnemonic("上一处差异(_P)");
+    view->next_button = gtk_button_new_with_mnemonic("下一处差异(_N)");
+    view->status_label = gtk_label_new("正在比较…");
+    gtk_widget_set_sensitive(view->previous_button, FALSE);
+    gtk_widget_set_sensitive(view->next_button, FALSE);
+    gtk_box_pack_start(GTK_BOX(toolbar), view->previous_button, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), view->next_button, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), view->status_label, FALSE, FALSE, 10);
+    gtk_box_pack_start(GTK_BOX(vbox), toolbar, FALSE, FALSE, 0);
+
+    GtkWidget* panes = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+    gtk_box_set_homogeneous(GTK_BOX(panes), TRUE);
+    gtk_container_set_border_width(GTK_CONTAINER(panes), 5);
+    gtk_box_pack_start(GTK_BOX(panes), create_pane(view, 0, document_name, "#fcdede"), TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(panes), create_pane(view, 1, filename, "#ddf6dd"), TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(vbox), panes, TRUE, TRUE, 0);
+    g_free(document_name);
+    g_free(file_name);
+
+    g_signal_connect(view->previous_button, "clicked", G_CALLBACK(on_previous_hunk), view);
+    g_signal_connect(view->next_button, "clicked", G_CALLBACK(on_next_hunk), view);
+    g_signal_connect(gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(view->views[0])), "value-changed",
+                     G_CALLBACK(on_left_scrolled), view);
+    g_signal_connect(gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(view->views[1])), "value-changed",
+                     G_CALLBACK(on_right_scrolled), view);
+    g_signal_connect(view->window, "destroy", G_CALLBACK(on_compare_view_destroy), view);
+    gtk_widget_show_all(view->window);
+
+    CompareJob* job = g_new0(CompareJob, 1);
+    job->view = view;
+    job->filename = g_strdup(filename);
+    job->document = notepad_get_snapshot(app);
+
+    GTask* task = g_task_new(NULL, view->cancellable, compare_job_done, job);
+    g_task_set_task_data(task, job, NULL);
+    g_task_run_in_thread(task, compare_job_thread);
+    g_object_unref(task);
+}
@@ -0,0 +1,16 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef COMPARE_VIEW_H
+#define COMPARE_VIEW_H
+
+#include <gtk/gtk.h>
+#include "notepad.h"
+
+// 并排比较：左侧为当前文档的快照，右侧为磁盘上的另一个文件。后台读取文件并按行哈希做
+// 线性空间的 Myers 差异，差异块以背景色标出，可逐个跳转，两侧按对应的行同步滚动。
+// 在独立的只读窗口中显示，关闭窗口时取消未完成的比较并释放
+extern void compare_view_open(NotepadApp* app, const char* filename);
+
+#endif // COMPARE_VIEW_H
@@ -0,0 +1,1162 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "csv_view.h"
+#include "encoding.h"
+#include <math.h>
+#include <string.h>
+
+#define CSV_VIEW_MARGIN 8           // 内容与窗口边缘的距离（像素）
+#define CSV_VIEW_WHEEL_ROWS 3       // 鼠标滚轮每格滚动的行数
+#define CSV_VIEW_WHEEL_CHARS 8      // 水平滚动每格的字符数
+#define CSV_VIEW_MIN_WIDTH 3        // 列的最小宽度（字符数）
+#define CSV_VIEW_DEFAULT_WIDTH 12   // 估算列宽之后才出现的列的宽度
+#define CSV_VIEW_CELL_PREVIEW 200   // 状态栏中显示的单元格最多的字符数
+#define CSV_VIEW_CANCEL_CHECK 0xFFFF
+#define CSV_VIEW_ENCODING_PROBE (64 * 1024)    // 检查开头这么多字节判断是否为 UTF-8
+
+typedef struct CsvJob CsvJob;
+
+typedef struct CsvView
+{
+    GtkWidget* window;
+    GtkWidget* area;
+    GtkAdjustment* adjustment;  // 以数据行为单位，value 为第一个可见行
+    GtkAdjustment* hadjustment; // 以像素为单位，单元格区域的水平滚动
+    GtkWidget* header_check;
+    GtkWidget* status_label;
+    GMappedFile* file;
+    const char* data;           // 跳过 BOM 之后的内容
+    gsize size;
+    const char* charset;        // 单元格的编码，UTF-8 时为 NULL
+    gchar delimiter;
+    PangoFontDescription* font;
+    gdouble char_width;
+    gint row_height;
+
+    GArray* rows;               // 每行的起始偏移（guint64），最后多一个文件末尾；建立完成之前为 NULL
+    GArray* widths;             // 每列的宽度（字符数，gint）
+    guint first_data;           // 第一个数据行，首行为标题时为 1
+    guint* order;               // 排序后第 i 个显示的行号，未排序时为 NULL
+    gint sort_column;           // 排序的列，-1 表示未排序
+    gboolean descending;
+    gint64 selected;            // 选中的显示行，-1 表示没有选中
+    CsvJob* job;                // 进行中的建立索引或排序
+} CsvView;
+
+// 后台任务，持有文件映射的引用，窗口关闭后仍可安全结束
+struct CsvJob
+{
+    CsvView* view;              // 窗口关闭或任务被取消后为 NULL
+    GMappedFile* file;
+    const char* data;           // 指向 file 的映射，跳过了 BOM
+    gsize size;
+    gchar delimiter;
+    GArray* rows;               // 建立索引的结果；排序时为行索引的引用
+    gboolean sort;
+    guint first;                // 参与排序的第一行
+    gint column;
+    gboolean descending;
+    gboolean numeric;           // 该列非空的单元格都是数字，按数值排序
+    guint* order;
+    GCancellable* cancellable;
+    gint64 start_time;
+};
+
+// 建立行索引时一个线程处理的一段。先统计每段的引号数，得到每段开头是否在引号内，再并行查找行首
+typedef struct IndexPart
+{
+    const char* data;
+    gsize start;
+    gsize end;
+    guint quotes;
+    gboolean quoted;            // 段开头是否在引号内
+    GArray* rows;               // 本段中的行首偏移（guint64）
+    GCancellable* cancellable;
+} IndexPart;
+
+// 排序键，文本指向文件映射。GB18030 的单元格按原始字节排序，常用汉字即按拼音顺序
+typedef struct SortKey
+{
+    const char* text;
+    guint32 length;
+    guint row;
+    gdouble number;             // 不是数字或为空时为 NAN
+} SortKey;
+
+gboolean csv_view_is_table_file(const char* filename)
+{
+    return g_str_has_suffix(filename, ".csv") || g_str_has_suffix(filename, ".CSV") ||
+           g_str_has_suffix(filename, ".tsv") || g_str_has_suffix(filename, ".TSV") ||
+           g_str_has_suffix(filename, ".tab");
+}
+
+// TSV 按扩展名确定，其他文件取第一行中引号外出现最多的候选分隔符
+static gchar detect_delimiter(const char* filename, const char* data, gsize size)
+{
+    if (g_str_has_suffix(filename, ".tsv") || g_str_has_suffix(filename, ".TSV") ||
+        g_str_has_suffix(filename, ".tab"))
+        return '\t';
+
+    static const gchar candidates[] = { ',', '\t', ';', '|' };
+    guint counts[G_N_ELEMENTS(candidates)] = { 0 };
+    gboolean quoted = FALSE;
+    for (gsize i = 0; i < MIN(size, 64 * 1024) && (quoted || data[i] != '\n'); i++)
+    {
+        if (data[i] == '"')
+            quoted = !quoted;
+        for (guint j = 0; j < G_N_ELEMENTS(candidates) && !quoted; j++)
+            counts[j] += data[i] == candidates[j];
+    }
+
+    guint best = 0;
+    for (guint j = 1; j < G_N_ELEMENTS(candidates); j++)
+    {
+        if (counts[j] > counts[best])
+            best = j;
+    }
+    return candidates[best];
+}
+
+static gsize find_byte(const char* data, gchar c, gsize pos, gsize end)
+{
+    const char* found = memchr(data + pos, c, end - pos);
+    return found ? (gsize)(found - data) : end;
+}
+
+static gpointer count_quotes_thread(gpointer data)
+{
+    IndexPart* part = (IndexPart*)data;
+    gsize pos = part->start;
+    while ((pos = find_byte(part->data, '"', pos, part->end)) < part->end)
+    {
+        part->quotes++;
+        pos++;
+        if ((part->quotes & CSV_VIEW_CANCEL_CHECK) == 0 && g_cancellable_is_cancelled(part->cancellable))
+            break;
+    }
+    return NULL;
+}
+
+// 记住下一个引号和下一个换行的位置，每个位置只用 memchr 找一次；引号内的换行不分行，"" 转义切换两次
+static gpointer index_part_thread(gpointer data)
+{
+    IndexPart* part = (IndexPart*)data;
+    const char* text = part->data;
+    gsize end = part->end;
+    gboolean quoted = part->quoted;
+    gsize quote = find_byte(text, '"', part->start, end);
+    gsize newline = find_byte(text, '\n', part->start, end);
+
+    while (TRUE)
+    {
+        if (quoted || quote < newline)
+        {
+            if (quote == end)
+                break;
+            quoted = !quoted;
+            gsize pos = quote + 1;
+            quote = find_byte(text, '"', pos, end);
+            if (newline < pos)
+                newline = find_byte(text, '\n', pos, end);
+        }
+        else
+        {
+            if (newline == end)
+                break;
+            guint64 row = newline + 1;
+            g_array_append_val(part->rows, row);
+            if ((part->rows->len & CSV_VIEW_CANCEL_CHECK) == 0 && g_cancellable_is_cancelled(part->cancellable))
+                break;
+            newline = find_byte(text, '\n', newline + 1, end);
+        }
+    }
+    return NULL;
+}
+
+static void run_parts(GThreadFunc func, IndexPart* parts, guint count)
+{
+    GThread** workers = g_new0(GThread*, count);
+    for (guint i = 1; i < count; i++)
+        workers[i] = g_thread_new("csv-index", func, &parts[i]);
+    func(&parts[0]);    // 第一段在当前线程执行
+    for (guint i = 1; i < count; i++)
+        g_thread_join(workers[i]);
+    g_free(workers);
+}
+
+// 返回每行的起始偏移，最后加上文件末尾；文件以换行结尾时不计末尾的空行。取消时返回 NULL
+static GArray* build_row_index(const char* data, gsize size, GCancellable* cancellable)
+{
+    guint threads = MAX(1, g_get_num_processors());
+    guint count = (guint)MIN((gsize)threads, MAX((gsize)1, size / CSV_VIEW_PART_MIN));
+    IndexPart* parts = g_new0(IndexPart, count);
+    for (guint i = 0; i < count; i++)
+    {
+        parts[i].data = data;
+        parts[i].start = size / count * i;
+        parts[i].end = i + 1 < count ? size / count * (i + 1) : size;
+        parts[i].rows = g_array_new(FALSE, FALSE, sizeof(guint64));
+        parts[i].cancellable = cancellable;
+    }
+
+    run_parts(count_quotes_thread, parts, count);
+    gboolean quoted = FALSE;
+    for (guint i = 0; i < count; i++)
+    {
+        parts[i].quoted = quoted;
+        quoted ^= parts[i].quotes & 1;
+    }
+    run_parts(index_part_thread, parts, count);
+
+    GArray* rows = NULL;
+    if (!g_cancellable_is_cancelled(cancellable))
+    {
+        rows = g_array_new(FALSE, FALSE, sizeof(guint64));
+        guint64 offset = 0;
+        g_array_append_val(rows, offset);
+        for (guint i = 0; i < count; i++)
+            g_array_append_vals(rows, parts[i].rows->data, parts[i].rows->len);
+        if (g_array_index(rows, guint64, rows->len - 1) == size)
+            g_array_set_size(rows, rows->len - 1);
+        offset = size;
+        g_array_append_val(rows, offset);
+    }
+
+    for (guint i = 0; i < count; i++)
+        g_array_free(parts[i].rows, TRUE);
+    g_free(parts);
+    return rows;
+}
+
+static guint row_count(const GArray* rows)
+{
+    return rows ? rows->len - 1 : 0;
+}
+
+// 一行的范围，不含行尾的 \n 和 \r
+static void row_bounds(const char* data, const GArray* rows, guint row, const char** start, const char** end)
+{
+    *start = data + g_array_index(rows, guint64, row);
+    *end = data + g_array_index(rows, guint64, row + 1);
+    if (*end > *start && (*end)[-1] == '\n')
+        (*end)--;
+    if (*end > *start && (*end)[-1] == '\r')
+        (*end)--;
+}
+
+// 找到一行中的第 column 个单元格，带引号时返回引号内的原始内容（"" 不还原）
+static gboolean locate_cell(const char* p, const char* end, gchar delimiter, guint column,
+                            const char** cell, gsize* length)
+{
+    for (guint index = 0;; index++)
+    {
+        const char* start = p;
+        if (p < end && *p == '"')
+        {
+            gboolean quoted = FALSE;
+            while (p < end && (quoted || *p != delimiter))
+            {
+                if (*p == '"')
+                    quoted = !quoted;
+                p++;
+            }
+        }
+        else
+        {
+            p = memchr(p, delimiter, (gsize)(end - p));
+            if (!p)
+                p = end;
+        }
+
+        if (index == column)
+        {
+            if (p - start >= 2 && *start == '"' && p[-1] == '"')
+            {
+                *cell = start + 1;
+                *length = (gsize)(p - start - 2);
+            }
+            else
+            {
+                *cell = start;
+                *length = (gsize)(p - start);
+            }
+            return TRUE;
+        }
+        if (p >= end)
+            return FALSE;
+        p++;
+    }
+}
+
+// 开头不是有效的 UTF-8 时按 GB18030（兼容 GBK）显示，探测范围末尾截断的字符不算无效
+static gboolean head_is_utf8(const char* data, gsize size)
+{
+    if (size == 0)
+        return TRUE;
+    gsize length = MIN(size, CSV_VIEW_ENCODING_PROBE);
+    const gchar* end;
+    if (g_utf8_validate(data, (gssize)length, &end))
+        return TRUE;
+    gsize rest = length - (gsize)(end - data);
+    return length < size && g_utf8_get_char_validated(end, (gssize)rest) == (gunichar)-2;
+}
+
+// 单元格转换为 UTF-8 用于显示，无法转换的内容替换为替换字符
+static gchar* display_text(const char* text, gsize length, const char* charset)
+{
+    if (charset)
+    {
+        gchar* converted = g_convert(text, (gssize)length, "UTF-8", charset, NULL, NULL, NULL);
+        if (converted)
+            return converted;
+    }
+    return g_utf8_make_valid(text, (gssize)length);
+}
+
+// 一行中的单元格数，按与 locate_cell 相同的规则分隔
+static guint count_cells(const char* p, const char* end, gchar delimiter)
+{
+    guint count = 1;
+    while (TRUE)
+    {
+        if (p < end && *p == '"')
+        {
+            gboolean quoted = FALSE;
+            while (p < end && (quoted || *p != delimiter))
+            {
+                if (*p == '"')
+                    quoted = !quoted;
+                p++;
+            }
+        }
+        else
+        {
+            p = memchr(p, delimiter, (gsize)(end - p));
+            if (!p)
+                p = end;
+        }
+        if (p >= end)
+            return count;
+        p++;
+        count++;
+    }
+}
+
+// 解析一行中的所有单元格，去掉引号并还原 "" 转义，转换为 UTF-8 后用于显示
+static void parse_row(const char* p, const char* end, gchar delimiter, const char* charset, GPtrArray* cells)
+{
+    g_ptr_array_set_size(cells, 0);
+    GString* cell = g_string_sized_new(64);
+    while (TRUE)
+    {
+        g_string_truncate(cell, 0);
+        if (p < end && *p == '"')
+        {
+            p++;
+            while (p < end)
+            {
+                if (*p == '"')
+                {
+                    if (p + 1 < end && p[1] == '"')
+                    {
+                        g_string_append_c(cell, '"');
+                        p += 2;
+                        continue;
+                    }
+                    p++;
+                    break;
+                }
+                g_string_append_c(cell, *p++);
+            }
+            // 结尾引号之后到分隔符之前的内容照原样保留
+            while (p < end && *p != delimiter)
+                g_string_append_c(cell, *p++);
+        }
+        else
+        {
+            const char* start = p;
+            p = memchr(p, delimiter, (gsize)(end - p));
+            if (!p)
+                p = end;
+            g_string_append_len(cell, start, p - start);
+        }
+        g_ptr_array_add(cells, display_text(cell->str, cell->len, charset));
+        if (p >= end)
+            break;
+        p++;
+    }
+    g_string_free(cell, TRUE);
+}
+
+static gdouble parse_number(const char* text, gsize length)
+{
+    gchar buffer[64];
+    if (length == 0 || length >= sizeof(buffer))
+        return NAN;
+    memcpy(buffer, text, length);
+    buffer[length] = '\0';
+    gchar* end;
+    gdouble number = g_ascii_strtod(buffer, &end);
+    return end != buffer && *end == '\0' ? number : NAN;
+}
+
+// 数值排序时空单元格和非数字排在最后，不受降序影响；相等时保持文件中的顺序
+static gint compare_keys(gconstpointer a, gconstpointer b, gpointer data)
+{
+    const SortKey* x = (const SortKey*)a;
+    const SortKey* y = (const SortKey*)b;
+    const CsvJob* job = (const CsvJob*)data;
+    gint order;
+
+    if (job->numeric)
+    {
+        gboolean x_missing = isnan(x->number), y_missing = isnan(y->number);
+        if (x_missing || y_missing)
+            return x_missing == y_missing ? 0 : (x_missing ? 1 : -1);
+        order = x->number < y->number ? -1 : x->number > y->number;
+    }
+    else
+    {
+        order = memcmp(x->text, y->text, MIN(x->length, y->length));
+        if (order == 0)
+            order = (x->length > y->length) - (x->length < y->length);
+    }
+    return job->descending ? -order : order;
+}
+
+// 取出每行在该列的单元格作为排序键，排序后得到行号的排列
+static void sort_rows(CsvJob* job, const char* data, GCancellable* cancellable)
+{
+    guint count = row_count(job->rows);
+    guint first = MIN(job->first, count);
+    GArray* keys = g_array_sized_new(FALSE, FALSE, sizeof(SortKey), count - first);
+    guint numbers = 0, others = 0;
+
+    for (guint row = first; row < count; row++)
+    {
+        if (((row - first) & CSV_VIEW_CANCEL_CHECK) == 0 && g_cancellable_is_cancelled(cancellable))
+        {
+            g_array_free(keys, TRUE);
+            return;
+        }
+
+        const char* start;
+        const char* end;
+        row_bounds(data, job->rows, row, &start, &end);
+        SortKey key = { "", 0, row, NAN };
+        gsize length;
+        if (locate_cell(start, end, job->delimiter, (guint)job->column, &key.text, &length))
+        {
+            key.length = (guint32)MIN(length, G_MAXUINT32);
+            key.number = parse_number(key.text, length);
+            if (!isnan(key.number))
+                numbers++;
+            else if (length > 0)
+                others++;
+        }
+        g_array_append_val(keys, key);
+    }
+
+    job->numeric = numbers > 0 && others == 0;
+    g_array_sort_with_data(keys, compare_keys, job);
+
+    job->order = g_new(guint, MAX(keys->len, 1));
+    for (guint i = 0; i < keys->len; i++)
+        job->order[i] = g_array_index(keys, SortKey, i).row;
+    g_array_free(keys, TRUE);
+}
+
+static void csv_job_free(CsvJob* job)
+{
+    g_mapped_file_unref(job->file);
+    if (job->rows)
+        g_array_unref(job->rows);
+    g_free(job->order);
+    g_object_unref(job->cancellable);
+    g_free(job);
+}
+
+static void csv_job_thread(GTask* task, gpointer source, gpointer task_data, GCancellable* cancellable)
+{
+    CsvJob* job = (CsvJob*)task_data;
+
+    if (job->sort)
+        sort_rows(job, job->data, cancellable);
+    else
+        job->rows = build_row_index(job->data, job->size, cancellable);
+
+    if (!g_task_return_error_if_cancelled(task))
+        g_task_return_boolean(task, TRUE);
+}
+
+static void set_status(CsvView* view, const char* message)
+{
+    gtk_label_set_text(GTK_LABEL(view->status_label), message);
+}
+
+static guint display_count(CsvView* view)
+{
+    guint count = row_count(view->rows);
+    return count > view->first_data ? count - view->first_data : 0;
+}
+
+static guint row_at(CsvView* view, guint display)
+{
+    return view->order ? view->order[display] : view->first_data + display;
+}
+
+static gdouble gutter_width(CsvView* view)
+{
+    gint digits = 1;
+    for (guint count = row_count(view->rows); count >= 10; count /= 10)
+        digits++;
+    return (digits + 2) * view->char_width;
+}
+
+// 单元格左右各留一个字符的空白
+static gdouble column_width(CsvView* view, guint column)
+{
+    return (g_array_index(view->widths, gint, column) + 2) * view->char_width;
+}
+
+static gdouble table_width(CsvView* view)
+{
+    gdouble width = 0;
+    for (guint i = 0; i < view->widths->len; i++)
+        width += column_width(view, i);
+    return width;
+}
+
+static gdouble data_top(CsvView* view)
+{
+    return CSV_VIEW_MARGIN + view->row_height + 2;
+}
+
+static void measure_font(CsvView* view)
+{
+    PangoLayout* layout = gtk_widget_create_pango_layout(view->area, "0");
+    pango_layout_set_font_description(layout, view->font);
+    gint width, height;
+    pango_layout_get_pixel_size(layout, &width, &height);
+    view->char_width = width;
+    view->row_height = MAX(height, 1);
+    g_object_unref(layout);
+}
+
+static void update_adjustment(CsvView* view)
+{
+    gint width = gtk_widget_get_allocated_width(view->area);
+    gint height = gtk_widget_get_allocated_height(view->area) - (gint)data_top(view) - CSV_VIEW_MARGIN;
+    gdouble page = MAX(1, height / view->row_height);
+    gdouble rows = (gdouble)display_count(view);
+    gdouble value = MIN(gtk_adjustment_get_value(view->adjustment), MAX(0, rows - page));
+    gtk_adjustment_configure(view->adjustment, value, 0, rows, 1, page, page);
+
+    gdouble visible = MAX(1, width - 2 * CSV_VIEW_MARGIN - gutter_width(view));
+    gdouble total = MAX(visible, table_width(view));
+    gdouble hvalue = MIN(gtk_adjustment_get_value(view->hadjustment), total - visible);
+    gtk_adjustment_configure(view->hadjustment, hvalue, 0, total, view->char_width * CSV_VIEW_WHEEL_CHARS,
+                             visible, visible);
+    gtk_widget_queue_draw(view->area);
+}
+
+// 估算列宽之后出现更多列的行时，为新的列补上默认宽度
+static void ensure_columns(CsvView* view, guint count)
+{
+    if (count <= view->widths->len)
+        return;
+    gint width = CSV_VIEW_DEFAULT_WIDTH;
+    while (view->widths->len < count)
+        g_array_append_val(view->widths, width);
+    update_adjustment(view);
+}
+
+static guint cells_in_row(CsvView* view, guint row)
+{
+    const char* start;
+    const char* end;
+    row_bounds(view->data, view->rows, row, &start, &end);
+    return count_cells(start, end, view->delimiter);
+}
+
+// 检查标题行和可见的行是否有新的列。在滚动、大小变化和任务完成时调用，绘制时不修改滚动范围
+static void discover_columns(CsvView* view)
+{
+    if (!view->rows)
+        return;
+
+    guint count = view->widths->len;
+    if (view->first_data > 0 && row_count(view->rows) > 0)
+        count = MAX(count, cells_in_row(view, 0));
+    guint first = (guint)gtk_adjustment_get_value(view->adjustment);
+    guint visible = (guint)gtk_adjustment_get_page_size(view->adjustment) + 1;
+    for (guint i = 0; i < visible && first + i < display_count(view); i++)
+        count = MAX(count, cells_in_row(view, row_at(view, first + i)));
+    ensure_columns(view, count);
+}
+
+static void measure_columns(CsvView* view)
+{
+    GPtrArray* cells = g_ptr_array_new_with_free_func(g_free);
+    guint count = MIN(row_count(view->rows), CSV_VIEW_SAMPLE_ROWS);
+    for (guint row = 0; row < count; row++)
+    {
+        const char* start;
+        const char* end;
+        row_bounds(view->data, view->rows, row, &start, &end);
+        parse_row(start, end, view->delimiter, view->charset, cells);
+        for (guint i = 0; i < cells->len; i++)
+        {
+            gint width = CLAMP((gint)g_utf8_strlen(g_ptr_array_index(cells, i), -1), CSV_VIEW_MIN_WIDTH,
+                               CSV_VIEW_MAX_WIDTH);
+            if (i >= view->widths->len)
+                g_array_append_val(view->widths, width);
+            else
+                g_array_index(view->widths, gint, i) = MAX(g_array_index(view->widths, gint, i), width);
+        }
+    }
+    g_ptr_array_unref(cells);
+}
+
+// 标题行：首行为标题时取首行的单元格，否则为列序号；排序的列加上方向箭头
+static void header_cells(CsvView* view, GPtrArray* cells)
+{
+    if (view->first_data > 0 && row_count(view->rows) > 0)
+    {
+        const char* start;
+        const char* end;
+        row_bounds(view->data, view->rows, 0, &start, &end);
+        parse_row(start, end, view->delimiter, view->charset, cells);
+    }
+    else
+    {
+        g_ptr_array_set_size(cells, 0);
+    }
+    for (guint i = cells->len; i < view->widths->len; i++)
+        g_ptr_array_add(cells, g_strdup_printf("列 %u", i + 1));
+
+    if (view->sort_column >= 0 && (guint)view->sort_column < cells->len)
+    {
+        gchar* name = g_ptr_array_index(cells, view->sort_column);
+        g_ptr_array_index(cells, view->sort_column) =
+            g_strdup_printf("%s %s", view->descending ? "▼" : "▲", name);
+        g_free(name);
+    }
+}
+
+// 只绘制与可见区域相交的单元格，超出列宽的内容以省略号结尾
+static void draw_cells(CsvView* view, cairo_t* cr, PangoLayout* layout, GPtrArray* cells, gdouble x, gdouble y,
+                       gdouble left, gdouble right)
+{
+    for (guint i = 0; i < cells->len && i < view->widths->len && x < right; i++)
+    {
+        gdouble width = column_width(view, i);
+        if (x + width > left)
+        {
+            const char* text = g_ptr_array_index(cells, i);
+            pango_layout_set_width(layout, (gint)((width - 2 * view->char_width) * PANGO_SCALE));
+            pango_layout_set_text(layout, text, -1);
+            cairo_move_to(cr, x + view->char_width, y);
+            pango_cairo_show_layout(cr, layout);
+        }
+        x += width;
+    }
+}
+
+static gboolean on_csv_draw(GtkWidget* widget, cairo_t* cr, gpointer data)
+{
+    CsvView* view = (CsvView*)data;
+    GtkStyleContext* style = gtk_widget_get_style_context(widget);
+    gint width = gtk_widget_get_allocated_width(widget);
+    gint height = gtk_widget_get_allocated_height(widget);
+    gtk_render_background(style, cr, 0, 0, width, height);
+    if (!view->rows)
+        return FALSE;
+
+    GdkRGBA color;
+    gtk_style_context_get_color(style, gtk_style_context_get_state(style), &color);
+    PangoLayout* layout = gtk_widget_create_pango_layout(widget, NULL);
+    pango_layout_set_font_description(layout, view->font);
+    pango_layout_set_single_paragraph_mode(layout, TRUE);
+    pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
+    GPtrArray* cells = g_ptr_array_new_with_free_func(g_free);
+
+    gdouble left = CSV_VIEW_MARGIN + gutter_width(view);
+    gdouble right = width - CSV_VIEW_MARGIN;
+    gdouble x = left - gtk_adjustment_get_value(view->hadjustment);
+    gdouble top = data_top(view);
+    guint first = (guint)gtk_adjustment_get_value(view->adjustment);
+    gint visible = (gint)((height - top) / view->row_height) + 1;
+
+    // 标题行的背景
+    cairo_set_source_rgba(cr, 0.5, 0.5, 0.5, 0.15);
+    cairo_rectangle(cr, 0, CSV_VIEW_MARGIN, width, view->row_height);
+    cairo_fill(cr);
+
+    // 行号不随水平滚动，显示行在文件中的序号
+    gdk_cairo_set_source_rgba(cr, &color);
+    for (gint i = 0; i < visible && first + (guint)i < display_count(view); i++)
+    {
+        guint display = first + (guint)i;
+        gdouble y = top + i * view->row_height;
+        if ((gint64)display == view->selected)
+        {
+            cairo_set_source_rgba(cr, 0.2, 0.5, 0.9, 0.35);
+            cairo_rectangle(cr, 0, y, width, view->row_height);
+            cairo_fill(cr);
+            gdk_cairo_set_source_rgba(cr, &color);
+        }
+        gchar* number = g_strdup_printf("%u", row_at(view, display) + 1);
+        pango_layout_set_width(layout, -1);
+        pango_layout_set_text(layout, number, -1);
+        cairo_move_to(cr, CSV_VIEW_MARGIN, y);
+        pango_cairo_show_layout(cr, layout);
+        g_free(number);
+    }
+
+    // 单元格只在行号列右侧绘制
+    cairo_save(cr);
+    cairo_rectangle(cr, left, 0, MAX(0, right - left), height);
+    cairo_clip(cr);
+
+    header_cells(view, cells);
+    gdk_cairo_set_source_rgba(cr, &color);
+    draw_cells(view, cr, layout, cells, x, CSV_VIEW_MARGIN, left, right);
+
+    for (gint i = 0; i < visible && first + (guint)i < display_count(view); i++)
+    {
+        const char* start;
+        const char* end;
+        row_bounds(view->data, view->rows, row_at(view, first + (guint)i), &start, &end);
+        parse_row(start, end, view->delimiter, view->charset, cells);
+        draw_cells(view, cr, layout, cells, x, top + i * view->row_height, left, right);
+    }
+
+    // 网格线
+    cairo_set_source_rgba(cr, 0.5, 0.5, 0.5, 0.4);
+    cairo_set_line_width(cr, 1);
+    gdouble column_x = x;
+    for (guint i = 0; i < view->widths->len && column_x < right; i++)
+    {
+        column_x += column_width(view, i);
+        cairo_move_to(cr, floor(column_x) + 0.5, CSV_VIEW_MARGIN);
+        cairo_line_to(cr, floor(column_x) + 0.5, height);
+    }
+    cairo_stroke(cr);
+    cairo_restore(cr);
+
+    cairo_set_source_rgba(cr, 0.5, 0.5, 0.5, 0.4);
+    cairo_move_to(cr, 0, floor(top) - 0.5);
+    cairo_line_to(cr, width, floor(top) - 0.5);
+    cairo_move_to(cr, floor(left) - 0.5, CSV_VIEW_MARGIN);
+    cairo_line_to(cr, floor(left) - 0.5, height);
+    cairo_stroke(cr);
+
+    g_ptr_array_unref(cells);
+    g_object_unref(layout);
+    return FALSE;
+}
+
+// 窗口左侧 x 处的列，不在任何列上时返回 -1
+static gint column_at(CsvView* view, gdouble x)
+{
+    gdouble column_x = CSV_VIEW_MARGIN + gutter_width(view) - gtk_adjustment_get_value(view->hadjustment);
+    if (x < CSV_VIEW_MARGIN + gutter_width(view))
+        return -1;
+    for (guint i = 0; i < view->widths->len; i++)
+    {
+        column_x += column_width(view, i);
+        if (x < column_x)
+            return (gint)i;
+    }
+    return -1;
+}
+
+static void show_cell(CsvView* view, gint column)
+{
+    guint row = row_at(view, (guint)view->selected);
+    const char* start;
+    const char* end;
+    row_bounds(view->data, view->rows, row, &start, &end);
+
+    gchar* status;
+    GPtrArray* cells = g_ptr_array_new_with_free_func(g_free);
+    parse_row(start, end, view->delimiter, view->charset, cells);
+    if (column >= 0 && (guint)column < cells->len)
+    {
+        const gchar* text = g_ptr_array_index(cells, column);
+        gchar* preview = g_utf8_substring(text, 0, MIN(g_utf8_strlen(text, -1), CSV_VIEW_CELL_PREVIEW));
+        status = g_strdup_printf("第 %u 行，第 %d 列：%s", row + 1, column + 1, preview);
+        g_free(preview);
+    }
+    else
+    {
+        status = g_strdup_printf("第 %u 行，共 %u 列", row + 1, cells->len);
+    }
+    set_status(view, status);
+    g_free(status);
+    g_ptr_array_unref(cells);
+}
+
+static void select_row(CsvView* view, gint64 index)
+{
+    if (display_count(view) == 0)
+        return;
+    index = CLAMP(index, 0, (gint64)display_count(view) - 1);
+    view->selected = index;
+
+    gdouble value = gtk_adjustment_get_value(view->adjustment);
+    gdouble page = gtk_adjustment_get_page_size(view->adjustment);
+    if (index < value)
+        gtk_adjustment_set_value(view->adjustment, (gdouble)index);
+    else if (index >= value + page)
+        gtk_adjustment_set_value(view->adjustment, (gdouble)index - page + 1);
+    gtk_widget_queue_draw(view->area);
+}
+
+static void cancel_job(CsvView* view)
+{
+    if (view->job)
+    {
+        g_cancellable_cancel(view->job->cancellable);
+        view->job->view = NULL;
+        view->job = NULL;
+    }
+}
+
+static void csv_job_done(GObject* source, GAsyncResult* result, gpointer data)
+{
+    CsvJob* job = (CsvJob*)data;
+    CsvView* view = job->view;
+    GError* error = NULL;
+
+    if (!g_task_propagate_boolean(G_TASK(result), &error) || !view)
+    {
+        g_clear_error(&error);
+        csv_job_free(job);
+        return;
+    }
+    view->job = NULL;
+
+    gchar* status;
+    gint64 elapsed = (g_get_monotonic_time() - job->start_time) / 1000;
+    if (job->sort)
+    {
+        g_free(view->order);
+        view->order = job->order;
+        job->order = NULL;
+        view->sort_column = job->column;
+        view->descending = job->descending;
+        view->selected = -1;
+        status = g_strdup_printf("已按第 %d 列%s%s（%" G_GINT64_FORMAT " 毫秒）", job->column + 1,
+                                 job->numeric ? "数值" : "", job->descending ? "降序排列" : "升序排列", elapsed);
+    }
+    else
+    {
+        view->rows = g_array_ref(job->rows);
+        measure_columns(view);
+        status = g_strdup_printf("%u 行，%u 列（建立行索引 %" G_GINT64_FORMAT " 毫秒）", row_count(view->rows),
+                                 view->widths->len, elapsed);
+    }
+    update_adjustment(view);
+    discover_columns(view);
+    set_status(view, status);
+    g_free(status);
+    csv_job_free(job);
+}
+
+static void start_job(CsvView* view, CsvJob* job, const char* status)
+{
+    job->view = view;
+    job->file = g_mapped_file_ref(view->file);
+    job->data = view->data;
+    job->size = view->size;
+    job->delimiter = view->delimiter;
+    job->cancellable = g_cancellable_new();
+    job->start_time = g_get_monotonic_time();
+    view->job = job;
+    set_status(view, status);
+
+    GTask* task = g_task_new(NULL, job->cancellable, csv_job_done, job);
+    g_task_set_task_data(task, job, NULL);
+    g_task_run_in_thread(task, csv_job_thread);
+    g_object_unref(task);
+}
+
+// 再次点击同一列时切换升序和降序
+static void start_sort(CsvView* view, gint column)
+{
+    if (!view->rows || view->job)
+        return;
+
+    CsvJob* job = g_new0(CsvJob, 1);
+    job->sort = TRUE;
+    job->rows = g_array_ref(view->rows);
+    job->first = view->first_data;
+    job->column = column;
+    job->descending = column == view->sort_column && !view->descending;
+    start_job(view, job, "正在排序…");
+}
+
+static gboolean on_csv_button_press(GtkWidget* widget, GdkEventButton* event, gpointer data)
+{
+    CsvView* view = (CsvView*)data;
+    gtk_widget_grab_focus(widget);
+    if (event->button != GDK_BUTTON_PRIMARY || event->y < CSV_VIEW_MARGIN || !view->rows)
+        return FALSE;
+
+    gint column = column_at(view, event->x);
+    if (event->y < data_top(view))
+    {
+        if (column >= 0)
+            start_sort(view, column);
+        return TRUE;
+    }
+
+    gint64 index = (gint64)gtk_adjustment_get_value(view->adjustment) +
+                   (gint64)((event->y - data_top(view)) / view->row_height);
+    if (index < (gint64)display_count(view))
+    {
+        select_row(view, index);
+        show_cell(view, column);
+    }
+    return TRUE;
+}
+
+static gboolean on_csv_key_press(GtkWidget* widget, GdkEventKey* event, gpointer data)
+{
+    CsvView* view = (CsvView*)data;
+    gint64 page = (gint64)gtk_adjustment_get_page_size(view->adjustment);
+    gdouble hvalue = gtk_adjustment_get_value(view->hadjustment);
+
+    switch (event->keyval)
+    {
+        case GDK_KEY_Up:
+            select_row(view, view->selected - 1);
+            break;
+        case GDK_KEY_Down:
+            select_row(view, view->selected + 1);
+            break;
+        case GDK_KEY_Page_Up:
+            select_row(view, view->selected - page);
+            break;
+        case GDK_KEY_Page_Down:
+            select_row(view, view->selected + page);
+            break;
+        case GDK_KEY_Home:
+            select_row(view, 0);
+            break;
+        case GDK_KEY_End:
+            select_row(view, (gint64)display_count(view) - 1);
+            break;
+        case GDK_KEY_Left:
+            gtk_adjustment_set_value(view->hadjustment, hvalue - view->char_width * CSV_VIEW_WHEEL_CHARS);
+            break;
+        case GDK_KEY_Right:
+            gtk_adjustment_set_value(view->hadjustment, hvalue + view->char_width * CSV_VIEW_WHEEL_CHARS);
+            break;
+        default:
+            return FALSE;
+    }
+    return TRUE;
+}
+
+// 按住 Shift 滚动或触控板的水平分量滚动单元格区域
+static gboolean on_csv_scroll(GtkWidget* widget, GdkEventScroll* event, gpointer data)
+{
+    CsvView* view = (CsvView*)data;
+    gdouble delta = 0, hdelta = 0;
+    gdouble dx, dy;
+    gdouble step = view->char_width * CSV_VIEW_WHEEL_CHARS;
+
+    switch (event->direction)
+    {
+        case GDK_SCROLL_UP:
+            delta = -CSV_VIEW_WHEEL_ROWS;
+            break;
+        case GDK_SCROLL_DOWN:
+            delta = CSV_VIEW_WHEEL_ROWS;
+            break;
+        case GDK_SCROLL_LEFT:
+            hdelta = -step;
+            break;
+        case GDK_SCROLL_RIGHT:
+            hdelta = step;
+            break;
+        case GDK_SCROLL_SMOOTH:
+            gdk_event_get_scroll_deltas((GdkEvent*)event, &dx, &dy);
+            delta = dy * CSV_VIEW_WHEEL_ROWS;
+            hdelta = dx * step;
+            break;
+        default:
+            return FALSE;
+    }
+
+    if (event->state & GDK_SHIFT_MASK)
+    {
+        hdelta += delta / CSV_VIEW_WHEEL_ROWS * step;
+        delta = 0;
+    }
+    gtk_adjustment_set_value(view->adjustment, gtk_adjustment_get_value(view->adjustment) + delta);
+    gtk_adjustment_set_value(view->hadjustment, gtk_adjustment_get_value(view->hadjustment) + hdelta);
+    return TRUE;
+}
+
+static void on_csv_size_allocate(GtkWidget* widget, GdkRectangle* allocation, gpointer data)
+{
+    CsvView* view = (CsvView*)data;
+    update_adjustment(view);
+    discover_columns(view);
+}
+
+static void on_adjustment_changed(GtkAdjustment* adjustment, gpointer data)
+{
+    CsvView* view = (CsvView*)data;
+    gtk_widget_queue_draw(view->area);
+}
+
+// 纵向滚动后可见的行可能有更多的列
+static void on_row_adjustment_changed(GtkAdjustment* adjustment, gpointer data)
+{
+    CsvView* view = (CsvView*)data;
+    discover_columns(view);
+    gtk_widget_queue_draw(view->area);
+}
+
+// 切换首行是否为标题时原来的排序不再对应，取消进行中的排序
+static void on_header_toggled(GtkToggleButton* button, gpointer data)
+{
+    CsvView* view = (CsvView*)data;
+    view->first_data = gtk_toggle_button_get_active(button) ? 1 : 0;
+    if (view->job && view->job->sort)
+        cancel_job(view);
+    g_free(view->order);
+    view->order = NULL;
+    view->sort_column = -1;
+    view->selected = -1;
+    update_adjustment(view);
+    discover_columns(view);
+}
+
+static void on_csv_view_destroy(GtkWidget* widget, gpointer data)
+{
+    CsvView* view = (CsvView*)data;
+    cancel_job(view);
+    if (view->rows)
+        g_array_unref(view->rows);
+    g_array_unref(view->widths);
+    g_free(view->order);
+    g_mapped_file_unref(view->file);
+    pango_font_description_free(view->font);
+    g_free(view);
+}
+
+gboolean csv_view_open(GtkWindow* parent, const char* filename, GError** error)
+{
+    // 只建立映射，页面在建立索引和绘制时才由系统按需读入
+    GMappedFile* file = g_mapped_file_new(filename, FALSE, error);
+    if (!file)
+        return FALSE;
+
+    // 跳过 BOM；分隔符和引号按单字节查找，UTF-16 的文件无法按字节分隔
+    const char* contents = g_mapped_file_get_contents(file);
+    gsize length = g_mapped_file_get_length(file);
+    TextEncoding encoding;
+    gsize bom_length;
+    encoding_detect((const guchar*)contents, MIN(length, CSV_VIEW_ENCODING_PROBE), &encoding, &bom_length);
+    if (g_str_has_prefix(encoding.charset, "UTF-16"))
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                    "表格查看不支持 %s 编码的文件，请先按文本打开并转换为 UTF-8 或 GB18030", encoding.charset);
+        g_mapped_file_unref(file);
+        return FALSE;
+    }
+
+    CsvView* view = g_new0(CsvView, 1);
+    view->file = file;
+    view->data = contents + bom_length;
+    view->size = length - bom_length;
+    if (!encoding.bom && !head_is_utf8(view->data, view->size))
+        encoding.charset = "GB18030";
+    view->charset = strcmp(encoding.charset, "UTF-8") == 0 ? NULL : encoding.charset;
+    view->delimiter = detect_delimiter(filename, view->data, view->size);
+    view->widths = g_array_new(FALSE, FALSE, sizeof(gint));
+    view->first_data = 1;
+    view->sort_column = -1;
+    view->selected = -1;
+    view->font = pango_font_description_from_string("Monospace 10");
+
+    gchar* basename = g_path_get_basename(filename);
+    gchar* title = g_strdup_printf("表格查看 - %s", basename);
+    view->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(view->window), title);
+    gtk_window_set_transient_for(GTK_WINDOW(view->window), parent);
+    gtk_window_set_default_size(GTK_WINDOW(view->window), 900, 600);
+    g_free(title);
+    g_free(basename);
+
+    GtkWidget* vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    gtk_container_add(GTK_CONTAINER(view->window), vbox);
+
+    GtkWidget* toolbar = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+    gtk_container_set_border_width(GTK_CONTAINER(toolbar), 5);
+    view->header_check = gtk_check_button_new_with_label("首行为标题");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(view->header_check), TRUE);
+    gchar* encoding_name = encoding_display_name(&encoding);
+    gchar* delimiter_text = g_strdup_printf("分隔符: %s  编码: %s", view->delimiter == '\t' ? "Tab" :
+                                            view->delimiter == ',' ? "逗号" :
+                                            view->delimiter == ';' ? "分号" : "竖线", encoding_name);
+    g_free(encoding_name);
+    gtk_box_pack_start(GTK_BOX(toolbar), view->header_check, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), gtk_label_new(delimiter_text), FALSE, FALSE, 10);
+    gtk_box_pack_start(GTK_BOX(toolbar), gtk_label_new("点击列标题排序"), FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(vbox), toolbar, FALSE, FALSE, 0);
+    g_free(delimiter_text);
+
+    // 表格区域和按行滚动的滚动条，水平滚动条以像素为单位
+    GtkWidget* grid = gtk_grid_new();
+    view->adjustment = gtk_adjustment_new(0, 0, 1, 1, 1, 1);
+    view->hadjustment = gtk_adjustment_new(0, 0, 1, 1, 1, 1);
+    view->area = gtk_drawing_area_new();
+    gtk_widget_set_hexpand(view->area, TRUE);
+    gtk_widget_set_vexpand(view->area, TRUE);
+    gtk_widget_set_can_focus(view->area, TRUE);
+    gtk_widget_add_events(view->area, GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK | GDK_BUTTON_PRESS_MASK |
+                                      GDK_KEY_PRESS_MASK);
+    gtk_grid_attach(GTK_GRID(grid), view->area, 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), gtk_scrollbar_new(GTK_ORIENTATION_VERTICAL, view->adjustment), 1, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), gtk_scrollbar_new(GTK_ORIENTATION_HORIZONTAL, view->hadjustment), 0, 1, 1, 1);
+    gtk_box_pack_start(GTK_BOX(vbox), grid, TRUE, TRUE, 0);
+
+    view->status_label = gtk_label_new(NULL);
+    gtk_widget_set_halign(view->status_label, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(view->status_label, 10);
+    gtk_widget_set_margin_top(view->status_label, 3);
+    gtk_widget_set_margin_bottom(view->status_label, 3);
+    gtk_label_set_ellipsize(GTK_LABEL(view->status_label), PANGO_ELLIPSIZE_END);
+    gtk_box_pack_start(GTK_BOX(vbox), view->status_label, FALSE, FALSE, 0);
+
+    measure_font(view);
+
+    g_signal_connect(view->area, "draw", G_CALLBACK(on_csv_draw), view);
+    g_signal_connect(view->area, "size-allocate", G_CALLBACK(on_csv_size_allocate), view);
+    g_signal_connect(view->area, "scroll-event", G_CALLBACK(on_csv_scroll), view);
+    g_signal_connect(view->area, "key-press-event", G_CALLBACK(on_csv_key_press), view);
+    g_signal_connect(view->area, "button-press-event", G_CALLBACK(on_csv_button_press), view);
+    g_signal_connect(view->adjustment, "value-changed", G_CALLBACK(on_row_adjustment_changed), view);
+    g_signal_connect(view->hadjustment, "value-changed", G_CALLBACK(on_adjustment_changed), view);
+    g_signal_connect(view->header_check, "toggled", G_CALLBACK(on_header_toggled), view);
+    g_signal_connect(view->window, "destroy", G_CALLBACK(on_csv_view_destroy), view);
+
+    gtk_widget_show_all(view->window);
+    gtk_widget_grab_focus(view->area);
+
+    gchar* size_text = g_format_size(view->size);
+    gchar* status = g_strdup_printf("正在建立行索引（%s）…", size_text);
+    start_job(view, g_new0(CsvJob, 1), status);
+    g_free(status);
+    g_free(size_text);
+    return TRUE;
+}
@@ -0,0 +1,21 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef CSV_VIEW_H
+#define CSV_VIEW_H
+
+#include <gtk/gtk.h>
+
+#define CSV_VIEW_PART_MIN       (4 * 1024 * 1024)   // 建立行索引时每个线程至少分到的字节数
+#define CSV_VIEW_SAMPLE_ROWS    1000                // 按前这么多行估算列宽
+#define CSV_VIEW_MAX_WIDTH      40                  // 列的最大宽度（字符数）
+#define CSV_VIEW_SUGGEST_SIZE   (64 * 1024 * 1024)  // 打开这么大的 CSV/TSV 文件时建议用表格查看
+
+// CSV/TSV 表格查看器：通过 mmap 访问文件，不载入文本缓冲区。后台并行建立行索引（引号内的换行不分行），
+// 只解析和绘制可见行的单元格。点击列标题在后台按该列排序，排序结果是行号的排列，不修改文件。
+// 在独立的窗口中只读显示，关闭窗口时释放
+extern gboolean csv_view_open(GtkWindow* parent, const char* filename, GError** error);
+extern gboolean csv_view_is_table_file(const char* filename);   // 按扩展名判断是否为 CSV/TSV 文件
+
+#endif // CSV_VIEW_H
@@ -0,0 +1,116 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "doc_stats.h"
+
+typedef enum CharClass
+{
+    CHAR_SEPARATOR,     // 空白和中日韩标点
+    CHAR_CJK,           // 中日韩字符，每个字符独立成词
+    CHAR_WORD           // 其他字符，连续的一段算一个词
+} CharClass;
+
+gboolean doc_stats_is_cjk(gunichar c)
+{
+    return (c >= 0x4E00 && c <= 0x9FFF) ||      // CJK 统一汉字
+           (c >= 0x3400 && c <= 0x4DBF) ||      // 扩展 A
+           (c >= 0x20000 && c <= 0x3134F) ||    // 扩展 B 及以后
+           (c >= 0xF900 && c <= 0xFAFF) ||      // 兼容汉字
+           (c >= 0x3040 && c <= 0x30FF) ||      // 平假名、片假名
+           (c >= 0xAC00 && c <= 0xD7AF);        // 韩文音节
+}
+
+static inline CharClass classify(gunichar c)
+{
+    if (c < 0x80)
+        return g_ascii_isspace((gchar)c) || c == 0 ? CHAR_SEPARATOR : CHAR_WORD;
+    if (doc_stats_is_cjk(c))
+        return CHAR_CJK;
+    if (g_unichar_isspace(c) || (c >= 0x2E80 && g_unichar_ispunct(c)))
+        return CHAR_SEPARATOR;
+    return CHAR_WORD;
+}
+
+// 以 previous 为前一个字符的类别，统计 text 中的词数、字符数等
+static CharClass count_span(CharClass previous, const char* text, gsize length, DocStats* stats)
+{
+    const char* p = text;
+    const char* end = text + length;
+
+    while (p < end)
+    {
+        guchar byte = (guchar)*p;
+        if (byte < 0x80)
+        {
+            // ASCII 快速路径
+            CharClass cls = (byte == ' ' || (byte >= '\t' && byte <= '\r') || byte == 0) ? CHAR_SEPARATOR : CHAR_WORD;
+            if (cls == CHAR_WORD && previous != CHAR_WORD)
+                stats->words++;
+            if (byte == '\n' || (byte == '\r' && (p + 1 >= end || p[1] != '\n')))
+                stats->lines++;
+            previous = cls;
+            stats->chars++;
+            p++;
+            continue;
+        }
+
+        gunichar c = g_utf8_get_char(p);
+        CharClass cls = classify(c);
+        if (cls == CHAR_CJK)
+        {
+            stats->cjk++;
+            stats->words++;
+        }
+        else if (cls == CHAR_WORD && previous != CHAR_WORD)
+        {
+            stats->words++;
+        }
+        if (c == 0x2029)
+            stats->lines++;
+
+        previous = cls;
+        stats->chars++;
+        p = g_utf8_next_char(p);
+    }
+
+    return previous;
+}
+
+void doc_stats_count(const char* text, gsize length, DocStats* stats)
+{
+    stats->chars = 0;
+    stats->words = 0;
+    stats->lines = 0;
+    stats->cjk = 0;
+    stats->bytes = (gint64)length;
+    count_span(CHAR_SEPARATOR, text, length, stats);
+}
+
+// 词数变化 = 词数(before + text + after) - 词数(before + after)。
+// before 本身是否为词首在两边相同，可以抵消；after 之后的字符只依赖 after，不受影响
+void doc_stats_edit_delta(gunichar before, const char* text, gsize length, gunichar after, DocStats* delta)
+{
+    CharClass before_class = before ? classify(before) : CHAR_SEPARATOR;
+    CharClass after_class = after ? classify(after) : CHAR_SEPARATOR;
+
+    doc_stats_count(text, 0, delta);
+    CharClass last = count_span(before_class, text, length, delta);
+    delta->bytes = (gint64)length;
+
+    // after 是否成为词首
+    gboolean after_starts_with_text = after_class == CHAR_WORD && last != CHAR_WORD;
+    gboolean after_starts_without_text = after_class == CHAR_WORD && before_class != CHAR_WORD;
+    delta->words += (gint64)after_starts_with_text - (gint64)after_starts_without_text;
+
+    // 行数变化交给 GtkTextBuffer，\r 与 \n 跨越编辑边界拼接的情况这里不处理
+}
+
+void doc_stats_add(DocStats* total, const DocStats* delta, gint sign)
+{
+    total->chars += sign * delta->chars;
+    total->words += sign * delta->words;
+    total->lines += sign * delta->lines;
+    total->bytes += sign * delta->bytes;
+    total->cjk += sign * delta->cjk;
+}
@@ -0,0 +1,32 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef DOC_STATS_H
+#define DOC_STATS_H
+
+#include <glib.h>
+
+// 文档统计信息
+typedef struct DocStats
+{
+    gint64 chars;       // 字符数
+    gint64 words;       // 词数（每个中日韩字符单独计为一个词）
+    gint64 lines;       // 换行数（\r\n 计为一个）
+    gint64 bytes;       // UTF-8 字节数
+    gint64 cjk;         // 中日韩字符数
+} DocStats;
+
+extern gboolean doc_stats_is_cjk(gunichar c);
+
+// 完整统计一段文本
+extern void doc_stats_count(const char* text, gsize length, DocStats* stats);
+
+// 计算在字符 before 与 after 之间插入 text 带来的统计变化（0 表示文档边界）。
+// 删除同一段文本时，变化量取反即可
+extern void doc_stats_edit_delta(gunichar before, const char* text, gsize length, gunichar after, DocStats* delta);
+
+// total += sign * delta
+extern void doc_stats_add(DocStats* total, const DocStats* delta, gint sign);
+
+#endif // DOC_STATS_H
@@ -0,0 +1,714 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "encoding.h"
+#include <string.h>
+
+#define ENCODING_CARRY_SIZE 16      // 块末尾不完整字符最多的字节数
+#define UTF16_PROBE_SIZE    4096    // 判断无 BOM 的 UTF-16 时检查的字节数
+
+typedef enum
+{
+    DECODE_OK,
+    DECODE_ERROR,
+    DECODE_NOT_UTF8         // 猜测为 UTF-8 但内容无效，需要按 GB18030 重新解码
+} DecodeResult;
+
+static const guchar utf8_bom[] = { 0xEF, 0xBB, 0xBF };
+static const guchar utf16le_bom[] = { 0xFF, 0xFE };
+static const guchar utf16be_bom[] = { 0xFE, 0xFF };
+
+void encoding_init_default(TextEncoding* encoding)
+{
+    encoding->charset = "UTF-8";
+    encoding->bom = FALSE;
+}
+
+static gboolean is_utf8(const TextEncoding* encoding)
+{
+    return strcmp(encoding->charset, "UTF-8") == 0;
+}
+
+void encoding_detect(const guchar* head, gsize length, TextEncoding* encoding, gsize* bom_length)
+{
+    encoding_init_default(encoding);
+    *bom_length = 0;
+
+    if (length >= 3 && memcmp(head, utf8_bom, 3) == 0)
+    {
+        encoding->bom = TRUE;
+        *bom_length = 3;
+        return;
+    }
+    if (length >= 2 && memcmp(head, utf16le_bom, 2) == 0)
+    {
+        encoding->charset = "UTF-16LE";
+        encoding->bom = TRUE;
+        *bom_length = 2;
+        return;
+    }
+    if (length >= 2 && memcmp(head, utf16be_bom, 2) == 0)
+    {
+        encoding->charset = "UTF-16BE";
+        encoding->bom = TRUE;
+        *bom_length = 2;
+        return;
+    }
+
+    // 没有 BOM 的 UTF-16：大部分字符是 ASCII 时，零字节集中在奇数或偶数位置
+    gsize probe = MIN(length, UTF16_PROBE_SIZE) & ~(gsize)1;
+    if (probe >= 4)
+    {
+        gsize even_zeros = 0, odd_zeros = 0;
+        for (gsize i = 0; i < probe; i += 2)
+        {
+            even_zeros += head[i] == 0;
+            odd_zeros += head[i + 1] == 0;
+        }
+        gsize pairs = probe / 2;
+        if (odd_zeros * 10 > pairs * 4 && even_zeros * 20 < pairs)
+            encoding->charset = "UTF-16LE";
+        else if (even_zeros * 10 > pairs * 4 && odd_zeros * 20 < pairs)
+            encoding->charset = "UTF-16BE";
+    }
+}
+
+gchar* encoding_display_name(const TextEncoding* encoding)
+{
+    return encoding->bom ? g_strdup_printf("%s BOM", encoding->charset) : g_strdup(encoding->charset);
+}
+
+gboolean encoding_parse_name(const char* name, TextEncoding* encoding)
+{
+    static const gchar* charsets[] = { "UTF-8", "GB18030", "UTF-16LE", "UTF-16BE" };
+
+    gsize length = strlen(name);
+    gboolean bom = length > 4 && g_ascii_strcasecmp(name + length - 4, " BOM") == 0;
+    gchar* charset = g_strndup(name, bom ? length - 4 : length);
+    if (g_ascii_strcasecmp(charset, "GBK") == 0 || g_ascii_strcasecmp(charset, "GB2312") == 0)
+    {
+        g_free(charset);
+        charset = g_strdup("GB18030");
+    }
+
+    gboolean found = FALSE;
+    for (gsize i = 0; i < G_N_ELEMENTS(charsets) && !found; i++)
+    {
+        if (g_ascii_strcasecmp(charset, charsets[i]) == 0)
+        {
+            encoding->charset = charsets[i];
+            encoding->bom = bom;
+            found = TRUE;
+        }
+    }
+    g_free(charset);
+
+    // GB18030 没有字节顺序标记
+    return found && !(bom && strcmp(encoding->charset, "GB18030") == 0);
+}
+
+gboolean encoding_file_looks_binary(const char* filename, GCancellable* cancellable)
+{
+    GFile* file = g_file_new_for_path(filename);
+    GFileInputStream* in = g_file_read(file, cancellable, NULL);
+    g_object_unref(file);
+    if (!in)
+        return FALSE;
+
+    guchar head[ENCODING_BINARY_PROBE];
+    gsize length = 0;
+    gboolean binary = FALSE;
+    if (g_input_stream_read_all(G_INPUT_STREAM(in), head, sizeof(head), &length, cancellable, NULL))
+    {
+        // UTF-16 的 ASCII 字符本身就带零字节
+        TextEncoding encoding;
+        gsize bom_length;
+        encoding_detect(head, length, &encoding, &bom_length);
+        binary = !g_str_has_prefix(encoding.charset, "UTF-16") && memchr(head, '\0', length) != NULL;
+    }
+    g_object_unref(in);
+    return binary;
+}
+
+// 转换一段输入并追加到 out。输入末尾不完整的字符留给下一块，consumed 返回实际用掉的字节数
+static gboolean convert_into(GConverter* converter, const char* in, gsize in_length, gboolean at_end,
+                             GString* out, gsize* consumed, GError** error)
+{
+    *consumed = 0;
+    while (TRUE)
+    {
+        // 转为 UTF-8 时每个输入字节最多产生 1.5 个输出字节，预留后 out 不需要再次扩容
+        gsize room = in_length + in_length / 2 + ENCODING_CARRY_SIZE;
+        gsize old_length = out->len;
+        g_string_set_size(out, old_length + room);
+
+        gsize bytes_read = 0, bytes_written = 0;
+        GError* local_error = NULL;
+        GConverterResult result = g_converter_convert(converter, in, in_length, out->str + old_length, room,
+                                                      at_end ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS,
+                                                      &bytes_read, &bytes_written, &local_error);
+        g_string_truncate(out, old_length + bytes_written);
+
+        if (result == G_CONVERTER_ERROR)
+        {
+            if (!at_end && g_error_matches(local_error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT))
+            {
+                g_error_free(local_error);
+                return TRUE;
+            }
+            g_propagate_error(error, local_error);
+            return FALSE;
+        }
+
+        in += bytes_read;
+        in_length -= bytes_read;
+        *consumed += bytes_read;
+        if (result == G_CONVERTER_FINISHED || (in_length == 0 && !at_end))
+            return TRUE;
+    }
+}
+
+// 检查 text 中 [*validated, len) 是否为 UTF-8。末尾不完整的字符留到下一块再检查；
+// NUL 字节不算无效
+static gboolean validate_utf8(const GString* text, gsize* validated, gboolean at_end)
+{
+    const gchar* p = text->str + *validated;
+    const gchar* end = text->str + text->len;
+
+    while (p < end)
+    {
+        const gchar* invalid;
+        if (g_utf8_validate(p, end - p, &invalid))
+        {
+            p = end;
+            break;
+        }
+        if (*invalid == '\0')
+        {
+            p = invalid + 1;
+            continue;
+        }
+        if (!at_end && g_utf8_get_char_validated(invalid, end - invalid) == (gunichar)-2)
+        {
+            p = invalid;
+            break;
+        }
+        return FALSE;
+    }
+
+    *validated = (gsize)(p - text->str);
+    return TRUE;
+}
+
+// 解码整个流。chunk 不为 NULL 时每块转换好的文本交给 chunk 后即丢弃，不返回全文
+static DecodeResult decode_stream(GInputStream* in, gsize size_hint, const TextEncoding* forced,
+                                  TextEncoding* encoding, GString** out_text, guint64* out_hash,
+                                  EncodingProgressFunc progress, gpointer progress_data,
+                                  EncodingChunkFunc chunk, gpointer chunk_data,
+                                  GCancellable* cancellable, GError** error)
+{
+    guchar* buffer = g_malloc(ENCODING_CARRY_SIZE + ENCODING_CHUNK_SIZE);
+    GConverter* converter = NULL;
+    GString* text = NULL;
+    ContentHash hash;
+    content_hash_init(&hash);
+
+    DecodeResult result = DECODE_ERROR;
+    gsize carry = 0;
+    gsize validated = 0;
+    guint64 total_read = 0;
+    gboolean first = TRUE;
+    gboolean at_end = FALSE;
+
+    while (!at_end)
+    {
+        // 读满一块（或到文件末尾），首块足够长才能可靠地检测编码
+        gsize n = 0;
+        if (!g_input_stream_read_all(in, buffer + carry, ENCODING_CHUNK_SIZE, &n, cancellable, error))
+            goto out;
+        at_end = n < ENCODING_CHUNK_SIZE;
+        content_hash_update(&hash, buffer + carry, n);
+        total_read += n;
+        if (progress)
+            progress(total_read, size_hint, progress_data);
+
+        gsize available = carry + n;
+        gsize start = 0;
+        if (first)
+        {
+            first = FALSE;
+            if (forced)
+            {
+                // 指定的编码带 BOM 时跳过文件开头相同的 BOM
+                *encoding = *forced;
+                if (forced->bom)
+                {
+                    TextEncoding detected;
+                    encoding_detect(buffer, available, &detected, &start);
+                    if (!detected.bom || strcmp(detected.charset, forced->charset) != 0)
+                        start = 0;
+                }
+            }
+            else
+            {
+                encoding_detect(buffer, available, encoding, &start);
+            }
+
+            if (is_utf8(encoding))
+            {
+                text = g_string_sized_new(size_hint + 1);
+            }
+            else
+            {
+                text = g_string_sized_new(size_hint + size_hint / 2 + ENCODING_CARRY_SIZE + 1);
+                converter = G_CONVERTER(g_charset_converter_new("UTF-8", encoding->charset, error));
+                if (!converter)
+                    goto out;
+            }
+        }
+
+        if (converter)
+        {
+            gsize consumed;
+            if (!convert_into(converter, (const char*)buffer + start, available - start, at_end, text, &consumed, error))
+                goto out;
+            carry = available - start - consumed;
+            if (carry > ENCODING_CARRY_SIZE)
+            {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "无法按 %s 解码文件内容", encoding->charset);
+                goto out;
+            }
+            memmove(buffer, buffer + start + consumed, carry);
+            validated = text->len;
+        }
+        else
+        {
+            g_string_append_len(text, (const char*)buffer + start, (gssize)(available - start));
+            if (!validate_utf8(text, &validated, at_end))
+            {
+                result = DECODE_NOT_UTF8;
+                goto out;
+            }
+        }
+
+        // 流式读取时只保留末尾尚未确认的不完整字符
+        if (chunk && validated > 0)
+        {
+            if (!chunk(text->str, validated, chunk_data, error))
+                goto out;
+            g_string_erase(text, 0, (gssize)validated);
+            validated = 0;
+        }
+    }
+
+    if (out_text)
+    {
+        *out_text = text;
+        text = NULL;
+    }
+    if (out_hash)
+        *out_hash = content_hash_finish(&hash);
+    result = DECODE_OK;
+
+out:
+    if (text)
+        g_string_free(text, TRUE);
+    if (converter)
+        g_object_unref(converter);
+    g_free(buffer);
+    return result;
+}
+
+// 先按检测结果解码；猜测的 UTF-8 无效时回到开头按 GB18030（兼容 GBK）重新解码
+static gboolean decode_seekable(GInputStream* in, gsize size_hint, TextEncoding* encoding, GString** out_text,
+                                guint64* out_hash, EncodingProgressFunc progress, gpointer progress_data,
+                                EncodingChunkFunc chunk, gpointer chunk_data,
+                                GCancellable* cancellable, GError** error)
+{
+    DecodeResult result = decode_stream(in, size_hint, NULL, encoding, out_text, out_hash,
+                                        progress, progress_data, chunk, chunk_data, cancellable, error);
+    if (result != DECODE_NOT_UTF8)
+        return result == DECODE_OK;
+
+    if (chunk && !chunk(NULL, 0, chunk_data, error))
+        return FALSE;
+    if (!g_seekable_seek(G_SEEKABLE(in), 0, G_SEEK_SET, cancellable, error))
+        return FALSE;
+    TextEncoding fallback = { "GB18030", FALSE };
+    return decode_stream(in, size_hint, &fallback, encoding, out_text, out_hash,
+                         progress, progress_data, chunk, chunk_data, cancellable, error) == DECODE_OK;
+}
+
+gboolean encoding_load_file(const char* filename, TextEncoding* encoding, GString** out_text,
+                            guint64* out_hash, EncodingProgressFunc progress, gpointer progress_data,
+                            GCancellable* cancellable, GError** error)
+{
+    GFile* file = g_file_new_for_path(filename);
+    GFileInputStream* in = g_file_read(file, cancellable, error);
+    g_object_unref(file);
+    if (!in)
+        return FALSE;
+
+    // 按文件大小预留输出空间，避免边读边扩容时复制整个文档
+    gsize size_hint = 0;
+    GFileInfo* info = g_file_input_stream_query_info(in, G_FILE_ATTRIBUTE_STANDARD_SIZE, cancellable, NULL);
+    if (info)
+    {
+        size_hint = (gsize)g_file_info_get_size(info);
+        g_object_unref(info);
+    }
+
+    gboolean loaded = decode_seekable(G_INPUT_STREAM(in), size_hint, encoding, out_text, out_hash,
+                                      progress, progress_data, NULL, NULL, cancellable, error);
+    g_object_unref(in);
+    return loaded;
+}
+
+gboolean encoding_stream_file(const char* filename, TextEncoding* encoding, EncodingChunkFunc chunk, gpointer data,
+                              GCancellable* cancellable, GError** error)
+{
+    GFile* file = g_file_new_for_path(filename);
+    GFileInputStream* in = g_file_read(file, cancellable, error);
+    g_object_unref(file);
+    if (!in)
+        return FALSE;
+
+    // size_hint 只决定工作缓冲区的大小，内存占用与文件大小无关
+    gboolean streamed = decode_seekable(G_INPUT_STREAM(in), ENCODING_CHUNK_SIZE, encoding, NULL, NULL,
+                                        NULL, NULL, chunk, data, cancellable, error);
+    g_object_unref(in);
+    return streamed;
+}
+
+gboolean encoding_stream_file_as(const char* filename, const TextEncoding* encoding, EncodingChunkFunc chunk,
+                                 gpointer data, GCancellable* cancellable, GError** error)
+{
+    GFile* file = g_file_new_for_path(filename);
+    GFileInputStream* in = g_file_read(file, cancellable, error);
+    g_object_unref(file);
+    if (!in)
+        return FALSE;
+
+    TextEncoding used;
+    DecodeResult result = decode_stream(G_INPUT_STREAM(in), ENCODING_CHUNK_SIZE, encoding, &used, NULL, NULL,
+                                        NULL, NULL, chunk, data, cancellable, error);
+    g_object_unref(in);
+    if (result == DECODE_NOT_UTF8)
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "文件内容不是有效的 %s", encoding->charset);
+    return result == DECODE_OK;
+}
+
+gboolean encoding_decode(const char* data, gsize length, TextEncoding* encoding, GString** out_text, GError** error)
+{
+    GInputStream* in = g_memory_input_stream_new_from_data(data, (gssize)length, NULL);
+    gboolean decoded = decode_seekable(in, length, encoding, out_text, NULL, NULL, NULL, NULL, NULL, NULL, error);
+    g_object_unref(in);
+    return decoded;
+}
+
+struct EncodingWriter
+{
+    GOutputStream* out;
+    GCancellable* cancellable;
+    GConverter* converter;      // 目标编码为 UTF-8 时为 NULL
+    LineEnding line_ending;
+    gchar* line_buffer;         // 转换行分隔符后的一块文本
+    gchar* out_buffer;          // 编码转换后的一块字节
+    ContentHash hash;           // 实际写出字节的哈希
+};
+
+#define WRITER_BUFFER_SIZE (ENCODING_CHUNK_SIZE * 2)
+
+static gboolean write_bytes(EncodingWriter* writer, const void* data, gsize length, GError** error)
+{
+    content_hash_update(&writer->hash, data, length);
+    if (!writer->out)
+        return TRUE;
+    return g_output_stream_write_all(writer->out, data, length, NULL, writer->cancellable, error);
+}
+
+// 转换一块 UTF-8 文本并写出。块必须在字符边界结束，at_end 时冲刷转换器
+static gboolean write_encoded(EncodingWriter* writer, const char* in, gsize length, gboolean at_end, GError** error)
+{
+    if (!writer->converter)
+        return write_bytes(writer, in, length, error);
+
+    while (length > 0 || at_end)
+    {
+        gsize bytes_read = 0, bytes_written = 0;
+        GConverterResult result = g_converter_convert(writer->converter, in, length,
+                                                      writer->out_buffer, WRITER_BUFFER_SIZE,
+                                                      at_end ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS,
+                                                      &bytes_read, &bytes_written, error);
+        if (result == G_CONVERTER_ERROR || !write_bytes(writer, writer->out_buffer, bytes_written, error))
+            return FALSE;
+
+        in += bytes_read;
+        length -= bytes_read;
+        if (result == G_CONVERTER_FINISHED)
+            break;
+    }
+    return TRUE;
+}
+
+EncodingWriter* encoding_writer_new(GOutputStream* out, const TextEncoding* encoding, LineEnding line_ending,
+                                    GCancellable* cancellable, GError** error)
+{
+    GConverter* converter = NULL;
+    if (!is_utf8(encoding))
+    {
+        converter = G_CONVERTER(g_charset_converter_new(encoding->charset, "UTF-8", error));
+        if (!converter)
+            return NULL;
+    }
+
+    EncodingWriter* writer = g_new0(EncodingWriter, 1);
+    writer->out = out ? g_object_ref(out) : NULL;
+    writer->cancellable = cancellable ? g_object_ref(cancellable) : NULL;
+    writer->converter = converter;
+    writer->line_ending = line_ending;
+    writer->line_buffer = line_ending != LINE_ENDING_LF ? g_malloc(WRITER_BUFFER_SIZE) : NULL;
+    writer->out_buffer = converter ? g_malloc(WRITER_BUFFER_SIZE) : NULL;
+    content_hash_init(&writer->hash);
+
+    if (encoding->bom)
+    {
+        const guchar* bom = utf8_bom;
+        gsize bom_length = sizeof(utf8_bom);
+        if (strcmp(encoding->charset, "UTF-16LE") == 0)
+        {
+            bom = utf16le_bom;
+            bom_length = sizeof(utf16le_bom);
+        }
+        else if (strcmp(encoding->charset, "UTF-16BE") == 0)
+        {
+            bom = utf16be_bom;
+            bom_length = sizeof(utf16be_bom);
+        }
+        if (!write_bytes(writer, bom, bom_length, error))
+        {
+            encoding_writer_free(writer);
+            return NULL;
+        }
+    }
+
+    return writer;
+}
+
+gboolean encoding_writer_write(EncodingWriter* writer, const char* text, gsize length, GError** error)
+{
+    while (length > 0)
+    {
+        // 每块不超过 ENCODING_CHUNK_SIZE，且不拆开多字节字符
+        gsize piece = MIN(length, (gsize)ENCODING_CHUNK_SIZE);
+        while (piece < length && piece > 0 && ((guchar)text[piece] & 0xC0) == 0x80)
+            piece--;
+
+        const char* data = text;
+        gsize data_length = piece;
+        if (writer->line_buffer)
+        {
+            data_length = line_ending_expand(text, piece, writer->line_ending, writer->line_buffer);
+            data = writer->line_buffer;
+        }
+        if (!write_encoded(writer, data, data_length, FALSE, error))
+            return FALSE;
+
+        text += piece;
+        length -= piece;
+    }
+    return TRUE;
+}
+
+gboolean encoding_writer_finish(EncodingWriter* writer, guint64* out_hash, GError** error)
+{
+    if (writer->converter && !write_encoded(writer, "", 0, TRUE, error))
+        return FALSE;
+    if (out_hash)
+        *out_hash = content_hash_finish(&writer->hash);
+    return TRUE;
+}
+
+void encoding_writer_free(EncodingWriter* writer)
+{
+    if (!writer)
+        return;
+    if (writer->out)
+        g_object_unref(writer->out);
+    if (writer->cancellable)
+        g_object_unref(writer->cancellable);
+    if (writer->converter)
+        g_object_unref(writer->converter);
+    g_free(writer->line_buffer);
+    g_free(writer->out_buffer);
+    g_free(writer);
+}
+
+gboolean encoding_write(GOutputStream* out, const char* text, gsize length, const TextEncoding* encoding,
+                        LineEnding line_ending, guint64* out_hash, GCancellable* cancellable, GError** error)
+{
+    EncodingWriter* writer = encoding_writer_new(out, encoding, line_ending, cancellable, error);
+    if (!writer)
+        return FALSE;
+
+    gboolean written = encoding_writer_write(writer, text, length, error) &&
+                       encoding_writer_finish(writer, out_hash, error);
+    encoding_writer_free(writer);
+    return written;
+}
+
+gboolean encoding_hash(const TextEncoding* encoding, LineEnding line_ending,
+                       EncodingFillFunc fill, gpointer data, guint64* out_hash, GError** error)
+{
+    EncodingWriter* writer = encoding_writer_new(NULL, encoding, line_ending, NULL, error);
+    if (!writer)
+        return FALSE;
+
+    gboolean hashed = fill(writer, data, error) && encoding_writer_finish(writer, out_hash, error);
+    encoding_writer_free(writer);
+    return hashed;
+}
+
+// 保存的目标流，不同的可靠程度对应不同的打开和关闭方式
+typedef struct SaveTarget
+{
+    SaveDurability durability;
+    GFile* file;
+    GFile* temp_file;       // SAVE_ATOMIC 的临时文件
+    GFileIOStream* io;      // SAVE_IN_PLACE 的读写流
+    GOutputStream* out;
+} SaveTarget;
+
+static gboolean save_target_open(SaveTarget* target, const char* filename, SaveDurability durability, GError** error)
+{
+    memset(target, 0, sizeof(*target));
+    target->durability = durability;
+    target->file = g_file_new_for_path(filename);
+
+    if (durability == SAVE_ATOMIC)
+    {
+        // 临时文件放在同一目录，保证之后的改名是原子操作。新建文件不会在关闭时 fsync
+        gchar* directory = g_path_get_dirname(filename);
+        gchar* basename = g_path_get_basename(filename);
+        gchar* temp_name = g_strdup_printf(".%s.%08x.tmp", basename, g_random_int());
+        gchar* temp_path = g_build_filename(directory, temp_name, NULL);
+        target->temp_file = g_file_new_for_path(temp_path);
+        g_free(temp_path);
+        g_free(temp_name);
+        g_free(basename);
+        g_free(directory);
+
+        GFileOutputStream* out = g_file_create(target->temp_file, G_FILE_CREATE_NONE, NULL, error);
+        target->out = out ? G_OUTPUT_STREAM(out) : NULL;
+    }
+    else if (durability == SAVE_IN_PLACE)
+    {
+        GError* open_error = NULL;
+        target->io = g_file_open_readwrite(target->file, NULL, &open_error);
+        if (!target->io && g_error_matches(open_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        {
+            g_clear_error(&open_error);
+            target->io = g_file_create_readwrite(target->file, G_FILE_CREATE_NONE, NULL, &open_error);
+        }
+        if (target->io)
+            target->out = g_object_ref(g_io_stream_get_output_stream(G_IO_STREAM(target->io)));
+        else
+            g_propagate_error(error, open_error);
+    }
+    else
+    {
+        // 替换已有文件时 GIO 会在改名前 fsync
+        GFileOutputStream* out = g_file_replace(target->file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+        target->out = out ? G_OUTPUT_STREAM(out) : NULL;
+    }
+
+    return target->out != NULL;
+}
+
+// 以取消方式关闭，GIO 会丢弃替换用的临时文件
+static void close_discarding(GOutputStream* out)
+{
+    GCancellable* cancellable = g_cancellable_new();
+    g_cancellable_cancel(cancellable);
+    g_output_stream_close(out, cancellable, NULL);
+    g_object_unref(cancellable);
+}
+
+// 内容写完（written 为 TRUE）时提交保存，否则尽量保留原文件
+static gboolean save_target_close(SaveTarget* target, gboolean written, GError** error)
+{
+    gboolean saved = written;
+
+    if (target->durability == SAVE_ATOMIC)
+    {
+        saved = saved && g_output_stream_close(target->out, NULL, error);
+        if (saved)
+        {
+            // 保留原文件的权限，然后改名替换
+            GFileInfo* info = g_file_query_info(target->file, G_FILE_ATTRIBUTE_UNIX_MODE,
+                                                G_FILE_QUERY_INFO_NONE, NULL, NULL);
+            if (info && g_file_info_has_attribute(info, G_FILE_ATTRIBUTE_UNIX_MODE))
+                g_file_set_attribute_uint32(target->temp_file, G_FILE_ATTRIBUTE_UNIX_MODE,
+                                            g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_UNIX_MODE),
+                                            G_FILE_QUERY_INFO_NONE, NULL, NULL);
+            if (info)
+                g_object_unref(info);
+
+            saved = g_file_move(target->temp_file, target->file,
+                                G_FILE_COPY_OVERWRITE | G_FILE_COPY_NO_FALLBACK_FOR_MOVE,
+                                NULL, NULL, NULL, error);
+        }
+        if (!saved)
+        {
+            g_output_stream_close(target->out, NULL, NULL);
+            g_file_delete(target->temp_file, NULL, NULL);
+        }
+    }
+    else if (target->durability == SAVE_IN_PLACE)
+    {
+        // 新内容可能比原来短，截掉多余的部分
+        GSeekable* seekable = G_SEEKABLE(target->io);
+        saved = saved && g_seekable_truncate(seekable, g_seekable_tell(seekable), NULL, error);
+        saved = g_io_stream_close(G_IO_STREAM(target->io), NULL, saved ? error : NULL) && saved;
+    }
+    else
+    {
+        if (saved)
+            saved = g_output_stream_close(target->out, NULL, error);
+        else
+            close_discarding(target->out);
+    }
+
+    g_object_unref(target->out);
+    if (target->io)
+        g_object_unref(target->io);
+    if (target->temp_file)
+        g_object_unref(target->temp_file);
+    g_object_unref(target->file);
+    return saved;
+}
+
+gboolean encoding_save_file(const char* filename, const TextEncoding* encoding, LineEnding line_ending,
+                            SaveDurability durability, EncodingFillFunc fill, gpointer data,
+                            guint64* out_hash, GCancellable* cancellable, GError** error)
+{
+    SaveTarget target;
+    if (!save_target_open(&target, filename, durability, error))
+    {
+        g_object_unref(target.file);
+        if (target.temp_file)
+            g_object_unref(target.temp_file);
+        return FALSE;
+    }
+
+    gboolean written = FALSE;
+    EncodingWriter* writer = encoding_writer_new(target.out, encoding, line_ending, cancellable, error);
+    if (writer)
+    {
+        written = fill(writer, data, error) && encoding_writer_finish(writer, out_hash, error);
+        encoding_writer_free(writer);
+    }
+
+    return save_target_close(&target, written, error);
+}
@@ -0,0 +1,99 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <gio/gio.h>
+#include "fingerprint.h"
+#include "line_ending.h"
+
+#define ENCODING_CHUNK_SIZE (256 * 1024)    // 流式转换每次处理的字节数
+
+// 文件的字符编码
+typedef struct TextEncoding
+{
+    const gchar* charset;   // "UTF-8"、"GB18030"、"UTF-16LE"、"UTF-16BE"（静态字符串）
+    gboolean bom;           // 文件开头是否带字节顺序标记
+} TextEncoding;
+
+extern void encoding_init_default(TextEncoding* encoding);     // UTF-8，无 BOM
+
+// 根据文件开头的字节判断编码，bom_length 返回需要跳过的 BOM 长度。
+// 没有 BOM 且不像 UTF-16 时返回 UTF-8，是否真的是 UTF-8 由解码过程确认
+extern void encoding_detect(const guchar* head, gsize length, TextEncoding* encoding, gsize* bom_length);
+
+#define ENCODING_BINARY_PROBE (8 * 1024)   // 检查文件开头这么多字节判断是否为二进制文件
+
+// 读取文件开头，判断是否像二进制文件：不是 UTF-16 却含有 NUL 字节。无法读取时返回 FALSE
+extern gboolean encoding_file_looks_binary(const char* filename, GCancellable* cancellable);
+
+// 状态栏显示的名称，例如 "UTF-8 BOM"、"GB18030"，调用者负责释放
+extern gchar* encoding_display_name(const TextEncoding* encoding);
+
+// 解析 encoding_display_name 格式的名称（不区分大小写，GBK、GB2312 视为 GB18030），无法识别时返回 FALSE
+extern gboolean encoding_parse_name(const char* name, TextEncoding* encoding);
+
+// 读取进度，done 和 total 为字节数（total 未知时为 0），在读取所在的线程中调用
+typedef void (*EncodingProgressFunc)(guint64 done, guint64 total, gpointer data);
+
+// 分块读取文件并转换为 UTF-8，可在工作线程中调用。
+// 同时返回原始字节的内容哈希，以及检测到的编码。progress 可以为 NULL
+extern gboolean encoding_load_file(const char* filename, TextEncoding* encoding, GString** out_text,
+                                   guint64* out_hash, EncodingProgressFunc progress, gpointer progress_data,
+                                   GCancellable* cancellable, GError** error);
+
+// 流式读取时接收转换好的一块 UTF-8 文本，每块都在字符边界结束。text 为 NULL 表示猜测的 UTF-8 无效，
+// 文件将从头按 GB18030 重新读取，之前收到的内容应当丢弃。返回 FALSE 并设置 error 时停止读取
+typedef gboolean (*EncodingChunkFunc)(const char* text, gsize length, gpointer data, GError** error);
+
+// 与 encoding_load_file 相同地检测和转换编码，但分块交给 chunk，不在内存中保留全文
+extern gboolean encoding_stream_file(const char* filename, TextEncoding* encoding, EncodingChunkFunc chunk,
+                                     gpointer data, GCancellable* cancellable, GError** error);
+
+// 按指定的编码流式读取，不检测也不会从头重新读取（chunk 不会收到 NULL）。
+// 用于按之前检测到的编码再次读取同一文件；内容不符合该编码时返回 FALSE
+extern gboolean encoding_stream_file_as(const char* filename, const TextEncoding* encoding, EncodingChunkFunc chunk,
+                                        gpointer data, GCancellable* cancellable, GError** error);
+
+// 与 encoding_load_file 相同，但输入为内存中的原始字节
+extern gboolean encoding_decode(const char* data, gsize length, TextEncoding* encoding, GString** out_text,
+                                GError** error);
+
+// 分块写出文本的写入器：转换行分隔符和编码，写出 BOM，并累计写出字节的哈希。
+// out 为 NULL 时只计算哈希，不写出
+typedef struct EncodingWriter EncodingWriter;
+
+extern EncodingWriter* encoding_writer_new(GOutputStream* out, const TextEncoding* encoding, LineEnding line_ending,
+                                           GCancellable* cancellable, GError** error);
+// text 为只含 \n 换行的 UTF-8 文本，必须在字符边界结束
+extern gboolean encoding_writer_write(EncodingWriter* writer, const char* text, gsize length, GError** error);
+extern gboolean encoding_writer_finish(EncodingWriter* writer, guint64* out_hash, GError** error);
+extern void encoding_writer_free(EncodingWriter* writer);
+
+// 把一段连续的文本写入输出流
+extern gboolean encoding_write(GOutputStream* out, const char* text, gsize length, const TextEncoding* encoding,
+                               LineEnding line_ending, guint64* out_hash, GCancellable* cancellable, GError** error);
+
+// 保存时由调用者分块提供内容
+typedef gboolean (*EncodingFillFunc)(EncodingWriter* writer, gpointer data, GError** error);
+
+// 计算按给定编码和行分隔符保存时将写出字节的哈希，不写文件
+extern gboolean encoding_hash(const TextEncoding* encoding, LineEnding line_ending,
+                              EncodingFillFunc fill, gpointer data, guint64* out_hash, GError** error);
+
+// 保存的可靠程度
+typedef enum
+{
+    SAVE_ATOMIC_FSYNC,      // 写入临时文件并 fsync 后替换原文件，断电也不会损坏
+    SAVE_ATOMIC,            // 写入临时文件后替换，不等待落盘，崩溃时可能丢失最近一次保存
+    SAVE_IN_PLACE           // 直接覆盖原文件，最快，写入中途失败会留下不完整的文件
+} SaveDurability;
+
+// 保存文件，失败或被 cancellable 取消时按 durability 的约定处理原文件（两种替换方式下原文件保持不变）
+extern gboolean encoding_save_file(const char* filename, const TextEncoding* encoding, LineEnding line_ending,
+                                   SaveDurability durability, EncodingFillFunc fill, gpointer data,
+                                   guint64* out_hash, GCancellable* cancellable, GError** error);
+
+#endif // ENCODING_H
@@ -4,6 +4,366 @@
 
 #include "file_operations.h"
 #include "output_exception.h"
+#include "text_diff.h"
+#include "paste.h"
+#include "long_operation.h"
+#include "hex_view.h"
+#include "compare_view.h"
+#include "csv_view.h"
+#include "perf_hud.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+// hash 为磁盘上原始字节（编码转换之前）的哈希
+void notepad_set_fingerprint(NotepadApp* app, const char* filename, guint64 hash)
+{
+    app->fingerprint.valid = false;
+    if (filename && file_fingerprint_stat(filename, &app->fingerprint))
+    {
+        app->fingerprint.hash = hash;
+        app->fingerprint.valid = true;
+    }
+}
+
+#define SAVE_CHUNK_CHARS (64 * 1024)   // 保存时每次从缓冲区取出的字符数
+
+// 保存的内容来源
+typedef struct SaveSource
+{
+    GtkTextBuffer* buffer;
+    LongOperation* operation;   // 报告进度并响应取消
+} SaveSource;
+
+// 分块取出缓冲区内容交给写入器，不生成整个文档的副本
+static gboolean write_buffer_chunks(EncodingWriter* writer, gpointer data, GError** error)
+{
+    SaveSource* source = (SaveSource*)data;
+    GtkTextBuffer* buffer = source->buffer;
+    gint total = gtk_text_buffer_get_char_count(buffer);
+    GtkTextIter start, end;
+    gtk_text_buffer_get_start_iter(buffer, &start);
+
+    while (!gtk_text_iter_is_end(&start))
+    {
+        end = start;
+        gtk_text_iter_forward_chars(&end, SAVE_CHUNK_CHARS);
+        gchar* text = gtk_text_buffer_get_text(buffer, &start, &end, TRUE);
+        gboolean written = encoding_writer_write(writer, text, strlen(text), error);
+        g_free(text);
+        if (!written)
+            return FALSE;
+        start = end;
+
+        // 处理界面事件期间编辑器已锁定，迭代器保持有效
+        long_operation_report(source->operation, (guint64)gtk_text_iter_get_offset(&start), (guint64)total);
+        if (!long_operation_pump(source->operation, error))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+// 按统计信息推算写出的字节数，确定与磁盘上的大小不同时返回 FALSE。统计未完成时无法判断，返回 TRUE
+static gboolean encoded_size_may_match(NotepadApp* app, guint64 size)
+{
+    const DocStats* stats = &app->ui->stats;
+    if (app->ui->stats_pending || app->ui->stats_suspended)
+        return TRUE;
+
+    guint64 newline_extra = app->line_ending == LINE_ENDING_CRLF ? (guint64)stats->lines : 0;
+    if (strcmp(app->encoding.charset, "UTF-8") == 0)
+        return size == (guint64)stats->bytes + newline_extra + (app->encoding.bom ? 3 : 0);
+
+    // 其他编码每个字符的字节数不定，只比较上下界
+    guint64 units = (guint64)stats->chars + newline_extra;
+    if (strcmp(app->encoding.charset, "GB18030") == 0)
+        return size >= units && size <= units * 4;
+    guint64 bom = app->encoding.bom ? 2 : 0;
+    return size >= bom + units * 2 && size <= bom + units * 4;
+}
+
+// 要写出的字节与磁盘上的文件完全相同时不必再写
+static gboolean save_is_redundant(NotepadApp* app, const char* filename, SaveSource* source)
+{
+    if (!app->filename || strcmp(app->filename, filename) != 0 || !app->fingerprint.valid)
+        return FALSE;
+
+    // 文件在磁盘上可能已变化时照常保存
+    FileFingerprint current;
+    if (!file_fingerprint_stat(filename, &current) || !file_fingerprint_same_identity(&current, &app->fingerprint))
+        return FALSE;
+
+    // 撤销回到了保存点，内容必然相同
+    if (notepad_at_save_point(app))
+        return TRUE;
+
+    // 改动后又改回原样：大小可能相同时才计算将要写出字节的哈希，与上次保存的比较
+    if (!encoded_size_may_match(app, current.size))
+        return FALSE;
+    guint64 hash;
+    return encoding_hash(&app->encoding, app->line_ending, write_buffer_chunks, source, &hash, NULL) &&
+           hash == app->fingerprint.hash;
+}
+
+// 按文档原来的编码、BOM 和行分隔符保存，并以写出的字节更新指纹
+gboolean notepad_write_file(NotepadApp* app, const char* filename, GError** error)
+{
+    paste_finish(app);
+
+    // NUL 已替换为 U+FFFD 的文档写回原文件会改变其二进制内容，先确认
+    if (app->nul_replaced && g_strcmp0(app->filename, filename) == 0 &&
+        !show_confirm_dialog(GTK_WINDOW(app->ui->window), "保存二进制文件",
+                             "此文件按文本打开时，其中的 NUL 字节显示为替换字符（U+FFFD）。\n"
+                             "保存后这些字节将被改写，原文件的二进制内容会损坏。仍要保存吗？"))
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_CANCELLED, "已取消保存");
+        return FALSE;
+    }
+
+    // 直接覆盖原文件时中途取消会留下不完整的文件，不提供取消
+    SaveDurability durability = app->settings.save_durability;
+    LongOperationFlags flags = LONG_OPERATION_LOCK_EDITOR;
+    if (durability != SAVE_IN_PLACE)
+        flags |= LONG_OPERATION_CANCELLABLE;
+    gchar* basename = g_path_get_basename(filename);
+    gchar* label = g_strdup_printf("正在保存 %s", basename);
+    SaveSource source = { app->ui->buffer, long_operation_begin(app, label, flags) };
+    g_free(label);
+
+    if (save_is_redundant(app, filename, &source))
+    {
+        autosave_discard(app->autosave, filename);
+        long_operation_end(source.operation, NULL);
+        g_free(basename);
+        return TRUE;
+    }
+
+    // 不等待落盘的保存方式先把要写的内容同步写入日志：写了一半或还没落盘就崩溃时，
+    // 日志与文件的哈希不符，下次打开时从日志恢复
+    gint64 start_time = g_get_monotonic_time();
+    if (durability != SAVE_ATOMIC_FSYNC)
+    {
+        GBytes* text = notepad_get_snapshot(app);
+        JournalState state = { 0, TRUE, app->encoding, app->line_ending };
+        autosave_write_now(app->autosave, filename, text, &state);
+        g_bytes_unref(text);
+    }
+
+    guint64 hash;
+    GError* save_error = NULL;
+    gboolean saved = encoding_save_file(filename, &app->encoding, app->line_ending, durability,
+                                        write_buffer_chunks, &source, &hash,
+                                        long_operation_get_cancellable(source.operation), &save_error);
+
+    gchar* message = NULL;
+    if (saved)
+        message = g_strdup_printf("已保存 %s", basename);
+    else if (g_error_matches(save_error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        message = g_strdup_printf("已取消保存 %s", basename);
+    long_operation_end(source.operation, message);
+    g_free(message);
+    g_free(basename);
+    if (save_error)
+        g_propagate_error(error, save_error);
+
+    if (saved)
+    {
+        perf_hud_record(app->ui->perf_hud, PERF_TIMING_SAVE, start_time);
+
+        // 不等待落盘的保存方式由后台线程补做 fsync，之后才删除日志
+        autosave_saved(app->autosave, filename, durability != SAVE_ATOMIC_FSYNC);
+        if (g_strcmp0(app->filename, filename) != 0)
+            autosave_discard(app->autosave, app->filename);
+        notepad_set_fingerprint(app, filename, hash);
+        app->nul_replaced = false;
+    }
+    return saved;
+}
+
+// 判断磁盘上的文件是否与记录的指纹不同。先比较大小/时间/inode，只有身份变化时才读内容比较哈希。
+// 若 out_content 不为 NULL 且文件确实变化，则返回读到的新内容（调用者负责释放）
+static bool file_changed_on_disk(NotepadApp* app, gchar** out_content, gsize* out_length)
+{
+    if (!app->filename || !app->fingerprint.valid)
+        return false;
+
+    FileFingerprint current;
+    if (!file_fingerprint_stat(app->filename, &current))
+        return false; // 文件被删除或无法访问，保留当前内容
+
+    if (file_fingerprint_same_identity(&current, &app->fingerprint))
+        return false;
+
+    gchar* content;
+    gsize length;
+    if (!g_file_get_contents(app->filename, &content, &length, NULL))
+        return false;
+
+    current.hash = content_hash_bytes(content, length);
+    current.valid = true;
+    if (current.hash == app->fingerprint.hash)
+    {
+        // 只是时间戳变化（例如 touch），内容相同
+        app->fingerprint = current;
+        g_free(content);
+        return false;
+    }
+
+    if (out_content)
+    {
+        *out_content = content;
+        *out_length = length;
+    }
+    else
+    {
+        g_free(content);
+    }
+    return true;
+}
+
+// 按行差异只替换变化的部分，光标、滚动位置和撤销历史都得以保留。
+// 整次重新加载记为一步撤销：从第一个到最后一个差异块的范围整段替换
+static void reload_with_diff(NotepadApp* app, const gchar* content, gsize length)
+{
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds(app->ui->buffer, &start, &end);
+    gchar* old_text = gtk_text_buffer_get_text(app->ui->buffer, &start, &end, TRUE);
+
+    TextLines* old_lines = text_lines_split(old_text, strlen(old_text));
+    TextLines* new_lines = text_lines_split(content, length);
+    GArray* hunks = text_diff_lines(old_lines, new_lines);
+    if (hunks->len == 0)
+    {
+        g_array_unref(hunks);
+        text_lines_free(old_lines);
+        text_lines_free(new_lines);
+        g_free(old_text);
+        return;
+    }
+
+    const DiffHunk* first = &g_array_index(hunks, DiffHunk, 0);
+    const DiffHunk* last = &g_array_index(hunks, DiffHunk, hunks->len - 1);
+    gsize old_from = old_lines->starts[first->old_start];
+    gsize old_to = old_lines->starts[last->old_start + last->old_count];
+    gsize new_from = new_lines->starts[first->new_start];
+    gsize new_to = new_lines->starts[last->new_start + last->new_count];
+    GBytes* original = g_bytes_new(old_text + old_from, old_to - old_from);
+    GBytes* replacement = g_bytes_new(content + new_from, new_to - new_from);
+    gint position = (gint)g_utf8_strlen(old_text, (gssize)old_from);
+
+    // 从后往前应用，前面差异块的行号不受影响
+    app->ui->recording_changes = FALSE;
+    for (gint i = (gint)hunks->len - 1; i >= 0; i--)
+    {
+        const DiffHunk* hunk = &g_array_index(hunks, DiffHunk, i);
+        GtkTextIter hunk_start, hunk_end;
+        gtk_text_buffer_get_iter_at_line(app->ui->buffer, &hunk_start, (gint)hunk->old_start);
+        gtk_text_buffer_get_iter_at_line(app->ui->buffer, &hunk_end, (gint)(hunk->old_start + hunk->old_count));
+        if (hunk->old_start + hunk->old_count >= old_lines->count)
+            gtk_text_buffer_get_end_iter(app->ui->buffer, &hunk_end);
+
+        if (hunk->old_count > 0)
+            gtk_text_buffer_delete(app->ui->buffer, &hunk_start, &hunk_end);
+
+        if (hunk->new_count > 0)
+        {
+            gsize from = new_lines->starts[hunk->new_start];
+            gsize to = new_lines->starts[hunk->new_start + hunk->new_count];
+            gtk_text_buffer_insert(app->ui->buffer, &hunk_start, content + from, (gint)(to - from));
+        }
+    }
+    app->ui->recording_changes = TRUE;
+    push_undo_replace(app, position, original, replacement);
+
+    g_bytes_unref(original);
+    g_bytes_unref(replacement);
+    g_array_unref(hunks);
+    text_lines_free(old_lines);
+    text_lines_free(new_lines);
+    g_free(old_text);
+}
+
+// 缓冲区不接受 NUL，按文本打开二进制文件时显示为替换字符。replaced 返回是否有 NUL 被替换
+static GString* replace_nul_chars(GString* text, bool* replaced)
+{
+    const gchar* nul = memchr(text->str, '\0', text->len);
+    *replaced = nul != NULL;
+    if (!nul)
+        return text;
+
+    GString* out = g_string_sized_new(text->len + 16);
+    const gchar* p = text->str;
+    const gchar* end = text->str + text->len;
+    while (nul)
+    {
+        g_string_append_len(out, p, (gssize)(nul - p));
+        g_string_append(out, "\xef\xbf\xbd");
+        p = nul + 1;
+        nul = memchr(p, '\0', (gsize)(end - p));
+    }
+    g_string_append_len(out, p, (gssize)(end - p));
+    g_string_free(text, TRUE);
+    return out;
+}
+
+void notepad_check_external_change(NotepadApp* app)
+{
+    // 保存等操作进行期间不重新加载，焦点变化可能来自其中处理的界面事件
+    if (app->checking_external_change || long_operation_editor_locked(app))
+        return;
+    app->checking_external_change = true;
+
+    gchar* content = NULL;
+    gsize length = 0;
+    if (file_changed_on_disk(app, &content, &length))
+    {
+        gboolean reload = TRUE;
+        if (app->is_modified)
+        {
+            reload = show_confirm_dialog(GTK_WINDOW(app->ui->window), "文件已修改",
+                                         "文件已被其他程序修改。是否重新加载？\n当前未保存的修改将被替换（可以撤销）。");
+        }
+
+        // 与打开文件相同，先检测编码并转换为 UTF-8
+        GString* text = NULL;
+        TextEncoding encoding;
+        GError* error = NULL;
+        if (reload && !encoding_decode(content, length, &encoding, &text, &error))
+        {
+            gchar* error_message = g_strdup_printf("无法转换文件编码：\n%s", error->message);
+            show_error_dialog(GTK_WINDOW(app->ui->window), "重新加载失败", error_message);
+            g_free(error_message);
+            g_error_free(error);
+            reload = FALSE;
+        }
+
+        if (reload)
+        {
+            paste_finish(app);
+            gsize text_length = text->len;
+            app->line_ending = line_ending_normalize(text->str, &text_length, app->line_ending);
+            g_string_truncate(text, text_length);
+            text = replace_nul_chars(text, &app->nul_replaced);
+            reload_with_diff(app, text->str, text->len);
+            notepad_collapse_long_lines(app, text->str, text->len);
+            app->encoding = encoding;
+            notepad_mark_saved(app);
+            update_line_ending_type(app);
+            update_encoding_type(app);
+            g_string_free(text, TRUE);
+        }
+        else
+        {
+            // 保存点对应的是磁盘上的旧版本，撤销回到那里时内容与磁盘不同，仍需保存
+            notepad_discard_save_point(app);
+        }
+
+        // 无论是否重新加载，都以磁盘上的新版本为基准，避免反复提示
+        notepad_set_fingerprint(app, app->filename, content_hash_bytes(content, length));
+        g_free(content);
+    }
+
+    app->checking_external_change = false;
+}
 
 void on_new_file(GtkWidget* widget, gpointer data)
 {
@@ -13,13 +373,25 @@ void on_new_file(GtkWidget* widget, gpointer data)
     if (!notepad_check_save_changes(app))
         return;
 
+    paste_finish(app);
+    app->ui->stats_suspended = TRUE;
     gtk_text_buffer_set_text(app->ui->buffer, "", -1);
+    app->ui->stats_suspended = FALSE;
+    notepad_rebuild_stats(app, NULL);
+    notepad_apply_word_wrap(app, 0);
+    update_long_line_status(app);
     if (app->filename)
     {
         g_free(app->filename);
         app->filename = NULL;
     }
+    app->fingerprint.valid = false;
+    app->nul_replaced = false;
+    encoding_init_default(&app->encoding);
+    app->line_ending = LINE_ENDING_DEFAULT;
+    update_highlight_language(app);
     gtk_window_set_title(GTK_WINDOW(app->ui->window), "记事本 - 新文件");
+    notepad_mark_saved(app);
 
     // 更新状态栏信息
     update_cursor_position(app);
@@ -27,6 +399,329 @@ void on_new_file(GtkWidget* widget, gpointer data)
     update_encoding_type(app);
 }
 
+// 后台打开文件的任务
+typedef struct OpenJob
+{
+    NotepadApp* app;
+    gchar* filename;
+    TextEncoding encoding;
+    LineEnding line_ending; // 文件原来的行分隔符
+    GString* text;          // 转换为 UTF-8 并统一为 \n 换行后的内容
+    guint64 hash;           // 原始字节的哈希
+    GBytes* journal;        // 比文件新的自动保存日志
+    LongOperation* operation;
+    gboolean force_text;    // 即使像二进制文件也按文本打开
+    gboolean binary;        // 结果：检测到二进制内容，没有读取
+    bool nul_replaced;      // 结果：按文本打开时有 NUL 被替换
+    gboolean loaded;        // 后台任务的结果，完成处理可能推迟到编辑器解锁之后
+    GError* error;
+    gint64 start_time;      // 开始打开的时间，用于性能面板
+} OpenJob;
+
+static void open_job_free(OpenJob* job)
+{
+    if (job->error)
+        g_error_free(job->error);
+    if (job->text)
+        g_string_free(job->text, TRUE);
+    if (job->journal)
+        g_bytes_unref(job->journal);
+    g_free(job->filename);
+    g_free(job);
+}
+
+static void report_open_progress(guint64 done, guint64 total, gpointer data)
+{
+    long_operation_report((LongOperation*)data, done, total);
+}
+
+static void open_job_thread(GTask* task, gpointer source, gpointer task_data, GCancellable* cancellable)
+{
+    OpenJob* job = (OpenJob*)task_data;
+    GError* error = NULL;
+
+    // 二进制文件不能放进只接受 UTF-8 的缓冲区，只读开头判断，交给主线程询问
+    if (!job->force_text && encoding_file_looks_binary(job->filename, cancellable))
+    {
+        job->binary = TRUE;
+        g_task_return_boolean(task, TRUE);
+        return;
+    }
+
+    if (encoding_load_file(job->filename, &job->encoding, &job->text, &job->hash,
+                           report_open_progress, job->operation, cancellable, &error))
+    {
+        // 原地统一换行符，缓冲区中只保存 \n
+        gsize length = job->text->len;
+        job->line_ending = line_ending_normalize(job->text->str, &length, LINE_ENDING_DEFAULT);
+        g_string_truncate(job->text, length);
+
+        // 开头之后才出现的 NUL 同样按二进制文件处理，选择按文本打开时才替换
+        if (!job->force_text && memchr(job->text->str, '\0', job->text->len))
+        {
+            g_string_free(job->text, TRUE);
+            job->text = NULL;
+            job->binary = TRUE;
+            g_task_return_boolean(task, TRUE);
+            return;
+        }
+        job->text = replace_nul_chars(job->text, &job->nul_replaced);
+        job->journal = autosave_recover(job->filename, job->hash);
+        g_task_return_boolean(task, TRUE);
+    }
+    else
+        g_task_return_error(task, error);
+}
+
+static void open_binary_file(NotepadApp* app, const char* filename);
+
+// 打开失败或取消后恢复为当前文档的标题
+static void restore_window_title(NotepadApp* app)
+{
+    gchar* title = app->filename ? g_strdup_printf("记事本 - %s", app->filename) : g_strdup("记事本 - 新文件");
+    gtk_window_set_title(GTK_WINDOW(app->ui->window), title);
+    g_free(title);
+    notepad_set_modified(app, app->is_modified);
+}
+
+static gboolean open_job_retry(gpointer data);
+
+// 在主线程上完成打开：载入缓冲区或提示错误
+static void open_job_finish(OpenJob* job)
+{
+    NotepadApp* app = job->app;
+
+    // 保存等操作锁定编辑器时持有缓冲区的迭代器，其中处理界面事件时完成的打开推迟到解锁之后，
+    // 与外部修改的检查一样不在此期间替换缓冲区或弹出对话框
+    if (long_operation_editor_locked(app))
+    {
+        g_timeout_add(LONG_OPERATION_PUMP_INTERVAL, open_job_retry, job);
+        return;
+    }
+
+    gboolean loaded = job->loaded;
+    GError* error = job->error;
+    job->error = NULL;
+
+    // 被新的打开操作取代时由新的操作负责界面，不提示
+    gboolean current = app->load_cancellable == long_operation_get_cancellable(job->operation);
+    if (loaded && !current)
+    {
+        long_operation_end(job->operation, NULL);
+        open_job_free(job);
+        return;
+    }
+
+    if (!loaded)
+    {
+        gchar* message = NULL;
+        if (current)
+        {
+            g_clear_object(&app->load_cancellable);
+            gtk_widget_set_sensitive(app->ui->text_view, TRUE);
+            app->open_line = 0;
+            restore_window_title(app);
+
+            gchar* basename = g_path_get_basename(job->filename);
+            if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            {
+                message = g_strdup_printf("已取消打开 %s", basename);
+            }
+            else
+            {
+                gchar* error_message = g_strdup_printf("无法打开文件：\"%s\":\n%s", job->filename, error->message);
+                show_error_dialog(GTK_WINDOW(app->ui->window), "打开文件失败", error_message);
+                g_free(error_message);
+            }
+            g_free(basename);
+        }
+        long_operation_end(job->operation, message);
+        g_free(message);
+        g_error_free(error);
+        open_job_free(job);
+        return;
+    }
+
+    long_operation_end(job->operation, NULL);
+    g_clear_object(&app->load_cancellable);
+    gtk_widget_set_sensitive(app->ui->text_view, TRUE);
+
+    if (job->binary)
+    {
+        gchar* filename = g_strdup(job->filename);
+        app->open_line = 0;
+        restore_window_title(app);
+        open_job_free(job);
+        open_binary_file(app, filename);
+        g_free(filename);
+        return;
+    }
+
+    // 大文件默认不换行，在载入之前决定，避免先按换行排版
+    notepad_apply_word_wrap(app, job->text->len);
+
+    // 整体载入时不做增量统计，改为在后台统计整个文件
+    paste_finish(app);
+    app->ui->stats_suspended = TRUE;
+    gtk_text_buffer_set_text(app->ui->buffer, job->text->str, (gint)job->text->len);
+    app->ui->stats_suspended = FALSE;
+    app->ui->history_base = app->ui->undo_stack ? app->ui->undo_stack->serial : 0;
+    notepad_collapse_long_lines(app, job->text->str, job->text->len);
+
+    if (app->filename)
+        g_free(app->filename);
+    app->filename = g_strdup(job->filename);
+    app->encoding = job->encoding;
+    app->line_ending = job->line_ending;
+    app->nul_replaced = job->nul_replaced;
+    update_highlight_language(app);
+
+    notepad_set_fingerprint(app, app->filename, job->hash);
+    GBytes* stats_text = g_string_free_to_bytes(job->text);
+    job->text = NULL;
+    notepad_rebuild_stats(app, stats_text);
+    g_bytes_unref(stats_text);
+
+    gchar* title = g_strdup_printf("记事本 - %s", app->filename);
+    gtk_window_set_title(GTK_WINDOW(app->ui->window), title);
+    g_free(title);
+
+    notepad_mark_saved(app); // 设置为未修改状态
+
+    // 更新状态栏信息
+    update_cursor_position(app);
+    update_line_ending_type(app);
+    update_encoding_type(app);
+
+    // 上次会话的文档：恢复光标、滚动位置和撤销历史
+    session_document_loaded(app);
+
+    if (job->journal)
+        notepad_restore_journal(app, job->journal);
+
+    if (app->open_line > 0)
+    {
+        notepad_goto_line(app, app->open_line);
+        app->open_line = 0;
+    }
+
+    perf_hud_record(app->ui->perf_hud, PERF_TIMING_OPEN, job->start_time);
+    open_job_free(job);
+}
+
+static gboolean open_job_retry(gpointer data)
+{
+    open_job_finish((OpenJob*)data);
+    return G_SOURCE_REMOVE;
+}
+
+static void open_job_done(GObject* source, GAsyncResult* result, gpointer data)
+{
+    OpenJob* job = (OpenJob*)data;
+    job->loaded = g_task_propagate_boolean(G_TASK(result), &job->error);
+    open_job_finish(job);
+}
+
+// 在工作线程中读取并转换编码，完成后回到主线程载入缓冲区
+static void open_path(NotepadApp* app, const char* filename, gboolean force_text)
+{
+    if (app->load_cancellable)
+    {
+        g_cancellable_cancel(app->load_cancellable);
+        g_object_unref(app->load_cancellable);
+    }
+
+    OpenJob* job = g_new0(OpenJob, 1);
+    job->app = app;
+    job->filename = g_strdup(filename);
+    job->force_text = force_text;
+    job->start_time = g_get_monotonic_time();
+
+    // 读取和转换编码期间在状态栏显示进度，可以取消
+    gchar* basename = g_path_get_basename(filename);
+    gchar* label = g_strdup_printf("正在打开 %s", basename);
+    job->operation = long_operation_begin(app, label, LONG_OPERATION_CANCELLABLE);
+    app->load_cancellable = g_object_ref(long_operation_get_cancellable(job->operation));
+    g_free(label);
+    g_free(basename);
+
+    // 载入期间禁止编辑
+    gtk_widget_set_sensitive(app->ui->text_view, FALSE);
+    gchar* title = g_strdup_printf("记事本 - 正在打开 %s", filename);
+    gtk_window_set_title(GTK_WINDOW(app->ui->window), title);
+    g_free(title);
+
+    GTask* task = g_task_new(NULL, app->load_cancellable, open_job_done, job);
+    g_task_set_task_data(task, job, NULL);
+    g_task_run_in_thread(task, open_job_thread);
+    g_object_unref(task);
+}
+
+static void open_table_file(NotepadApp* app, const char* filename)
+{
+    GError* error = NULL;
+    if (!csv_view_open(GTK_WINDOW(app->ui->window), filename, &error))
+    {
+        gchar* error_message = g_strdup_printf("无法打开文件：\"%s\":\n%s", filename, error->message);
+        show_error_dialog(GTK_WINDOW(app->ui->window), "打开文件失败", error_message);
+        g_free(error_message);
+        g_error_free(error);
+    }
+}
+
+// 很大的 CSV/TSV 文件建议在表格查看器中打开，不载入文本缓冲区，当前文档保持不变
+static gboolean suggest_table_view(NotepadApp* app, const char* filename)
+{
+    GStatBuf file_stat;
+    if (!csv_view_is_table_file(filename) || g_stat(filename, &file_stat) != 0 ||
+        file_stat.st_size < CSV_VIEW_SUGGEST_SIZE)
+        return FALSE;
+
+    gchar* basename = g_path_get_basename(filename);
+    gchar* size_text = g_format_size((guint64)file_stat.st_size);
+    gchar* message = g_strdup_printf("“%s”有 %s。是否以表格查看？\n选择“否”将按文本打开。", basename, size_text);
+    gboolean table = show_confirm_dialog(GTK_WINDOW(app->ui->window), "大型表格文件", message);
+    g_free(message);
+    g_free(size_text);
+    g_free(basename);
+
+    if (table)
+        open_table_file(app, filename);
+    return table;
+}
+
+void notepad_open_path(NotepadApp* app, const char* filename)
+{
+    if (suggest_table_view(app, filename))
+        return;
+    open_path(app, filename, FALSE);
+}
+
+// 二进制文件默认在十六进制查看器中打开，当前文档保持不变
+static void open_binary_file(NotepadApp* app, const char* filename)
+{
+    gchar* basename = g_path_get_basename(filename);
+    gchar* message = g_strdup_printf("“%s”似乎是二进制文件。是否以十六进制查看？\n选择“否”将按文本打开。", basename);
+    gboolean hex = show_confirm_dialog(GTK_WINDOW(app->ui->window), "二进制文件", message);
+    g_free(message);
+    g_free(basename);
+
+    if (!hex)
+    {
+        open_path(app, filename, TRUE);
+        return;
+    }
+
+    GError* error = NULL;
+    if (!hex_view_open(GTK_WINDOW(app->ui->window), filename, &error))
+    {
+        gchar* error_message = g_strdup_printf("无法打开文件：\"%s\":\n%s", filename, error->message);
+        show_error_dialog(GTK_WINDOW(app->ui->window), "打开文件失败", error_message);
+        g_free(error_message);
+        g_error_free(error);
+    }
+}
+
 void on_open_file(GtkWidget* widget, gpointer data)
 {
     NotepadApp* app = (NotepadApp*)data;
@@ -45,38 +740,60 @@ void on_open_file(GtkWidget* widget, gpointer data)
     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
     {
         gchar* filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+        notepad_open_path(app, filename);
+        g_free(filename);
+    }
+    gtk_widget_destroy(dialog);
+}
 
-        gchar* content;
-        gsize length;
-        GError* error = NULL;
-        if (g_file_get_contents(filename, &content, &length, &error))
-        {
-            gtk_text_buffer_set_text(app->ui->buffer, content, -1);
-            g_free(content);
+void on_compare_file(GtkWidget* widget, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
 
-            if (app->filename)
-                g_free(app->filename);
-            app->filename = g_strdup(filename);
+    GtkWidget* dialog = gtk_file_chooser_dialog_new("选择要比较的文件",
+                                                    GTK_WINDOW(app->ui->window),
+                                                    GTK_FILE_CHOOSER_ACTION_OPEN,
+                                                    "取消", GTK_RESPONSE_CANCEL,
+                                                    "比较", GTK_RESPONSE_ACCEPT,
+                                                    NULL);
 
-            gchar* title = g_strdup_printf("记事本 - %s", filename);
-            gtk_window_set_title(GTK_WINDOW(app->ui->window), title);
-            g_free(title);
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+    {
+        gchar* filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+        paste_finish(app);
+        compare_view_open(app, filename);
+        g_free(filename);
+    }
+    gtk_widget_destroy(dialog);
+}
 
-            notepad_set_modified(app, FALSE); // 设置为未修改状态
+void on_open_table(GtkWidget* widget, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
 
-            // 更新状态栏信息
-            update_cursor_position(app);
-            update_line_ending_type(app);
-            update_encoding_type(app);
-        }
-        else
-        {
-            // 打开文件失败，显示错误对话框
-            gchar* error_message = g_strdup_printf("无法打开文件：\"%s\":\n%s", filename, error->message);
-            show_error_dialog(GTK_WINDOW(app->ui->window), "打开文件失败", error_message);
-            g_free(error_message);
-            g_error_free(error);
-        }
+    GtkWidget* dialog = gtk_file_chooser_dialog_new("以表格查看",
+                                                    GTK_WINDOW(app->ui->window),
+                                                    GTK_FILE_CHOOSER_ACTION_OPEN,
+                                                    "取消", GTK_RESPONSE_CANCEL,
+                                                    "打开", GTK_RESPONSE_ACCEPT,
+                                                    NULL);
+    GtkFileFilter* filter = gtk_file_filter_new();
+    gtk_file_filter_set_name(filter, "CSV/TSV 文件");
+    gtk_file_filter_add_pattern(filter, "*.csv");
+    gtk_file_filter_add_pattern(filter, "*.CSV");
+    gtk_file_filter_add_pattern(filter, "*.tsv");
+    gtk_file_filter_add_pattern(filter, "*.TSV");
+    gtk_file_filter_add_pattern(filter, "*.tab");
+    gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(dialog), filter);
+    GtkFileFilter* all = gtk_file_filter_new();
+    gtk_file_filter_set_name(all, "所有文件");
+    gtk_file_filter_add_pattern(all, "*");
+    gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(dialog), all);
+
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+    {
+        gchar* filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+        open_table_file(app, filename);
         g_free(filename);
     }
     gtk_widget_destroy(dialog);
@@ -91,21 +808,28 @@ void on_save_file(GtkWidget* widget, gpointer data)
         return;
     }
 
-    GtkTextIter start, end;
-    gtk_text_buffer_get_bounds(app->ui->buffer, &start, &end);
-    gchar* text = gtk_text_buffer_get_text(app->ui->buffer, &start, &end, FALSE);
+    // 文件在打开后被其他程序修改过，覆盖前先确认
+    if (file_changed_on_disk(app, NULL, NULL) &&
+        !show_confirm_dialog(GTK_WINDOW(app->ui->window), "保存文件",
+                             "文件已被其他程序修改，保存将覆盖这些修改。是否继续？"))
+        return;
 
     GError* error = NULL;
-    if (g_file_set_contents(app->filename, text, -1, &error))
-        notepad_set_modified(app, FALSE); // 保存成功，设置为未修改状态
+    if (notepad_write_file(app, app->filename, &error))
+    {
+        notepad_mark_saved(app); // 保存成功，设置为未修改状态
+    }
     else
     {
-        gchar* error_message = g_strdup_printf("无法保存文件 \"%s\":\n%s", app->filename, error->message);
-        show_error_dialog(GTK_WINDOW(app->ui->window), "保存文件失败", error_message);
-        g_free(error_message);
+        // 用户取消时状态栏已有通知
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            gchar* error_message = g_strdup_printf("无法保存文件 \"%s\":\n%s", app->filename, error->message);
+            show_error_dialog(GTK_WINDOW(app->ui->window), "保存文件失败", error_message);
+            g_free(error_message);
+        }
         g_error_free(error);
     }
-    g_free(text);
 }
 
 void on_save_as_file(GtkWidget* widget, gpointer data)
@@ -122,31 +846,30 @@ void on_save_as_file(GtkWidget* widget, gpointer data)
     {
         gchar* filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
 
-        GtkTextIter start, end;
-        gtk_text_buffer_get_bounds(app->ui->buffer, &start, &end);
-        gchar* text = gtk_text_buffer_get_text(app->ui->buffer, &start, &end, FALSE);
-
         GError* error = NULL;
-        if (g_file_set_contents(filename, text, -1, &error))
+        if (notepad_write_file(app, filename, &error))
         {
             if (app->filename)
                 g_free(app->filename);
             app->filename = g_strdup(filename);
+            update_highlight_language(app);
 
             gchar* title = g_strdup_printf("记事本 - %s", filename);
             gtk_window_set_title(GTK_WINDOW(app->ui->window), title);
             g_free(title);
 
-            notepad_set_modified(app, FALSE); // 保存成功，设置为未修改状态
+            notepad_mark_saved(app); // 保存成功，设置为未修改状态
         }
         else
         {
-            gchar* error_message = g_strdup_printf("无法保存文件 \"%s\":\n%s", filename, error->message);
-            show_error_dialog(GTK_WINDOW(app->ui->window), "保存文件失败", error_message);
-            g_free(error_message);
+            if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            {
+                gchar* error_message = g_strdup_printf("无法保存文件 \"%s\":\n%s", filename, error->message);
+                show_error_dialog(GTK_WINDOW(app->ui->window), "保存文件失败", error_message);
+                g_free(error_message);
+            }
             g_error_free(error);
         }
-        g_free(text);
         g_free(filename);
     }
     gtk_widget_destroy(dialog);
@@ -155,6 +878,6 @@ void on_save_as_file(GtkWidget* widget, gpointer data)
 void on_exit(GtkWidget* widget, gpointer data)
 {
     NotepadApp* app = (NotepadApp*)data;
-    if (notepad_check_save_changes(app))
+    if (notepad_prepare_quit(app))
         gtk_main_quit();
 }
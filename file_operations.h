@@ -11,6 +11,12 @@ extern void on_new_file(GtkWidget* widget, gpointer data); // 创建新文件
 extern void on_open_file(GtkWidget* widget, gpointer data); // 打开文件
 extern void on_save_file(GtkWidget* widget, gpointer data); // 保存文件
 extern void on_save_as_file(GtkWidget* widget, gpointer data); // 另存为
+extern void on_compare_file(GtkWidget* widget, gpointer data); // 与磁盘上的文件并排比较
+extern void on_open_table(GtkWidget* widget, gpointer data); // 在表格查看器中打开 CSV/TSV 文件
 extern void on_exit(GtkWidget* widget, gpointer data); // 退出应用
+extern void notepad_open_path(NotepadApp* app, const char* filename); // 在后台打开指定文件
+extern void notepad_set_fingerprint(NotepadApp* app, const char* filename, guint64 hash); // 记录文件指纹
+extern gboolean notepad_write_file(NotepadApp* app, const char* filename, GError** error); // 按原编码保存文档
+extern void notepad_check_external_change(NotepadApp* app); // 检查文件是否被外部修改
 
 #endif // FILE_OPERATIONS_H
@@ -0,0 +1,887 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "filter_view.h"
+#include "text_search.h"
+#include "text_diff.h"
+#include "log_index.h"
+#include <string.h>
+
+#define FILTER_VIEW_MARGIN 4        // 列表内容与边缘的距离（像素）
+#define FILTER_VIEW_WHEEL_ROWS 3    // 鼠标滚轮每格滚动的行数
+
+typedef struct FilterJob FilterJob;
+
+struct FilterView
+{
+    NotepadApp* app;
+    GtkWidget* panel;
+    GtkWidget* entry;
+    GtkWidget* case_check;
+    GtkWidget* field_check;     // 按字段查询结构化日志
+    GtkWidget* area;
+    GtkAdjustment* adjustment;  // 以列表行为单位，value 为第一个可见行
+    GtkWidget* status_label;
+    PangoFontDescription* font;
+    gint row_height;
+
+    gchar** patterns;           // 当前的条件，没有条件时为 NULL
+    gboolean case_sensitive;
+    gchar* query;               // 字段查询模式下已校验的查询，否则为 NULL
+    gchar** fields;             // 查询用到的字段，列表中显示在行内容之前
+    GArray* lines;              // 匹配行的行号（guint，从 0 开始，递增）
+    gint64 selected;            // 选中的列表行，-1 表示没有选中
+
+    GtkTextMark* scanned_mark;  // 已扫描部分最后一行的行首，之后追加的内容只需从这里扫描
+    gboolean dirty;             // 已扫描的部分被修改，需要完整重新筛选
+    guint refresh_id;           // 等待开始的筛选
+    GCancellable* cancellable;  // 进行中的筛选
+    gboolean refresh_pending;   // 筛选期间文档又有追加，完成后继续
+
+    guint generation;           // 每次修改文档加一
+    GPtrArray* columns;         // 上次查询建立的字段索引（LogColumn）
+    guint columns_generation;   // columns 对应的文档版本
+};
+
+// 后台筛选任务
+struct FilterJob
+{
+    FilterView* view;
+    GBytes* text;               // 完整快照，或已扫描部分之后的文本
+    guint base_line;            // text 第一行的行号
+    gboolean append;            // 结果接在已有结果之后
+    gchar** patterns;
+    gboolean case_sensitive;
+    gchar* query;               // 字段查询，为 NULL 时按 patterns 筛选
+    GPtrArray* columns;         // 开始时为可复用的索引，完成后为本次查询用到的全部索引
+    guint generation;           // 快照对应的文档版本
+    gint64 index_time;          // 建立索引用的时间（微秒），全部复用时为 0
+    gint64 query_time;
+    GArray* lines;
+    gint64 start_time;
+};
+
+// 一个线程处理的一段，起止都在行首
+typedef struct FilterPart
+{
+    const SearchPattern* patterns;
+    guint pattern_count;
+    const char* text;
+    gsize start;
+    gsize end;
+    guint newlines;             // 本段的换行数
+    GArray* lines;              // 匹配行相对本段第一行的行号
+    GCancellable* cancellable;
+} FilterPart;
+
+static gsize find_from(const FilterPart* part, guint index, gsize pos)
+{
+    const char* found = text_search_find(&part->patterns[index], part->text + pos, part->end - pos);
+    return found ? (gsize)(found - part->text) : G_MAXSIZE;
+}
+
+// 每个条件记住下一个匹配的位置，取最靠前的一个；记录所在行后跳到下一行，同一行只记录一次
+static gpointer filter_part_thread(gpointer data)
+{
+    FilterPart* part = (FilterPart*)data;
+    gsize next[FILTER_VIEW_MAX_PATTERNS];
+    for (guint i = 0; i < part->pattern_count; i++)
+        next[i] = find_from(part, i, part->start);
+
+    gsize counted = part->start;
+    guint line = 0;
+    while (!g_cancellable_is_cancelled(part->cancellable))
+    {
+        gsize first = G_MAXSIZE;
+        for (guint i = 0; i < part->pattern_count; i++)
+            first = MIN(first, next[i]);
+        if (first == G_MAXSIZE)
+            break;
+
+        line += text_count_line_breaks(part->text + counted, first - counted);
+        counted = first;
+        g_array_append_val(part->lines, line);
+
+        gsize break_length;
+        const char* line_break = text_find_line_break(part->text + first, part->end - first, &break_length);
+        gsize pos = line_break ? (gsize)(line_break - part->text) + break_length : part->end;
+        for (guint i = 0; i < part->pattern_count; i++)
+        {
+            if (next[i] < pos)
+                next[i] = pos < part->end ? find_from(part, i, pos) : G_MAXSIZE;
+        }
+    }
+
+    part->newlines = line + text_count_line_breaks(part->text + counted, part->end - counted);
+    return NULL;
+}
+
+// 按行首把文本切成若干段并行查找，按顺序合并为行号
+static GArray* filter_lines(const SearchPattern* patterns, guint pattern_count, const char* text, gsize length,
+                            guint base_line, GCancellable* cancellable)
+{
+    guint threads = MAX(1, g_get_num_processors());
+    guint count = (guint)MIN((gsize)threads, MAX((gsize)1, length / FILTER_VIEW_PART_MIN));
+
+    FilterPart* parts = g_new0(FilterPart, count);
+    gsize start = 0;
+    for (guint i = 0; i < count; i++)
+    {
+        gsize end = length;
+        if (i + 1 < count)
+        {
+            gsize target = MAX(start, length / count * (i + 1));
+            const char* newline = memchr(text + target, '\n', length - target);
+            end = newline ? (gsize)(newline - text) + 1 : length;
+        }
+        parts[i].patterns = patterns;
+        parts[i].pattern_count = pattern_count;
+        parts[i].text = text;
+        parts[i].start = start;
+        parts[i].end = end;
+        parts[i].lines = g_array_new(FALSE, FALSE, sizeof(guint));
+        parts[i].cancellable = cancellable;
+        start = end;
+    }
+
+    GThread** workers = g_new0(GThread*, count);
+    for (guint i = 1; i < count; i++)
+        workers[i] = g_thread_new("filter-view", filter_part_thread, &parts[i]);
+    filter_part_thread(&parts[0]);  // 第一段在当前线程执行
+    for (guint i = 1; i < count; i++)
+        g_thread_join(workers[i]);
+    g_free(workers);
+
+    GArray* lines = g_array_new(FALSE, FALSE, sizeof(guint));
+    guint base = base_line;
+    for (guint i = 0; i < count; i++)
+    {
+        for (guint j = 0; j < parts[i].lines->len; j++)
+        {
+            guint line = base + g_array_index(parts[i].lines, guint, j);
+            g_array_append_val(lines, line);
+        }
+        base += parts[i].newlines;
+        g_array_free(parts[i].lines, TRUE);
+    }
+    g_free(parts);
+    return lines;
+}
+
+static void filter_job_free(FilterJob* job)
+{
+    if (job->text)
+        g_bytes_unref(job->text);
+    g_strfreev(job->patterns);
+    g_free(job->query);
+    if (job->columns)
+        g_ptr_array_unref(job->columns);
+    if (job->lines)
+        g_array_unref(job->lines);
+    g_free(job);
+}
+
+static LogColumn* find_column(GPtrArray* columns, const char* field)
+{
+    for (guint i = 0; columns && i < columns->len; i++)
+    {
+        LogColumn* column = g_ptr_array_index(columns, i);
+        if (strcmp(log_column_get_field(column), field) == 0)
+            return column;
+    }
+    return NULL;
+}
+
+// 复用已有的字段索引，只为缺少的字段扫描快照，再在索引上执行查询
+static void query_job_thread(FilterJob* job, GCancellable* cancellable)
+{
+    LogQuery* query = log_query_parse(job->query, NULL);
+    gchar** fields = log_query_get_fields(query);
+    GPtrArray* columns = g_ptr_array_new_with_free_func((GDestroyNotify)log_column_unref);
+    GPtrArray* missing = g_ptr_array_new();
+    for (gchar** field = fields; *field; field++)
+    {
+        LogColumn* column = find_column(job->columns, *field);
+        if (column)
+            g_ptr_array_add(columns, log_column_ref(column));
+        else
+            g_ptr_array_add(missing, *field);
+    }
+
+    if (missing->len > 0)
+    {
+        g_ptr_array_add(missing, NULL);
+        gsize length;
+        const char* text = (const char*)g_bytes_get_data(job->text, &length);
+        gint64 start = g_get_monotonic_time();
+        GPtrArray* built = log_columns_build((const char* const*)missing->pdata, text, length, cancellable);
+        job->index_time = g_get_monotonic_time() - start;
+        for (guint i = 0; built && i < built->len; i++)
+            g_ptr_array_add(columns, log_column_ref(g_ptr_array_index(built, i)));
+        if (built)
+            g_ptr_array_unref(built);
+    }
+
+    if (!g_cancellable_is_cancelled(cancellable))
+    {
+        gint64 start = g_get_monotonic_time();
+        job->lines = log_query_run(query, columns);
+        job->query_time = g_get_monotonic_time() - start;
+    }
+
+    if (job->columns)
+        g_ptr_array_unref(job->columns);
+    job->columns = columns;
+    g_ptr_array_free(missing, TRUE);
+    g_strfreev(fields);
+    log_query_free(query);
+}
+
+static void filter_job_thread(GTask* task, gpointer source, gpointer task_data, GCancellable* cancellable)
+{
+    FilterJob* job = (FilterJob*)task_data;
+    if (job->query)
+    {
+        query_job_thread(job, cancellable);
+        if (!g_task_return_error_if_cancelled(task))
+            g_task_return_boolean(task, TRUE);
+        return;
+    }
+
+    gsize length;
+    const char* text = (const char*)g_bytes_get_data(job->text, &length);
+
+    SearchPattern patterns[FILTER_VIEW_MAX_PATTERNS];
+    guint count = g_strv_length(job->patterns);
+    for (guint i = 0; i < count; i++)
+        text_search_pattern_init(&patterns[i], job->patterns[i], strlen(job->patterns[i]), job->case_sensitive);
+
+    job->lines = filter_lines(patterns, count, text, length, job->base_line, cancellable);
+    if (!g_task_return_error_if_cancelled(task))
+        g_task_return_boolean(task, TRUE);
+}
+
+static void set_status(FilterView* view, const char* message)
+{
+    gtk_label_set_text(GTK_LABEL(view->status_label), message);
+}
+
+static guint list_length(FilterView* view)
+{
+    return view->lines ? view->lines->len : 0;
+}
+
+static void update_adjustment(FilterView* view)
+{
+    gint height = gtk_widget_get_allocated_height(view->area) - 2 * FILTER_VIEW_MARGIN;
+    gdouble page = MAX(1, height / view->row_height);
+    gdouble rows = (gdouble)list_length(view);
+    gdouble value = MIN(gtk_adjustment_get_value(view->adjustment), MAX(0, rows - page));
+    gtk_adjustment_configure(view->adjustment, value, 0, rows, 1, page, page);
+    gtk_widget_queue_draw(view->area);
+}
+
+static void start_filter(FilterView* view);
+
+static void filter_job_done(GObject* source, GAsyncResult* result, gpointer data)
+{
+    FilterJob* job = (FilterJob*)data;
+    GError* error = NULL;
+
+    // 被新的条件取消或面板已释放
+    if (!g_task_propagate_boolean(G_TASK(result), &error))
+    {
+        g_error_free(error);
+        filter_job_free(job);
+        return;
+    }
+
+    FilterView* view = job->view;
+    g_clear_object(&view->cancellable);
+
+    // 筛选期间文档被修改，结果的行号可能已与缓冲区对不上，丢弃后由修改触发的刷新重新筛选。
+    // 修改都在已扫描部分之后时，追加扫描退回本次的起点即可
+    if (job->generation != view->generation)
+    {
+        if (job->append && !view->dirty)
+        {
+            GtkTextIter start;
+            gtk_text_buffer_get_iter_at_line(view->app->ui->buffer, &start, (gint)job->base_line);
+            gtk_text_buffer_move_mark(view->app->ui->buffer, view->scanned_mark, &start);
+        }
+        else
+        {
+            view->dirty = TRUE;
+        }
+        filter_job_free(job);
+        if (view->refresh_pending)
+        {
+            view->refresh_pending = FALSE;
+            start_filter(view);
+        }
+        return;
+    }
+
+    if (job->append && view->lines)
+    {
+        // 从重新扫描的第一行开始用新结果代替
+        guint keep = view->lines->len;
+        while (keep > 0 && g_array_index(view->lines, guint, keep - 1) >= job->base_line)
+            keep--;
+        g_array_set_size(view->lines, keep);
+        g_array_append_vals(view->lines, job->lines->data, job->lines->len);
+        if (view->selected >= (gint64)view->lines->len)
+            view->selected = -1;
+    }
+    else
+    {
+        if (view->lines)
+            g_array_unref(view->lines);
+        view->lines = g_array_ref(job->lines);
+        view->selected = -1;
+    }
+    update_adjustment(view);
+
+    gchar* status;
+    if (job->query)
+    {
+        // 保留本次的索引，文档未修改时下次查询可以直接使用
+        if (view->columns)
+            g_ptr_array_unref(view->columns);
+        view->columns = g_ptr_array_ref(job->columns);
+        view->columns_generation = job->generation;
+        if (job->index_time > 0)
+            status = g_strdup_printf("%u 行匹配（建立索引 %" G_GINT64_FORMAT " 毫秒，查询 %" G_GINT64_FORMAT " 毫秒）",
+                                     view->lines->len, job->index_time / 1000, job->query_time / 1000);
+        else
+            status = g_strdup_printf("%u 行匹配（查询 %" G_GINT64_FORMAT " 毫秒）", view->lines->len,
+                                     job->query_time / 1000);
+    }
+    else
+    {
+        status = g_strdup_printf("%u 行匹配（%" G_GINT64_FORMAT " 毫秒）", view->lines->len,
+                                 (g_get_monotonic_time() - job->start_time) / 1000);
+    }
+    set_status(view, status);
+    g_free(status);
+    filter_job_free(job);
+
+    if (view->refresh_pending)
+    {
+        view->refresh_pending = FALSE;
+        start_filter(view);
+    }
+}
+
+static void cancel_filter(FilterView* view)
+{
+    if (view->refresh_id)
+    {
+        g_source_remove(view->refresh_id);
+        view->refresh_id = 0;
+    }
+    if (view->cancellable)
+    {
+        g_cancellable_cancel(view->cancellable);
+        g_clear_object(&view->cancellable);
+    }
+    view->refresh_pending = FALSE;
+}
+
+// 文档被修改过时完整筛选快照，否则只扫描已扫描部分最后一行及之后追加的内容
+static void start_filter(FilterView* view)
+{
+    NotepadApp* app = view->app;
+    GtkTextBuffer* buffer = app->ui->buffer;
+    if (!view->patterns && !view->query)
+        return;
+    if (view->cancellable)
+    {
+        view->refresh_pending = TRUE;
+        return;
+    }
+
+    FilterJob* job = g_new0(FilterJob, 1);
+    job->view = view;
+    job->patterns = g_strdupv(view->patterns);
+    job->case_sensitive = view->case_sensitive;
+    job->start_time = g_get_monotonic_time();
+    job->generation = view->generation;
+
+    GtkTextIter start, end;
+    gtk_text_buffer_get_end_iter(buffer, &end);
+    if (view->query)
+    {
+        // 字段查询总是针对整个文档；索引是当前版本的并且包含所有字段时不需要快照
+        job->query = g_strdup(view->query);
+        if (view->columns && view->columns_generation == view->generation)
+            job->columns = g_ptr_array_ref(view->columns);
+        gboolean complete = TRUE;
+        for (gchar** field = view->fields; *field && complete; field++)
+            complete = find_column(job->columns, *field) != NULL;
+        if (!complete)
+            job->text = notepad_get_snapshot(app);
+    }
+    else if (view->dirty || !view->lines)
+    {
+        job->text = notepad_get_snapshot(app);
+    }
+    else
+    {
+        gtk_text_buffer_get_iter_at_mark(buffer, &start, view->scanned_mark);
+        job->base_line = (guint)gtk_text_iter_get_line(&start);
+        job->append = TRUE;
+        gchar* tail = gtk_text_buffer_get_text(buffer, &start, &end, TRUE);
+        job->text = g_bytes_new_take(tail, strlen(tail));
+    }
+
+    // 最后一行之后可能继续追加，下次从它的行首开始
+    gtk_text_iter_set_line_offset(&end, 0);
+    gtk_text_buffer_move_mark(buffer, view->scanned_mark, &end);
+    view->dirty = FALSE;
+
+    set_status(view, "正在筛选…");
+    view->cancellable = g_cancellable_new();
+    GTask* task = g_task_new(NULL, view->cancellable, filter_job_done, job);
+    g_task_set_task_data(task, job, NULL);
+    g_task_run_in_thread(task, filter_job_thread);
+    g_object_unref(task);
+}
+
+static gboolean on_refresh_timeout(gpointer data)
+{
+    FilterView* view = (FilterView*)data;
+    view->refresh_id = 0;
+    start_filter(view);
+    return G_SOURCE_REMOVE;
+}
+
+static void schedule_filter(FilterView* view)
+{
+    if ((!view->patterns && !view->query) || !gtk_widget_get_visible(view->panel))
+        return;
+    if (view->refresh_id)
+        g_source_remove(view->refresh_id);
+    view->refresh_id = g_timeout_add(FILTER_VIEW_DELAY, on_refresh_timeout, view);
+}
+
+static void clear_columns(FilterView* view)
+{
+    if (view->columns)
+    {
+        g_ptr_array_unref(view->columns);
+        view->columns = NULL;
+    }
+}
+
+static void clear_results(FilterView* view, const char* status)
+{
+    if (view->lines)
+    {
+        g_array_unref(view->lines);
+        view->lines = NULL;
+    }
+    view->selected = -1;
+    update_adjustment(view);
+    set_status(view, status);
+}
+
+// 字段查询模式下整个输入是一个查询，先在这里校验，出错时在状态栏显示原因
+static void set_query(FilterView* view, const char* text)
+{
+    GError* error = NULL;
+    LogQuery* query = *text ? log_query_parse(text, &error) : NULL;
+    if (!query)
+    {
+        clear_results(view, error ? error->message : "输入查询，例如 level=error latency>500");
+        g_clear_error(&error);
+        return;
+    }
+
+    view->query = g_strdup(text);
+    view->fields = log_query_get_fields(query);
+    log_query_free(query);
+    set_status(view, "…");
+    schedule_filter(view);
+}
+
+// 条件用 | 分隔，忽略空条件
+static void on_pattern_changed(GtkWidget* widget, gpointer data)
+{
+    FilterView* view = (FilterView*)data;
+    cancel_filter(view);
+    g_strfreev(view->patterns);
+    view->patterns = NULL;
+    g_clear_pointer(&view->query, g_free);
+    g_clear_pointer(&view->fields, g_strfreev);
+    view->dirty = TRUE;
+    view->case_sensitive = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(view->case_check));
+
+    gboolean structured = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(view->field_check));
+    gtk_widget_set_sensitive(view->case_check, !structured);
+    gtk_entry_set_placeholder_text(GTK_ENTRY(view->entry), structured ? "例如 level=error latency>500"
+                                                                      : "筛选行，例如 ERROR|timeout");
+    if (structured)
+    {
+        set_query(view, gtk_entry_get_text(GTK_ENTRY(view->entry)));
+        return;
+    }
+    clear_columns(view);
+
+    gchar** parts = g_strsplit(gtk_entry_get_text(GTK_ENTRY(view->entry)), "|", -1);
+    GPtrArray* patterns = g_ptr_array_new();
+    for (gchar** part = parts; *part; part++)
+    {
+        if (**part && patterns->len < FILTER_VIEW_MAX_PATTERNS)
+            g_ptr_array_add(patterns, g_strdup(*part));
+    }
+    g_ptr_array_add(patterns, NULL);
+    gchar** list = (gchar**)g_ptr_array_free(patterns, FALSE);
+    g_strfreev(parts);
+
+    if (!list[0])
+    {
+        g_strfreev(list);
+        clear_results(view, "输入条件，多个条件用 | 分隔");
+        return;
+    }
+    for (gchar** pattern = list; *pattern; pattern++)
+    {
+        if (!text_search_pattern_supported(*pattern, view->case_sensitive))
+        {
+            g_strfreev(list);
+            clear_results(view, "不区分大小写时条件只能包含 ASCII 字符");
+            return;
+        }
+    }
+
+    view->patterns = list;
+    set_status(view, "…");
+    schedule_filter(view);
+}
+
+// 已扫描部分之前的修改需要完整重新筛选。从最后一行行首开始的修改（例如末尾追加）不影响之前的行号，
+// 只需重新扫描最后一行及之后的部分
+static void on_buffer_insert(GtkTextBuffer* buffer, GtkTextIter* location, gchar* text, gint len, gpointer data)
+{
+    FilterView* view = (FilterView*)data;
+    GtkTextIter scanned;
+    gtk_text_buffer_get_iter_at_mark(buffer, &scanned, view->scanned_mark);
+    if (gtk_text_iter_compare(location, &scanned) < 0)
+        view->dirty = TRUE;
+    view->generation++;
+    schedule_filter(view);
+}
+
+static void on_buffer_delete(GtkTextBuffer* buffer, GtkTextIter* start, GtkTextIter* end, gpointer data)
+{
+    FilterView* view = (FilterView*)data;
+    GtkTextIter scanned;
+    gtk_text_buffer_get_iter_at_mark(buffer, &scanned, view->scanned_mark);
+    if (gtk_text_iter_compare(start, &scanned) < 0)
+        view->dirty = TRUE;
+    view->generation++;
+    schedule_filter(view);
+}
+
+static void measure_font(FilterView* view)
+{
+    PangoLayout* layout = gtk_widget_create_pango_layout(view->area, "0");
+    pango_layout_set_font_description(layout, view->font);
+    gint width, height;
+    pango_layout_get_pixel_size(layout, &width, &height);
+    view->row_height = MAX(height, 1);
+    g_object_unref(layout);
+}
+
+// 字段查询时在行内容之前列出查询用到的字段的值
+static void append_fields(FilterView* view, GString* row, const char* text)
+{
+    gsize length = strlen(text);
+    for (gchar** field = view->fields; *field; field++)
+    {
+        const char* value;
+        gsize value_length;
+        if (log_line_get_field(text, length, *field, &value, &value_length))
+            g_string_append_printf(row, "%s=%.*s  ", *field, (int)value_length, value);
+    }
+    g_string_append(row, "│ ");
+}
+
+// 只为可见的行从缓冲区取出内容，过长的行截断
+static void format_row(FilterView* view, GString* row, guint line)
+{
+    GtkTextBuffer* buffer = view->app->ui->buffer;
+    GtkTextIter start, end;
+    gtk_text_buffer_get_iter_at_line(buffer, &start, (gint)line);
+    end = start;
+    if (!gtk_text_iter_ends_line(&end))
+        gtk_text_iter_forward_to_line_end(&end);
+    GtkTextIter limit = start;
+    gtk_text_iter_forward_chars(&limit, FILTER_VIEW_PREVIEW);
+    if (gtk_text_iter_compare(&limit, &end) < 0)
+        end = limit;
+
+    gchar* text = gtk_text_buffer_get_text(buffer, &start, &end, TRUE);
+    g_string_printf(row, "%8u  ", line + 1);
+    if (view->fields)
+        append_fields(view, row, text);
+    g_string_append(row, text);
+    g_free(text);
+}
+
+static gboolean on_list_draw(GtkWidget* widget, cairo_t* cr, gpointer data)
+{
+    FilterView* view = (FilterView*)data;
+    GtkStyleContext* style = gtk_widget_get_style_context(widget);
+    gint width = gtk_widget_get_allocated_width(widget);
+    gint height = gtk_widget_get_allocated_height(widget);
+    gtk_render_background(style, cr, 0, 0, width, height);
+
+    GdkRGBA color;
+    gtk_style_context_get_color(style, gtk_style_context_get_state(style), &color);
+    PangoLayout* layout = gtk_widget_create_pango_layout(widget, NULL);
+    pango_layout_set_font_description(layout, view->font);
+    pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
+    pango_layout_set_width(layout, MAX(1, width - 2 * FILTER_VIEW_MARGIN) * PANGO_SCALE);
+    GString* row = g_string_sized_new(128);
+
+    guint first = (guint)gtk_adjustment_get_value(view->adjustment);
+    gint visible = height / view->row_height + 1;
+    for (gint i = 0; i < visible && first + (guint)i < list_length(view); i++)
+    {
+        guint index = first + (guint)i;
+        gdouble y = FILTER_VIEW_MARGIN + i * view->row_height;
+        if ((gint64)index == view->selected)
+        {
+            cairo_set_source_rgba(cr, 0.2, 0.5, 0.9, 0.35);
+            cairo_rectangle(cr, 0, y, width, view->row_height);
+            cairo_fill(cr);
+        }
+
+        format_row(view, row, g_array_index(view->lines, guint, index));
+        pango_layout_set_text(layout, row->str, (gint)row->len);
+        gdk_cairo_set_source_rgba(cr, &color);
+        cairo_move_to(cr, FILTER_VIEW_MARGIN, y);
+        pango_cairo_show_layout(cr, layout);
+    }
+
+    g_string_free(row, TRUE);
+    g_object_unref(layout);
+    return FALSE;
+}
+
+// 选中列表中的一行并在编辑器中跳转到对应的行
+static void select_row(FilterView* view, gint64 index)
+{
+    if (list_length(view) == 0)
+        return;
+    index = CLAMP(index, 0, (gint64)list_length(view) - 1);
+    view->selected = index;
+
+    gdouble value = gtk_adjustment_get_value(view->adjustment);
+    gdouble page = gtk_adjustment_get_page_size(view->adjustment);
+    if (index < value)
+        gtk_adjustment_set_value(view->adjustment, (gdouble)index);
+    else if (index >= value + page)
+        gtk_adjustment_set_value(view->adjustment, (gdouble)index - page + 1);
+    gtk_widget_queue_draw(view->area);
+
+    NotepadApp* app = view->app;
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_line(app->ui->buffer, &iter, (gint)g_array_index(view->lines, guint, index));
+    gtk_text_buffer_place_cursor(app->ui->buffer, &iter);
+    gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(app->ui->text_view), gtk_text_buffer_get_insert(app->ui->buffer),
+                                 0.1, TRUE, 0.0, 0.3);
+}
+
+static gboolean on_list_button_press(GtkWidget* widget, GdkEventButton* event, gpointer data)
+{
+    FilterView* view = (FilterView*)data;
+    gtk_widget_grab_focus(widget);
+    if (event->button != GDK_BUTTON_PRIMARY || event->y < FILTER_VIEW_MARGIN)
+        return FALSE;
+
+    gint64 index = (gint64)gtk_adjustment_get_value(view->adjustment) +
+                   (gint64)((event->y - FILTER_VIEW_MARGIN) / view->row_height);
+    if (index < (gint64)list_length(view))
+        select_row(view, index);
+    return TRUE;
+}
+
+static gboolean on_list_key_press(GtkWidget* widget, GdkEventKey* event, gpointer data)
+{
+    FilterView* view = (FilterView*)data;
+    gint64 page = (gint64)gtk_adjustment_get_page_size(view->adjustment);
+
+    switch (event->keyval)
+    {
+        case GDK_KEY_Up:
+            select_row(view, view->selected - 1);
+            break;
+        case GDK_KEY_Down:
+            select_row(view, view->selected + 1);
+            break;
+        case GDK_KEY_Page_Up:
+            select_row(view, view->selected - page);
+            break;
+        case GDK_KEY_Page_Down:
+            select_row(view, view->selected + page);
+            break;
+        case GDK_KEY_Home:
+            select_row(view, 0);
+            break;
+        case GDK_KEY_End:
+            select_row(view, (gint64)list_length(view) - 1);
+            break;
+        case GDK_KEY_Return:
+        case GDK_KEY_KP_Enter:
+            gtk_widget_grab_focus(view->app->ui->text_view);
+            break;
+        default:
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean on_list_scroll(GtkWidget* widget, GdkEventScroll* event, gpointer data)
+{
+    FilterView* view = (FilterView*)data;
+    gdouble delta;
+    gdouble dx, dy;
+
+    switch (event->direction)
+    {
+        case GDK_SCROLL_UP:
+            delta = -FILTER_VIEW_WHEEL_ROWS;
+            break;
+        case GDK_SCROLL_DOWN:
+            delta = FILTER_VIEW_WHEEL_ROWS;
+            break;
+        case GDK_SCROLL_SMOOTH:
+            gdk_event_get_scroll_deltas((GdkEvent*)event, &dx, &dy);
+            delta = dy * FILTER_VIEW_WHEEL_ROWS;
+            break;
+        default:
+            return FALSE;
+    }
+
+    gtk_adjustment_set_value(view->adjustment, gtk_adjustment_get_value(view->adjustment) + delta);
+    return TRUE;
+}
+
+static void on_list_size_allocate(GtkWidget* widget, GdkRectangle* allocation, gpointer data)
+{
+    update_adjustment((FilterView*)data);
+}
+
+static void on_adjustment_changed(GtkAdjustment* adjustment, gpointer data)
+{
+    FilterView* view = (FilterView*)data;
+    gtk_widget_queue_draw(view->area);
+}
+
+FilterView* filter_view_new(NotepadApp* app)
+{
+    FilterView* view = g_new0(FilterView, 1);
+    view->app = app;
+    view->selected = -1;
+    view->dirty = TRUE;
+    view->font = pango_font_description_from_string("Monospace 10");
+
+    GtkTextIter start;
+    gtk_text_buffer_get_start_iter(app->ui->buffer, &start);
+    view->scanned_mark = gtk_text_buffer_create_mark(app->ui->buffer, NULL, &start, TRUE);
+
+    view->panel = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    gtk_widget_set_size_request(view->panel, 360, -1);
+
+    GtkWidget* toolbar = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+    gtk_container_set_border_width(GTK_CONTAINER(toolbar), 5);
+    view->entry = gtk_search_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(view->entry), "筛选行，例如 ERROR|timeout");
+    view->case_check = gtk_check_button_new_with_label("区分大小写");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(view->case_check), TRUE);
+    gtk_box_pack_start(GTK_BOX(toolbar), view->entry, TRUE, TRUE, 0);
+    view->field_check = gtk_check_button_new_with_label("字段查询");
+    gtk_widget_set_tooltip_text(view->field_check,
+                                "按字段查询 JSON 行或 key=value 日志，例如 level=error latency>500");
+    gtk_box_pack_start(GTK_BOX(toolbar), view->case_check, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), view->field_check, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(view->panel), toolbar, FALSE, FALSE, 0);
+
+    GtkWidget* hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+    view->adjustment = gtk_adjustment_new(0, 0, 1, 1, 1, 1);
+    view->area = gtk_drawing_area_new();
+    gtk_widget_set_can_focus(view->area, TRUE);
+    gtk_widget_add_events(view->area, GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK | GDK_BUTTON_PRESS_MASK |
+                                      GDK_KEY_PRESS_MASK);
+    GtkWidget* scrollbar = gtk_scrollbar_new(GTK_ORIENTATION_VERTICAL, view->adjustment);
+    gtk_box_pack_start(GTK_BOX(hbox), view->area, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(hbox), scrollbar, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(view->panel), hbox, TRUE, TRUE, 0);
+
+    view->status_label = gtk_label_new("输入条件，多个条件用 | 分隔");
+    gtk_widget_set_halign(view->status_label, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(view->status_label, 5);
+    gtk_widget_set_margin_top(view->status_label, 3);
+    gtk_widget_set_margin_bottom(view->status_label, 3);
+    gtk_box_pack_start(GTK_BOX(view->panel), view->status_label, FALSE, FALSE, 0);
+
+    measure_font(view);
+    gtk_widget_show_all(view->panel);
+    gtk_widget_hide(view->panel);
+    gtk_widget_set_no_show_all(view->panel, TRUE);
+
+    g_signal_connect(view->entry, "changed", G_CALLBACK(on_pattern_changed), view);
+    g_signal_connect(view->case_check, "toggled", G_CALLBACK(on_pattern_changed), view);
+    g_signal_connect(view->field_check, "toggled", G_CALLBACK(on_pattern_changed), view);
+    g_signal_connect(view->area, "draw", G_CALLBACK(on_list_draw), view);
+    g_signal_connect(view->area, "size-allocate", G_CALLBACK(on_list_size_allocate), view);
+    g_signal_connect(view->area, "scroll-event", G_CALLBACK(on_list_scroll), view);
+    g_signal_connect(view->area, "key-press-event", G_CALLBACK(on_list_key_press), view);
+    g_signal_connect(view->area, "button-press-event", G_CALLBACK(on_list_button_press), view);
+    g_signal_connect(view->adjustment, "value-changed", G_CALLBACK(on_adjustment_changed), view);
+    g_signal_connect(app->ui->buffer, "insert-text", G_CALLBACK(on_buffer_insert), view);
+    g_signal_connect(app->ui->buffer, "delete-range", G_CALLBACK(on_buffer_delete), view);
+    return view;
+}
+
+GtkWidget* filter_view_get_widget(FilterView* view)
+{
+    return view->panel;
+}
+
+void filter_view_free(FilterView* view)
+{
+    if (!view)
+        return;
+    cancel_filter(view);
+    g_strfreev(view->patterns);
+    g_free(view->query);
+    g_strfreev(view->fields);
+    clear_columns(view);
+    if (view->lines)
+        g_array_unref(view->lines);
+    pango_font_description_free(view->font);
+    g_free(view);
+}
+
+// 隐藏时停止跟随文档的修改，再次显示时完整筛选一次
+void filter_view_set_visible(FilterView* view, gboolean visible)
+{
+    if (visible)
+    {
+        gtk_widget_show(view->panel);
+        view->dirty = TRUE;
+        schedule_filter(view);
+        gtk_widget_grab_focus(view->entry);
+    }
+    else
+    {
+        cancel_filter(view);
+        gtk_widget_hide(view->panel);
+        gtk_widget_grab_focus(view->app->ui->text_view);
+    }
+}
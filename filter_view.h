@@ -0,0 +1,28 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef FILTER_VIEW_H
+#define FILTER_VIEW_H
+
+#include <gtk/gtk.h>
+#include "notepad.h"
+
+#define FILTER_VIEW_DELAY        200            // 输入条件或编辑文档后多久开始筛选（毫秒）
+#define FILTER_VIEW_MAX_PATTERNS 16             // 用 | 分隔的条件最多的个数
+#define FILTER_VIEW_PART_MIN     (1024 * 1024)  // 每个线程至少分到的字节数
+#define FILTER_VIEW_PREVIEW      400            // 每行最多显示的字符数
+
+// 筛选行面板：只列出包含任一条件（用 | 分隔，按字面匹配）的行，不修改文档。
+// 在后台对快照按行首切块并行查找，得到匹配行的行号；列表只绘制可见的行，从缓冲区取行内容，
+// 点击某行跳转到编辑器中的该行。文档只在末尾追加内容时，只扫描上次扫描的最后一行及之后的部分
+// 勾选“字段查询”时输入按字段的查询（见 log_index.h），为查询用到的字段建立索引并缓存，
+// 文档未修改时换一个查询只需在索引上重新计算
+typedef struct FilterView FilterView;
+
+extern FilterView* filter_view_new(NotepadApp* app);        // 在文本视图创建之后调用，面板默认隐藏
+extern GtkWidget* filter_view_get_widget(FilterView* view);
+extern void filter_view_free(FilterView* view);
+extern void filter_view_set_visible(FilterView* view, gboolean visible);
+
+#endif // FILTER_VIEW_H
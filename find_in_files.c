@@ -0,0 +1,577 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "find_in_files.h"
+#include "notepad.h"
+#include "file_operations.h"
+#include "output_exception.h"
+#include "text_search.h"
+#include "long_operation.h"
+#include <string.h>
+
+#define FIND_BINARY_PROBE   (8 * 1024)          // 检查开头这么多字节中是否有 NUL 来判断二进制文件
+#define FIND_BLOCK_SIZE     (4 * 1024 * 1024)   // 大文件每扫描一块检查一次取消
+#define FIND_FLUSH_COUNT    256                 // 单个文件积累这么多结果后先交给主线程
+#define FIND_PREVIEW_BYTES  200                 // 结果列表中显示的行内容长度
+#define FIND_PREVIEW_BEFORE 60                  // 长行中匹配位置之前保留的字节数
+#define FIND_DRAIN_INTERVAL 100                 // 主线程取结果的间隔（毫秒）
+
+enum
+{
+    COLUMN_PATH,
+    COLUMN_DISPLAY,
+    COLUMN_LINE,
+    COLUMN_TEXT,
+    COLUMN_COUNT
+};
+
+typedef struct FindResult
+{
+    gchar* path;
+    gint line;              // 从 1 开始
+    gchar* text;            // 行内容预览（有效的 UTF-8）
+} FindResult;
+
+// 一次搜索的共享状态，由面板、遍历线程共同持有
+typedef struct FindSearch
+{
+    gint ref_count;
+    gchar* root;
+    gchar* needle;
+    SearchPattern pattern;
+    GCancellable* cancellable;
+    GThreadPool* pool;      // 逐个文件搜索的工作线程
+    GMutex lock;
+    GPtrArray* pending;     // 尚未加入列表的结果，由 lock 保护
+    gint files_searched;    // 以下字段原子访问
+    gint result_count;
+    gint finished;          // 遍历结束且所有文件都已处理
+} FindSearch;
+
+struct FindInFiles
+{
+    NotepadApp* app;
+    GtkWidget* window;
+    GtkWidget* entry;
+    GtkWidget* folder_button;
+    GtkWidget* case_check;
+    GtkWidget* search_button;
+    GtkWidget* stop_button;
+    GtkWidget* status_label;
+    GtkListStore* store;
+    FindSearch* search;     // 当前或最近一次搜索
+    guint drain_id;
+};
+
+static void find_result_free(gpointer data)
+{
+    FindResult* result = (FindResult*)data;
+    g_free(result->path);
+    g_free(result->text);
+    g_free(result);
+}
+
+static FindSearch* find_search_ref(FindSearch* search)
+{
+    g_atomic_int_inc(&search->ref_count);
+    return search;
+}
+
+static void find_search_unref(gpointer data)
+{
+    FindSearch* search = (FindSearch*)data;
+    if (!g_atomic_int_dec_and_test(&search->ref_count))
+        return;
+
+    g_ptr_array_unref(search->pending);
+    g_mutex_clear(&search->lock);
+    g_object_unref(search->cancellable);
+    g_free(search->needle);
+    g_free(search->root);
+    g_free(search);
+}
+
+static void publish_results(FindSearch* search, GPtrArray* results)
+{
+    g_mutex_lock(&search->lock);
+    for (guint i = 0; i < results->len; i++)
+        g_ptr_array_add(search->pending, g_ptr_array_index(results, i));
+    g_mutex_unlock(&search->lock);
+
+    // 结果的所有权已转移
+    g_ptr_array_set_free_func(results, NULL);
+    g_ptr_array_set_size(results, 0);
+    g_ptr_array_set_free_func(results, find_result_free);
+}
+
+// 取匹配所在行的一段作为预览，超长行只保留匹配附近的内容
+static gchar* make_preview(const char* text, gsize line_start, gsize line_end, gsize match)
+{
+    gsize start = line_start;
+    if (match - line_start > FIND_PREVIEW_BEFORE)
+    {
+        start = match - FIND_PREVIEW_BEFORE;
+        while (start < match && ((guchar)text[start] & 0xC0) == 0x80)
+            start++;
+    }
+
+    gsize end = MIN(line_end, start + FIND_PREVIEW_BYTES);
+    if (end > start && text[end - 1] == '\r')
+        end--;
+
+    gchar* preview = g_utf8_make_valid(text + start, (gssize)(end - start));
+    g_strstrip(preview);
+    return preview;
+}
+
+// 与编辑器载入时相同，\r\n、\n 和单独的 \r 都是一个换行
+static gboolean is_line_break(const char* text, gsize i, gsize length)
+{
+    return text[i] == '\n' || (text[i] == '\r' && (i + 1 >= length || text[i + 1] != '\n'));
+}
+
+// 在映射的文件内容中查找，每行只记录一次
+static void search_text(FindSearch* search, const char* path, const char* text, gsize length)
+{
+    GPtrArray* results = g_ptr_array_new_with_free_func(find_result_free);
+    gsize needle_length = search->pattern.length;
+    gsize position = 0;
+    gsize counted = 0;          // 已统计换行到该位置
+    gsize line_start = 0;
+    gint line = 1;
+
+    while (position < length && !g_cancellable_is_cancelled(search->cancellable))
+    {
+        gsize block = MIN(FIND_BLOCK_SIZE, length - position);
+        gsize scan_end = MIN(length, position + block + needle_length - 1);
+        const char* found = text_search_find(&search->pattern, text + position, scan_end - position);
+        if (!found)
+        {
+            position += block;
+            continue;
+        }
+
+        gsize match = (gsize)(found - text);
+        for (; counted < match; counted++)
+        {
+            if (is_line_break(text, counted, length))
+            {
+                line++;
+                line_start = counted + 1;
+            }
+        }
+
+        gsize line_end = match;
+        while (line_end < length && text[line_end] != '\n' && text[line_end] != '\r')
+            line_end++;
+
+        FindResult* result = g_new(FindResult, 1);
+        result->path = g_strdup(path);
+        result->line = line;
+        result->text = make_preview(text, line_start, line_end, match);
+        g_ptr_array_add(results, result);
+
+        if (g_atomic_int_add(&search->result_count, 1) + 1 >= FIND_IN_FILES_MAX_RESULTS)
+            break;
+        if (results->len >= FIND_FLUSH_COUNT)
+            publish_results(search, results);
+
+        position = line_end;
+    }
+
+    if (results->len > 0)
+        publish_results(search, results);
+    g_ptr_array_unref(results);
+}
+
+// 线程池的工作函数，data 为文件路径
+static void search_file(gpointer data, gpointer user_data)
+{
+    gchar* path = (gchar*)data;
+    FindSearch* search = (FindSearch*)user_data;
+
+    // 取消或结果已满后，队列中剩余的文件直接丢弃
+    if (!g_cancellable_is_cancelled(search->cancellable) &&
+        g_atomic_int_get(&search->result_count) < FIND_IN_FILES_MAX_RESULTS)
+    {
+        GMappedFile* mapped = g_mapped_file_new(path, FALSE, NULL);
+        if (mapped)
+        {
+            const char* text = g_mapped_file_get_contents(mapped);
+            gsize length = g_mapped_file_get_length(mapped);
+
+            // 开头含 NUL 的视为二进制文件，跳过
+            if (length > 0 && !memchr(text, '\0', MIN(length, FIND_BINARY_PROBE)))
+                search_text(search, path, text, length);
+            g_mapped_file_unref(mapped);
+        }
+        g_atomic_int_inc(&search->files_searched);
+    }
+    g_free(path);
+}
+
+static void walk_directory(FindSearch* search, GFile* directory, GQueue* directories, GCancellable* cancellable)
+{
+    GFileEnumerator* enumerator = g_file_enumerate_children(directory,
+                                                            G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                                            G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                            cancellable, NULL);
+    if (!enumerator)
+        return;
+
+    GFileInfo* info;
+    while ((info = g_file_enumerator_next_file(enumerator, cancellable, NULL)) != NULL)
+    {
+        const char* name = g_file_info_get_name(info);
+        GFileType type = g_file_info_get_file_type(info);
+
+        if (type == G_FILE_TYPE_DIRECTORY && name[0] != '.')
+        {
+            // 跳过 .git 等隐藏目录
+            g_queue_push_tail(directories, g_file_enumerator_get_child(enumerator, info));
+        }
+        else if (type == G_FILE_TYPE_REGULAR)
+        {
+            GFile* child = g_file_enumerator_get_child(enumerator, info);
+            g_thread_pool_push(search->pool, g_file_get_path(child), NULL);
+            g_object_unref(child);
+        }
+        g_object_unref(info);
+
+        if (g_atomic_int_get(&search->result_count) >= FIND_IN_FILES_MAX_RESULTS)
+            break;
+    }
+    g_object_unref(enumerator);
+}
+
+// 遍历线程：逐层列出目录，把文件交给线程池，全部处理完后标记结束
+static void walk_thread(GTask* task, gpointer source, gpointer task_data, GCancellable* cancellable)
+{
+    FindSearch* search = (FindSearch*)task_data;
+    GQueue directories = G_QUEUE_INIT;
+    g_queue_push_tail(&directories, g_file_new_for_path(search->root));
+
+    GFile* directory;
+    while ((directory = g_queue_pop_head(&directories)) != NULL)
+    {
+        if (!g_cancellable_is_cancelled(cancellable) &&
+            g_atomic_int_get(&search->result_count) < FIND_IN_FILES_MAX_RESULTS)
+            walk_directory(search, directory, &directories, cancellable);
+        g_object_unref(directory);
+    }
+
+    // 等待队列中的文件处理完（取消时工作线程会直接丢弃）
+    g_thread_pool_free(search->pool, FALSE, TRUE);
+    search->pool = NULL;
+    g_atomic_int_set(&search->finished, TRUE);
+    g_task_return_boolean(task, TRUE);
+}
+
+static FindSearch* find_search_new(const gchar* root, const gchar* needle, gboolean case_sensitive)
+{
+    FindSearch* search = g_new0(FindSearch, 1);
+    search->ref_count = 1;
+    search->root = g_strdup(root);
+    search->needle = g_strdup(needle);
+    text_search_pattern_init(&search->pattern, search->needle, strlen(search->needle), case_sensitive);
+    search->cancellable = g_cancellable_new();
+    g_mutex_init(&search->lock);
+    search->pending = g_ptr_array_new_with_free_func(find_result_free);
+    search->pool = g_thread_pool_new(search_file, search, (gint)g_get_num_processors(), FALSE, NULL);
+    return search;
+}
+
+static void update_status(FindInFiles* panel, gboolean finished)
+{
+    FindSearch* search = panel->search;
+    gint files = g_atomic_int_get(&search->files_searched);
+    gint results = g_atomic_int_get(&search->result_count);
+    gchar* status;
+
+    if (!finished)
+        status = g_strdup_printf("正在搜索... 已搜索 %d 个文件，找到 %d 处", files, results);
+    else if (g_cancellable_is_cancelled(search->cancellable))
+        status = g_strdup_printf("已停止：搜索了 %d 个文件，找到 %d 处", files, results);
+    else if (results >= FIND_IN_FILES_MAX_RESULTS)
+        status = g_strdup_printf("结果过多，只显示前 %d 处", FIND_IN_FILES_MAX_RESULTS);
+    else
+        status = g_strdup_printf("搜索完成：%d 个文件，找到 %d 处", files, results);
+
+    gtk_label_set_text(GTK_LABEL(panel->status_label), status);
+    g_free(status);
+}
+
+// 定时把工作线程积累的结果成批加入列表
+static gboolean drain_results(gpointer data)
+{
+    FindInFiles* panel = (FindInFiles*)data;
+    FindSearch* search = panel->search;
+
+    // 先读结束标记再取结果，保证最后一批不会遗漏
+    gboolean finished = g_atomic_int_get(&search->finished);
+
+    g_mutex_lock(&search->lock);
+    GPtrArray* batch = search->pending;
+    search->pending = g_ptr_array_new_with_free_func(find_result_free);
+    g_mutex_unlock(&search->lock);
+
+    gsize root_length = strlen(search->root);
+    for (guint i = 0; i < batch->len; i++)
+    {
+        FindResult* result = (FindResult*)g_ptr_array_index(batch, i);
+        const char* display = result->path;
+        if (g_str_has_prefix(display, search->root))
+        {
+            display += root_length;
+            while (*display == G_DIR_SEPARATOR)
+                display++;
+        }
+        gtk_list_store_insert_with_values(panel->store, NULL, -1,
+                                          COLUMN_PATH, result->path,
+                                          COLUMN_DISPLAY, display,
+                                          COLUMN_LINE, result->line,
+                                          COLUMN_TEXT, result->text,
+                                          -1);
+    }
+    g_ptr_array_unref(batch);
+
+    update_status(panel, finished);
+    if (!finished)
+        return G_SOURCE_CONTINUE;
+
+    panel->drain_id = 0;
+    gtk_widget_set_sensitive(panel->search_button, TRUE);
+    gtk_widget_set_sensitive(panel->stop_button, FALSE);
+    return G_SOURCE_REMOVE;
+}
+
+// 取消并丢弃当前搜索，不再接收它的结果
+static void discard_search(FindInFiles* panel)
+{
+    if (panel->drain_id)
+    {
+        g_source_remove(panel->drain_id);
+        panel->drain_id = 0;
+    }
+    if (panel->search)
+    {
+        g_cancellable_cancel(panel->search->cancellable);
+        find_search_unref(panel->search);
+        panel->search = NULL;
+    }
+}
+
+static void on_search_clicked(GtkWidget* widget, gpointer data)
+{
+    FindInFiles* panel = (FindInFiles*)data;
+    const gchar* needle = gtk_entry_get_text(GTK_ENTRY(panel->entry));
+    gboolean case_sensitive = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(panel->case_check));
+    if (strlen(needle) == 0)
+        return;
+
+    if (!text_search_pattern_supported(needle, case_sensitive))
+    {
+        show_error_dialog(GTK_WINDOW(panel->window), "无法搜索", "不区分大小写时查找内容只能包含 ASCII 字符。");
+        return;
+    }
+
+    gchar* root = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(panel->folder_button));
+    if (!root)
+    {
+        show_error_dialog(GTK_WINDOW(panel->window), "无法搜索", "请选择要搜索的文件夹。");
+        return;
+    }
+
+    discard_search(panel);
+    gtk_list_store_clear(panel->store);
+    panel->search = find_search_new(root, needle, case_sensitive);
+    g_free(root);
+
+    GTask* task = g_task_new(NULL, panel->search->cancellable, NULL, NULL);
+    g_task_set_task_data(task, find_search_ref(panel->search), find_search_unref);
+    g_task_run_in_thread(task, walk_thread);
+    g_object_unref(task);
+
+    panel->drain_id = g_timeout_add(FIND_DRAIN_INTERVAL, drain_results, panel);
+    gtk_widget_set_sensitive(panel->search_button, FALSE);
+    gtk_widget_set_sensitive(panel->stop_button, TRUE);
+    update_status(panel, FALSE);
+}
+
+static void on_stop_clicked(GtkWidget* widget, gpointer data)
+{
+    FindInFiles* panel = (FindInFiles*)data;
+
+    // 只发出取消，剩余结果和最终状态仍由 drain_results 处理
+    if (panel->search)
+        g_cancellable_cancel(panel->search->cancellable);
+}
+
+static void on_result_activated(GtkTreeView* view, GtkTreePath* path, GtkTreeViewColumn* column, gpointer data)
+{
+    FindInFiles* panel = (FindInFiles*)data;
+    NotepadApp* app = panel->app;
+    GtkTreeIter iter;
+    if (!gtk_tree_model_get_iter(GTK_TREE_MODEL(panel->store), &iter, path))
+        return;
+
+    // 面板不随编辑器锁定，保存等操作进行期间不打开文件，也不弹出保存提示
+    if (long_operation_editor_locked(app))
+    {
+        gtk_widget_error_bell(GTK_WIDGET(view));
+        return;
+    }
+
+    gchar* filename = NULL;
+    gint line = 0;
+    gtk_tree_model_get(GTK_TREE_MODEL(panel->store), &iter, COLUMN_PATH, &filename, COLUMN_LINE, &line, -1);
+
+    // 已经打开的文件直接跳转，否则在载入完成后跳转
+    if (app->filename && strcmp(app->filename, filename) == 0 && !app->load_cancellable)
+        notepad_goto_line(app, line);
+    else if (notepad_check_save_changes(app))
+    {
+        app->open_line = line;
+        notepad_open_path(app, filename);
+    }
+
+    g_free(filename);
+    gtk_window_present(GTK_WINDOW(app->ui->window));
+}
+
+// 关闭面板只是隐藏，同时停止正在进行的搜索，不在后台继续遍历
+static void on_panel_hide(GtkWidget* widget, gpointer data)
+{
+    FindInFiles* panel = (FindInFiles*)data;
+    if (panel->search)
+        g_cancellable_cancel(panel->search->cancellable);
+}
+
+static void on_panel_destroy(GtkWidget* widget, gpointer data)
+{
+    FindInFiles* panel = (FindInFiles*)data;
+    discard_search(panel);
+    panel->window = NULL;
+}
+
+static FindInFiles* find_in_files_new(NotepadApp* app)
+{
+    FindInFiles* panel = g_new0(FindInFiles, 1);
+    panel->app = app;
+
+    panel->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(panel->window), "在文件中查找");
+    gtk_window_set_transient_for(GTK_WINDOW(panel->window), GTK_WINDOW(app->ui->window));
+    gtk_window_set_destroy_with_parent(GTK_WINDOW(panel->window), TRUE);
+    gtk_window_set_default_size(GTK_WINDOW(panel->window), 720, 460);
+    g_signal_connect(panel->window, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
+    g_signal_connect(panel->window, "hide", G_CALLBACK(on_panel_hide), panel);
+    g_signal_connect(panel->window, "destroy", G_CALLBACK(on_panel_destroy), panel);
+
+    GtkWidget* vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
+    gtk_container_set_border_width(GTK_CONTAINER(vbox), 10);
+    gtk_container_add(GTK_CONTAINER(panel->window), vbox);
+
+    // 查找内容和文件夹
+    GtkWidget* grid = gtk_grid_new();
+    gtk_grid_set_row_spacing(GTK_GRID(grid), 5);
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 5);
+
+    GtkWidget* find_label = gtk_label_new("查找内容:");
+    gtk_widget_set_halign(find_label, GTK_ALIGN_START);
+    panel->entry = gtk_entry_new();
+    gtk_widget_set_hexpand(panel->entry, TRUE);
+
+    GtkWidget* folder_label = gtk_label_new("文件夹:");
+    gtk_widget_set_halign(folder_label, GTK_ALIGN_START);
+    panel->folder_button = gtk_file_chooser_button_new("选择文件夹", GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER);
+    gchar* folder = app->filename ? g_path_get_dirname(app->filename) : g_get_current_dir();
+    gtk_file_chooser_set_filename(GTK_FILE_CHOOSER(panel->folder_button), folder);
+    g_free(folder);
+
+    gtk_grid_attach(GTK_GRID(grid), find_label, 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), panel->entry, 1, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), folder_label, 0, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), panel->folder_button, 1, 1, 1, 1);
+    gtk_box_pack_start(GTK_BOX(vbox), grid, FALSE, FALSE, 0);
+
+    // 选项和按钮
+    GtkWidget* hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+    panel->case_check = gtk_check_button_new_with_label("区分大小写");
+    panel->search_button = gtk_button_new_with_label("查找");
+    panel->stop_button = gtk_button_new_with_label("停止");
+    gtk_widget_set_sensitive(panel->stop_button, FALSE);
+    gtk_box_pack_start(GTK_BOX(hbox), panel->case_check, FALSE, FALSE, 0);
+    gtk_box_pack_end(GTK_BOX(hbox), panel->stop_button, FALSE, FALSE, 0);
+    gtk_box_pack_end(GTK_BOX(hbox), panel->search_button, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
+
+    // 结果列表
+    panel->store = gtk_list_store_new(COLUMN_COUNT, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INT, G_TYPE_STRING);
+    GtkWidget* tree_view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(panel->store));
+    GtkCellRenderer* renderer = gtk_cell_renderer_text_new();
+    gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(tree_view), -1, "文件", renderer,
+                                                "text", COLUMN_DISPLAY, NULL);
+    gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(tree_view), -1, "行", renderer,
+                                                "text", COLUMN_LINE, NULL);
+    gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(tree_view), -1, "内容", renderer,
+                                                "text", COLUMN_TEXT, NULL);
+    for (gint i = 0; i < 2; i++)
+        gtk_tree_view_column_set_resizable(gtk_tree_view_get_column(GTK_TREE_VIEW(tree_view), i), TRUE);
+
+    GtkWidget* scrolled = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_container_add(GTK_CONTAINER(scrolled), tree_view);
+    gtk_box_pack_start(GTK_BOX(vbox), scrolled, TRUE, TRUE, 0);
+
+    panel->status_label = gtk_label_new("");
+    gtk_widget_set_halign(panel->status_label, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(vbox), panel->status_label, FALSE, FALSE, 0);
+
+    g_signal_connect(panel->entry, "activate", G_CALLBACK(on_search_clicked), panel);
+    g_signal_connect(panel->search_button, "clicked", G_CALLBACK(on_search_clicked), panel);
+    g_signal_connect(panel->stop_button, "clicked", G_CALLBACK(on_stop_clicked), panel);
+    g_signal_connect(tree_view, "row-activated", G_CALLBACK(on_result_activated), panel);
+
+    return panel;
+}
+
+void on_find_in_files(GtkWidget* widget, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+    FindInFiles* panel = app->ui->find_in_files;
+    if (panel && !panel->window)
+    {
+        // 窗口已随主窗口销毁
+        find_in_files_free(panel);
+        panel = NULL;
+    }
+    if (!panel)
+        panel = app->ui->find_in_files = find_in_files_new(app);
+
+    // 默认查找查找栏中的内容
+    const gchar* find_text = gtk_entry_get_text(GTK_ENTRY(app->ui->find_entry));
+    if (strlen(gtk_entry_get_text(GTK_ENTRY(panel->entry))) == 0 && strlen(find_text) > 0)
+        gtk_entry_set_text(GTK_ENTRY(panel->entry), find_text);
+
+    gtk_widget_show_all(panel->window);
+    gtk_window_present(GTK_WINDOW(panel->window));
+    gtk_widget_grab_focus(panel->entry);
+}
+
+void find_in_files_free(FindInFiles* panel)
+{
+    if (!panel)
+        return;
+
+    discard_search(panel);
+    if (panel->window)
+    {
+        g_signal_handlers_disconnect_by_data(panel->window, panel);
+        gtk_widget_destroy(panel->window);
+    }
+    g_object_unref(panel->store);
+    g_free(panel);
+}
@@ -0,0 +1,17 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef FIND_IN_FILES_H
+#define FIND_IN_FILES_H
+
+#include <gtk/gtk.h>
+
+#define FIND_IN_FILES_MAX_RESULTS 20000     // 结果超过该数量后停止搜索
+
+typedef struct FindInFiles FindInFiles;
+
+extern void on_find_in_files(GtkWidget* widget, gpointer data);   // 显示在文件中查找面板
+extern void find_in_files_free(FindInFiles* panel);                // 取消搜索并释放面板
+
+#endif // FIND_IN_FILES_H
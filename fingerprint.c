@@ -0,0 +1,129 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "fingerprint.h"
+#include <string.h>
+#include <gio/gio.h>
+
+#define HASH_SEED    0x9E3779B97F4A7C15ULL
+#define HASH_PRIME_1 0xBF58476D1CE4E5B9ULL
+#define HASH_PRIME_2 0x94D049BB133111EBULL
+
+static inline uint64_t hash_mix_word(uint64_t state, uint64_t word)
+{
+    word *= HASH_PRIME_1;
+    word ^= word >> 31;
+    state ^= word;
+    return (state << 27 | state >> 37) * HASH_PRIME_2 + HASH_SEED;
+}
+
+void content_hash_init(ContentHash* hash)
+{
+    hash->state = HASH_SEED;
+    hash->total = 0;
+    hash->tail_len = 0;
+}
+
+void content_hash_update(ContentHash* hash, const void* data, size_t len)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    hash->total += len;
+
+    // 先补齐上次剩下的半个字
+    if (hash->tail_len > 0)
+    {
+        size_t need = 8 - hash->tail_len;
+        size_t take = len < need ? len : need;
+        memcpy(hash->tail + hash->tail_len, p, take);
+        hash->tail_len += take;
+        p += take;
+        len -= take;
+        if (hash->tail_len < 8)
+            return;
+
+        uint64_t word;
+        memcpy(&word, hash->tail, 8);
+        hash->state = hash_mix_word(hash->state, word);
+        hash->tail_len = 0;
+    }
+
+    while (len >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        hash->state = hash_mix_word(hash->state, word);
+        p += 8;
+        len -= 8;
+    }
+
+    memcpy(hash->tail, p, len);
+    hash->tail_len = len;
+}
+
+uint64_t content_hash_finish(const ContentHash* hash)
+{
+    uint64_t state = hash->state;
+    if (hash->tail_len > 0)
+    {
+        uint64_t word = 0;
+        memcpy(&word, hash->tail, hash->tail_len);
+        state = hash_mix_word(state, word);
+    }
+
+    // splitmix64 收尾，保证雪崩效果
+    state ^= hash->total;
+    state ^= state >> 30;
+    state *= HASH_PRIME_1;
+    state ^= state >> 27;
+    state *= HASH_PRIME_2;
+    state ^= state >> 31;
+    return state;
+}
+
+uint64_t content_hash_bytes(const void* data, size_t len)
+{
+    ContentHash hash;
+    content_hash_init(&hash);
+    content_hash_update(&hash, data, len);
+    return content_hash_finish(&hash);
+}
+
+bool file_fingerprint_stat(const char* filename, FileFingerprint* fp)
+{
+    GFile* file = g_file_new_for_path(filename);
+    GFileInfo* info = g_file_query_info(file,
+                                        G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                        G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                                        G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+                                        G_FILE_ATTRIBUTE_UNIX_INODE,
+                                        G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    g_object_unref(file);
+
+    if (!info)
+        return false;
+
+    fp->size = (uint64_t)g_file_info_get_size(info);
+    fp->mtime_usec = (int64_t)g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+                     g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+    // Windows 上没有 inode，取值为 0，仅靠大小和时间判断
+    fp->inode = g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_UNIX_INODE);
+    g_object_unref(info);
+    return true;
+}
+
+bool file_fingerprint_compute(const char* filename, const char* content, size_t len, FileFingerprint* fp)
+{
+    fp->valid = false;
+    if (!file_fingerprint_stat(filename, fp))
+        return false;
+
+    fp->hash = content_hash_bytes(content, len);
+    fp->valid = true;
+    return true;
+}
+
+bool file_fingerprint_same_identity(const FileFingerprint* a, const FileFingerprint* b)
+{
+    return a->size == b->size && a->mtime_usec == b->mtime_usec && a->inode == b->inode;
+}
@@ -0,0 +1,45 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 流式内容哈希（按 8 字节字处理，分块输入与一次性输入结果一致）
+typedef struct ContentHash
+{
+    uint64_t state;
+    uint64_t total;         // 已输入的总字节数
+    uint8_t tail[8];        // 未凑满一个字的剩余字节
+    size_t tail_len;
+} ContentHash;
+
+// 文件指纹：身份（大小、修改时间、inode）+ 已加载内容的哈希
+typedef struct FileFingerprint
+{
+    uint64_t size;
+    int64_t mtime_usec;
+    uint64_t inode;
+    uint64_t hash;
+    bool valid;
+} FileFingerprint;
+
+extern void content_hash_init(ContentHash* hash);
+extern void content_hash_update(ContentHash* hash, const void* data, size_t len);
+extern uint64_t content_hash_finish(const ContentHash* hash);
+extern uint64_t content_hash_bytes(const void* data, size_t len); // 一次性计算
+
+// 读取文件的身份信息（不读内容），失败返回 false
+extern bool file_fingerprint_stat(const char* filename, FileFingerprint* fp);
+
+// 用文件身份和给定内容生成完整指纹
+extern bool file_fingerprint_compute(const char* filename, const char* content, size_t len, FileFingerprint* fp);
+
+// 仅比较身份信息，相同说明文件大概率未被修改
+extern bool file_fingerprint_same_identity(const FileFingerprint* a, const FileFingerprint* b);
+
+#endif // FINGERPRINT_H
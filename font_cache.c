@@ -0,0 +1,120 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "font_cache.h"
+#include <pango/pangocairo.h>
+
+#define FONT_FLAG_INSTALLED 1
+#define FONT_FLAG_CJK       2
+
+struct FontCache
+{
+    GHashTable* families;   // 小写的族名 -> FONT_FLAG_*，就绪前为 NULL
+    GCancellable* cancellable;
+};
+
+static gchar* family_key(const gchar* family)
+{
+    return g_utf8_casefold(family, -1);
+}
+
+// 工作线程：使用独立的字体映射枚举所有字体族，并检查是否覆盖汉字
+static void enumerate_thread(GTask* task, gpointer source, gpointer task_data, GCancellable* cancellable)
+{
+    PangoFontMap* font_map = pango_cairo_font_map_new();
+    PangoContext* context = pango_font_map_create_context(font_map);
+    PangoLanguage* language = pango_language_from_string("zh-cn");
+    GHashTable* families = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    PangoFontFamily** list = NULL;
+    gint count = 0;
+    pango_font_map_list_families(font_map, &list, &count);
+
+    for (gint i = 0; i < count && !g_cancellable_is_cancelled(cancellable); i++)
+    {
+        const gchar* name = pango_font_family_get_name(list[i]);
+        gint flags = FONT_FLAG_INSTALLED;
+
+        PangoFontDescription* desc = pango_font_description_new();
+        pango_font_description_set_family(desc, name);
+        PangoFont* font = pango_font_map_load_font(font_map, context, desc);
+        if (font)
+        {
+            PangoCoverage* coverage = pango_font_get_coverage(font, language);
+            if (pango_coverage_get(coverage, 0x4E2D) == PANGO_COVERAGE_EXACT)    // “中”
+                flags |= FONT_FLAG_CJK;
+            pango_coverage_unref(coverage);
+            g_object_unref(font);
+        }
+        pango_font_description_free(desc);
+
+        g_hash_table_insert(families, family_key(name), GINT_TO_POINTER(flags));
+    }
+
+    g_free(list);
+    g_object_unref(context);
+    g_object_unref(font_map);
+    g_task_return_pointer(task, families, (GDestroyNotify)g_hash_table_unref);
+}
+
+static void enumerate_done(GObject* source, GAsyncResult* result, gpointer data)
+{
+    GHashTable* families = g_task_propagate_pointer(G_TASK(result), NULL);
+    if (!families)
+        return;     // 已取消，缓存可能已经释放
+
+    FontCache* cache = (FontCache*)data;
+    cache->families = families;
+}
+
+FontCache* font_cache_new(void)
+{
+    FontCache* cache = g_new0(FontCache, 1);
+    cache->cancellable = g_cancellable_new();
+
+    GTask* task = g_task_new(NULL, cache->cancellable, enumerate_done, cache);
+    g_task_set_return_on_cancel(task, FALSE);
+    g_task_run_in_thread(task, enumerate_thread);
+    g_object_unref(task);
+    return cache;
+}
+
+void font_cache_free(FontCache* cache)
+{
+    if (!cache)
+        return;
+
+    g_cancellable_cancel(cache->cancellable);
+    g_object_unref(cache->cancellable);
+    if (cache->families)
+        g_hash_table_unref(cache->families);
+    g_free(cache);
+}
+
+gboolean font_cache_ready(FontCache* cache)
+{
+    return cache->families != NULL;
+}
+
+static gint lookup(FontCache* cache, const gchar* family)
+{
+    gchar* key = family_key(family);
+    gint flags = GPOINTER_TO_INT(g_hash_table_lookup(cache->families, key));
+    g_free(key);
+    return flags;
+}
+
+gboolean font_cache_has_family(FontCache* cache, const gchar* family)
+{
+    if (!cache->families || !family)
+        return cache->families == NULL;
+    return (lookup(cache, family) & FONT_FLAG_INSTALLED) != 0;
+}
+
+gboolean font_cache_has_cjk(FontCache* cache, const gchar* family)
+{
+    if (!cache->families || !family)
+        return FALSE;
+    return (lookup(cache, family) & FONT_FLAG_CJK) != 0;
+}
@@ -0,0 +1,23 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef FONT_CACHE_H
+#define FONT_CACHE_H
+
+#include <gtk/gtk.h>
+
+// 已安装字体族的缓存。启动时在工作线程中枚举一次，之后的查询都是哈希表查找
+typedef struct FontCache FontCache;
+
+extern FontCache* font_cache_new(void);        // 立即返回，枚举在后台进行
+extern void font_cache_free(FontCache* cache);
+extern gboolean font_cache_ready(FontCache* cache);
+
+// 字体族是否已安装。缓存尚未就绪时返回 TRUE，交给 Pango 自行回退
+extern gboolean font_cache_has_family(FontCache* cache, const gchar* family);
+
+// 字体族是否包含常用汉字。缓存尚未就绪或未安装时返回 FALSE
+extern gboolean font_cache_has_cjk(FontCache* cache, const gchar* family);
+
+#endif // FONT_CACHE_H
@@ -0,0 +1,528 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "hex_view.h"
+#include "text_search.h"
+#include <string.h>
+
+#define HEX_VIEW_MARGIN 8       // 内容与窗口边缘的距离（像素）
+#define HEX_VIEW_WHEEL_ROWS 3   // 鼠标滚轮每格滚动的行数
+
+typedef struct HexSearch HexSearch;
+
+typedef struct HexView
+{
+    GtkWidget* window;
+    GtkWidget* area;
+    GtkAdjustment* adjustment;  // 以行为单位，value 为第一个可见行
+    GtkWidget* offset_entry;
+    GtkWidget* search_entry;
+    GtkWidget* hex_check;
+    GtkWidget* status_label;
+    GMappedFile* file;
+    const guchar* data;
+    gsize size;
+    gint offset_digits;         // 偏移列的十六进制位数
+    PangoFontDescription* font;
+    gdouble char_width;         // 等宽字体的字符宽度（像素）
+    gint row_height;
+    gint64 cursor;              // 选中的第一个字节，-1 表示没有选中
+    gsize selection_length;
+    HexSearch* search;          // 进行中的查找
+} HexView;
+
+// 后台查找任务，持有文件映射的引用，窗口关闭后仍可安全结束
+struct HexSearch
+{
+    HexView* view;              // 窗口关闭后为 NULL
+    GMappedFile* file;
+    GBytes* pattern;
+    gsize from;
+    gsize match;
+    GCancellable* cancellable;
+};
+
+static guint64 row_count(HexView* view)
+{
+    return (view->size + HEX_VIEW_BYTES_PER_ROW - 1) / HEX_VIEW_BYTES_PER_ROW;
+}
+
+// 各列的起始字符位置：偏移、两个空格、每字节 "xx "、一个空格、ASCII
+static gint hex_column(HexView* view, gsize index)
+{
+    return view->offset_digits + 2 + (gint)index * 3;
+}
+
+static gint ascii_column(HexView* view, gsize index)
+{
+    return view->offset_digits + 2 + HEX_VIEW_BYTES_PER_ROW * 3 + 1 + (gint)index;
+}
+
+static void format_row(HexView* view, GString* line, gsize offset, gsize count)
+{
+    g_string_printf(line, "%0*" G_GINT64_MODIFIER "x  ", view->offset_digits, (guint64)offset);
+    for (gsize i = 0; i < HEX_VIEW_BYTES_PER_ROW; i++)
+    {
+        if (i < count)
+            g_string_append_printf(line, "%02x ", view->data[offset + i]);
+        else
+            g_string_append(line, "   ");
+    }
+    g_string_append_c(line, ' ');
+    for (gsize i = 0; i < count; i++)
+    {
+        guchar c = view->data[offset + i];
+        g_string_append_c(line, g_ascii_isprint(c) ? (gchar)c : '.');
+    }
+}
+
+static void measure_font(HexView* view)
+{
+    PangoLayout* layout = gtk_widget_create_pango_layout(view->area, "0");
+    pango_layout_set_font_description(layout, view->font);
+    gint width, height;
+    pango_layout_get_pixel_size(layout, &width, &height);
+    view->char_width = width;
+    view->row_height = MAX(height, 1);
+    g_object_unref(layout);
+}
+
+// 按可见区域的高度更新滚动范围，行数可达上亿，都在 gdouble 的精确范围内
+static void update_adjustment(HexView* view)
+{
+    gint height = gtk_widget_get_allocated_height(view->area) - 2 * HEX_VIEW_MARGIN;
+    gdouble page = MAX(1, height / view->row_height);
+    gdouble rows = (gdouble)row_count(view);
+    gdouble value = MIN(gtk_adjustment_get_value(view->adjustment), MAX(0, rows - page));
+    gtk_adjustment_configure(view->adjustment, value, 0, rows, 1, page, page);
+}
+
+static void draw_selection(HexView* view, cairo_t* cr, gsize offset, gsize count, gdouble y)
+{
+    if (view->cursor < 0)
+        return;
+
+    gsize first = MAX((gsize)view->cursor, offset);
+    gsize last = MIN((gsize)view->cursor + view->selection_length, offset + count);
+    if (first >= last)
+        return;
+
+    cairo_set_source_rgba(cr, 0.2, 0.5, 0.9, 0.35);
+    gsize from = first - offset, to = last - offset;
+    cairo_rectangle(cr, HEX_VIEW_MARGIN + hex_column(view, from) * view->char_width, y,
+                    ((to - from) * 3 - 1) * view->char_width, view->row_height);
+    cairo_rectangle(cr, HEX_VIEW_MARGIN + ascii_column(view, from) * view->char_width, y,
+                    (to - from) * view->char_width, view->row_height);
+    cairo_fill(cr);
+}
+
+// 只格式化和绘制可见的行
+static gboolean on_hex_draw(GtkWidget* widget, cairo_t* cr, gpointer data)
+{
+    HexView* view = (HexView*)data;
+    GtkStyleContext* style = gtk_widget_get_style_context(widget);
+    gint width = gtk_widget_get_allocated_width(widget);
+    gint height = gtk_widget_get_allocated_height(widget);
+    gtk_render_background(style, cr, 0, 0, width, height);
+
+    GdkRGBA color;
+    gtk_style_context_get_color(style, gtk_style_context_get_state(style), &color);
+    PangoLayout* layout = gtk_widget_create_pango_layout(widget, NULL);
+    pango_layout_set_font_description(layout, view->font);
+    GString* line = g_string_sized_new(128);
+
+    guint64 first_row = (guint64)gtk_adjustment_get_value(view->adjustment);
+    gint visible = height / view->row_height + 1;
+    for (gint i = 0; i < visible && first_row + (guint64)i < row_count(view); i++)
+    {
+        gsize offset = (gsize)(first_row + (guint64)i) * HEX_VIEW_BYTES_PER_ROW;
+        gsize count = MIN(HEX_VIEW_BYTES_PER_ROW, view->size - offset);
+        gdouble y = HEX_VIEW_MARGIN + i * view->row_height;
+
+        draw_selection(view, cr, offset, count, y);
+        format_row(view, line, offset, count);
+        pango_layout_set_text(layout, line->str, (gint)line->len);
+        gdk_cairo_set_source_rgba(cr, &color);
+        cairo_move_to(cr, HEX_VIEW_MARGIN, y);
+        pango_cairo_show_layout(cr, layout);
+    }
+
+    g_string_free(line, TRUE);
+    g_object_unref(layout);
+    return FALSE;
+}
+
+static void set_status(HexView* view, const char* message)
+{
+    gtk_label_set_text(GTK_LABEL(view->status_label), message);
+}
+
+static void scroll_to_offset(HexView* view, gsize offset)
+{
+    gdouble row = (gdouble)(offset / HEX_VIEW_BYTES_PER_ROW);
+    gdouble value = gtk_adjustment_get_value(view->adjustment);
+    gdouble page = gtk_adjustment_get_page_size(view->adjustment);
+    if (row < value || row >= value + page)
+        gtk_adjustment_set_value(view->adjustment, MAX(0, row - page / 3));
+}
+
+static void select_bytes(HexView* view, gsize offset, gsize length)
+{
+    view->cursor = (gint64)offset;
+    view->selection_length = length;
+    scroll_to_offset(view, offset);
+
+    gchar* status = g_strdup_printf("偏移: 0x%" G_GINT64_MODIFIER "x (%" G_GINT64_MODIFIER "u)  字节: 0x%02x",
+                                    (guint64)offset, (guint64)offset, view->data[offset]);
+    set_status(view, status);
+    g_free(status);
+    gtk_widget_queue_draw(view->area);
+}
+
+static void on_adjustment_changed(GtkAdjustment* adjustment, gpointer data)
+{
+    HexView* view = (HexView*)data;
+    gtk_widget_queue_draw(view->area);
+}
+
+static void on_hex_size_allocate(GtkWidget* widget, GdkRectangle* allocation, gpointer data)
+{
+    update_adjustment((HexView*)data);
+}
+
+static gboolean on_hex_scroll(GtkWidget* widget, GdkEventScroll* event, gpointer data)
+{
+    HexView* view = (HexView*)data;
+    gdouble delta;
+    gdouble dx, dy;
+
+    switch (event->direction)
+    {
+        case GDK_SCROLL_UP:
+            delta = -HEX_VIEW_WHEEL_ROWS;
+            break;
+        case GDK_SCROLL_DOWN:
+            delta = HEX_VIEW_WHEEL_ROWS;
+            break;
+        case GDK_SCROLL_SMOOTH:
+            gdk_event_get_scroll_deltas((GdkEvent*)event, &dx, &dy);
+            delta = dy * HEX_VIEW_WHEEL_ROWS;
+            break;
+        default:
+            return FALSE;
+    }
+
+    gtk_adjustment_set_value(view->adjustment, gtk_adjustment_get_value(view->adjustment) + delta);
+    return TRUE;
+}
+
+static gboolean on_hex_key_press(GtkWidget* widget, GdkEventKey* event, gpointer data)
+{
+    HexView* view = (HexView*)data;
+    gdouble value = gtk_adjustment_get_value(view->adjustment);
+    gdouble page = gtk_adjustment_get_page_size(view->adjustment);
+
+    switch (event->keyval)
+    {
+        case GDK_KEY_Up:
+            value -= 1;
+            break;
+        case GDK_KEY_Down:
+            value += 1;
+            break;
+        case GDK_KEY_Page_Up:
+            value -= page;
+            break;
+        case GDK_KEY_Page_Down:
+            value += page;
+            break;
+        case GDK_KEY_Home:
+            value = 0;
+            break;
+        case GDK_KEY_End:
+            value = gtk_adjustment_get_upper(view->adjustment);
+            break;
+        default:
+            return FALSE;
+    }
+
+    gtk_adjustment_set_value(view->adjustment, value);
+    return TRUE;
+}
+
+// 点击十六进制或 ASCII 列中的字节将其选中
+static gboolean on_hex_button_press(GtkWidget* widget, GdkEventButton* event, gpointer data)
+{
+    HexView* view = (HexView*)data;
+    gtk_widget_grab_focus(widget);
+    if (event->button != GDK_BUTTON_PRIMARY || event->y < HEX_VIEW_MARGIN)
+        return FALSE;
+
+    gint column = (gint)((event->x - HEX_VIEW_MARGIN) / view->char_width);
+    guint64 row = (guint64)gtk_adjustment_get_value(view->adjustment) +
+                  (guint64)((event->y - HEX_VIEW_MARGIN) / view->row_height);
+
+    gint index = -1;
+    if (column >= hex_column(view, 0) && column < hex_column(view, HEX_VIEW_BYTES_PER_ROW))
+        index = (column - hex_column(view, 0)) / 3;
+    else if (column >= ascii_column(view, 0) && column < ascii_column(view, HEX_VIEW_BYTES_PER_ROW))
+        index = column - ascii_column(view, 0);
+
+    gsize offset = (gsize)row * HEX_VIEW_BYTES_PER_ROW + (gsize)index;
+    if (index >= 0 && offset < view->size)
+        select_bytes(view, offset, 1);
+    return TRUE;
+}
+
+// 偏移默认按十进制解析，0x 开头按十六进制
+static void on_offset_activate(GtkEntry* entry, gpointer data)
+{
+    HexView* view = (HexView*)data;
+    const gchar* text = gtk_entry_get_text(entry);
+    while (g_ascii_isspace(*text))
+        text++;
+
+    gboolean hex = text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+    guint64 offset;
+    if (!g_ascii_string_to_unsigned(hex ? text + 2 : text, hex ? 16 : 10, 0, G_MAXUINT64, &offset, NULL))
+    {
+        set_status(view, "无效的偏移，请输入十进制数或以 0x 开头的十六进制数");
+        return;
+    }
+    if (offset >= view->size)
+    {
+        set_status(view, "偏移超出了文件大小");
+        return;
+    }
+    select_bytes(view, (gsize)offset, 1);
+    gtk_widget_grab_focus(view->area);
+}
+
+// 十六进制模式下解析 "DE AD be ef" 形式的字节，否则按输入的 UTF-8 文本查找
+static GBytes* parse_pattern(HexView* view, const gchar* text)
+{
+    if (!gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(view->hex_check)))
+        return *text ? g_bytes_new(text, strlen(text)) : NULL;
+
+    GByteArray* bytes = g_byte_array_new();
+    const gchar* p = text;
+    while (*p)
+    {
+        if (g_ascii_isspace(*p))
+        {
+            p++;
+            continue;
+        }
+        gint high = g_ascii_xdigit_value(p[0]);
+        gint low = high >= 0 && p[1] ? g_ascii_xdigit_value(p[1]) : -1;
+        if (low < 0)
+        {
+            g_byte_array_unref(bytes);
+            return NULL;
+        }
+        guint8 byte = (guint8)(high * 16 + low);
+        g_byte_array_append(bytes, &byte, 1);
+        p += 2;
+    }
+    if (bytes->len == 0)
+    {
+        g_byte_array_unref(bytes);
+        return NULL;
+    }
+    return g_byte_array_free_to_bytes(bytes);
+}
+
+static void hex_search_free(HexSearch* search)
+{
+    g_mapped_file_unref(search->file);
+    g_bytes_unref(search->pattern);
+    g_object_unref(search->cancellable);
+    g_free(search);
+}
+
+// 在 [start, end) 中按块查找，跨块的匹配由块末尾多看的 length - 1 个字节覆盖
+static gboolean find_bytes(const SearchPattern* pattern, const char* data, gsize start, gsize end,
+                           GCancellable* cancellable, gsize* match)
+{
+    gsize pos = start;
+    while (pos < end && !g_cancellable_is_cancelled(cancellable))
+    {
+        gsize window_end = MIN(pos + HEX_VIEW_SEARCH_BLOCK + pattern->length - 1, end);
+        const char* found = text_search_find(pattern, data + pos, window_end - pos);
+        if (found)
+        {
+            *match = (gsize)(found - data);
+            return TRUE;
+        }
+        if (window_end == end)
+            break;
+        pos = window_end - (pattern->length - 1);
+    }
+    return FALSE;
+}
+
+static void hex_search_thread(GTask* task, gpointer source, gpointer task_data, GCancellable* cancellable)
+{
+    HexSearch* search = (HexSearch*)task_data;
+    const char* data = g_mapped_file_get_contents(search->file);
+    gsize size = g_mapped_file_get_length(search->file);
+    gsize length;
+    const char* needle = g_bytes_get_data(search->pattern, &length);
+
+    SearchPattern pattern;
+    text_search_pattern_init(&pattern, needle, length, TRUE);
+
+    // 从选中位置之后查找到文件末尾，再从开头绕回
+    gboolean found = find_bytes(&pattern, data, search->from, size, cancellable, &search->match) ||
+                     find_bytes(&pattern, data, 0, MIN(search->from + length - 1, size), cancellable, &search->match);
+    if (!g_task_return_error_if_cancelled(task))
+        g_task_return_boolean(task, found);
+}
+
+static void hex_search_done(GObject* source, GAsyncResult* result, gpointer data)
+{
+    HexSearch* search = (HexSearch*)data;
+    HexView* view = search->view;
+    GError* error = NULL;
+    gboolean found = g_task_propagate_boolean(G_TASK(result), &error);
+
+    if (view && view->search == search)
+    {
+        view->search = NULL;
+        if (found)
+            select_bytes(view, search->match, g_bytes_get_size(search->pattern));
+        else if (!error)
+            set_status(view, "找不到匹配的字节");
+    }
+    if (error)
+        g_error_free(error);
+    hex_search_free(search);
+}
+
+static void on_search_activate(GtkEntry* entry, gpointer data)
+{
+    HexView* view = (HexView*)data;
+    GBytes* pattern = parse_pattern(view, gtk_entry_get_text(entry));
+    if (!pattern)
+    {
+        set_status(view, "请输入要查找的内容（十六进制模式下每个字节两位数字）");
+        return;
+    }
+
+    // 新的查找取消之前的
+    if (view->search)
+    {
+        g_cancellable_cancel(view->search->cancellable);
+        view->search->view = NULL;
+    }
+
+    HexSearch* search = g_new0(HexSearch, 1);
+    search->view = view;
+    search->file = g_mapped_file_ref(view->file);
+    search->pattern = pattern;
+    search->from = view->cursor >= 0 ? (gsize)view->cursor + 1 : 0;
+    search->cancellable = g_cancellable_new();
+    view->search = search;
+    set_status(view, "正在查找…");
+
+    GTask* task = g_task_new(NULL, search->cancellable, hex_search_done, search);
+    g_task_set_task_data(task, search, NULL);
+    g_task_run_in_thread(task, hex_search_thread);
+    g_object_unref(task);
+}
+
+static void on_hex_view_destroy(GtkWidget* widget, gpointer data)
+{
+    HexView* view = (HexView*)data;
+    if (view->search)
+    {
+        g_cancellable_cancel(view->search->cancellable);
+        view->search->view = NULL;
+    }
+    if (view->file)
+        g_mapped_file_unref(view->file);
+    pango_font_description_free(view->font);
+    g_free(view);
+}
+
+gboolean hex_view_open(GtkWindow* parent, const char* filename, GError** error)
+{
+    // 只建立映射，页面在绘制和查找时才由系统按需读入
+    GMappedFile* file = g_mapped_file_new(filename, FALSE, error);
+    if (!file)
+        return FALSE;
+
+    HexView* view = g_new0(HexView, 1);
+    view->file = file;
+    view->data = (const guchar*)g_mapped_file_get_contents(file);
+    view->size = g_mapped_file_get_length(file);
+    view->offset_digits = view->size > G_MAXUINT32 ? 16 : 8;
+    view->cursor = -1;
+    view->font = pango_font_description_from_string("Monospace 10");
+
+    gchar* basename = g_path_get_basename(filename);
+    gchar* title = g_strdup_printf("十六进制查看 - %s", basename);
+    view->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(view->window), title);
+    gtk_window_set_transient_for(GTK_WINDOW(view->window), parent);
+    gtk_window_set_default_size(GTK_WINDOW(view->window), 820, 600);
+    g_free(title);
+    g_free(basename);
+
+    GtkWidget* vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    gtk_container_add(GTK_CONTAINER(view->window), vbox);
+
+    // 工具栏：跳转到偏移和字节查找
+    GtkWidget* toolbar = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+    gtk_container_set_border_width(GTK_CONTAINER(toolbar), 5);
+    view->offset_entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(view->offset_entry), "偏移，例如 4096 或 0x1000");
+    view->search_entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(view->search_entry), "查找字节");
+    view->hex_check = gtk_check_button_new_with_label("十六进制");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(view->hex_check), TRUE);
+    gtk_box_pack_start(GTK_BOX(toolbar), gtk_label_new("跳转到:"), FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), view->offset_entry, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), gtk_label_new("查找:"), FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), view->search_entry, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), view->hex_check, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(vbox), toolbar, FALSE, FALSE, 0);
+
+    // 内容区域和按行滚动的滚动条
+    GtkWidget* hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+    view->adjustment = gtk_adjustment_new(0, 0, 1, 1, 1, 1);
+    view->area = gtk_drawing_area_new();
+    gtk_widget_set_can_focus(view->area, TRUE);
+    gtk_widget_add_events(view->area, GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK | GDK_BUTTON_PRESS_MASK |
+                                      GDK_KEY_PRESS_MASK);
+    GtkWidget* scrollbar = gtk_scrollbar_new(GTK_ORIENTATION_VERTICAL, view->adjustment);
+    gtk_box_pack_start(GTK_BOX(hbox), view->area, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(hbox), scrollbar, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(vbox), hbox, TRUE, TRUE, 0);
+
+    gchar* size_text = g_format_size_full(view->size, G_FORMAT_SIZE_LONG_FORMAT);
+    view->status_label = gtk_label_new(size_text);
+    g_free(size_text);
+    gtk_widget_set_halign(view->status_label, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(view->status_label, 10);
+    gtk_widget_set_margin_top(view->status_label, 3);
+    gtk_widget_set_margin_bottom(view->status_label, 3);
+    gtk_box_pack_start(GTK_BOX(vbox), view->status_label, FALSE, FALSE, 0);
+
+    measure_font(view);
+
+    g_signal_connect(view->area, "draw", G_CALLBACK(on_hex_draw), view);
+    g_signal_connect(view->area, "size-allocate", G_CALLBACK(on_hex_size_allocate), view);
+    g_signal_connect(view->area, "scroll-event", G_CALLBACK(on_hex_scroll), view);
+    g_signal_connect(view->area, "key-press-event", G_CALLBACK(on_hex_key_press), view);
+    g_signal_connect(view->area, "button-press-event", G_CALLBACK(on_hex_button_press), view);
+    g_signal_connect(view->adjustment, "value-changed", G_CALLBACK(on_adjustment_changed), view);
+    g_signal_connect(view->offset_entry, "activate", G_CALLBACK(on_offset_activate), view);
+    g_signal_connect(view->search_entry, "activate", G_CALLBACK(on_search_activate), view);
+    g_signal_connect(view->window, "destroy", G_CALLBACK(on_hex_view_destroy), view);
+
+    gtk_widget_show_all(view->window);
+    gtk_widget_grab_focus(view->area);
+    return TRUE;
+}
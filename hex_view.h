@@ -0,0 +1,17 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef HEX_VIEW_H
+#define HEX_VIEW_H
+
+#include <gtk/gtk.h>
+
+#define HEX_VIEW_BYTES_PER_ROW  16
+#define HEX_VIEW_SEARCH_BLOCK   (4 * 1024 * 1024)   // 字节查找每次扫描的大小，块之间检查取消
+
+// 十六进制查看器：通过 mmap 访问文件，只绘制可见的行，内存占用与文件大小无关。
+// 在独立的窗口中只读显示，支持跳转到偏移和按字节查找，关闭窗口时释放
+extern gboolean hex_view_open(GtkWindow* parent, const char* filename, GError** error);
+
+#endif // HEX_VIEW_H
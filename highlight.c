@@ -0,0 +1,671 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "highlight.h"
+#include <string.h>
+
+// 每行在缓存中占一个字节：低 6 位为行首状态，高 2 位为标志
+#define STATE_MASK      0x3F
+#define STATE_UNKNOWN   0x3F
+#define LINE_DIRTY      0x80    // 行内容或行首状态已变化，需要重新分析
+#define LINE_PAINTED    0x40    // 该行的标签已是最新
+
+#define HIGHLIGHT_SLICE_USEC        4000    // 每个空闲回调最多占用的时间
+#define HIGHLIGHT_MARGIN_LINES      50      // 可见区域上下额外着色的行数
+#define HIGHLIGHT_MAX_LINE_BYTES    16384   // 超长行不着色，状态原样传递
+
+enum { JSON_NORMAL, JSON_BLOCK_COMMENT };
+enum { SHELL_NORMAL, SHELL_DOUBLE_QUOTE, SHELL_SINGLE_QUOTE };
+
+struct Highlighter
+{
+    GtkTextView* view;
+    GtkTextBuffer* buffer;
+    GtkAdjustment* vadjustment;
+    HighlightLanguage language;
+    GtkTextTag* tags[TOKEN_COUNT];
+    GArray* lines;          // 每行的状态字节
+    gint first_dirty;       // 该行之前没有需要重新分析的行
+    gint edit_line;         // 编辑前记录的起始行
+    gint edit_line_count;   // 编辑前的总行数
+    guint idle_id;
+    gulong handlers[5];
+};
+
+static const char* const json_keywords[] = { "true", "false", "null", NULL };
+static const char* const shell_keywords[] = {
+    "if", "then", "else", "elif", "fi", "for", "while", "until", "do", "done", "case", "esac",
+    "in", "function", "return", "local", "export", "readonly", "select", "break", "continue", NULL
+};
+static const char* const conf_keywords[] = { "true", "false", "yes", "no", "on", "off", NULL };
+
+static inline void emit(HighlightTokenFunc func, gpointer user_data, HighlightToken token, gsize start, gsize end)
+{
+    if (func && end > start)
+        func(token, start, end, user_data);
+}
+
+static gboolean is_keyword(const char* word, gsize length, const char* const* keywords)
+{
+    for (; *keywords; keywords++)
+    {
+        if (strlen(*keywords) == length && memcmp(*keywords, word, length) == 0)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static inline gboolean is_word_char(char c)
+{
+    return g_ascii_isalnum(c) || c == '_';
+}
+
+// 查找块注释结尾，返回 "*/" 之后的位置，没有则返回 0
+static gsize find_comment_end(const char* text, gsize length, gsize from)
+{
+    for (gsize i = from; i + 1 < length; i++)
+    {
+        if (text[i] == '*' && text[i + 1] == '/')
+            return i + 2;
+    }
+    return 0;
+}
+
+// 跳过引号字符串的剩余部分，返回是否在本行闭合。*pos 指向开引号之后
+static gboolean skip_string(const char* text, gsize length, gsize* pos, char quote, gboolean escapes)
+{
+    gsize i = *pos;
+    while (i < length)
+    {
+        if (escapes && text[i] == '\\' && i + 1 < length)
+        {
+            i += 2;
+            continue;
+        }
+        if (text[i++] == quote)
+        {
+            *pos = i;
+            return TRUE;
+        }
+    }
+    *pos = length;
+    return FALSE;
+}
+
+static gsize skip_number(const char* text, gsize length, gsize i)
+{
+    while (i < length && (g_ascii_isalnum(text[i]) || text[i] == '.' ||
+                          ((text[i] == '+' || text[i] == '-') && (text[i - 1] == 'e' || text[i - 1] == 'E'))))
+        i++;
+    return i;
+}
+
+static guint8 lex_json(guint8 state, const char* text, gsize length, HighlightTokenFunc func, gpointer user_data)
+{
+    gsize i = 0;
+    if (state == JSON_BLOCK_COMMENT)
+    {
+        gsize close = find_comment_end(text, length, 0);
+        emit(func, user_data, TOKEN_COMMENT, 0, close ? close : length);
+        if (!close)
+            return JSON_BLOCK_COMMENT;
+        i = close;
+    }
+
+    while (i < length)
+    {
+        char c = text[i];
+        if (c == '"')
+        {
+            gsize start = i++;
+            skip_string(text, length, &i, '"', TRUE);
+
+            // 后面紧跟冒号的字符串是键
+            gsize j = i;
+            while (j < length && (text[j] == ' ' || text[j] == '\t'))
+                j++;
+            emit(func, user_data, j < length && text[j] == ':' ? TOKEN_KEY : TOKEN_STRING, start, i);
+        }
+        else if (c == '/' && i + 1 < length && text[i + 1] == '/')
+        {
+            emit(func, user_data, TOKEN_COMMENT, i, length);
+            break;
+        }
+        else if (c == '/' && i + 1 < length && text[i + 1] == '*')
+        {
+            gsize close = find_comment_end(text, length, i + 2);
+            emit(func, user_data, TOKEN_COMMENT, i, close ? close : length);
+            if (!close)
+                return JSON_BLOCK_COMMENT;
+            i = close;
+        }
+        else if (g_ascii_isdigit(c) || (c == '-' && i + 1 < length && g_ascii_isdigit(text[i + 1])))
+        {
+            gsize start = i;
+            i = skip_number(text, length, i + 1);
+            emit(func, user_data, TOKEN_NUMBER, start, i);
+        }
+        else if (g_ascii_isalpha(c))
+        {
+            gsize start = i;
+            while (i < length && is_word_char(text[i]))
+                i++;
+            if (is_keyword(text + start, i - start, json_keywords))
+                emit(func, user_data, TOKEN_KEYWORD, start, i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    return JSON_NORMAL;
+}
+
+static guint8 lex_shell(guint8 state, const char* text, gsize length, HighlightTokenFunc func, gpointer user_data)
+{
+    gsize i = 0;
+    if (state == SHELL_DOUBLE_QUOTE || state == SHELL_SINGLE_QUOTE)
+    {
+        gboolean closed = skip_string(text, length, &i, state == SHELL_DOUBLE_QUOTE ? '"' : '\'',
+                                      state == SHELL_DOUBLE_QUOTE);
+        emit(func, user_data, TOKEN_STRING, 0, i);
+        if (!closed)
+            return state;
+    }
+
+    while (i < length)
+    {
+        char c = text[i];
+        gboolean word_start = i == 0 || g_ascii_isspace(text[i - 1]) || text[i - 1] == ';';
+
+        if (c == '#' && word_start)
+        {
+            emit(func, user_data, TOKEN_COMMENT, i, length);
+            break;
+        }
+        else if (c == '"' || c == '\'')
+        {
+            gsize start = i++;
+            gboolean closed = skip_string(text, length, &i, c, c == '"');
+            emit(func, user_data, TOKEN_STRING, start, i);
+            if (!closed)
+                return c == '"' ? SHELL_DOUBLE_QUOTE : SHELL_SINGLE_QUOTE;
+        }
+        else if (c == '\\')
+        {
+            i += 2;
+        }
+        else if (c == '$' && i + 1 < length)
+        {
+            gsize start = i++;
+            if (text[i] == '{')
+            {
+                while (i < length && text[i] != '}')
+                    i++;
+                i = MIN(i + 1, length);
+            }
+            else if (is_word_char(text[i]))
+            {
+                while (i < length && is_word_char(text[i]))
+                    i++;
+            }
+            else if (text[i] && strchr("?#@*!$-", text[i]))
+            {
+                i++;
+            }
+            emit(func, user_data, TOKEN_VARIABLE, start, i);
+        }
+        else if ((g_ascii_isalpha(c) || c == '_') && word_start)
+        {
+            gsize start = i;
+            while (i < length && is_word_char(text[i]))
+                i++;
+            if (i < length && text[i] == '=')
+                emit(func, user_data, TOKEN_KEY, start, i);     // 变量赋值
+            else if (is_keyword(text + start, i - start, shell_keywords))
+                emit(func, user_data, TOKEN_KEYWORD, start, i);
+        }
+        else if (g_ascii_isdigit(c) && word_start)
+        {
+            gsize start = i;
+            while (i < length && g_ascii_isdigit(text[i]))
+                i++;
+            if (i == length || !is_word_char(text[i]))
+                emit(func, user_data, TOKEN_NUMBER, start, i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    return SHELL_NORMAL;
+}
+
+// 配置文件（ini / conf / properties 一类）没有跨行结构
+static guint8 lex_conf(const char* text, gsize length, HighlightTokenFunc func, gpointer user_data)
+{
+    gsize i = 0;
+    while (i < length && g_ascii_isspace(text[i]))
+        i++;
+    if (i == length)
+        return 0;
+
+    if (text[i] == '#' || text[i] == ';')
+    {
+        emit(func, user_data, TOKEN_COMMENT, i, length);
+        return 0;
+    }
+    if (text[i] == '[')
+    {
+        const char* close = memchr(text + i, ']', length - i);
+        emit(func, user_data, TOKEN_SECTION, i, close ? (gsize)(close - text) + 1 : length);
+        return 0;
+    }
+
+    // 键：到第一个 = 或 : 为止
+    gsize key_start = i;
+    while (i < length && text[i] != '=' && text[i] != ':')
+        i++;
+    if (i == length)
+        return 0;
+    gsize key_end = i;
+    while (key_end > key_start && g_ascii_isspace(text[key_end - 1]))
+        key_end--;
+    emit(func, user_data, TOKEN_KEY, key_start, key_end);
+
+    // 值
+    i++;
+    while (i < length)
+    {
+        char c = text[i];
+        gboolean word_start = g_ascii_isspace(text[i - 1]) || text[i - 1] == '=' || text[i - 1] == ':' ||
+                              text[i - 1] == ',' || text[i - 1] == '[';
+
+        if ((c == '#' || c == ';') && g_ascii_isspace(text[i - 1]))
+        {
+            emit(func, user_data, TOKEN_COMMENT, i, length);
+            break;
+        }
+        else if (c == '"' || c == '\'')
+        {
+            gsize start = i++;
+            skip_string(text, length, &i, c, c == '"');
+            emit(func, user_data, TOKEN_STRING, start, i);
+        }
+        else if (word_start && (g_ascii_isdigit(c) || (c == '-' && i + 1 < length && g_ascii_isdigit(text[i + 1]))))
+        {
+            gsize start = i;
+            i = skip_number(text, length, i + 1);
+            emit(func, user_data, TOKEN_NUMBER, start, i);
+        }
+        else if (word_start && g_ascii_isalpha(c))
+        {
+            gsize start = i;
+            while (i < length && is_word_char(text[i]))
+                i++;
+            if (is_keyword(text + start, i - start, conf_keywords))
+                emit(func, user_data, TOKEN_KEYWORD, start, i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    return 0;
+}
+
+guint8 highlight_lex_line(HighlightLanguage language, guint8 state, const char* text, gsize length,
+                          HighlightTokenFunc func, gpointer user_data)
+{
+    switch (language)
+    {
+    case HIGHLIGHT_JSON:
+        return lex_json(state, text, length, func, user_data);
+    case HIGHLIGHT_SHELL:
+        return lex_shell(state, text, length, func, user_data);
+    case HIGHLIGHT_CONF:
+        return lex_conf(text, length, func, user_data);
+    default:
+        return 0;
+    }
+}
+
+HighlightLanguage highlight_language_for_file(const char* filename)
+{
+    if (!filename)
+        return HIGHLIGHT_NONE;
+
+    gchar* base = g_path_get_basename(filename);
+    gchar* lower = g_ascii_strdown(base, -1);
+    const char* dot = strrchr(lower, '.');
+    const char* ext = dot ? dot + 1 : "";
+    HighlightLanguage language = HIGHLIGHT_NONE;
+
+    if (g_strcmp0(ext, "json") == 0 || g_strcmp0(ext, "jsonc") == 0 || g_strcmp0(ext, "geojson") == 0)
+        language = HIGHLIGHT_JSON;
+    else if (g_strcmp0(ext, "sh") == 0 || g_strcmp0(ext, "bash") == 0 || g_strcmp0(ext, "zsh") == 0 ||
+             g_strcmp0(ext, "ksh") == 0 || g_strcmp0(lower, ".bashrc") == 0 ||
+             g_strcmp0(lower, ".profile") == 0 || g_strcmp0(lower, ".zshrc") == 0)
+        language = HIGHLIGHT_SHELL;
+    else if (g_strcmp0(ext, "conf") == 0 || g_strcmp0(ext, "cfg") == 0 || g_strcmp0(ext, "ini") == 0 ||
+             g_strcmp0(ext, "cnf") == 0 || g_strcmp0(ext, "properties") == 0 || g_strcmp0(ext, "toml") == 0 ||
+             g_strcmp0(ext, "env") == 0 || g_strcmp0(lower, ".gitconfig") == 0 ||
+             g_strcmp0(lower, ".editorconfig") == 0)
+        language = HIGHLIGHT_CONF;
+
+    g_free(lower);
+    g_free(base);
+    return language;
+}
+
+// 着色时的上下文
+typedef struct PaintContext
+{
+    Highlighter* highlighter;
+    gint line;
+} PaintContext;
+
+static void paint_token(HighlightToken token, gsize start, gsize end, gpointer user_data)
+{
+    PaintContext* context = (PaintContext*)user_data;
+    GtkTextIter token_start, token_end;
+    gtk_text_buffer_get_iter_at_line_index(context->highlighter->buffer, &token_start, context->line, (gint)start);
+    gtk_text_buffer_get_iter_at_line_index(context->highlighter->buffer, &token_end, context->line, (gint)end);
+    gtk_text_buffer_apply_tag(context->highlighter->buffer, context->highlighter->tags[token], &token_start, &token_end);
+}
+
+// 分析缓冲区中的一行，paint 为真时同时重新着色
+static guint8 lex_buffer_line(Highlighter* highlighter, gint line, guint8 state, gboolean paint)
+{
+    GtkTextIter start, end;
+    gtk_text_buffer_get_iter_at_line(highlighter->buffer, &start, line);
+    end = start;
+    if (!gtk_text_iter_ends_line(&end))
+        gtk_text_iter_forward_to_line_end(&end);
+
+    if (paint)
+    {
+        for (gint i = 0; i < TOKEN_COUNT; i++)
+            gtk_text_buffer_remove_tag(highlighter->buffer, highlighter->tags[i], &start, &end);
+    }
+
+    gint length = gtk_text_iter_get_line_index(&end);
+    if (length == 0 || length > HIGHLIGHT_MAX_LINE_BYTES)
+        return state;
+
+    gchar* text = gtk_text_iter_get_slice(&start, &end);
+    PaintContext context = { highlighter, line };
+    guint8 result = highlight_lex_line(highlighter->language, state, text, (gsize)length,
+                                       paint ? paint_token : NULL, &context);
+    g_free(text);
+    return result;
+}
+
+// 从第一个脏行开始重新分析，直到状态收敛或到达 target 行
+static gboolean lex_until(Highlighter* highlighter, gint target, gint64 deadline)
+{
+    guint8* lines = (guint8*)highlighter->lines->data;
+    gint count = (gint)highlighter->lines->len;
+    gint i = highlighter->first_dirty;
+    guint processed = 0;
+
+    while (i < target && i < count)
+    {
+        if (!(lines[i] & LINE_DIRTY))
+        {
+            i++;
+            continue;
+        }
+
+        guint8 end_state = lex_buffer_line(highlighter, i, lines[i] & STATE_MASK, FALSE);
+        lines[i] &= STATE_MASK;
+        if (i + 1 < count && (lines[i + 1] & STATE_MASK) != end_state)
+            lines[i + 1] = end_state | LINE_DIRTY;
+        i++;
+
+        if ((++processed & 63) == 0 && g_get_monotonic_time() >= deadline)
+            break;
+    }
+
+    highlighter->first_dirty = i;
+    return i >= MIN(target, count);
+}
+
+static void visible_lines(Highlighter* highlighter, gint* first, gint* last)
+{
+    GdkRectangle rect;
+    GtkTextIter iter;
+    gtk_text_view_get_visible_rect(highlighter->view, &rect);
+    gtk_text_view_get_line_at_y(highlighter->view, &iter, rect.y, NULL);
+    *first = gtk_text_iter_get_line(&iter);
+    gtk_text_view_get_line_at_y(highlighter->view, &iter, rect.y + rect.height, NULL);
+    *last = gtk_text_iter_get_line(&iter);
+}
+
+static void reset_lines(Highlighter* highlighter)
+{
+    guint count = (guint)gtk_text_buffer_get_line_count(highlighter->buffer);
+    g_array_set_size(highlighter->lines, count);
+    memset(highlighter->lines->data, LINE_DIRTY | STATE_UNKNOWN, count);
+    ((guint8*)highlighter->lines->data)[0] = LINE_DIRTY;  // 第一行从初始状态开始
+    highlighter->first_dirty = 0;
+}
+
+static gboolean highlight_idle(gpointer data)
+{
+    Highlighter* highlighter = (Highlighter*)data;
+    gint64 deadline = g_get_monotonic_time() + HIGHLIGHT_SLICE_USEC;
+
+    // 行数对不上说明错过了某次编辑，整体重来
+    if ((gint)highlighter->lines->len != gtk_text_buffer_get_line_count(highlighter->buffer))
+        reset_lines(highlighter);
+
+    gint first, last;
+    visible_lines(highlighter, &first, &last);
+    first = MAX(0, first - HIGHLIGHT_MARGIN_LINES);
+    last = MIN((gint)highlighter->lines->len - 1, last + HIGHLIGHT_MARGIN_LINES);
+
+    // 只分析到可见区域末尾，后面的行等滚动到时再分析
+    gboolean lexed = lex_until(highlighter, last + 1, deadline);
+
+    guint8* lines = (guint8*)highlighter->lines->data;
+    gboolean painted = TRUE;
+    for (gint i = first; i <= last; i++)
+    {
+        if (i >= highlighter->first_dirty)
+        {
+            painted = FALSE;
+            break;
+        }
+        if (lines[i] & LINE_PAINTED)
+            continue;
+        if (g_get_monotonic_time() >= deadline)
+        {
+            painted = FALSE;
+            break;
+        }
+        lex_buffer_line(highlighter, i, lines[i] & STATE_MASK, TRUE);
+        lines[i] |= LINE_PAINTED;
+    }
+
+    if (lexed && painted)
+    {
+        highlighter->idle_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void schedule(Highlighter* highlighter)
+{
+    if (highlighter->language != HIGHLIGHT_NONE && !highlighter->idle_id)
+        highlighter->idle_id = g_idle_add(highlight_idle, highlighter);
+}
+
+// line 行被修改，其后新增（或减少）了 delta 行
+static void lines_changed(Highlighter* highlighter, gint line, gint delta)
+{
+    GArray* lines = highlighter->lines;
+    if (line < 0 || line >= (gint)lines->len || (delta < 0 && line + 1 - delta > (gint)lines->len))
+    {
+        reset_lines(highlighter);
+        schedule(highlighter);
+        return;
+    }
+
+    if (delta > 0)
+    {
+        guint old_length = lines->len;
+        g_array_set_size(lines, old_length + (guint)delta);
+        guint8* data = (guint8*)lines->data;
+        memmove(data + line + 1 + delta, data + line + 1, old_length - (guint)line - 1);
+        memset(data + line + 1, LINE_DIRTY | STATE_UNKNOWN, (gsize)delta);
+    }
+    else if (delta < 0)
+    {
+        g_array_remove_range(lines, (guint)line + 1, (guint)-delta);
+    }
+
+    guint8* data = (guint8*)lines->data;
+    data[line] = (data[line] & STATE_MASK) | LINE_DIRTY;
+    highlighter->first_dirty = MIN(highlighter->first_dirty, line);
+    schedule(highlighter);
+}
+
+static void on_insert_before(GtkTextBuffer* buffer, GtkTextIter* location, gchar* text, gint len, gpointer data)
+{
+    Highlighter* highlighter = (Highlighter*)data;
+    highlighter->edit_line = gtk_text_iter_get_line(location);
+    highlighter->edit_line_count = gtk_text_buffer_get_line_count(buffer);
+}
+
+static void on_insert_after(GtkTextBuffer* buffer, GtkTextIter* location, gchar* text, gint len, gpointer data)
+{
+    Highlighter* highlighter = (Highlighter*)data;
+    if (highlighter->language == HIGHLIGHT_NONE)
+        return;
+    lines_changed(highlighter, highlighter->edit_line,
+                  gtk_text_buffer_get_line_count(buffer) - highlighter->edit_line_count);
+}
+
+static void on_delete_before(GtkTextBuffer* buffer, GtkTextIter* start, GtkTextIter* end, gpointer data)
+{
+    Highlighter* highlighter = (Highlighter*)data;
+    highlighter->edit_line = MIN(gtk_text_iter_get_line(start), gtk_text_iter_get_line(end));
+    highlighter->edit_line_count = gtk_text_buffer_get_line_count(buffer);
+}
+
+static void on_delete_after(GtkTextBuffer* buffer, GtkTextIter* start, GtkTextIter* end, gpointer data)
+{
+    Highlighter* highlighter = (Highlighter*)data;
+    if (highlighter->language == HIGHLIGHT_NONE)
+        return;
+    lines_changed(highlighter, highlighter->edit_line,
+                  gtk_text_buffer_get_line_count(buffer) - highlighter->edit_line_count);
+}
+
+static void on_scrolled(GtkAdjustment* adjustment, gpointer data)
+{
+    schedule((Highlighter*)data);
+}
+
+Highlighter* highlighter_new(GtkTextView* view)
+{
+    Highlighter* highlighter = g_new0(Highlighter, 1);
+    highlighter->view = view;
+    highlighter->buffer = g_object_ref(gtk_text_view_get_buffer(view));   // 窗口销毁后仍需断开信号
+    highlighter->language = HIGHLIGHT_NONE;
+    highlighter->lines = g_array_new(FALSE, FALSE, sizeof(guint8));
+
+    highlighter->tags[TOKEN_KEYWORD] = gtk_text_buffer_create_tag(highlighter->buffer, "hl-keyword",
+                                                                  "foreground", "#0000aa",
+                                                                  "weight", PANGO_WEIGHT_BOLD, NULL);
+    highlighter->tags[TOKEN_STRING] = gtk_text_buffer_create_tag(highlighter->buffer, "hl-string",
+                                                                 "foreground", "#a31515", NULL);
+    highlighter->tags[TOKEN_NUMBER] = gtk_text_buffer_create_tag(highlighter->buffer, "hl-number",
+                                                                 "foreground", "#098658", NULL);
+    highlighter->tags[TOKEN_COMMENT] = gtk_text_buffer_create_tag(highlighter->buffer, "hl-comment",
+                                                                  "foreground", "#808080",
+                                                                  "style", PANGO_STYLE_ITALIC, NULL);
+    highlighter->tags[TOKEN_KEY] = gtk_text_buffer_create_tag(highlighter->buffer, "hl-key",
+                                                              "foreground", "#7a3e9d", NULL);
+    highlighter->tags[TOKEN_VARIABLE] = gtk_text_buffer_create_tag(highlighter->buffer, "hl-variable",
+                                                                   "foreground", "#007a7a", NULL);
+    highlighter->tags[TOKEN_SECTION] = gtk_text_buffer_create_tag(highlighter->buffer, "hl-section",
+                                                                  "foreground", "#0451a5",
+                                                                  "weight", PANGO_WEIGHT_BOLD, NULL);
+
+    highlighter->handlers[0] = g_signal_connect(highlighter->buffer, "insert-text",
+                                                G_CALLBACK(on_insert_before), highlighter);
+    highlighter->handlers[1] = g_signal_connect_after(highlighter->buffer, "insert-text",
+                                                      G_CALLBACK(on_insert_after), highlighter);
+    highlighter->handlers[2] = g_signal_connect(highlighter->buffer, "delete-range",
+                                                G_CALLBACK(on_delete_before), highlighter);
+    highlighter->handlers[3] = g_signal_connect_after(highlighter->buffer, "delete-range",
+                                                      G_CALLBACK(on_delete_after), highlighter);
+
+    // 文本视图需要已放入滚动窗口
+    highlighter->vadjustment = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(view));
+    if (highlighter->vadjustment)
+    {
+        g_object_ref(highlighter->vadjustment);
+        highlighter->handlers[4] = g_signal_connect(highlighter->vadjustment, "value-changed",
+                                                    G_CALLBACK(on_scrolled), highlighter);
+    }
+
+    return highlighter;
+}
+
+void highlighter_free(Highlighter* highlighter)
+{
+    if (!highlighter)
+        return;
+
+    if (highlighter->idle_id)
+        g_source_remove(highlighter->idle_id);
+    for (gint i = 0; i < 4; i++)
+        g_signal_handler_disconnect(highlighter->buffer, highlighter->handlers[i]);
+    if (highlighter->vadjustment)
+    {
+        g_signal_handler_disconnect(highlighter->vadjustment, highlighter->handlers[4]);
+        g_object_unref(highlighter->vadjustment);
+    }
+    g_object_unref(highlighter->buffer);
+    g_array_free(highlighter->lines, TRUE);
+    g_free(highlighter);
+}
+
+void highlighter_set_language(Highlighter* highlighter, HighlightLanguage language)
+{
+    if (highlighter->language == language)
+        return;
+
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds(highlighter->buffer, &start, &end);
+    for (gint i = 0; i < TOKEN_COUNT; i++)
+        gtk_text_buffer_remove_tag(highlighter->buffer, highlighter->tags[i], &start, &end);
+
+    highlighter->language = language;
+    if (language == HIGHLIGHT_NONE)
+    {
+        if (highlighter->idle_id)
+        {
+            g_source_remove(highlighter->idle_id);
+            highlighter->idle_id = 0;
+        }
+        g_array_set_size(highlighter->lines, 0);
+        return;
+    }
+
+    reset_lines(highlighter);
+    schedule(highlighter);
+}
+
+HighlightLanguage highlighter_get_language(Highlighter* highlighter)
+{
+    return highlighter->language;
+}
@@ -0,0 +1,48 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef HIGHLIGHT_H
+#define HIGHLIGHT_H
+
+#include <gtk/gtk.h>
+
+// 支持高亮的语言
+typedef enum
+{
+    HIGHLIGHT_NONE,
+    HIGHLIGHT_JSON,
+    HIGHLIGHT_SHELL,
+    HIGHLIGHT_CONF
+} HighlightLanguage;
+
+// 词法单元类型
+typedef enum
+{
+    TOKEN_KEYWORD,
+    TOKEN_STRING,
+    TOKEN_NUMBER,
+    TOKEN_COMMENT,
+    TOKEN_KEY,          // JSON 的键、配置文件的键
+    TOKEN_VARIABLE,     // shell 变量
+    TOKEN_SECTION,      // 配置文件的 [节]
+    TOKEN_COUNT
+} HighlightToken;
+
+typedef void (*HighlightTokenFunc)(HighlightToken token, gsize start, gsize end, gpointer user_data);
+
+typedef struct Highlighter Highlighter;
+
+// 根据文件扩展名选择语言
+extern HighlightLanguage highlight_language_for_file(const char* filename);
+
+// 以 state 为行首状态对一行文本做词法分析，返回行尾状态。func 可以为 NULL
+extern guint8 highlight_lex_line(HighlightLanguage language, guint8 state, const char* text, gsize length,
+                                 HighlightTokenFunc func, gpointer user_data);
+
+extern Highlighter* highlighter_new(GtkTextView* view);
+extern void highlighter_free(Highlighter* highlighter);
+extern void highlighter_set_language(Highlighter* highlighter, HighlightLanguage language);
+extern HighlightLanguage highlighter_get_language(Highlighter* highlighter);
+
+#endif // HIGHLIGHT_H
@@ -0,0 +1,386 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "incremental_search.h"
+#include "notepad.h"
+#include "text_search.h"
+#include "perf_hud.h"
+#include <string.h>
+
+struct IncrementalSearch
+{
+    NotepadApp* app;
+    GtkTextTag* tag;            // 可见区域内匹配的高亮
+    guint scan_id;              // 等待开始的全文扫描
+    guint highlight_id;         // 滚动后重新高亮的空闲回调
+    GCancellable* cancellable;  // 进行中的全文扫描
+    gboolean pending_jump;      // 按键时附近没有匹配，扫描完成后跳到第一个匹配
+
+    // 上一次完成的全文扫描，查询追加字符时从中筛选
+    gchar* query;
+    gboolean case_sensitive;
+    guint generation;
+    GArray* matches;            // SearchMatch（字节偏移），按位置递增、互不重叠。匹配过多时为 NULL
+};
+
+// 后台扫描任务
+typedef struct ScanJob
+{
+    IncrementalSearch* search;
+    GBytes* snapshot;
+    guint generation;
+    gchar* query;
+    gboolean case_sensitive;
+    GArray* previous;           // 可以从中筛选的上一次结果，否则为 NULL
+    gsize from;                 // 查找起点（字符偏移）
+    GArray* matches;
+    guint64 count;              // 匹配总数，超过 matches 的长度时 matches 只有开头的一部分
+    gboolean found;
+    gsize first_start;          // 起点之后第一个匹配（字符偏移），到末尾后从头绕回
+    gsize first_end;
+    gint64 start_time;          // 开始扫描的时间，用于性能面板
+} ScanJob;
+
+static void scan_job_free(ScanJob* job)
+{
+    g_bytes_unref(job->snapshot);
+    g_free(job->query);
+    if (job->previous)
+        g_array_unref(job->previous);
+    if (job->matches)
+        g_array_unref(job->matches);
+    g_free(job);
+}
+
+static gboolean bytes_equal(const char* a, const char* b, gsize length, gboolean case_sensitive)
+{
+    return case_sensitive ? memcmp(a, b, length) == 0 : g_ascii_strncasecmp(a, b, length) == 0;
+}
+
+// 查询的真前缀同时也是后缀时，它的匹配可能互相重叠，不重叠的结果不包含所有出现位置，不能用来筛选
+static gboolean has_border(const char* query, gboolean case_sensitive)
+{
+    gsize length = strlen(query);
+    for (gsize k = 1; k < length; k++)
+    {
+        if (bytes_equal(query, query + length - k, k, case_sensitive))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+// 新查询的每个出现位置都是旧查询的出现位置，逐个验证并按从左到右的顺序去掉重叠
+static GArray* narrow_matches(GArray* previous, const char* text, gsize length, const char* query,
+                              gboolean case_sensitive, GCancellable* cancellable)
+{
+    gsize query_length = strlen(query);
+    GArray* matches = g_array_new(FALSE, FALSE, sizeof(SearchMatch));
+    gsize next_allowed = 0;
+
+    for (guint i = 0; i < previous->len; i++)
+    {
+        if ((i & 0xFFFF) == 0 && g_cancellable_is_cancelled(cancellable))
+            break;
+
+        gsize start = g_array_index(previous, SearchMatch, i).start;
+        if (start < next_allowed || start + query_length > length ||
+            !bytes_equal(text + start, query, query_length, case_sensitive))
+            continue;
+
+        SearchMatch match = { start, start + query_length };
+        g_array_append_val(matches, match);
+        next_allowed = match.end;
+    }
+    return matches;
+}
+
+static void scan_job_thread(GTask* task, gpointer source, gpointer task_data, GCancellable* cancellable)
+{
+    ScanJob* job = (ScanJob*)task_data;
+    gsize length;
+    const char* text = (const char*)g_bytes_get_data(job->snapshot, &length);
+
+    SearchPattern pattern;
+    text_search_pattern_init(&pattern, job->query, strlen(job->query), job->case_sensitive);
+    if (job->previous)
+    {
+        job->matches = narrow_matches(job->previous, text, length, job->query, job->case_sensitive, cancellable);
+        job->count = job->matches->len;
+    }
+    else
+    {
+        job->matches = text_search_parallel_all(&pattern, text, length, INCREMENTAL_SEARCH_MAX_MATCHES,
+                                                cancellable, &job->count);
+    }
+    if (g_task_return_error_if_cancelled(task))
+        return;
+
+    // 二分查找起点之后的第一个匹配，只为它换算字符偏移
+    if (job->matches->len > 0)
+    {
+        gsize from = text_search_byte_offset(text, length, job->from);
+        guint low = 0, high = job->matches->len;
+        while (low < high)
+        {
+            guint mid = low + (high - low) / 2;
+            if (g_array_index(job->matches, SearchMatch, mid).start < from)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        SearchMatch first = g_array_index(job->matches, SearchMatch, low < job->matches->len ? low : 0);
+
+        // 只保存了开头的匹配时，起点之后的第一个匹配可能不在其中
+        gsize match;
+        if (low == job->matches->len && job->count > job->matches->len &&
+            text_search_parallel_first(&pattern, text, length, from, cancellable, &match))
+        {
+            first.start = match;
+            first.end = match + pattern.length;
+        }
+        job->found = TRUE;
+        job->first_start = text_search_char_offset(text, first.start);
+        job->first_end = job->first_start + g_utf8_strlen(text + first.start, (gssize)(first.end - first.start));
+    }
+    g_task_return_boolean(task, TRUE);
+}
+
+static void set_count_label(IncrementalSearch* search, const char* text)
+{
+    gtk_label_set_text(GTK_LABEL(search->app->ui->find_count_label), text);
+}
+
+static void select_match(IncrementalSearch* search, GtkTextIter* start, GtkTextIter* end)
+{
+    GtkTextView* view = GTK_TEXT_VIEW(search->app->ui->text_view);
+    gtk_text_buffer_select_range(search->app->ui->buffer, start, end);
+    gtk_text_view_scroll_to_iter(view, start, 0.1, FALSE, 0.0, 0.0);
+}
+
+static GtkTextSearchFlags search_flags(gboolean case_sensitive)
+{
+    return case_sensitive ? GTK_TEXT_SEARCH_TEXT_ONLY : GTK_TEXT_SEARCH_TEXT_ONLY | GTK_TEXT_SEARCH_CASE_INSENSITIVE;
+}
+
+// 只在可见区域内查找并高亮，代价与文档大小无关
+static void highlight_visible(IncrementalSearch* search)
+{
+    NotepadApp* app = search->app;
+    GtkTextBuffer* buffer = app->ui->buffer;
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds(buffer, &start, &end);
+    gtk_text_buffer_remove_tag(buffer, search->tag, &start, &end);
+
+    const gchar* query = gtk_entry_get_text(GTK_ENTRY(app->ui->find_entry));
+    if (!*query || !app->ui->find_replace_visible)
+        return;
+
+    GdkRectangle visible;
+    GtkTextView* view = GTK_TEXT_VIEW(app->ui->text_view);
+    gtk_text_view_get_visible_rect(view, &visible);
+    gtk_text_view_get_iter_at_location(view, &start, visible.x, visible.y);
+    gtk_text_view_get_iter_at_location(view, &end, visible.x + visible.width, visible.y + visible.height);
+    gtk_text_iter_set_line_offset(&start, 0);
+    gtk_text_iter_forward_to_line_end(&end);
+
+    GtkTextSearchFlags flags = search_flags(gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(app->ui->case_sensitive_check)));
+    GtkTextIter match_start, match_end;
+    while (gtk_text_iter_forward_search(&start, query, flags, &match_start, &match_end, &end))
+    {
+        gtk_text_buffer_apply_tag(buffer, search->tag, &match_start, &match_end);
+        start = match_end;
+    }
+}
+
+static void scan_job_done(GObject* source, GAsyncResult* result, gpointer data)
+{
+    ScanJob* job = (ScanJob*)data;
+    IncrementalSearch* search = job->search;
+    GError* error = NULL;
+
+    // 被新的按键取消
+    if (!g_task_propagate_boolean(G_TASK(result), &error))
+    {
+        g_error_free(error);
+        scan_job_free(job);
+        return;
+    }
+    g_clear_object(&search->cancellable);
+
+    NotepadApp* app = search->app;
+    if (job->generation != app->content_generation)
+    {
+        scan_job_free(job);
+        return;
+    }
+
+    // 保存完整的结果，供之后追加字符时筛选；匹配过多时只保存了一部分，下次重新扫描
+    g_free(search->query);
+    if (search->matches)
+        g_array_unref(search->matches);
+    search->query = g_strdup(job->query);
+    search->case_sensitive = job->case_sensitive;
+    search->generation = job->generation;
+    search->matches = job->count == job->matches->len ? g_array_ref(job->matches) : NULL;
+    perf_hud_record(app->ui->perf_hud, PERF_TIMING_SEARCH, job->start_time);
+
+    gchar* label = job->count > 0 ? g_strdup_printf("共 %" G_GUINT64_FORMAT " 个匹配", job->count) : g_strdup("无匹配");
+    set_count_label(search, label);
+    g_free(label);
+
+    if (search->pending_jump && job->found)
+    {
+        GtkTextIter start, end;
+        gtk_text_buffer_get_iter_at_offset(app->ui->buffer, &start, (gint)job->first_start);
+        gtk_text_buffer_get_iter_at_offset(app->ui->buffer, &end, (gint)job->first_end);
+        select_match(search, &start, &end);
+    }
+    search->pending_jump = FALSE;
+    highlight_visible(search);
+    scan_job_free(job);
+}
+
+static void cancel_scan(IncrementalSearch* search)
+{
+    if (search->scan_id)
+    {
+        g_source_remove(search->scan_id);
+        search->scan_id = 0;
+    }
+    if (search->cancellable)
+    {
+        g_cancellable_cancel(search->cancellable);
+        g_clear_object(&search->cancellable);
+    }
+}
+
+// 查找起点：选区开头（正在输入的查询仍从当前匹配处开始），否则为光标
+static gint search_origin(NotepadApp* app)
+{
+    GtkTextIter start, end;
+    if (!gtk_text_buffer_get_selection_bounds(app->ui->buffer, &start, &end))
+        gtk_text_buffer_get_iter_at_mark(app->ui->buffer, &start, gtk_text_buffer_get_insert(app->ui->buffer));
+    return gtk_text_iter_get_offset(&start);
+}
+
+static gboolean on_scan_timeout(gpointer data)
+{
+    IncrementalSearch* search = (IncrementalSearch*)data;
+    NotepadApp* app = search->app;
+    search->scan_id = 0;
+
+    const gchar* query = gtk_entry_get_text(GTK_ENTRY(app->ui->find_entry));
+    gboolean case_sensitive = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(app->ui->case_sensitive_check));
+
+    // 需要 Unicode 大小写折叠的查询不能按字节扫描，退回逐个查找
+    if (!text_search_pattern_supported(query, case_sensitive))
+    {
+        set_count_label(search, "");
+        if (search->pending_jump)
+            on_find_next(NULL, app);
+        search->pending_jump = FALSE;
+        return G_SOURCE_REMOVE;
+    }
+
+    ScanJob* job = g_new0(ScanJob, 1);
+    job->search = search;
+    job->start_time = g_get_monotonic_time();
+    job->snapshot = notepad_get_snapshot(app);
+    job->generation = app->content_generation;
+    job->query = g_strdup(query);
+    job->case_sensitive = case_sensitive;
+    job->from = (gsize)search_origin(app);
+
+    gsize previous_length = search->query ? strlen(search->query) : 0;
+    if (search->matches && search->generation == job->generation && search->case_sensitive == case_sensitive &&
+        strlen(query) > previous_length && strncmp(query, search->query, previous_length) == 0 &&
+        !has_border(search->query, case_sensitive))
+        job->previous = g_array_ref(search->matches);
+
+    search->cancellable = g_cancellable_new();
+    GTask* task = g_task_new(NULL, search->cancellable, scan_job_done, job);
+    g_task_set_task_data(task, job, NULL);
+    g_task_run_in_thread(task, scan_job_thread);
+    g_object_unref(task);
+    return G_SOURCE_REMOVE;
+}
+
+static void on_query_changed(GtkWidget* widget, gpointer data)
+{
+    IncrementalSearch* search = (IncrementalSearch*)data;
+    NotepadApp* app = search->app;
+    cancel_scan(search);
+
+    const gchar* query = gtk_entry_get_text(GTK_ENTRY(app->ui->find_entry));
+    if (!*query)
+    {
+        search->pending_jump = FALSE;
+        set_count_label(search, "");
+        highlight_visible(search);
+        return;
+    }
+
+    // 先在起点之后的一小段内同步查找，大多数情况下立即得到第一个匹配
+    GtkTextIter start, limit, match_start, match_end;
+    gboolean case_sensitive = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(app->ui->case_sensitive_check));
+    gtk_text_buffer_get_iter_at_offset(app->ui->buffer, &start, search_origin(app));
+    limit = start;
+    gtk_text_iter_forward_chars(&limit, INCREMENTAL_SEARCH_SYNC_CHARS);
+    search->pending_jump = !gtk_text_iter_forward_search(&start, query, search_flags(case_sensitive),
+                                                          &match_start, &match_end, &limit);
+    if (!search->pending_jump)
+        select_match(search, &match_start, &match_end);
+
+    highlight_visible(search);
+    set_count_label(search, "…");
+    search->scan_id = g_timeout_add(INCREMENTAL_SEARCH_DELAY, on_scan_timeout, search);
+}
+
+static gboolean on_highlight_idle(gpointer data)
+{
+    IncrementalSearch* search = (IncrementalSearch*)data;
+    search->highlight_id = 0;
+    highlight_visible(search);
+    return G_SOURCE_REMOVE;
+}
+
+static void on_scrolled(GtkAdjustment* adjustment, gpointer data)
+{
+    IncrementalSearch* search = (IncrementalSearch*)data;
+    if (search->app->ui->find_replace_visible && !search->highlight_id)
+        search->highlight_id = g_idle_add(on_highlight_idle, search);
+}
+
+IncrementalSearch* incremental_search_new(NotepadApp* app)
+{
+    IncrementalSearch* search = g_new0(IncrementalSearch, 1);
+    search->app = app;
+    search->tag = gtk_text_buffer_create_tag(app->ui->buffer, "search-match", "background", "#fce94f", NULL);
+
+    g_signal_connect(app->ui->find_entry, "changed", G_CALLBACK(on_query_changed), search);
+    g_signal_connect(app->ui->case_sensitive_check, "toggled", G_CALLBACK(on_query_changed), search);
+    g_signal_connect(gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(app->ui->text_view)), "value-changed",
+                     G_CALLBACK(on_scrolled), search);
+    return search;
+}
+
+void incremental_search_clear(IncrementalSearch* search)
+{
+    cancel_scan(search);
+    search->pending_jump = FALSE;
+    highlight_visible(search);
+}
+
+void incremental_search_free(IncrementalSearch* search)
+{
+    if (!search)
+        return;
+    cancel_scan(search);
+    if (search->highlight_id)
+        g_source_remove(search->highlight_id);
+    g_free(search->query);
+    if (search->matches)
+        g_array_unref(search->matches);
+    g_free(search);
+}
@@ -0,0 +1,24 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef INCREMENTAL_SEARCH_H
+#define INCREMENTAL_SEARCH_H
+
+#include <gtk/gtk.h>
+#include "ui.h"
+
+#define INCREMENTAL_SEARCH_DELAY      150           // 输入停止多久后在后台统计全文匹配（毫秒）
+#define INCREMENTAL_SEARCH_SYNC_CHARS (64 * 1024)   // 每次按键在光标之后同步查找的字符数
+#define INCREMENTAL_SEARCH_MAX_MATCHES (256 * 1024) // 最多保存的匹配数，超过时只计数，下次按键重新扫描
+
+// 边输入边查找：每次按键立即在光标附近查找并高亮可见区域内的匹配，
+// 输入停顿后在后台对快照统计全部匹配。查询只是在末尾追加字符时，
+// 从上一次的匹配中筛选而不重新扫描全文。新的按键取消进行中的扫描
+typedef struct IncrementalSearch IncrementalSearch;
+
+extern IncrementalSearch* incremental_search_new(NotepadApp* app);  // 在文本视图和查找栏创建之后调用
+extern void incremental_search_free(IncrementalSearch* search);
+extern void incremental_search_clear(IncrementalSearch* search);    // 关闭查找栏时取消扫描并清除高亮
+
+#endif // INCREMENTAL_SEARCH_H
@@ -0,0 +1,109 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "line_ending.h"
+#include <string.h>
+
+const gchar* line_ending_name(LineEnding line_ending)
+{
+    switch (line_ending)
+    {
+    case LINE_ENDING_CRLF:
+        return "CRLF";
+    case LINE_ENDING_CR:
+        return "CR";
+    default:
+        return "LF";
+    }
+}
+
+static gsize count_newlines(const char* text, gsize length)
+{
+    gsize count = 0;
+    const char* end = text + length;
+    while ((text = memchr(text, '\n', (gsize)(end - text))) != NULL)
+    {
+        count++;
+        text++;
+    }
+    return count;
+}
+
+LineEnding line_ending_normalize(char* text, gsize* length, LineEnding fallback)
+{
+    gsize len = *length;
+    const char* cr = memchr(text, '\r', len);
+    if (!cr)
+        return memchr(text, '\n', len) ? LINE_ENDING_LF : fallback;
+
+    // 按段移动：每次找到下一个 \r，把它之前的内容整体前移
+    gsize crlf = 0, lone_cr = 0;
+    gsize lf = count_newlines(text, (gsize)(cr - text));
+    gsize read = (gsize)(cr - text);
+    gsize write = read;
+
+    while (read < len)
+    {
+        // 此处 text[read] == '\r'
+        if (read + 1 < len && text[read + 1] == '\n')
+        {
+            crlf++;
+            read += 2;
+        }
+        else
+        {
+            lone_cr++;
+            read++;
+        }
+        text[write++] = '\n';
+
+        const char* next = memchr(text + read, '\r', len - read);
+        gsize segment = next ? (gsize)(next - (text + read)) : len - read;
+        lf += count_newlines(text + read, segment);
+        memmove(text + write, text + read, segment);
+        read += segment;
+        write += segment;
+    }
+
+    text[write] = '\0';
+    *length = write;
+
+    if (crlf >= lf && crlf >= lone_cr)
+        return LINE_ENDING_CRLF;
+    return lf >= lone_cr ? LINE_ENDING_LF : LINE_ENDING_CR;
+}
+
+gsize line_ending_expand(const char* text, gsize length, LineEnding target, char* out)
+{
+    if (target == LINE_ENDING_LF)
+    {
+        memcpy(out, text, length);
+        return length;
+    }
+
+    gsize written = 0;
+    const char* end = text + length;
+    while (text < end)
+    {
+        const char* newline = memchr(text, '\n', (gsize)(end - text));
+        gsize segment = newline ? (gsize)(newline - text) : (gsize)(end - text);
+        memcpy(out + written, text, segment);
+        written += segment;
+        text += segment;
+        if (!newline)
+            break;
+
+        if (target == LINE_ENDING_CRLF)
+        {
+            out[written++] = '\r';
+            out[written++] = '\n';
+        }
+        else
+        {
+            out[written++] = '\r';
+        }
+        text++;
+    }
+    return written;
+}
@@ -0,0 +1,33 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef LINE_ENDING_H
+#define LINE_ENDING_H
+
+#include <glib.h>
+
+// 行分隔符。缓冲区内部统一使用 \n，保存时再转换为文档记录的分隔符
+typedef enum
+{
+    LINE_ENDING_LF,
+    LINE_ENDING_CRLF,
+    LINE_ENDING_CR
+} LineEnding;
+
+#ifdef G_OS_WIN32
+#define LINE_ENDING_DEFAULT LINE_ENDING_CRLF
+#else
+#define LINE_ENDING_DEFAULT LINE_ENDING_LF
+#endif
+
+extern const gchar* line_ending_name(LineEnding line_ending);     // "LF"、"CRLF"、"CR"
+
+// 原地把 \r\n 和 \r 统一为 \n，length 返回新长度。
+// 返回文本中出现最多的分隔符，没有换行时返回 fallback
+extern LineEnding line_ending_normalize(char* text, gsize* length, LineEnding fallback);
+
+// 把只含 \n 的文本转换为 target 分隔符写入 out（容量至少为 2 * length），返回写入的字节数
+extern gsize line_ending_expand(const char* text, gsize length, LineEnding target, char* out);
+
+#endif // LINE_ENDING_H
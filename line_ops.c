@@ -0,0 +1,555 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "line_ops.h"
+#include "text_search.h"
+#include <math.h>
+#include <string.h>
+
+#define LINE_PART_MIN        (64 * 1024)    // 每个线程至少分到的行数或字节数，太少时不值得开线程
+#define LINE_INSERTION_SORT  16             // 小于这个长度的区间直接插入排序
+#define LINE_CANCEL_CHECK    0xFFFF         // 每处理这么多行检查一次取消
+
+// 行索引：第 i 行是 text[starts[i], starts[i + 1] - 1)，不含换行。
+// 原文不以换行结尾时 starts[count] = length + 1，最后一行的长度公式保持一致
+typedef struct LineIndex
+{
+    const char* text;
+    gsize length;
+    gsize* starts;
+    guint count;
+    gboolean trailing_newline;
+} LineIndex;
+
+static const char* operation_names[LINE_OPERATION_COUNT] = {
+    "排序（按文本）",
+    "排序（按数值）",
+    "排序（自然顺序）",
+    "删除重复行",
+    "反转行顺序",
+    "保留匹配的行",
+    "删除匹配的行"
+};
+
+const char* line_operation_name(LineOperation operation)
+{
+    return operation_names[operation];
+}
+
+gboolean line_operation_needs_pattern(LineOperation operation)
+{
+    return operation == LINE_KEEP_MATCHING || operation == LINE_REMOVE_MATCHING;
+}
+
+static inline const char* line_text(const LineIndex* index, guint line)
+{
+    return index->text + index->starts[line];
+}
+
+static inline gsize line_length(const LineIndex* index, guint line)
+{
+    return index->starts[line + 1] - index->starts[line] - 1;
+}
+
+// 把工作分成若干份交给多个线程，第一份在当前线程执行
+typedef void (*PartFunc)(gpointer data, guint part, guint parts);
+
+typedef struct Part
+{
+    PartFunc func;
+    gpointer data;
+    guint index;
+    guint count;
+} Part;
+
+static gpointer part_thread(gpointer data)
+{
+    Part* part = (Part*)data;
+    part->func(part->data, part->index, part->count);
+    return NULL;
+}
+
+static void run_parts(PartFunc func, gpointer data, guint parts)
+{
+    Part* list = g_new(Part, parts);
+    GThread** threads = g_new0(GThread*, parts);
+    for (guint i = 0; i < parts; i++)
+    {
+        list[i].func = func;
+        list[i].data = data;
+        list[i].index = i;
+        list[i].count = parts;
+        if (i > 0)
+            threads[i] = g_thread_new("line-ops", part_thread, &list[i]);
+    }
+
+    part_thread(&list[0]);
+
+    for (guint i = 1; i < parts; i++)
+        g_thread_join(threads[i]);
+    g_free(threads);
+    g_free(list);
+}
+
+static guint part_count(gsize work)
+{
+    gsize threads = MAX(1, g_get_num_processors());
+    return (guint)MIN(threads, MAX((gsize)1, work / LINE_PART_MIN));
+}
+
+// 第 part 份的起点，最后一份的终点为 total
+static inline gsize part_bound(gsize total, guint part, guint parts)
+{
+    return total / parts * part + total % parts * part / parts;
+}
+
+// 建立行索引：先分块并行统计换行数，再按前缀和并行填写每行的起点
+typedef struct IndexBuild
+{
+    LineIndex* index;
+    gsize* newlines;        // 每块中的换行数，第二遍时改为该块第一个换行的序号
+    GCancellable* cancellable;
+} IndexBuild;
+
+static void count_newlines(gpointer data, guint part, guint parts)
+{
+    IndexBuild* build = (IndexBuild*)data;
+    const char* text = build->index->text;
+    gsize end = part_bound(build->index->length, part + 1, parts);
+    gsize count = 0;
+
+    for (const char* p = text + part_bound(build->index->length, part, parts);
+         (p = memchr(p, '\n', (gsize)(text + end - p))) != NULL; p++)
+        count++;
+    build->newlines[part] = count;
+}
+
+static void fill_starts(gpointer data, guint part, guint parts)
+{
+    IndexBuild* build = (IndexBuild*)data;
+    const char* text = build->index->text;
+    gsize end = part_bound(build->index->length, part + 1, parts);
+    gsize* starts = build->index->starts + build->newlines[part] + 1;
+
+    for (const char* p = text + part_bound(build->index->length, part, parts);
+         (p = memchr(p, '\n', (gsize)(text + end - p))) != NULL; p++)
+        *starts++ = (gsize)(p - text) + 1;
+}
+
+static void line_index_build(LineIndex* index, const char* text, gsize length)
+{
+    index->text = text;
+    index->length = length;
+    index->trailing_newline = length > 0 && text[length - 1] == '\n';
+
+    guint parts = part_count(length);
+    IndexBuild build = { index, g_new0(gsize, parts), NULL };
+    run_parts(count_newlines, &build, parts);
+
+    gsize total = 0;
+    for (guint i = 0; i < parts; i++)
+    {
+        gsize count = build.newlines[i];
+        build.newlines[i] = total;
+        total += count;
+    }
+
+    index->count = (guint)(length == 0 || index->trailing_newline ? total : total + 1);
+    index->starts = g_new(gsize, total + 2);
+    index->starts[0] = 0;
+    run_parts(fill_starts, &build, parts);
+    if (length > 0 && !index->trailing_newline)
+        index->starts[index->count] = length + 1;
+    g_free(build.newlines);
+}
+
+// 行比较
+static int compare_bytes(const char* a, gsize a_length, const char* b, gsize b_length)
+{
+    int result = memcmp(a, b, MIN(a_length, b_length));
+    if (result != 0)
+        return result;
+    return a_length < b_length ? -1 : a_length > b_length;
+}
+
+// 连续的数字按数值比较，数值相同时前导零少的在前，其余字节按字节顺序比较
+static int compare_natural(const char* a, gsize a_length, const char* b, gsize b_length)
+{
+    gsize i = 0, j = 0;
+    while (i < a_length && j < b_length)
+    {
+        if (g_ascii_isdigit(a[i]) && g_ascii_isdigit(b[j]))
+        {
+            gsize a_start = i, b_start = j;
+            while (a_start < a_length && a[a_start] == '0')
+                a_start++;
+            while (b_start < b_length && b[b_start] == '0')
+                b_start++;
+
+            gsize a_end = a_start, b_end = b_start;
+            while (a_end < a_length && g_ascii_isdigit(a[a_end]))
+                a_end++;
+            while (b_end < b_length && g_ascii_isdigit(b[b_end]))
+                b_end++;
+
+            if (a_end - a_start != b_end - b_start)
+                return a_end - a_start < b_end - b_start ? -1 : 1;
+            int result = memcmp(a + a_start, b + b_start, a_end - a_start);
+            if (result != 0)
+                return result;
+            if (a_start - i != b_start - j)
+                return a_start - i < b_start - j ? -1 : 1;
+
+            i = a_end;
+            j = b_end;
+            continue;
+        }
+
+        if (a[i] != b[j])
+            return (guchar)a[i] < (guchar)b[j] ? -1 : 1;
+        i++;
+        j++;
+    }
+    if (i < a_length)
+        return 1;
+    return j < b_length ? -1 : 0;
+}
+
+// 行首（跳过空白）的数字，没有数字时为负无穷
+static double numeric_key(const char* line, gsize length)
+{
+    char buffer[64];
+    gsize n = MIN(length, sizeof(buffer) - 1);
+    memcpy(buffer, line, n);
+    buffer[n] = '\0';
+
+    char* end;
+    double value = g_ascii_strtod(buffer, &end);
+    return end == buffer || isnan(value) ? -INFINITY : value;
+}
+
+typedef struct SortContext
+{
+    const LineIndex* index;
+    LineOperation operation;
+    double* keys;           // 按数值排序时每行的数值
+    guint* order;           // 行号，排序的对象
+    guint* scratch;         // 与 order 等长的归并缓冲区
+    guint parts;
+    guint width;            // 当前归并轮次中每段包含的份数
+    GCancellable* cancellable;
+} SortContext;
+
+static int compare_lines(const SortContext* context, guint a, guint b)
+{
+    const LineIndex* index = context->index;
+    if (context->operation == LINE_SORT_NUMERIC && context->keys[a] != context->keys[b])
+        return context->keys[a] < context->keys[b] ? -1 : 1;
+    if (context->operation == LINE_SORT_NATURAL)
+        return compare_natural(line_text(index, a), line_length(index, a), line_text(index, b), line_length(index, b));
+    return compare_bytes(line_text(index, a), line_length(index, a), line_text(index, b), line_length(index, b));
+}
+
+// 稳定归并 source[low, middle) 和 source[middle, high) 到 target[low, high)
+static void merge_runs(const SortContext* context, const guint* source, guint* target,
+                       gsize low, gsize middle, gsize high)
+{
+    gsize i = low, j = middle, k = low;
+    while (i < middle && j < high)
+        target[k++] = compare_lines(context, source[j], source[i]) < 0 ? source[j++] : source[i++];
+    while (i < middle)
+        target[k++] = source[i++];
+    while (j < high)
+        target[k++] = source[j++];
+}
+
+// 归并排序 order[low, high)，scratch 的同一区间作为缓冲
+static void sort_range(const SortContext* context, gsize low, gsize high)
+{
+    guint* order = context->order;
+    if (high - low <= LINE_INSERTION_SORT)
+    {
+        for (gsize i = low + 1; i < high; i++)
+        {
+            guint line = order[i];
+            gsize j = i;
+            for (; j > low && compare_lines(context, order[j - 1], line) > 0; j--)
+                order[j] = order[j - 1];
+            order[j] = line;
+        }
+        return;
+    }
+    if (high - low > LINE_CANCEL_CHECK && g_cancellable_is_cancelled(context->cancellable))
+        return;
+
+    gsize middle = low + (high - low) / 2;
+    sort_range(context, low, middle);
+    sort_range(context, middle, high);
+    if (compare_lines(context, order[middle - 1], order[middle]) <= 0)
+        return;
+
+    memcpy(context->scratch + low, order + low, (high - low) * sizeof(guint));
+    merge_runs(context, context->scratch, order, low, middle, high);
+}
+
+static void compute_keys(gpointer data, guint part, guint parts)
+{
+    SortContext* context = (SortContext*)data;
+    const LineIndex* index = context->index;
+    gsize end = part_bound(index->count, part + 1, parts);
+    for (gsize i = part_bound(index->count, part, parts); i < end; i++)
+        context->keys[i] = numeric_key(line_text(index, (guint)i), line_length(index, (guint)i));
+}
+
+static void sort_part(gpointer data, guint part, guint parts)
+{
+    SortContext* context = (SortContext*)data;
+    sort_range(context, part_bound(context->index->count, part, context->parts),
+               part_bound(context->index->count, part + 1, context->parts));
+}
+
+// 一轮归并：第 pair 对相邻的两段从 order 归并到 scratch，落单的一段直接复制
+static void merge_pair(gpointer data, guint pair, guint pairs)
+{
+    SortContext* context = (SortContext*)data;
+    gsize total = context->index->count;
+    guint first = pair * 2 * context->width;
+    gsize low = part_bound(total, first, context->parts);
+    gsize middle = part_bound(total, MIN(first + context->width, context->parts), context->parts);
+    gsize high = part_bound(total, MIN(first + 2 * context->width, context->parts), context->parts);
+    merge_runs(context, context->order, context->scratch, low, middle, high);
+}
+
+// 各份在各自线程中排序，再逐轮两两并行归并
+static guint* sort_lines(const LineIndex* index, LineOperation operation, GCancellable* cancellable)
+{
+    SortContext context = { index, operation, NULL, NULL, NULL, part_count(index->count), 1, cancellable };
+    context.order = g_new(guint, index->count);
+    context.scratch = g_new(guint, index->count);
+    for (guint i = 0; i < index->count; i++)
+        context.order[i] = i;
+
+    if (operation == LINE_SORT_NUMERIC)
+    {
+        context.keys = g_new(double, index->count);
+        run_parts(compute_keys, &context, context.parts);
+    }
+
+    run_parts(sort_part, &context, context.parts);
+    for (; context.width < context.parts && !g_cancellable_is_cancelled(cancellable); context.width *= 2)
+    {
+        guint pairs = (context.parts + 2 * context.width - 1) / (2 * context.width);
+        run_parts(merge_pair, &context, pairs);
+        guint* swap = context.order;
+        context.order = context.scratch;
+        context.scratch = swap;
+    }
+
+    g_free(context.keys);
+    g_free(context.scratch);
+    return context.order;
+}
+
+// 去重：并行计算每行的哈希，再按原顺序插入开放寻址的哈希表，表中只存行号
+typedef struct HashContext
+{
+    const LineIndex* index;
+    guint32* hashes;
+} HashContext;
+
+static guint32 hash_line(const char* line, gsize length)
+{
+    guint32 hash = 2166136261u;
+    for (gsize i = 0; i < length; i++)
+        hash = (hash ^ (guchar)line[i]) * 16777619u;
+    return hash;
+}
+
+static void hash_part(gpointer data, guint part, guint parts)
+{
+    HashContext* context = (HashContext*)data;
+    const LineIndex* index = context->index;
+    gsize end = part_bound(index->count, part + 1, parts);
+    for (gsize i = part_bound(index->count, part, parts); i < end; i++)
+        context->hashes[i] = hash_line(line_text(index, (guint)i), line_length(index, (guint)i));
+}
+
+static guint* unique_lines(const LineIndex* index, GCancellable* cancellable, guint* kept)
+{
+    HashContext context = { index, g_new(guint32, index->count) };
+    run_parts(hash_part, &context, part_count(index->count));
+
+    gsize size = 16;
+    while (size < (gsize)index->count + index->count / 2)
+        size *= 2;
+    guint* slots = g_new0(guint, size);     // 行号 + 1，0 表示空
+    guint* order = g_new(guint, index->count);
+    guint count = 0;
+
+    for (guint i = 0; i < index->count; i++)
+    {
+        if ((i & LINE_CANCEL_CHECK) == 0 && g_cancellable_is_cancelled(cancellable))
+            break;
+
+        const char* text = line_text(index, i);
+        gsize length = line_length(index, i);
+        gsize slot = context.hashes[i] & (size - 1);
+        gboolean duplicate = FALSE;
+        for (; slots[slot] != 0; slot = (slot + 1) & (size - 1))
+        {
+            guint other = slots[slot] - 1;
+            if (context.hashes[other] == context.hashes[i] && line_length(index, other) == length &&
+                memcmp(line_text(index, other), text, length) == 0)
+            {
+                duplicate = TRUE;
+                break;
+            }
+        }
+        if (duplicate)
+            continue;
+
+        slots[slot] = i + 1;
+        order[count++] = i;
+    }
+
+    g_free(slots);
+    g_free(context.hashes);
+    *kept = count;
+    return order;
+}
+
+// 按内容筛选：并行判断每行是否包含 pattern
+typedef struct MatchContext
+{
+    const LineIndex* index;
+    SearchPattern pattern;
+    gboolean byte_search;   // 能否按字节查找，否则先做 Unicode 大小写折叠
+    gchar* folded;          // 折叠后的 pattern
+    guint8* matched;
+    GCancellable* cancellable;
+} MatchContext;
+
+static void match_part(gpointer data, guint part, guint parts)
+{
+    MatchContext* context = (MatchContext*)data;
+    const LineIndex* index = context->index;
+    gsize end = part_bound(index->count, part + 1, parts);
+
+    for (gsize i = part_bound(index->count, part, parts); i < end; i++)
+    {
+        if ((i & LINE_CANCEL_CHECK) == 0 && g_cancellable_is_cancelled(context->cancellable))
+            return;
+
+        const char* text = line_text(index, (guint)i);
+        gsize length = line_length(index, (guint)i);
+        if (context->pattern.length == 0)
+        {
+            context->matched[i] = TRUE;
+        }
+        else if (context->byte_search)
+        {
+            context->matched[i] = text_search_find(&context->pattern, text, length) != NULL;
+        }
+        else
+        {
+            gchar* folded = g_utf8_casefold(text, (gssize)length);
+            context->matched[i] = strstr(folded, context->folded) != NULL;
+            g_free(folded);
+        }
+    }
+}
+
+static guint* filter_lines(const LineIndex* index, const char* pattern, gboolean case_sensitive, gboolean keep,
+                           GCancellable* cancellable, guint* kept)
+{
+    MatchContext context = { index };
+    text_search_pattern_init(&context.pattern, pattern, strlen(pattern), case_sensitive);
+    context.byte_search = text_search_pattern_supported(pattern, case_sensitive);
+    context.folded = context.byte_search ? NULL : g_utf8_casefold(pattern, -1);
+    context.matched = g_new0(guint8, index->count);
+    context.cancellable = cancellable;
+    run_parts(match_part, &context, part_count(index->count));
+
+    guint* order = g_new(guint, index->count);
+    guint count = 0;
+    for (guint i = 0; i < index->count; i++)
+    {
+        if ((gboolean)context.matched[i] == keep)
+            order[count++] = i;
+    }
+
+    g_free(context.matched);
+    g_free(context.folded);
+    *kept = count;
+    return order;
+}
+
+// 按 order 中的顺序拼接各行，只分配一次
+static GBytes* join_lines(const LineIndex* index, const guint* order, guint count)
+{
+    gsize total = 0;
+    for (guint i = 0; i < count; i++)
+        total += line_length(index, order[i]) + 1;
+    if (count > 0 && !index->trailing_newline)
+        total--;
+
+    gchar* result = g_malloc(total + 1);
+    gchar* p = result;
+    for (guint i = 0; i < count; i++)
+    {
+        gsize length = line_length(index, order[i]);
+        memcpy(p, line_text(index, order[i]), length);
+        p += length;
+        if (i + 1 < count || index->trailing_newline)
+            *p++ = '\n';
+    }
+    *p = '\0';
+    return g_bytes_new_take(result, total);
+}
+
+GBytes* line_ops_apply(LineOperation operation, const char* text, gsize length,
+                       const char* pattern, gboolean case_sensitive,
+                       GCancellable* cancellable, guint* lines)
+{
+    LineIndex index;
+    line_index_build(&index, text, length);
+
+    guint* order = NULL;
+    guint count = index.count;
+    switch (operation)
+    {
+    case LINE_SORT_TEXT:
+    case LINE_SORT_NUMERIC:
+    case LINE_SORT_NATURAL:
+        order = sort_lines(&index, operation, cancellable);
+        break;
+    case LINE_UNIQUE:
+        order = unique_lines(&index, cancellable, &count);
+        break;
+    case LINE_REVERSE:
+        order = g_new(guint, index.count);
+        for (guint i = 0; i < index.count; i++)
+            order[i] = index.count - 1 - i;
+        break;
+    case LINE_KEEP_MATCHING:
+    case LINE_REMOVE_MATCHING:
+        order = filter_lines(&index, pattern ? pattern : "", case_sensitive, operation == LINE_KEEP_MATCHING,
+                             cancellable, &count);
+        break;
+    default:
+        g_return_val_if_reached(NULL);
+    }
+
+    GBytes* result = NULL;
+    if (!g_cancellable_is_cancelled(cancellable))
+    {
+        result = join_lines(&index, order, count);
+        if (lines)
+            *lines = count;
+    }
+
+    g_free(order);
+    g_free(index.starts);
+    return result;
+}
@@ -0,0 +1,33 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef LINE_OPS_H
+#define LINE_OPS_H
+
+#include <gio/gio.h>
+
+// 按行处理文本：排序、去重、反转和按内容筛选
+typedef enum
+{
+    LINE_SORT_TEXT,         // 按字节顺序排序
+    LINE_SORT_NUMERIC,      // 按行首的数字排序，没有数字的行排在最前
+    LINE_SORT_NATURAL,      // 自然排序，连续的数字按数值比较（file2 < file10）
+    LINE_UNIQUE,            // 删除重复的行，保留第一次出现的位置
+    LINE_REVERSE,           // 反转行的顺序
+    LINE_KEEP_MATCHING,     // 只保留包含指定文本的行
+    LINE_REMOVE_MATCHING,   // 删除包含指定文本的行
+    LINE_OPERATION_COUNT
+} LineOperation;
+
+extern const char* line_operation_name(LineOperation operation);        // 菜单中显示的名称
+extern gboolean line_operation_needs_pattern(LineOperation operation);  // 是否需要输入要匹配的文本
+
+// 对 text 的各行执行操作，返回新的文本，取消时返回 NULL。可在工作线程中调用。
+// 行只以 (偏移, 长度) 引用 text 中的内容，不逐行复制；排序和哈希分块在多个线程中并行执行。
+// 结果以 \n 连接各行，原文以换行结尾时结果也以换行结尾。lines 返回结果的行数（可为 NULL）
+extern GBytes* line_ops_apply(LineOperation operation, const char* text, gsize length,
+                              const char* pattern, gboolean case_sensitive,
+                              GCancellable* cancellable, guint* lines);
+
+#endif // LINE_OPS_H
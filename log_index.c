@@ -0,0 +1,639 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "log_index.h"
+#include "text_diff.h"
+#include <math.h>
+#include <string.h>
+
+#define LOG_INDEX_CANCEL_CHECK 0xFFFF   // 每处理这么多行检查一次取消
+
+struct LogColumn
+{
+    gint ref_count;
+    gchar* field;
+    guint lines;
+    guint32* ids;           // 每行的值编号，0 表示该行没有这个字段
+    GPtrArray* values;      // 编号 - 1 对应的值
+    gdouble* numbers;       // 编号 - 1 对应的数值，不是数字时为 NAN
+};
+
+typedef enum
+{
+    LOG_OP_EQUAL,
+    LOG_OP_NOT_EQUAL,
+    LOG_OP_LESS,
+    LOG_OP_LESS_EQUAL,
+    LOG_OP_GREATER,
+    LOG_OP_GREATER_EQUAL
+} LogOp;
+
+typedef struct LogTerm
+{
+    gchar* field;
+    LogOp op;
+    gchar* value;
+    gdouble number;         // 值为数字时的数值，否则为 NAN
+} LogTerm;
+
+struct LogQuery
+{
+    LogTerm terms[LOG_INDEX_MAX_TERMS];
+    guint count;
+};
+
+// 要提取的一组字段
+typedef struct FieldSet
+{
+    const char* const* names;
+    gsize lengths[LOG_INDEX_MAX_TERMS];
+    guint count;
+} FieldSet;
+
+// 行内的一个值
+typedef struct LogValue
+{
+    const char* start;
+    gsize length;
+} LogValue;
+
+// 一个线程处理的一段，起止都在行首
+typedef struct BuildPart
+{
+    const FieldSet* set;
+    const char* text;
+    gsize start;
+    gsize end;
+    gboolean last;              // 最后一段，负责文本末尾换行之后的空行
+    GCancellable* cancellable;
+    guint lines;
+    GArray* ids[LOG_INDEX_MAX_TERMS];           // 每行在本段字典中的编号
+    GHashTable* dictionary[LOG_INDEX_MAX_TERMS]; // 值 → 本段编号
+    GPtrArray* values[LOG_INDEX_MAX_TERMS];     // 本段编号 - 1 → 值（字符串属于字典）
+} BuildPart;
+
+static void field_set_init(FieldSet* set, const char* const* names)
+{
+    set->names = names;
+    set->count = 0;
+    while (names[set->count] && set->count < LOG_INDEX_MAX_TERMS)
+    {
+        set->lengths[set->count] = strlen(names[set->count]);
+        set->count++;
+    }
+}
+
+static gint field_index(const FieldSet* set, const char* key, gsize length)
+{
+    for (guint i = 0; i < set->count; i++)
+    {
+        if (set->lengths[i] == length && memcmp(set->names[i], key, length) == 0)
+            return (gint)i;
+    }
+    return -1;
+}
+
+static const char* skip_space(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+    return p;
+}
+
+static gboolean is_key_char(gchar c)
+{
+    return g_ascii_isalnum(c) || c == '_' || c == '.' || c == '-';
+}
+
+// p 在开头引号之后，返回结尾引号的位置。字符串内容用 memchr 整段跳过，只在遇到引号时检查转义
+static const char* string_end(const char* p, const char* end)
+{
+    while ((p = memchr(p, '"', (gsize)(end - p))) != NULL)
+    {
+        const char* q = p;
+        while (q[-1] == '\\')
+            q--;
+        if (((p - q) & 1) == 0)
+            return p;
+        p++;
+    }
+    return NULL;
+}
+
+static void set_value(LogValue* values, gint index, const char* start, gsize length, guint* found)
+{
+    if (index >= 0 && !values[index].start)
+    {
+        values[index].start = start;
+        values[index].length = length;
+        (*found)++;
+    }
+}
+
+// 只看对象顶层的键，嵌套的对象和数组只计深度；对象和数组类型的值不索引
+static void scan_json(const char* p, const char* end, const FieldSet* set, LogValue* values)
+{
+    guint found = 0;
+    gint depth = 0;
+    while (p < end && found < set->count)
+    {
+        if (*p != '"')
+        {
+            if (*p == '{' || *p == '[')
+                depth++;
+            else if (*p == '}' || *p == ']')
+                depth--;
+            p++;
+            continue;
+        }
+
+        const char* key = p + 1;
+        const char* close = string_end(key, end);
+        if (!close)
+            return;
+        p = close + 1;
+        const char* colon = skip_space(p, end);
+        if (depth != 1 || colon >= end || *colon != ':')
+            continue;
+
+        gint index = field_index(set, key, (gsize)(close - key));
+        p = skip_space(colon + 1, end);
+        if (p >= end || *p == '{' || *p == '[')
+            continue;
+        if (*p == '"')
+        {
+            const char* value = p + 1;
+            close = string_end(value, end);
+            if (!close)
+                return;
+            set_value(values, index, value, (gsize)(close - value), &found);
+            p = close + 1;
+        }
+        else
+        {
+            const char* value = p;
+            while (p < end && *p != ',' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\r')
+                p++;
+            set_value(values, index, value, (gsize)(p - value), &found);
+        }
+    }
+}
+
+// key=value 形式，值可以加双引号；不是 key=value 的词跳过
+static void scan_pairs(const char* p, const char* end, const FieldSet* set, LogValue* values)
+{
+    guint found = 0;
+    while (p < end && found < set->count)
+    {
+        while (p < end && g_ascii_isspace(*p))
+            p++;
+        const char* key = p;
+        while (p < end && is_key_char(*p))
+            p++;
+        if (p == key || p >= end || *p != '=')
+        {
+            while (p < end && !g_ascii_isspace(*p))
+                p++;
+            continue;
+        }
+
+        gint index = field_index(set, key, (gsize)(p - key));
+        p++;
+        if (p < end && *p == '"')
+        {
+            const char* value = p + 1;
+            const char* close = string_end(value, end);
+            if (!close)
+                close = end;
+            set_value(values, index, value, (gsize)(close - value), &found);
+            p = close < end ? close + 1 : end;
+        }
+        else
+        {
+            const char* value = p;
+            while (p < end && !g_ascii_isspace(*p))
+                p++;
+            set_value(values, index, value, (gsize)(p - value), &found);
+        }
+    }
+}
+
+static void scan_line(const char* line, gsize length, const FieldSet* set, LogValue* values)
+{
+    const char* end = line + length;
+    const char* p = skip_space(line, end);
+    if (p < end && *p == '{')
+        scan_json(p, end, set, values);
+    else
+        scan_pairs(p, end, set, values);
+}
+
+gboolean log_line_get_field(const char* line, gsize length, const char* field,
+                            const char** value, gsize* value_length)
+{
+    const char* names[] = { field, NULL };
+    FieldSet set;
+    field_set_init(&set, names);
+    LogValue values[1] = { { NULL, 0 } };
+    scan_line(line, length, &set, values);
+    *value = values[0].start;
+    *value_length = values[0].length;
+    return values[0].start != NULL;
+}
+
+static guint32 intern_value(BuildPart* part, guint field, GString* scratch, const LogValue* value)
+{
+    g_string_truncate(scratch, 0);
+    g_string_append_len(scratch, value->start, (gssize)value->length);
+    guint32 id = GPOINTER_TO_UINT(g_hash_table_lookup(part->dictionary[field], scratch->str));
+    if (id == 0)
+    {
+        gchar* key = g_strdup(scratch->str);
+        g_ptr_array_add(part->values[field], key);
+        id = part->values[field]->len;
+        g_hash_table_insert(part->dictionary[field], key, GUINT_TO_POINTER(id));
+    }
+    return id;
+}
+
+static gpointer build_part_thread(gpointer data)
+{
+    BuildPart* part = (BuildPart*)data;
+    const FieldSet* set = part->set;
+    GString* scratch = g_string_new(NULL);
+    const char* p = part->text + part->start;
+    const char* end = part->text + part->end;
+    gboolean ends_with_break = part->end == 0 || part->text[part->end - 1] == '\n';
+
+    // 按 GtkTextBuffer 的规则分行，行号才能与缓冲区对应
+    while (p < end)
+    {
+        if ((part->lines & LOG_INDEX_CANCEL_CHECK) == 0 && g_cancellable_is_cancelled(part->cancellable))
+            break;
+
+        gsize break_length;
+        const char* line_break = text_find_line_break(p, (gsize)(end - p), &break_length);
+        const char* line_end = line_break ? line_break : end;
+        LogValue values[LOG_INDEX_MAX_TERMS];
+        memset(values, 0, sizeof(values));
+        scan_line(p, (gsize)(line_end - p), set, values);
+
+        for (guint i = 0; i < set->count; i++)
+        {
+            guint32 id = values[i].start ? intern_value(part, i, scratch, &values[i]) : 0;
+            g_array_append_val(part->ids[i], id);
+        }
+        part->lines++;
+        ends_with_break = line_break != NULL;
+        p = line_break ? line_break + break_length : end;
+    }
+
+    // 文本为空或以换行结尾时，最后还有一个空行
+    if (part->last && ends_with_break)
+    {
+        guint32 none = 0;
+        for (guint i = 0; i < set->count; i++)
+            g_array_append_val(part->ids[i], none);
+        part->lines++;
+    }
+
+    g_string_free(scratch, TRUE);
+    return NULL;
+}
+
+static gdouble parse_number(const char* value)
+{
+    gchar* end;
+    gdouble number = g_ascii_strtod(value, &end);
+    return *value && end != value && *end == '\0' ? number : NAN;
+}
+
+// 把各段的字典合并为一列，值的字符串从段的字典转移到列中
+static LogColumn* merge_parts(BuildPart* parts, guint count, guint field, const char* name)
+{
+    LogColumn* column = g_new0(LogColumn, 1);
+    column->ref_count = 1;
+    column->field = g_strdup(name);
+    for (guint i = 0; i < count; i++)
+        column->lines += parts[i].lines;
+    column->ids = g_new(guint32, MAX(column->lines, 1));
+    column->values = g_ptr_array_new_with_free_func(g_free);
+
+    GHashTable* global = g_hash_table_new(g_str_hash, g_str_equal);
+    guint offset = 0;
+    for (guint i = 0; i < count; i++)
+    {
+        GPtrArray* values = parts[i].values[field];
+        guint32* remap = g_new(guint32, values->len + 1);
+        remap[0] = 0;
+        for (guint j = 0; j < values->len; j++)
+        {
+            gchar* value = g_ptr_array_index(values, j);
+            guint32 id = GPOINTER_TO_UINT(g_hash_table_lookup(global, value));
+            if (id == 0)
+            {
+                g_ptr_array_add(column->values, value);
+                id = column->values->len;
+                g_hash_table_insert(global, value, GUINT_TO_POINTER(id));
+            }
+            else
+            {
+                g_free(value);
+            }
+            remap[j + 1] = id;
+        }
+
+        const guint32* ids = (const guint32*)parts[i].ids[field]->data;
+        for (guint j = 0; j < parts[i].lines; j++)
+            column->ids[offset + j] = remap[ids[j]];
+        offset += parts[i].lines;
+        g_free(remap);
+    }
+    g_hash_table_destroy(global);
+
+    column->numbers = g_new(gdouble, MAX(column->values->len, 1));
+    for (guint i = 0; i < column->values->len; i++)
+        column->numbers[i] = parse_number(g_ptr_array_index(column->values, i));
+    return column;
+}
+
+GPtrArray* log_columns_build(const char* const* fields, const char* text, gsize length, GCancellable* cancellable)
+{
+    FieldSet set;
+    field_set_init(&set, fields);
+
+    guint threads = MAX(1, g_get_num_processors());
+    guint count = (guint)MIN((gsize)threads, MAX((gsize)1, length / LOG_INDEX_PART_MIN));
+    BuildPart* parts = g_new0(BuildPart, count);
+    gsize start = 0;
+    for (guint i = 0; i < count; i++)
+    {
+        gsize end = length;
+        if (i + 1 < count)
+        {
+            gsize target = MAX(start, length / count * (i + 1));
+            const char* newline = memchr(text + target, '\n', length - target);
+            end = newline ? (gsize)(newline - text) + 1 : length;
+        }
+        parts[i].set = &set;
+        parts[i].text = text;
+        parts[i].start = start;
+        parts[i].end = end;
+        parts[i].last = i + 1 == count;
+        parts[i].cancellable = cancellable;
+        for (guint f = 0; f < set.count; f++)
+        {
+            parts[i].ids[f] = g_array_new(FALSE, FALSE, sizeof(guint32));
+            parts[i].dictionary[f] = g_hash_table_new(g_str_hash, g_str_equal);
+            parts[i].values[f] = g_ptr_array_new();
+        }
+        start = end;
+    }
+
+    GThread** workers = g_new0(GThread*, count);
+    for (guint i = 1; i < count; i++)
+        workers[i] = g_thread_new("log-index", build_part_thread, &parts[i]);
+    build_part_thread(&parts[0]);   // 第一段在当前线程执行
+    for (guint i = 1; i < count; i++)
+        g_thread_join(workers[i]);
+    g_free(workers);
+
+    GPtrArray* columns = NULL;
+    if (!g_cancellable_is_cancelled(cancellable))
+    {
+        columns = g_ptr_array_new_with_free_func((GDestroyNotify)log_column_unref);
+        for (guint f = 0; f < set.count; f++)
+            g_ptr_array_add(columns, merge_parts(parts, count, f, set.names[f]));
+    }
+
+    // 合并后值的字符串已转移到列中，取消时仍属于各段
+    for (guint i = 0; i < count; i++)
+    {
+        for (guint f = 0; f < set.count; f++)
+        {
+            if (!columns)
+                g_ptr_array_foreach(parts[i].values[f], (GFunc)g_free, NULL);
+            g_ptr_array_free(parts[i].values[f], TRUE);
+            g_hash_table_destroy(parts[i].dictionary[f]);
+            g_array_free(parts[i].ids[f], TRUE);
+        }
+    }
+    g_free(parts);
+    return columns;
+}
+
+LogColumn* log_column_ref(LogColumn* column)
+{
+    g_atomic_int_inc(&column->ref_count);
+    return column;
+}
+
+void log_column_unref(LogColumn* column)
+{
+    if (!column || !g_atomic_int_dec_and_test(&column->ref_count))
+        return;
+    g_free(column->field);
+    g_free(column->ids);
+    g_ptr_array_free(column->values, TRUE);
+    g_free(column->numbers);
+    g_free(column);
+}
+
+const char* log_column_get_field(const LogColumn* column)
+{
+    return column->field;
+}
+
+LogQuery* log_query_parse(const char* text, GError** error)
+{
+    LogQuery* query = g_new0(LogQuery, 1);
+    const char* p = text;
+
+    while (TRUE)
+    {
+        while (g_ascii_isspace(*p))
+            p++;
+        if (!*p)
+            break;
+        if (query->count == LOG_INDEX_MAX_TERMS)
+        {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "条件不能超过 %d 个", LOG_INDEX_MAX_TERMS);
+            log_query_free(query);
+            return NULL;
+        }
+
+        const char* field = p;
+        while (is_key_char(*p))
+            p++;
+        gsize field_length = (gsize)(p - field);
+
+        LogOp op;
+        if (p[0] == '!' && p[1] == '=')
+            op = LOG_OP_NOT_EQUAL;
+        else if (p[0] == '<' && p[1] == '=')
+            op = LOG_OP_LESS_EQUAL;
+        else if (p[0] == '>' && p[1] == '=')
+            op = LOG_OP_GREATER_EQUAL;
+        else if (p[0] == '<')
+            op = LOG_OP_LESS;
+        else if (p[0] == '>')
+            op = LOG_OP_GREATER;
+        else if (p[0] == '=')
+            op = LOG_OP_EQUAL;
+        else
+            op = (LogOp)-1;
+        if (field_length == 0 || op == (LogOp)-1)
+        {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                        "无法识别的条件，应为 字段=值、字段>数字 等形式");
+            log_query_free(query);
+            return NULL;
+        }
+        p += op == LOG_OP_EQUAL || op == LOG_OP_LESS || op == LOG_OP_GREATER ? 1 : 2;
+
+        const char* value = p;
+        gsize value_length;
+        if (*p == '"')
+        {
+            value = ++p;
+            while (*p && *p != '"')
+                p++;
+            value_length = (gsize)(p - value);
+            if (*p)
+                p++;
+        }
+        else
+        {
+            while (*p && !g_ascii_isspace(*p))
+                p++;
+            value_length = (gsize)(p - value);
+        }
+        if (value_length == 0)
+        {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "字段 %.*s 缺少要比较的值",
+                        (int)field_length, field);
+            log_query_free(query);
+            return NULL;
+        }
+
+        LogTerm* term = &query->terms[query->count++];
+        term->field = g_strndup(field, field_length);
+        term->op = op;
+        term->value = g_strndup(value, value_length);
+        term->number = parse_number(term->value);
+    }
+
+    if (query->count == 0)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "请输入查询条件，例如 level=error latency>500");
+        log_query_free(query);
+        return NULL;
+    }
+    return query;
+}
+
+void log_query_free(LogQuery* query)
+{
+    if (!query)
+        return;
+    for (guint i = 0; i < query->count; i++)
+    {
+        g_free(query->terms[i].field);
+        g_free(query->terms[i].value);
+    }
+    g_free(query);
+}
+
+gchar** log_query_get_fields(const LogQuery* query)
+{
+    GPtrArray* fields = g_ptr_array_new();
+    for (guint i = 0; i < query->count; i++)
+    {
+        gboolean seen = FALSE;
+        for (guint j = 0; j < fields->len && !seen; j++)
+            seen = strcmp(g_ptr_array_index(fields, j), query->terms[i].field) == 0;
+        if (!seen)
+            g_ptr_array_add(fields, g_strdup(query->terms[i].field));
+    }
+    g_ptr_array_add(fields, NULL);
+    return (gchar**)g_ptr_array_free(fields, FALSE);
+}
+
+static gboolean term_matches(const LogTerm* term, const char* value, gdouble number)
+{
+    if (term->op == LOG_OP_EQUAL && strcmp(term->value, "*") == 0)
+        return TRUE;
+
+    gint order;
+    if (!isnan(term->number) && !isnan(number))
+        order = number < term->number ? -1 : number > term->number;
+    else if (!isnan(term->number) && term->op != LOG_OP_EQUAL && term->op != LOG_OP_NOT_EQUAL)
+        return FALSE;   // 和数字比大小时，不是数字的值不匹配
+    else if (term->op == LOG_OP_EQUAL || term->op == LOG_OP_NOT_EQUAL)
+        order = g_ascii_strcasecmp(value, term->value);
+    else
+        order = strcmp(value, term->value);
+
+    switch (term->op)
+    {
+    case LOG_OP_EQUAL:
+        return order == 0;
+    case LOG_OP_NOT_EQUAL:
+        return order != 0;
+    case LOG_OP_LESS:
+        return order < 0;
+    case LOG_OP_LESS_EQUAL:
+        return order <= 0;
+    case LOG_OP_GREATER:
+        return order > 0;
+    default:
+        return order >= 0;
+    }
+}
+
+static LogColumn* find_column(GPtrArray* columns, const char* field)
+{
+    for (guint i = 0; i < columns->len; i++)
+    {
+        LogColumn* column = g_ptr_array_index(columns, i);
+        if (strcmp(column->field, field) == 0)
+            return column;
+    }
+    return NULL;
+}
+
+// 每个条件先对列中每个不同的值求一次结果，再按行的值编号查表
+GArray* log_query_run(const LogQuery* query, GPtrArray* columns)
+{
+    guint8* allowed[LOG_INDEX_MAX_TERMS];
+    const guint32* ids[LOG_INDEX_MAX_TERMS];
+    guint lines = G_MAXUINT;
+
+    for (guint t = 0; t < query->count; t++)
+    {
+        const LogTerm* term = &query->terms[t];
+        LogColumn* column = find_column(columns, term->field);
+        g_return_val_if_fail(column != NULL, NULL);
+
+        allowed[t] = g_new0(guint8, column->values->len + 1);
+        for (guint i = 0; i < column->values->len; i++)
+            allowed[t][i + 1] = (guint8)term_matches(term, g_ptr_array_index(column->values, i), column->numbers[i]);
+        ids[t] = column->ids;
+        lines = MIN(lines, column->lines);
+    }
+
+    GArray* result = g_array_new(FALSE, FALSE, sizeof(guint));
+    for (guint line = 0; line < lines; line++)
+    {
+        guint t = 0;
+        while (t < query->count && allowed[t][ids[t][line]])
+            t++;
+        if (t == query->count)
+            g_array_append_val(result, line);
+    }
+
+    for (guint t = 0; t < query->count; t++)
+        g_free(allowed[t]);
+    return result;
+}
@@ -0,0 +1,44 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef LOG_INDEX_H
+#define LOG_INDEX_H
+
+#include <gio/gio.h>
+
+#define LOG_INDEX_PART_MIN  (1024 * 1024)   // 建立索引时每个线程至少分到的字节数
+#define LOG_INDEX_MAX_TERMS 16              // 查询最多的条件数
+
+// 结构化日志的字段索引。每行是一个 JSON 对象（只看顶层的键）或 key=value 形式的文本，
+// 两种格式可以混合。字段的值按行做字典编码：每行一个 32 位的值编号，
+// 查询时每个不同的值只判断一次，再按编号扫描整列
+
+// 一个字段的列，建立后只读，可在线程之间共享
+typedef struct LogColumn LogColumn;
+
+// 并行扫描 text 的所有行，为 fields 中的每个字段（以 NULL 结尾）建立一列，取消时返回 NULL。可在工作线程中调用
+extern GPtrArray* log_columns_build(const char* const* fields, const char* text, gsize length,
+                                    GCancellable* cancellable);
+extern LogColumn* log_column_ref(LogColumn* column);
+extern void log_column_unref(LogColumn* column);
+extern const char* log_column_get_field(const LogColumn* column);
+
+// 在一行中查找字段，找到时 value 指向行内的值（字符串不含引号、不反转义）
+extern gboolean log_line_get_field(const char* line, gsize length, const char* field,
+                                   const char** value, gsize* value_length);
+
+// 查询：空格分隔的若干条件，全部满足的行匹配。条件为 字段 运算符 值，运算符为 = != > >= < <=，
+// 值可以加双引号。两边都是数字时按数值比较，否则按字符串比较（= 和 != 不区分 ASCII 大小写），
+// 但用 > >= < <= 和数字比较时不是数字的值不匹配；
+// 字段=* 表示该行有这个字段。行中没有条件的字段时不匹配
+typedef struct LogQuery LogQuery;
+
+extern LogQuery* log_query_parse(const char* text, GError** error);
+extern void log_query_free(LogQuery* query);
+extern gchar** log_query_get_fields(const LogQuery* query);    // 查询用到的字段（不重复），调用者用 g_strfreev 释放
+
+// 在已建立的列上执行查询，返回匹配行的行号（guint，递增）。columns 中必须包含查询用到的所有字段
+extern GArray* log_query_run(const LogQuery* query, GPtrArray* columns);
+
+#endif // LOG_INDEX_H
@@ -0,0 +1,212 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "long_lines.h"
+#include <string.h>
+
+#define LONG_LINE_TAG "long-line-collapsed"
+#define LONG_LINE_EXPANDED_MARK "long-line-expanded"   // 光标所在、临时展开的超长行的行首
+
+typedef void (*LongLineFunc)(gint line, gpointer data);
+
+static GtkTextTag* get_tag(GtkTextBuffer* buffer)
+{
+    GtkTextTagTable* table = gtk_text_buffer_get_tag_table(buffer);
+    GtkTextTag* tag = gtk_text_tag_table_lookup(table, LONG_LINE_TAG);
+    if (!tag)
+        tag = gtk_text_buffer_create_tag(buffer, LONG_LINE_TAG, "invisible", TRUE, NULL);
+    return tag;
+}
+
+// 一段不含 \n 的文本中下一个换行：单独的 \r 或 U+2029，length 返回其字节数。
+// 段末的 \r 是 \r\n 的一部分，属于本行的结尾
+static const char* find_inner_break(const char* p, const char* end, gsize* length)
+{
+    const char* cr = memchr(p, '\r', (gsize)(end - p));
+    if (cr && cr + 1 == end)
+        cr = NULL;
+
+    const char* limit = cr ? cr : end;
+    for (const char* e2 = p; (e2 = memchr(e2, 0xE2, (gsize)(limit - e2))) != NULL; e2++)
+    {
+        if (limit - e2 >= 3 && (guchar)e2[1] == 0x80 && (guchar)e2[2] == 0xA9)
+        {
+            *length = 3;
+            return e2;
+        }
+    }
+    *length = 1;
+    return cr;
+}
+
+// 扫描文本，对每个超长行调用 func（可为 NULL），返回超长行数。
+// 换行规则与 GtkTextBuffer 一致：\n、\r\n、单独的 \r 和 U+2029
+static gint scan_long_lines(const char* text, gsize length, LongLineFunc func, gpointer data)
+{
+    const char* p = text;
+    const char* end = text + length;
+    gint line = 0;
+    gint count = 0;
+
+    while (p < end)
+    {
+        const char* newline = memchr(p, '\n', (gsize)(end - p));
+        const char* segment_end = newline ? newline : end;
+
+        const char* line_start = p;
+        const char* line_break;
+        gsize break_length;
+        while ((line_break = find_inner_break(line_start, segment_end, &break_length)) != NULL)
+        {
+            if (line_break - line_start > LONG_LINE_THRESHOLD)
+            {
+                count++;
+                if (func)
+                    func(line, data);
+            }
+            line++;
+            line_start = line_break + break_length;
+        }
+
+        if (segment_end - line_start > LONG_LINE_THRESHOLD)
+        {
+            count++;
+            if (func)
+                func(line, data);
+        }
+
+        if (!newline)
+            break;
+        line++;
+        p = newline + 1;
+    }
+
+    return count;
+}
+
+gboolean long_lines_detect(const char* text, gsize length)
+{
+    return scan_long_lines(text, length, NULL, NULL) > 0;
+}
+
+static gboolean collapse_line(GtkTextBuffer* buffer, GtkTextTag* tag, gint line)
+{
+    GtkTextIter start, end;
+    gtk_text_buffer_get_iter_at_line(buffer, &start, line);
+    if (gtk_text_iter_get_bytes_in_line(&start) <= LONG_LINE_THRESHOLD ||
+        gtk_text_iter_get_chars_in_line(&start) <= LONG_LINE_VISIBLE_CHARS)
+        return FALSE;
+
+    gtk_text_iter_set_line_offset(&start, LONG_LINE_VISIBLE_CHARS);
+    end = start;
+    gtk_text_iter_forward_to_line_end(&end);
+    gtk_text_buffer_apply_tag(buffer, tag, &start, &end);
+    return TRUE;
+}
+
+typedef struct CollapseContext
+{
+    GtkTextBuffer* buffer;
+    GtkTextTag* tag;
+    gint collapsed;
+} CollapseContext;
+
+static void collapse_found_line(gint line, gpointer data)
+{
+    CollapseContext* context = (CollapseContext*)data;
+    if (collapse_line(context->buffer, context->tag, line))
+        context->collapsed++;
+}
+
+gint long_lines_collapse_text(GtkTextBuffer* buffer, const char* text, gsize length)
+{
+    CollapseContext context = { buffer, get_tag(buffer), 0 };
+    scan_long_lines(text, length, collapse_found_line, &context);
+    return context.collapsed;
+}
+
+gint long_lines_collapse(GtkTextBuffer* buffer, gint first_line, gint last_line)
+{
+    GtkTextTag* tag = get_tag(buffer);
+    gint collapsed = 0;
+    last_line = MIN(last_line, gtk_text_buffer_get_line_count(buffer) - 1);
+
+    for (gint line = MAX(first_line, 0); line <= last_line; line++)
+    {
+        if (collapse_line(buffer, tag, line))
+            collapsed++;
+    }
+    return collapsed;
+}
+
+gboolean long_lines_expand_at(GtkTextBuffer* buffer, const GtkTextIter* iter)
+{
+    GtkTextTag* tag = get_tag(buffer);
+    GtkTextIter start = *iter;
+    GtkTextIter end = *iter;
+    gtk_text_iter_set_line_offset(&start, 0);
+    if (!gtk_text_iter_ends_line(&end))
+        gtk_text_iter_forward_to_line_end(&end);
+
+    // 行内是否有折叠的部分
+    GtkTextIter probe = start;
+    if (!gtk_text_iter_has_tag(&probe, tag) &&
+        (!gtk_text_iter_forward_to_tag_toggle(&probe, tag) || gtk_text_iter_compare(&probe, &end) >= 0))
+        return FALSE;
+
+    gtk_text_buffer_remove_tag(buffer, tag, &start, &end);
+
+    // 记住展开的行，光标离开后重新折叠
+    GtkTextMark* mark = gtk_text_buffer_get_mark(buffer, LONG_LINE_EXPANDED_MARK);
+    if (mark)
+        gtk_text_buffer_move_mark(buffer, mark, &start);
+    else
+        gtk_text_buffer_create_mark(buffer, LONG_LINE_EXPANDED_MARK, &start, TRUE);
+    return TRUE;
+}
+
+gboolean long_lines_collapse_left(GtkTextBuffer* buffer, const GtkTextIter* iter)
+{
+    GtkTextMark* mark = gtk_text_buffer_get_mark(buffer, LONG_LINE_EXPANDED_MARK);
+    if (!mark)
+        return FALSE;
+
+    GtkTextIter start;
+    gtk_text_buffer_get_iter_at_mark(buffer, &start, mark);
+    gint line = gtk_text_iter_get_line(&start);
+    if (line == gtk_text_iter_get_line(iter))
+        return FALSE;
+
+    gtk_text_buffer_delete_mark(buffer, mark);
+    return collapse_line(buffer, get_tag(buffer), line);
+}
+
+void long_lines_expand_all(GtkTextBuffer* buffer)
+{
+    GtkTextMark* mark = gtk_text_buffer_get_mark(buffer, LONG_LINE_EXPANDED_MARK);
+    if (mark)
+        gtk_text_buffer_delete_mark(buffer, mark);
+
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds(buffer, &start, &end);
+    gtk_text_buffer_remove_tag(buffer, get_tag(buffer), &start, &end);
+}
+
+gint long_lines_count_collapsed(GtkTextBuffer* buffer)
+{
+    GtkTextTag* tag = get_tag(buffer);
+    GtkTextIter iter;
+    gint count = 0;
+
+    // 只在标签的边界之间跳转，不逐行遍历
+    gtk_text_buffer_get_start_iter(buffer, &iter);
+    if (gtk_text_iter_starts_tag(&iter, tag))
+        count++;
+    while (gtk_text_iter_forward_to_tag_toggle(&iter, tag))
+    {
+        if (gtk_text_iter_starts_tag(&iter, tag))
+            count++;
+    }
+    return count;
+}
@@ -0,0 +1,33 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef LONG_LINES_H
+#define LONG_LINES_H
+
+#include <gtk/gtk.h>
+
+#define LONG_LINE_THRESHOLD     (64 * 1024)     // 超过该字节数的行视为超长行
+#define LONG_LINE_VISIBLE_CHARS 4096            // 折叠后只显示开头这么多字符
+
+// 文本中是否存在超长行
+extern gboolean long_lines_detect(const char* text, gsize length);
+
+// 按已载入缓冲区的原始内容折叠其中的超长行，只访问超长行所在位置，返回折叠的行数
+extern gint long_lines_collapse_text(GtkTextBuffer* buffer, const char* text, gsize length);
+
+// 折叠 [first_line, last_line] 范围内的超长行，返回折叠的行数
+extern gint long_lines_collapse(GtkTextBuffer* buffer, gint first_line, gint last_line);
+
+// 展开 iter 所在行，返回该行原先是否处于折叠状态。展开的行会被记住
+extern gboolean long_lines_expand_at(GtkTextBuffer* buffer, const GtkTextIter* iter);
+
+// 光标移到 iter 时，若已离开之前展开的行则重新折叠该行，返回是否折叠
+extern gboolean long_lines_collapse_left(GtkTextBuffer* buffer, const GtkTextIter* iter);
+
+extern void long_lines_expand_all(GtkTextBuffer* buffer);
+
+// 当前仍处于折叠状态的行数
+extern gint long_lines_count_collapsed(GtkTextBuffer* buffer);
+
+#endif // LONG_LINES_H
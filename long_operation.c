@@ -0,0 +1,308 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "long_operation.h"
+#include "notepad.h"
+
+struct LongOperation
+{
+    OperationBar* bar;
+    gchar* label;
+    LongOperationFlags flags;
+    GCancellable* cancellable;
+    gint permille;          // 进度（千分比），-1 表示未知。工作线程写入，主线程读取
+    gint64 last_pump;       // 上次处理界面事件的时间
+    guint lock_id;          // 等待锁定编辑器的回调
+    gboolean locked;        // 是否持有编辑器锁定
+};
+
+struct OperationBar
+{
+    NotepadApp* app;
+    GtkWidget* notification_label;
+    GtkWidget* progress_box;
+    GtkWidget* progress_label;
+    GtkWidget* progress_bar;
+    GtkWidget* cancel_button;
+    GList* operations;      // 进行中的操作，最近开始的在前
+    guint refresh_id;
+    guint notification_id;
+    gint lock_count;
+    gboolean quit_pending;  // 退出在等待不可取消或锁定编辑器的操作结束
+};
+
+static void on_cancel_clicked(GtkWidget* widget, gpointer data)
+{
+    OperationBar* bar = (OperationBar*)data;
+    if (bar->operations)
+    {
+        LongOperation* operation = (LongOperation*)bar->operations->data;
+        g_cancellable_cancel(operation->cancellable);
+        gtk_widget_set_sensitive(bar->cancel_button, FALSE);
+    }
+}
+
+GtkWidget* operation_bar_new(NotepadApp* app)
+{
+    OperationBar* bar = g_new0(OperationBar, 1);
+    bar->app = app;
+    app->ui->operation_bar = bar;
+
+    GtkWidget* box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+
+    // 通知占据状态栏左侧的空白，没有通知时为空
+    bar->notification_label = gtk_label_new("");
+    gtk_widget_set_halign(bar->notification_label, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(bar->notification_label, 10);
+    gtk_label_set_ellipsize(GTK_LABEL(bar->notification_label), PANGO_ELLIPSIZE_END);
+    gtk_box_pack_start(GTK_BOX(box), bar->notification_label, TRUE, TRUE, 0);
+
+    // 进度区域只在有操作进行时显示
+    bar->progress_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+    gtk_widget_set_margin_end(bar->progress_box, 10);
+    bar->progress_label = gtk_label_new("");
+    bar->progress_bar = gtk_progress_bar_new();
+    gtk_widget_set_size_request(bar->progress_bar, 150, -1);
+    gtk_widget_set_valign(bar->progress_bar, GTK_ALIGN_CENTER);
+    bar->cancel_button = gtk_button_new_with_label("取消");
+    gtk_button_set_relief(GTK_BUTTON(bar->cancel_button), GTK_RELIEF_NONE);
+    g_signal_connect(bar->cancel_button, "clicked", G_CALLBACK(on_cancel_clicked), bar);
+
+    gtk_box_pack_start(GTK_BOX(bar->progress_box), bar->progress_label, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(bar->progress_box), bar->progress_bar, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(bar->progress_box), bar->cancel_button, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(box), bar->progress_box, FALSE, FALSE, 0);
+    gtk_widget_set_no_show_all(bar->progress_box, TRUE);
+
+    return box;
+}
+
+static void operation_free(LongOperation* operation)
+{
+    if (operation->lock_id)
+        g_source_remove(operation->lock_id);
+    g_object_unref(operation->cancellable);
+    g_free(operation->label);
+    g_free(operation);
+}
+
+void operation_bar_free(OperationBar* bar)
+{
+    if (!bar)
+        return;
+    for (GList* l = bar->operations; l; l = l->next)
+        g_cancellable_cancel(((LongOperation*)l->data)->cancellable);
+    g_list_free_full(bar->operations, (GDestroyNotify)operation_free);
+    if (bar->refresh_id)
+        g_source_remove(bar->refresh_id);
+    if (bar->notification_id)
+        g_source_remove(bar->notification_id);
+    g_free(bar);
+}
+
+// 按最近开始的操作刷新进度区域
+static void refresh_progress(OperationBar* bar)
+{
+    LongOperation* operation = (LongOperation*)bar->operations->data;
+    gint permille = g_atomic_int_get(&operation->permille);
+
+    gtk_label_set_text(GTK_LABEL(bar->progress_label), operation->label);
+    if (permille < 0)
+        gtk_progress_bar_pulse(GTK_PROGRESS_BAR(bar->progress_bar));
+    else
+        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(bar->progress_bar), permille / 1000.0);
+
+    gtk_widget_set_visible(bar->cancel_button, operation->flags & LONG_OPERATION_CANCELLABLE);
+    gtk_widget_set_sensitive(bar->cancel_button, !g_cancellable_is_cancelled(operation->cancellable));
+    gtk_widget_show_all(bar->progress_box);
+}
+
+// 进度区域在操作持续一个刷新间隔之后才出现，很快完成的操作不会闪烁
+static gboolean on_refresh(gpointer data)
+{
+    OperationBar* bar = (OperationBar*)data;
+    refresh_progress(bar);
+    return G_SOURCE_CONTINUE;
+}
+
+static void lock_editor(LongOperation* operation)
+{
+    OperationBar* bar = operation->bar;
+    if (operation->lock_id)
+    {
+        g_source_remove(operation->lock_id);
+        operation->lock_id = 0;
+    }
+    if (operation->locked)
+        return;
+
+    operation->locked = TRUE;
+    if (bar->lock_count++ == 0)
+    {
+        gtk_widget_set_sensitive(bar->app->ui->menu_bar, FALSE);
+        gtk_widget_set_sensitive(bar->app->ui->find_replace_bar, FALSE);
+        gtk_widget_set_sensitive(bar->app->ui->text_view, FALSE);
+    }
+}
+
+static void unlock_editor(LongOperation* operation)
+{
+    OperationBar* bar = operation->bar;
+    if (!operation->locked)
+        return;
+
+    operation->locked = FALSE;
+    if (--bar->lock_count == 0)
+    {
+        gtk_widget_set_sensitive(bar->app->ui->menu_bar, TRUE);
+        gtk_widget_set_sensitive(bar->app->ui->find_replace_bar, TRUE);
+        // 正在后台打开的文件载入完成之前仍不能编辑
+        if (!bar->app->load_cancellable)
+            gtk_widget_set_sensitive(bar->app->ui->text_view, TRUE);
+        gtk_widget_grab_focus(bar->app->ui->text_view);
+    }
+}
+
+// 高于输入事件的优先级：后台操作在处理下一个输入之前锁定，
+// 在主线程上一次完成的操作在此之前就已结束，编辑器不会闪烁
+static gboolean on_lock_editor(gpointer data)
+{
+    LongOperation* operation = (LongOperation*)data;
+    operation->lock_id = 0;
+    lock_editor(operation);
+    return G_SOURCE_REMOVE;
+}
+
+LongOperation* long_operation_begin(NotepadApp* app, const char* label, LongOperationFlags flags)
+{
+    OperationBar* bar = app->ui->operation_bar;
+    LongOperation* operation = g_new0(LongOperation, 1);
+    operation->bar = bar;
+    operation->label = g_strdup(label);
+    operation->flags = flags;
+    operation->cancellable = g_cancellable_new();
+    operation->permille = -1;
+    operation->last_pump = g_get_monotonic_time();
+
+    if (flags & LONG_OPERATION_LOCK_EDITOR)
+        operation->lock_id = g_idle_add_full(G_PRIORITY_HIGH, on_lock_editor, operation, NULL);
+
+    bar->operations = g_list_prepend(bar->operations, operation);
+    if (!bar->refresh_id)
+        bar->refresh_id = g_timeout_add(LONG_OPERATION_INTERVAL, on_refresh, bar);
+    return operation;
+}
+
+GCancellable* long_operation_get_cancellable(LongOperation* operation)
+{
+    return operation->cancellable;
+}
+
+void long_operation_report(LongOperation* operation, guint64 done, guint64 total)
+{
+    gint permille = total > 0 ? (gint)(MIN(done, total) * 1000 / total) : -1;
+    g_atomic_int_set(&operation->permille, permille);
+}
+
+gboolean long_operation_pump(LongOperation* operation, GError** error)
+{
+    gint64 now = g_get_monotonic_time();
+    if (now - operation->last_pump >= LONG_OPERATION_PUMP_INTERVAL * 1000)
+    {
+        // 处理事件期间不能让用户修改正在处理的内容
+        if (operation->flags & LONG_OPERATION_LOCK_EDITOR)
+            lock_editor(operation);
+        while (gtk_events_pending())
+            gtk_main_iteration_do(FALSE);
+        operation->last_pump = g_get_monotonic_time();
+    }
+    return !g_cancellable_set_error_if_cancelled(operation->cancellable, error);
+}
+
+// 退出之前必须等待结束的操作：不可取消的操作（例如原地保存）中途停下会留下写了一半的文件，
+// 锁定编辑器的操作取消后也要等它处理完当前的界面事件再返回
+static gboolean must_finish(LongOperation* operation)
+{
+    return !(operation->flags & LONG_OPERATION_CANCELLABLE) || (operation->flags & LONG_OPERATION_LOCK_EDITOR);
+}
+
+static gboolean operations_must_finish(OperationBar* bar)
+{
+    for (GList* l = bar->operations; l; l = l->next)
+        if (must_finish((LongOperation*)l->data))
+            return TRUE;
+    return FALSE;
+}
+
+static gboolean on_deferred_quit(gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+    if (notepad_prepare_quit(app))
+        gtk_main_quit();
+    return G_SOURCE_REMOVE;
+}
+
+void long_operation_end(LongOperation* operation, const char* message)
+{
+    OperationBar* bar = operation->bar;
+    unlock_editor(operation);
+    bar->operations = g_list_remove(bar->operations, operation);
+    operation_free(operation);
+
+    if (bar->operations)
+    {
+        refresh_progress(bar);
+    }
+    else
+    {
+        g_source_remove(bar->refresh_id);
+        bar->refresh_id = 0;
+        gtk_widget_hide(bar->progress_box);
+    }
+
+    if (message)
+        notepad_notify(bar->app, message);
+
+    // 在主循环回到顶层之后再退出，不在结束操作的调用者中间关闭窗口
+    if (bar->quit_pending && !operations_must_finish(bar))
+    {
+        bar->quit_pending = FALSE;
+        g_idle_add(on_deferred_quit, bar->app);
+    }
+}
+
+gboolean long_operation_defer_quit(NotepadApp* app)
+{
+    OperationBar* bar = app->ui->operation_bar;
+    for (GList* l = bar->operations; l; l = l->next)
+    {
+        LongOperation* operation = (LongOperation*)l->data;
+        if (operation->flags & LONG_OPERATION_CANCELLABLE)
+            g_cancellable_cancel(operation->cancellable);
+    }
+    bar->quit_pending = operations_must_finish(bar);
+    return bar->quit_pending;
+}
+
+gboolean long_operation_editor_locked(NotepadApp* app)
+{
+    return app->ui->operation_bar->lock_count > 0;
+}
+
+static gboolean on_notification_timeout(gpointer data)
+{
+    OperationBar* bar = (OperationBar*)data;
+    bar->notification_id = 0;
+    gtk_label_set_text(GTK_LABEL(bar->notification_label), "");
+    return G_SOURCE_REMOVE;
+}
+
+void notepad_notify(NotepadApp* app, const char* message)
+{
+    OperationBar* bar = app->ui->operation_bar;
+    gtk_label_set_text(GTK_LABEL(bar->notification_label), message);
+    if (bar->notification_id)
+        g_source_remove(bar->notification_id);
+    bar->notification_id = g_timeout_add_seconds(NOTIFICATION_TIMEOUT, on_notification_timeout, bar);
+}
@@ -0,0 +1,50 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef LONG_OPERATION_H
+#define LONG_OPERATION_H
+
+#include <gtk/gtk.h>
+#include "ui.h"
+
+#define LONG_OPERATION_INTERVAL      100    // 状态栏进度的刷新间隔（毫秒）
+#define LONG_OPERATION_PUMP_INTERVAL 40     // 在主线程上分段执行时处理界面事件的间隔（毫秒）
+#define NOTIFICATION_TIMEOUT         5      // 通知在状态栏上显示的时间（秒）
+
+typedef enum
+{
+    LONG_OPERATION_CANCELLABLE = 1 << 0,    // 显示取消按钮
+    LONG_OPERATION_LOCK_EDITOR = 1 << 1     // 期间禁止编辑和使用菜单，不超过一次界面事件处理就完成时不锁定
+} LongOperationFlags;
+
+// 耗时操作：每个操作有自己的 GCancellable，进度显示在状态栏上，
+// 同时进行多个操作时显示最近开始的一个。结束时可以在状态栏上显示一条通知
+typedef struct LongOperation LongOperation;
+typedef struct OperationBar OperationBar;
+
+extern GtkWidget* operation_bar_new(NotepadApp* app);   // 创建状态栏上的通知和进度区域
+extern void operation_bar_free(OperationBar* bar);       // 取消所有操作并释放
+
+extern LongOperation* long_operation_begin(NotepadApp* app, const char* label, LongOperationFlags flags);
+extern GCancellable* long_operation_get_cancellable(LongOperation* operation);
+
+// 报告进度，可在任意线程中调用。total 为 0 表示进度未知
+extern void long_operation_report(LongOperation* operation, guint64 done, guint64 total);
+
+// 在主线程上分段执行的操作在每段之间调用：按间隔处理界面事件（包括取消按钮），
+// 操作被取消时返回 FALSE 并设置 G_IO_ERROR_CANCELLED
+extern gboolean long_operation_pump(LongOperation* operation, GError** error);
+
+// 结束并释放操作，message 不为 NULL 时作为通知显示
+extern void long_operation_end(LongOperation* operation, const char* message);
+
+// 退出前取消所有可取消的操作。仍有不可取消或锁定编辑器的操作时返回 TRUE，
+// 这些操作全部结束后重新尝试退出
+extern gboolean long_operation_defer_quit(NotepadApp* app);
+extern gboolean long_operation_editor_locked(NotepadApp* app);
+
+// 在状态栏上显示一条不需要确认的通知
+extern void notepad_notify(NotepadApp* app, const char* message);
+
+#endif // LONG_OPERATION_H
@@ -1,11 +1,23 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <gtk/gtk.h>
 #include "notepad.h"
 #include "ui.h"
+#include "undo_stress.h"
+#include "batch.h"
+#include "save_bench.h"
 
 int main(int argc, char* argv[])
 {
+    // 批处理、撤销/重做压力测试和保存基准测试不需要显示，在初始化界面之前处理
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0)
+        return batch_run(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--undo-stress") == 0)
+        return undo_stress_run(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--save-bench") == 0)
+        return save_bench_run(argc - 2, argv + 2);
+
     puts("记事本程序已启动。");
     gtk_init(&argc, &argv);
 
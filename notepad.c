@@ -8,6 +8,13 @@
 #include <string.h>
 #include "file_operations.h"
 #include "output_exception.h"
+#include "text_search.h"
+#include "long_lines.h"
+#include "paste.h"
+#include "long_operation.h"
+#include "incremental_search.h"
+#include "perf_hud.h"
+#include "filter_view.h"
 
 // 构造函数
 NotepadApp* notepad_app_new(void)
@@ -17,29 +24,88 @@ NotepadApp* notepad_app_new(void)
     app->filename = NULL;
     app->is_modified = false;       // 使用标准bool
     app->is_saved = true;           // 使用标准bool
+    memset(&app->fingerprint, 0, sizeof(app->fingerprint));
+    app->checking_external_change = false;
+    app->nul_replaced = false;
+    app->content_generation = 0;
+    app->snapshot = NULL;
+    app->snapshot_generation = 0;
+    encoding_init_default(&app->encoding);
+    app->line_ending = LINE_ENDING_DEFAULT;
+    app->saved_line_ending = LINE_ENDING_DEFAULT;
+    app->load_cancellable = NULL;
+    app->open_line = 0;
+    settings_load(&app->settings);
+    app->autosave = autosave_new();
+    app->autosave_id = 0;
+    app->journal_generation = 0;
+    app->session = session_new();
 
     // 初始化UI属性
     app->ui->window = NULL;
+    app->ui->menu_bar = NULL;
     app->ui->text_view = NULL;
     app->ui->buffer = NULL;
     app->ui->status_bar = NULL;
     app->ui->cursor_label = NULL;
     app->ui->line_ending_label = NULL;
     app->ui->encoding_label = NULL;
+    app->ui->stats_label = NULL;
+    app->ui->long_line_label = NULL;
     app->ui->find_replace_bar = NULL;
     app->ui->find_entry = NULL;
     app->ui->replace_entry = NULL;
     app->ui->find_replace_visible = FALSE;
+    app->ui->search_cancellable = NULL;
+    app->ui->highlighter = NULL;
+    app->ui->highlight_item = NULL;
+    app->ui->long_line_item = NULL;
+    memset(app->ui->line_ending_items, 0, sizeof(app->ui->line_ending_items));
+    app->ui->updating_line_ending_menu = FALSE;
+    app->ui->find_in_files = NULL;
+    app->ui->relayout = NULL;
+    app->ui->font_cache = NULL;
+    app->ui->word_wrap_item = NULL;
+    app->ui->updating_word_wrap_item = FALSE;
+    app->ui->paste = NULL;
+    app->ui->operation_bar = NULL;
+    app->ui->incremental_search = NULL;
+    app->ui->perf_hud = NULL;
+    app->ui->filter_view = NULL;
+    app->ui->find_count_label = NULL;
 
     // 初始化撤销/重做相关字段
     app->ui->undo_stack = NULL;
     app->ui->redo_stack = NULL;
+    app->ui->undo_count = 0;
+    app->ui->redo_count = 0;
+    app->ui->undo_bytes = 0;
+    app->ui->redo_bytes = 0;
     app->ui->recording_changes = TRUE;
+    app->ui->undo_serial = 0;
+    app->ui->save_serial = 0;
+    app->ui->history_base = 0;
+
+    // 初始化文档统计
+    memset(&app->ui->stats, 0, sizeof(app->ui->stats));
+    app->ui->stats_pending = FALSE;
+    app->ui->stats_suspended = FALSE;
+    app->ui->stats_generation = 0;
+    app->ui->stats_update_id = 0;
+    app->ui->selection_stats_id = 0;
+    app->ui->selection_generation = 0;
+    app->ui->has_selection_stats = FALSE;
 
     // 初始化字体设置 - 设置支持中文的字体
     app->ui->primary_font = g_strdup("Microsoft YaHei 12");
     app->ui->fallback_font = g_strdup("SimSun 12");
 
+    // 初始化背景设置
+    app->ui->has_background_color = FALSE;
+    memset(&app->ui->background_color, 0, sizeof(app->ui->background_color));
+    app->ui->background_image = NULL;
+    app->ui->background_opacity = 1.0;
+
     return app;
 }
 
@@ -52,6 +118,21 @@ void notepad_app_free(NotepadApp* app)
         {
             free(app->filename);    // 使用标准free而非g_free
         }
+        if (app->snapshot)
+        {
+            g_bytes_unref(app->snapshot);
+        }
+        if (app->load_cancellable)
+        {
+            g_cancellable_cancel(app->load_cancellable);
+            g_object_unref(app->load_cancellable);
+        }
+        if (app->autosave_id)
+        {
+            g_source_remove(app->autosave_id);
+        }
+        autosave_free(app->autosave);   // 等待日志的写入和删除完成
+        session_free(app->session);     // 等待会话文件写入完成
         if (app->ui)
         {
             // 释放字体设置
@@ -63,6 +144,30 @@ void notepad_app_free(NotepadApp* app)
             {
                 g_free(app->ui->fallback_font);
             }
+            g_free(app->ui->background_image);
+
+            if (app->ui->stats_update_id)
+            {
+                g_source_remove(app->ui->stats_update_id);
+            }
+            if (app->ui->selection_stats_id)
+            {
+                g_source_remove(app->ui->selection_stats_id);
+            }
+            highlighter_free(app->ui->highlighter);
+            find_in_files_free(app->ui->find_in_files);
+            paste_free(app->ui->paste);
+            incremental_search_free(app->ui->incremental_search);
+            perf_hud_free(app->ui->perf_hud);
+            filter_view_free(app->ui->filter_view);
+            operation_bar_free(app->ui->operation_bar);
+            relayout_free(app->ui->relayout);
+            font_cache_free(app->ui->font_cache);
+            if (app->ui->search_cancellable)
+            {
+                g_cancellable_cancel(app->ui->search_cancellable);
+                g_object_unref(app->ui->search_cancellable);
+            }
 
             // 清理撤销/重做栈
             clear_undo_stack(&app->ui->undo_stack);
@@ -73,18 +178,70 @@ void notepad_app_free(NotepadApp* app)
     }
 }
 
+// 定期把未保存的内容写入自动保存日志
+static gboolean on_autosave_timer(gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+    if (app->is_modified && !app->load_cancellable && !app->ui->paste && app->journal_generation != app->content_generation)
+    {
+        GBytes* text = notepad_get_snapshot(app);
+        JournalState state = { app->fingerprint.valid ? app->fingerprint.hash : 0, FALSE, app->encoding, app->line_ending };
+        autosave_write(app->autosave, app->filename, text, &state);
+        g_bytes_unref(text);
+        app->journal_generation = app->content_generation;
+    }
+    session_save(app);
+    return G_SOURCE_CONTINUE;
+}
+
 void notepad_app_run(NotepadApp* app)
 {
     setup_main_window(app);
     gtk_widget_show_all(app->ui->window);
+
+    // 上次未命名文档没有保存就异常退出
+    GBytes* journal = autosave_recover(NULL, 0);
+    if (journal)
+    {
+        notepad_restore_journal(app, journal);
+        g_bytes_unref(journal);
+    }
+
+    // 恢复上次的会话；有未命名文档的日志时不再打开上次的文档，以免覆盖恢复的内容
+    session_restore(app, journal == NULL);
+    app->autosave_id = g_timeout_add_seconds(AUTOSAVE_INTERVAL, on_autosave_timer, app);
+
     gtk_main();
 }
 
+void notepad_restore_journal(NotepadApp* app, GBytes* text)
+{
+    if (!show_confirm_dialog(GTK_WINDOW(app->ui->window), "恢复未保存的内容",
+                             "发现上次异常退出前自动保存的内容。是否恢复？\n选择“否”将删除这些内容。"))
+    {
+        autosave_discard(app->autosave, app->filename);
+        return;
+    }
+
+    // 作为一次普通修改载入，可以撤销回磁盘上的版本
+    paste_finish(app);
+    gsize length;
+    const gchar* content = g_bytes_get_data(text, &length);
+    app->ui->stats_suspended = TRUE;
+    gtk_text_buffer_set_text(app->ui->buffer, content, (gint)length);
+    app->ui->stats_suspended = FALSE;
+    notepad_collapse_long_lines(app, content, length);
+    notepad_rebuild_stats(app, text);
+    update_cursor_position(app);
+}
+
 void notepad_set_modified(NotepadApp* app, bool modified)
 {
     app->is_modified = modified;
 
-    // 更新状态栏和窗口标题
+    // 更新状态栏和窗口标题，命令行模式下没有窗口
+    if (!app->ui->window)
+        return;
     const gchar* current_title = gtk_window_get_title(GTK_WINDOW(app->ui->window));
     gchar* new_title;
 
@@ -102,6 +259,37 @@ void notepad_set_modified(NotepadApp* app, bool modified)
     }
 }
 
+// 撤销栈顶的编号即为当前内容在撤销历史中的位置
+static guint64 undo_position(NotepadApp* app)
+{
+    return app->ui->undo_stack ? app->ui->undo_stack->serial : 0;
+}
+
+void notepad_mark_saved(NotepadApp* app)
+{
+    app->ui->save_serial = undo_position(app);
+    app->saved_line_ending = app->line_ending;
+    notepad_set_modified(app, false);
+}
+
+bool notepad_at_save_point(NotepadApp* app)
+{
+    return undo_position(app) == app->ui->save_serial && app->line_ending == app->saved_line_ending;
+}
+
+void notepad_update_modified(NotepadApp* app)
+{
+    bool modified = !notepad_at_save_point(app);
+    if (modified != app->is_modified)
+        notepad_set_modified(app, modified);
+}
+
+void notepad_discard_save_point(NotepadApp* app)
+{
+    app->ui->save_serial = G_MAXUINT64;
+    notepad_set_modified(app, true);
+}
+
 bool notepad_check_save_changes(NotepadApp* app)
 {
     if (!app->is_modified)
@@ -128,15 +316,10 @@ bool notepad_check_save_changes(NotepadApp* app)
             // 用户选择保存
             if (app->filename)
             {
-                GtkTextIter start, end;
-                gtk_text_buffer_get_bounds(app->ui->buffer, &start, &end);
-                gchar* text = gtk_text_buffer_get_text(app->ui->buffer, &start, &end, FALSE);
-                gboolean saved = g_file_set_contents(app->filename, text, -1, NULL);
-                g_free(text);
-
+                gboolean saved = notepad_write_file(app, app->filename, NULL);
                 if (saved)
                 {
-                    notepad_set_modified(app, false);  // 使用标准bool
+                    notepad_mark_saved(app);
                     return true; // 保存成功
                 }
                 gtk_widget_show_all(app->ui->window); // 显示错误信息
@@ -149,6 +332,7 @@ bool notepad_check_save_changes(NotepadApp* app)
                 return !app->is_modified;
             }
         case GTK_RESPONSE_NO:
+            autosave_discard(app->autosave, app->filename);
             return true; // 不保存，直接返回
         case GTK_RESPONSE_CANCEL:
         default:
@@ -156,6 +340,39 @@ bool notepad_check_save_changes(NotepadApp* app)
     }
 }
 
+bool notepad_prepare_quit(NotepadApp* app)
+{
+    // 原地保存等不能中断的操作进行期间不退出，等它们结束后再关闭
+    if (long_operation_defer_quit(app))
+        return false;
+    if (!notepad_check_save_changes(app))
+        return false;
+    session_save(app);
+    return true;
+}
+
+void notepad_apply_word_wrap(NotepadApp* app, gsize length)
+{
+    gboolean wrap = app->settings.word_wrap && (gint64)length <= app->settings.wrap_size_limit;
+
+    // 只同步菜单和换行标签，不改变用户的默认设置
+    app->ui->updating_word_wrap_item = TRUE;
+    gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(app->ui->word_wrap_item), wrap);
+    app->ui->updating_word_wrap_item = FALSE;
+    relayout_set_wrap(app->ui->relayout, wrap);
+}
+
+void notepad_goto_line(NotepadApp* app, gint line)
+{
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_line(app->ui->buffer, &iter, MAX(line, 1) - 1);
+    gtk_text_buffer_place_cursor(app->ui->buffer, &iter);
+
+    // 刚载入的文本可能还没有完成布局，滚动到标记会在布局完成后生效
+    gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(app->ui->text_view), gtk_text_buffer_get_insert(app->ui->buffer),
+                                 0.0, TRUE, 0.0, 0.3);
+}
+
 void update_cursor_position(NotepadApp* app)
 {
     if (!app->ui->cursor_label)
@@ -178,64 +395,276 @@ void update_line_ending_type(NotepadApp* app)
     if (!app->ui->line_ending_label)
         return;
 
-    // 获取文本内容分析行分隔符
+    // 行分隔符在载入时已检测并记录，缓冲区内部统一为 \n
+    gtk_label_set_text(GTK_LABEL(app->ui->line_ending_label), line_ending_name(app->line_ending));
+
+    // 同步菜单中的选中项，不触发切换回调
+    GtkWidget* item = app->ui->line_ending_items[app->line_ending];
+    if (item && !gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(item)))
+    {
+        app->ui->updating_line_ending_menu = TRUE;
+        gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(item), TRUE);
+        app->ui->updating_line_ending_menu = FALSE;
+    }
+}
+
+void update_encoding_type(NotepadApp* app)
+{
+    if (!app->ui->encoding_label)
+        return;
+
+    // 编码在打开文件时已检测并记录，这里不再重新读取文件
+    gchar* encoding = encoding_display_name(&app->encoding);
+    gtk_label_set_text(GTK_LABEL(app->ui->encoding_label), encoding);
+    g_free(encoding);
+}
+
+void update_highlight_language(NotepadApp* app)
+{
+    if (!app->ui->highlighter)
+        return;
+
+    gboolean enabled = !app->ui->highlight_item ||
+                       gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(app->ui->highlight_item));
+    highlighter_set_language(app->ui->highlighter,
+                             enabled ? highlight_language_for_file(app->filename) : HIGHLIGHT_NONE);
+}
+
+void update_long_line_status(NotepadApp* app)
+{
+    if (!app->ui->long_line_label)
+        return;
+
+    gint collapsed = long_lines_count_collapsed(app->ui->buffer);
+    if (collapsed > 0)
+    {
+        gchar* text = g_strdup_printf("已折叠 %d 个超长行", collapsed);
+        gtk_label_set_text(GTK_LABEL(app->ui->long_line_label), text);
+        gtk_widget_show(app->ui->long_line_label);
+        g_free(text);
+    }
+    else
+    {
+        gtk_widget_hide(app->ui->long_line_label);
+    }
+}
+
+gboolean notepad_long_line_protection(NotepadApp* app)
+{
+    return !app->ui->long_line_item ||
+           gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(app->ui->long_line_item));
+}
+
+// content 为刚载入缓冲区的内容，按字节扫描即可定位超长行
+void notepad_collapse_long_lines(NotepadApp* app, const char* content, gsize length)
+{
+    if (notepad_long_line_protection(app))
+        long_lines_collapse_text(app->ui->buffer, content, length);
+    update_long_line_status(app);
+}
+
+// 快照按内容版本缓存，连续多次查找不会重复复制整个文档
+GBytes* notepad_get_snapshot(NotepadApp* app)
+{
+    if (app->snapshot && app->snapshot_generation == app->content_generation)
+        return g_bytes_ref(app->snapshot);
+
+    if (app->snapshot)
+        g_bytes_unref(app->snapshot);
+
     GtkTextIter start, end;
     gtk_text_buffer_get_bounds(app->ui->buffer, &start, &end);
-    gchar* text = gtk_text_buffer_get_text(app->ui->buffer, &start, &end, FALSE);
+    gchar* text = gtk_text_buffer_get_text(app->ui->buffer, &start, &end, TRUE);
+
+    app->snapshot = g_bytes_new_take(text, strlen(text));
+    app->snapshot_generation = app->content_generation;
+    return g_bytes_ref(app->snapshot);
+}
+
+// 后台统计任务
+typedef struct StatsJob
+{
+    NotepadApp* app;
+    GBytes* text;
+    guint generation;       // 发起时的 stats_generation，统计选区时为 selection_generation
+    gboolean selection;     // 统计的是选区而不是整个文档
+    gsize start;            // 选区的字符偏移
+    gsize end;
+    DocStats result;
+} StatsJob;
+
+void update_document_stats(NotepadApp* app)
+{
+    if (!app->ui->stats_label)
+        return;
 
-    const gchar* line_ending = "CRLF";  // 默认值
+    GString* text = g_string_new(NULL);
+    if (app->ui->has_selection_stats)
+    {
+        g_string_append_printf(text, "选中: %" G_GINT64_FORMAT " 字符, %" G_GINT64_FORMAT " 词 | ",
+                               app->ui->selection_stats.chars, app->ui->selection_stats.words);
+    }
 
-    if (text && strlen(text) > 0)
+    if (app->ui->stats_pending)
+    {
+        g_string_append(text, "正在统计...");
+    }
+    else
     {
-        if (strstr(text, "\r\n"))
-            line_ending = "CRLF";  // Windows
-        else if (strstr(text, "\n"))
-            line_ending = "LF";    // Unix/Linux
-        else if (strstr(text, "\r"))
-            line_ending = "CR";    // Mac (经典)
+        g_string_append_printf(text, "字符: %d  词: %" G_GINT64_FORMAT "  行: %d  字节: %" G_GINT64_FORMAT
+                               "  中日韩: %" G_GINT64_FORMAT,
+                               gtk_text_buffer_get_char_count(app->ui->buffer),
+                               app->ui->stats.words,
+                               gtk_text_buffer_get_line_count(app->ui->buffer),
+                               app->ui->stats.bytes,
+                               app->ui->stats.cjk);
+    }
+
+    gtk_label_set_text(GTK_LABEL(app->ui->stats_label), text->str);
+    g_string_free(text, TRUE);
+}
+
+static gboolean stats_update_idle(gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+    app->ui->stats_update_id = 0;
+    update_document_stats(app);
+    return G_SOURCE_REMOVE;
+}
+
+// 连续输入时合并为一次刷新
+void notepad_schedule_stats_update(NotepadApp* app)
+{
+    if (!app->ui->stats_update_id)
+        app->ui->stats_update_id = g_idle_add(stats_update_idle, app);
+}
+
+static void stats_job_thread(GTask* task, gpointer source, gpointer task_data, GCancellable* cancellable)
+{
+    StatsJob* job = (StatsJob*)task_data;
+    gsize length;
+    const char* text = (const char*)g_bytes_get_data(job->text, &length);
+
+    if (job->selection)
+    {
+        gsize from = text_search_byte_offset(text, length, job->start);
+        gsize to = from + text_search_byte_offset(text + from, length - from, job->end - job->start);
+        doc_stats_count(text + from, to - from, &job->result);
+    }
+    else
+    {
+        doc_stats_count(text, length, &job->result);
+    }
+    g_task_return_boolean(task, TRUE);
+}
+
+static void stats_job_done(GObject* source, GAsyncResult* result, gpointer data)
+{
+    StatsJob* job = (StatsJob*)data;
+    NotepadApp* app = job->app;
+
+    guint current = job->selection ? app->ui->selection_generation : app->ui->stats_generation;
+    if (job->generation == current)
+    {
+        if (job->selection)
+        {
+            app->ui->selection_stats = job->result;
+            app->ui->has_selection_stats = TRUE;
+        }
         else
-            line_ending = "[unknown]";
+        {
+            // 统计期间的编辑已经以增量形式累加，这里再加上快照的基数
+            doc_stats_add(&app->ui->stats, &job->result, 1);
+            app->ui->stats_pending = FALSE;
+        }
+        update_document_stats(app);
     }
 
-    gtk_label_set_text(GTK_LABEL(app->ui->line_ending_label), line_ending);
-    g_free(text);
+    g_bytes_unref(job->text);
+    g_free(job);
 }
 
-void update_encoding_type(NotepadApp* app)
+static void start_stats_job(NotepadApp* app, GBytes* text, gboolean selection, gsize start, gsize end)
 {
-    if (!app->ui->encoding_label)
-        return;
+    StatsJob* job = g_new0(StatsJob, 1);
+    job->app = app;
+    job->text = g_bytes_ref(text);
+    job->generation = selection ? app->ui->selection_generation : app->ui->stats_generation;
+    job->selection = selection;
+    job->start = start;
+    job->end = end;
 
-    // 检测当前文件的字符编码
-    const gchar* encoding = "UTF-8";  // 默认编码
+    GTask* task = g_task_new(NULL, NULL, stats_job_done, job);
+    g_task_set_task_data(task, job, NULL);
+    g_task_run_in_thread(task, stats_job_thread);
+    g_object_unref(task);
+}
+
+// text 为当前缓冲区的完整内容；为 NULL 表示文档为空
+void notepad_rebuild_stats(NotepadApp* app, GBytes* text)
+{
+    memset(&app->ui->stats, 0, sizeof(app->ui->stats));
+    app->ui->stats_generation++;
+    app->ui->selection_generation++;
+    app->ui->has_selection_stats = FALSE;
 
-    if (app->filename)
+    if (text && g_bytes_get_size(text) > 0)
+    {
+        app->ui->stats_pending = TRUE;
+        start_stats_job(app, text, FALSE, 0, 0);
+    }
+    else
     {
-        // 简单的编码检测，实际项目中可能需要更复杂的检测逻辑
-        gchar* content;
-        gsize length;
-        if (g_file_get_contents(app->filename, &content, &length, NULL))
+        app->ui->stats_pending = FALSE;
+    }
+    update_document_stats(app);
+}
+
+// 选区较小时直接统计，较大时在后台对快照统计
+#define SELECTION_STATS_SYNC_LIMIT (1024 * 1024)
+
+static gboolean selection_stats_timeout(gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+    app->ui->selection_stats_id = 0;
+
+    // 之前发起的后台选区统计不论结果如何都已过期
+    app->ui->selection_generation++;
+
+    GtkTextIter start, end;
+    if (!gtk_text_buffer_get_selection_bounds(app->ui->buffer, &start, &end))
+    {
+        if (app->ui->has_selection_stats)
         {
-            // 检查UTF-8 BOM
-            if (length >= 3 &&
-                (guchar)content[0] == 0xEF &&
-                (guchar)content[1] == 0xBB &&
-                (guchar)content[2] == 0xBF)
-            {
-                encoding = "UTF-8 BOM";
-            }
-            else if (g_utf8_validate(content, (gssize)length, NULL))
-            {
-                encoding = "UTF-8";
-            }
-            else
-            {
-                // 简单判断，可能是其他编码
-                encoding = "ANSI";
-            }
-            g_free(content);
+            app->ui->has_selection_stats = FALSE;
+            update_document_stats(app);
         }
+        return G_SOURCE_REMOVE;
     }
 
-    gtk_label_set_text(GTK_LABEL(app->ui->encoding_label), encoding);
+    gint start_offset = gtk_text_iter_get_offset(&start);
+    gint end_offset = gtk_text_iter_get_offset(&end);
+    if (end_offset - start_offset <= SELECTION_STATS_SYNC_LIMIT)
+    {
+        gchar* text = gtk_text_buffer_get_text(app->ui->buffer, &start, &end, TRUE);
+        doc_stats_count(text, strlen(text), &app->ui->selection_stats);
+        app->ui->has_selection_stats = TRUE;
+        g_free(text);
+        update_document_stats(app);
+    }
+    else
+    {
+        GBytes* snapshot = notepad_get_snapshot(app);
+        start_stats_job(app, snapshot, TRUE, (gsize)start_offset, (gsize)end_offset);
+        g_bytes_unref(snapshot);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+void notepad_schedule_selection_stats(NotepadApp* app)
+{
+    if (app->ui->selection_stats_id)
+        g_source_remove(app->ui->selection_stats_id);
+    app->ui->selection_stats_id = g_timeout_add(150, selection_stats_timeout, app);
 }
@@ -8,6 +8,11 @@
 
 #include <stdbool.h>
 #include "ui.h"
+#include "fingerprint.h"
+#include "encoding.h"
+#include "settings.h"
+#include "autosave.h"
+#include "session.h"
 
 typedef struct NotepadApp
 {
@@ -15,15 +20,48 @@ typedef struct NotepadApp
     char* filename;         // 使用标准char*
     bool is_modified;       // 使用标准bool
     bool is_saved;          // 使用标准bool
+    FileFingerprint fingerprint;    // 打开/保存时记录的文件指纹，用于检测外部修改
+    bool checking_external_change;  // 正在检查外部修改（防止对话框引起的焦点事件重入）
+    guint content_generation;       // 文档内容版本，每次修改递增
+    GBytes* snapshot;               // 缓存的只读文本快照，供后台线程使用
+    guint snapshot_generation;      // 快照对应的内容版本
+    TextEncoding encoding;          // 文件的字符编码，保存时按原编码写回
+    bool nul_replaced;              // 按文本打开的二进制文件，NUL 已显示为 U+FFFD，写回原文件前需要确认
+    LineEnding line_ending;         // 保存时使用的行分隔符（缓冲区内部只用 \n）
+    LineEnding saved_line_ending;   // 保存点对应的行分隔符
+    GCancellable* load_cancellable; // 正在后台打开的文件
+    gint open_line;                 // 打开完成后跳转到的行（从 1 开始），0 表示不跳转
+    NotepadSettings settings;       // 用户设置
+    Autosave* autosave;             // 自动保存日志
+    guint autosave_id;              // 自动保存定时器
+    guint journal_generation;       // 最近一次写入日志的内容版本
+    Session* session;               // 会话的保存和恢复
 } NotepadApp;
 
 extern NotepadApp* notepad_app_new(void); // 创建 NotepadApp 实例
 extern void notepad_app_free(NotepadApp* app); // 释放 NotepadApp 实例
 extern void notepad_app_run(NotepadApp* app); // 运行 Notepad 应用
 extern void notepad_set_modified(NotepadApp* app, bool modified); // 设置修改状态
+extern void notepad_mark_saved(NotepadApp* app);               // 以当前撤销位置为保存点，并设为未修改
+extern bool notepad_at_save_point(NotepadApp* app);            // 内容是否与保存点相同
+extern void notepad_update_modified(NotepadApp* app);          // 按保存点重新计算修改状态
+extern void notepad_discard_save_point(NotepadApp* app);       // 发生了不可撤销的修改，保存点失效
+extern void notepad_restore_journal(NotepadApp* app, GBytes* text); // 询问是否恢复自动保存日志中的内容
 extern bool notepad_check_save_changes(NotepadApp* app); // 检查并提示保存
+extern bool notepad_prepare_quit(NotepadApp* app);       // 退出前取消后台操作、提示保存并写入会话，返回 false 时不退出
 extern void update_cursor_position(NotepadApp* app);           // 更新光标位置
+extern void notepad_goto_line(NotepadApp* app, gint line);     // 移动光标到指定行（从 1 开始）
+extern void notepad_apply_word_wrap(NotepadApp* app, gsize length); // 按设置和文档大小决定是否自动换行
 extern void update_line_ending_type(NotepadApp* app);          // 更新行分隔符类型
 extern void update_encoding_type(NotepadApp* app);             // 更新字符集类型
+extern void update_highlight_language(NotepadApp* app);        // 按文件名切换高亮语言
+extern void update_long_line_status(NotepadApp* app);          // 更新超长行折叠状态
+extern gboolean notepad_long_line_protection(NotepadApp* app); // 是否启用长行保护
+extern void notepad_collapse_long_lines(NotepadApp* app, const char* content, gsize length); // 折叠载入内容中的超长行
+extern GBytes* notepad_get_snapshot(NotepadApp* app);          // 获取当前文档的只读快照
+extern void update_document_stats(NotepadApp* app);            // 更新文档统计信息
+extern void notepad_schedule_stats_update(NotepadApp* app);    // 空闲时更新文档统计信息
+extern void notepad_rebuild_stats(NotepadApp* app, GBytes* text); // 后台重新统计整个文档
+extern void notepad_schedule_selection_stats(NotepadApp* app); // 延迟统计选区
 
 #endif // NOTEPAD_H
@@ -0,0 +1,222 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "paste.h"
+#include "notepad.h"
+#include "long_lines.h"
+#include "long_operation.h"
+#include <string.h>
+
+struct PasteJob
+{
+    NotepadApp* app;
+    GBytes* text;           // 规范化后的全部内容，完成后由撤销记录继续持有
+    gsize inserted;         // 已插入的字节数
+    GtkTextMark* mark;      // 下一块的插入位置（右重力，随插入后移）
+    GtkTextMark* start;     // 插入起点（左重力），完成时才取偏移，期间其他修改不会使它失效
+    guint idle_id;
+    LongOperation* operation;   // 状态栏进度，插入不可取消
+};
+
+// 从 offset 开始取一块：尽量在换行之后断开，单行过长时在字符边界断开
+static gsize next_chunk_length(const gchar* text, gsize length, gsize offset)
+{
+    gsize remaining = length - offset;
+    if (remaining <= PASTE_CHUNK_SIZE)
+        return remaining;
+
+    const gchar* start = text + offset;
+    const gchar* end = start + PASTE_CHUNK_SIZE;
+    for (const gchar* p = end; p > start; p--)
+    {
+        if (p[-1] == '\n')
+            return (gsize)(p - start);
+    }
+
+    while (end > start && ((guchar)*end & 0xC0) == 0x80)
+        end--;
+    return (gsize)(end - start);
+}
+
+static void insert_chunk(PasteJob* job)
+{
+    NotepadApp* app = job->app;
+    gsize length;
+    const gchar* text = g_bytes_get_data(job->text, &length);
+    gsize chunk = next_chunk_length(text, length, job->inserted);
+
+    // 每块不单独记录撤销，统计和高亮照常增量更新
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_mark(app->ui->buffer, &iter, job->mark);
+    app->ui->recording_changes = FALSE;
+    gtk_text_buffer_insert(app->ui->buffer, &iter, text + job->inserted, (gint)chunk);
+    app->ui->recording_changes = TRUE;
+    job->inserted += chunk;
+    long_operation_report(job->operation, job->inserted, length);
+}
+
+static gboolean paste_done(PasteJob* job)
+{
+    return job->inserted >= g_bytes_get_size(job->text);
+}
+
+static void paste_complete(PasteJob* job)
+{
+    NotepadApp* app = job->app;
+    GtkTextBuffer* buffer = app->ui->buffer;
+    app->ui->paste = NULL;
+
+    // 整个粘贴只占一条撤销记录，直接引用粘贴的内容
+    GtkTextIter start, end;
+    gtk_text_buffer_get_iter_at_mark(buffer, &start, job->start);
+    push_undo_action_bytes(app, UNDO_DELETE, gtk_text_iter_get_offset(&start), job->text);
+
+    gtk_text_buffer_get_iter_at_mark(buffer, &end, job->mark);
+    gtk_text_buffer_place_cursor(buffer, &end);
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(app->ui->text_view), TRUE);
+    gtk_text_view_scroll_mark_onscreen(GTK_TEXT_VIEW(app->ui->text_view), gtk_text_buffer_get_insert(buffer));
+
+    // 分块期间跳过了超长行检查，完成后对整个粘贴范围统一折叠
+    gsize length;
+    const gchar* text = g_bytes_get_data(job->text, &length);
+    if (notepad_long_line_protection(app) && long_lines_detect(text, length) &&
+        long_lines_collapse(buffer, gtk_text_iter_get_line(&start), gtk_text_iter_get_line(&end)) > 0)
+        update_long_line_status(app);
+
+    notepad_update_modified(app);
+    long_operation_end(job->operation, NULL);
+    gtk_text_buffer_delete_mark(buffer, job->mark);
+    gtk_text_buffer_delete_mark(buffer, job->start);
+    g_bytes_unref(job->text);
+    g_free(job);
+}
+
+static gboolean paste_slice(gpointer data)
+{
+    PasteJob* job = (PasteJob*)data;
+    gint64 deadline = g_get_monotonic_time() + PASTE_SLICE_BUDGET * 1000;
+
+    do
+        insert_chunk(job);
+    while (!paste_done(job) && g_get_monotonic_time() < deadline);
+
+    if (!paste_done(job))
+        return G_SOURCE_CONTINUE;
+
+    job->idle_id = 0;
+    paste_complete(job);
+    return G_SOURCE_REMOVE;
+}
+
+// text 由粘贴任务接管，是粘贴内容唯一的副本
+static void paste_start(NotepadApp* app, GtkTextIter* location, gchar* text, gsize length)
+{
+    GtkTextBuffer* buffer = app->ui->buffer;
+
+    // 先统一换行符，分块边界不会把 \r\n 拆开
+    line_ending_normalize(text, &length, app->line_ending);
+
+    PasteJob* job = g_new0(PasteJob, 1);
+    job->app = app;
+    job->text = g_bytes_new_take(text, length);
+    job->mark = gtk_text_buffer_create_mark(buffer, NULL, location, FALSE);
+    job->start = gtk_text_buffer_create_mark(buffer, NULL, location, TRUE);
+    job->operation = long_operation_begin(app, "正在粘贴", 0);
+    app->ui->paste = job;
+
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(app->ui->text_view), FALSE);
+    insert_chunk(job);
+    job->idle_id = g_idle_add(paste_slice, job);
+}
+
+static void on_clipboard_text(GtkClipboard* clipboard, const gchar* text, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+    if (!text || app->ui->paste || !gtk_text_view_get_editable(GTK_TEXT_VIEW(app->ui->text_view)))
+        return;
+
+    GtkTextBuffer* buffer = app->ui->buffer;
+    gsize length = strlen(text);
+
+    // 与文本视图默认的粘贴一样先替换选区
+    gtk_text_buffer_begin_user_action(buffer);
+    gtk_text_buffer_delete_selection(buffer, TRUE, TRUE);
+    if (length < PASTE_CHUNK_THRESHOLD)
+    {
+        gtk_text_buffer_insert_interactive_at_cursor(buffer, text, (gint)length, TRUE);
+        gtk_text_buffer_end_user_action(buffer);
+        gtk_text_view_scroll_mark_onscreen(GTK_TEXT_VIEW(app->ui->text_view), gtk_text_buffer_get_insert(buffer));
+        return;
+    }
+    gtk_text_buffer_end_user_action(buffer);
+
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_mark(buffer, &iter, gtk_text_buffer_get_insert(buffer));
+    paste_start(app, &iter, g_strndup(text, length), length);
+}
+
+void on_paste_clipboard(GtkTextView* view, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+
+    // 默认的粘贴把整个剪贴板内容一次插入，改为先取得文本再决定是否分块
+    g_signal_stop_emission_by_name(view, "paste-clipboard");
+    if (app->ui->paste)
+    {
+        gtk_widget_error_bell(GTK_WIDGET(view));
+        return;
+    }
+
+    GtkClipboard* clipboard = gtk_widget_get_clipboard(GTK_WIDGET(view), GDK_SELECTION_CLIPBOARD);
+    gtk_clipboard_request_text(clipboard, on_clipboard_text, app);
+}
+
+void on_drag_data_received(GtkWidget* widget, GdkDragContext* context, gint x, gint y,
+                           GtkSelectionData* selection, guint info, guint time, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+
+    // 小段文本和文本视图内部的移动仍由默认处理完成
+    if (!app->ui->paste &&
+        (gtk_selection_data_get_length(selection) < PASTE_CHUNK_THRESHOLD || gtk_drag_get_source_widget(context) == widget))
+        return;
+
+    g_signal_stop_emission_by_name(widget, "drag-data-received");
+    gchar* text = app->ui->paste ? NULL : (gchar*)gtk_selection_data_get_text(selection);
+    if (!text)
+    {
+        gtk_drag_finish(context, FALSE, FALSE, time);
+        return;
+    }
+
+    GtkTextIter iter;
+    gint buffer_x, buffer_y;
+    gtk_text_view_window_to_buffer_coords(GTK_TEXT_VIEW(widget), GTK_TEXT_WINDOW_WIDGET, x, y, &buffer_x, &buffer_y);
+    gtk_text_view_get_iter_at_location(GTK_TEXT_VIEW(widget), &iter, buffer_x, buffer_y);
+    paste_start(app, &iter, text, strlen(text));
+    gtk_drag_finish(context, TRUE, FALSE, time);
+}
+
+void paste_finish(NotepadApp* app)
+{
+    PasteJob* job = app->ui->paste;
+    if (!job)
+        return;
+
+    g_source_remove(job->idle_id);
+    job->idle_id = 0;
+    while (!paste_done(job))
+        insert_chunk(job);
+    paste_complete(job);
+}
+
+void paste_free(PasteJob* job)
+{
+    if (!job)
+        return;
+    if (job->idle_id)
+        g_source_remove(job->idle_id);
+    g_bytes_unref(job->text);
+    g_free(job);
+}
@@ -0,0 +1,27 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef PASTE_H
+#define PASTE_H
+
+#include <gtk/gtk.h>
+#include "ui.h"
+
+#define PASTE_CHUNK_THRESHOLD (1024 * 1024)     // 超过该字节数的粘贴和拖放分块插入
+#define PASTE_CHUNK_SIZE      (256 * 1024)      // 每块最多插入的字节数
+#define PASTE_SLICE_BUDGET    8                 // 每次空闲回调插入的时间预算（毫秒）
+
+// 大段粘贴：内容只复制一次，在空闲时分块插入，完成后作为一条撤销记录，
+// 撤销记录与粘贴任务共用同一份 GBytes。插入期间文本视图只读
+typedef struct PasteJob PasteJob;
+
+extern void on_paste_clipboard(GtkTextView* view, gpointer data);     // 接管文本视图的粘贴
+extern void on_drag_data_received(GtkWidget* widget, GdkDragContext* context, gint x, gint y,
+                                  GtkSelectionData* selection, guint info, guint time, gpointer data);
+
+// 立即插入尚未插入的部分。撤销、保存、载入等需要完整缓冲区的操作之前调用
+extern void paste_finish(NotepadApp* app);
+extern void paste_free(PasteJob* job);  // 放弃未完成的插入（程序退出时）
+
+#endif // PASTE_H
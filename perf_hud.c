@@ -0,0 +1,235 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "perf_hud.h"
+#include <stdlib.h>
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+
+struct PerfHud
+{
+    NotepadApp* app;
+    GtkWidget* label;
+    guint refresh_id;
+    gint64 timings[PERF_TIMING_COUNT];  // 最近一次的耗时（微秒），-1 表示尚未发生
+
+    // 帧耗时：每帧从 before-paint 到 after-paint（更新、布局和绘制），每次刷新后清零。
+    // 只统计文本视图重绘过的帧，面板自己更新标签引起的帧不计入
+    GdkFrameClock* frame_clock;
+    gulong before_paint_id;
+    gulong after_paint_id;
+    GtkWidget* view;
+    gulong draw_id;
+    gint64 frame_start;
+    gboolean view_drawn;
+    guint frames;
+    gint64 frame_total;
+    gint64 frame_max;
+};
+
+static const char* timing_names[PERF_TIMING_COUNT] = { "打开", "保存", "查找" };
+
+// 进程常驻内存（字节），无法获取时返回 -1
+static gint64 resident_bytes(void)
+{
+    gint64 result = -1;
+#ifdef G_OS_UNIX
+    gchar* contents;
+    if (g_file_get_contents("/proc/self/statm", &contents, NULL, NULL))
+    {
+        gchar** fields = g_strsplit(contents, " ", 3);
+        if (fields[0] && fields[1])
+            result = g_ascii_strtoll(fields[1], NULL, 10) * sysconf(_SC_PAGESIZE);
+        g_strfreev(fields);
+        g_free(contents);
+    }
+#endif
+    return result;
+}
+
+static void append_size(GString* text, const char* name, gint64 bytes)
+{
+    gchar* size = g_format_size((guint64)bytes);
+    g_string_append_printf(text, "%s %s", name, size);
+    g_free(size);
+}
+
+static void append_duration(GString* text, gint64 microseconds)
+{
+    if (microseconds < 0)
+        g_string_append(text, "-");
+    else if (microseconds < 10 * G_TIME_SPAN_MILLISECOND)
+        g_string_append_printf(text, "%.1f ms", microseconds / 1000.0);
+    else if (microseconds < G_TIME_SPAN_SECOND)
+        g_string_append_printf(text, "%d ms", (gint)(microseconds / 1000));
+    else
+        g_string_append_printf(text, "%.2f s", microseconds / 1e6);
+}
+
+static void refresh(PerfHud* hud)
+{
+    NotepadApp* app = hud->app;
+    GString* text = g_string_new(NULL);
+
+    append_size(text, "文档", app->ui->stats.bytes);
+
+    // 撤销占用取自入栈出栈时维护的计数，不遍历历史
+    g_string_append_printf(text, "  |  撤销 %u 项 / 重做 %u 项，", app->ui->undo_count, app->ui->redo_count);
+    append_size(text, "", (gint64)(app->ui->undo_bytes + app->ui->redo_bytes));
+
+    gint64 resident = resident_bytes();
+    g_string_append(text, "  |  ");
+    if (resident >= 0)
+        append_size(text, "内存", resident);
+    else
+        g_string_append(text, "内存 -");
+
+    for (gint i = 0; i < PERF_TIMING_COUNT; i++)
+    {
+        g_string_append_printf(text, "  |  %s ", timing_names[i]);
+        append_duration(text, hud->timings[i]);
+    }
+
+    // 帧率按刷新间隔折算，文本视图没有重绘时为空闲
+    g_string_append(text, "  |  帧 ");
+    if (hud->frames == 0)
+    {
+        g_string_append(text, "空闲");
+    }
+    else
+    {
+        g_string_append_printf(text, "%u/s 平均 ", hud->frames * 1000 / PERF_HUD_INTERVAL);
+        append_duration(text, hud->frame_total / hud->frames);
+        g_string_append(text, " 最长 ");
+        append_duration(text, hud->frame_max);
+    }
+    hud->frames = 0;
+    hud->frame_total = 0;
+    hud->frame_max = 0;
+
+    gtk_label_set_text(GTK_LABEL(hud->label), text->str);
+    g_string_free(text, TRUE);
+}
+
+static gboolean on_refresh(gpointer data)
+{
+    refresh((PerfHud*)data);
+    return G_SOURCE_CONTINUE;
+}
+
+static void on_before_paint(GdkFrameClock* clock, gpointer data)
+{
+    PerfHud* hud = (PerfHud*)data;
+    hud->frame_start = g_get_monotonic_time();
+    hud->view_drawn = FALSE;
+}
+
+static gboolean on_view_draw(GtkWidget* widget, cairo_t* cr, gpointer data)
+{
+    ((PerfHud*)data)->view_drawn = TRUE;
+    return FALSE;
+}
+
+static void on_after_paint(GdkFrameClock* clock, gpointer data)
+{
+    PerfHud* hud = (PerfHud*)data;
+    if (hud->frame_start == 0 || !hud->view_drawn)
+    {
+        hud->frame_start = 0;
+        return;
+    }
+
+    gint64 duration = g_get_monotonic_time() - hud->frame_start;
+    hud->frame_start = 0;
+    hud->frames++;
+    hud->frame_total += duration;
+    hud->frame_max = MAX(hud->frame_max, duration);
+}
+
+static void stop_sampling(PerfHud* hud)
+{
+    if (hud->refresh_id)
+    {
+        g_source_remove(hud->refresh_id);
+        hud->refresh_id = 0;
+    }
+    if (hud->frame_clock)
+    {
+        g_signal_handler_disconnect(hud->frame_clock, hud->before_paint_id);
+        g_signal_handler_disconnect(hud->frame_clock, hud->after_paint_id);
+        g_clear_object(&hud->frame_clock);
+    }
+    if (hud->view)
+    {
+        g_signal_handler_disconnect(hud->view, hud->draw_id);
+        g_clear_object(&hud->view);
+    }
+}
+
+PerfHud* perf_hud_new(NotepadApp* app)
+{
+    PerfHud* hud = g_new0(PerfHud, 1);
+    hud->app = app;
+    for (gint i = 0; i < PERF_TIMING_COUNT; i++)
+        hud->timings[i] = -1;
+
+    hud->label = gtk_label_new("");
+    gtk_label_set_ellipsize(GTK_LABEL(hud->label), PANGO_ELLIPSIZE_END);
+    gtk_widget_set_halign(hud->label, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(hud->label, 10);
+    gtk_widget_set_margin_top(hud->label, 2);
+    gtk_widget_set_margin_bottom(hud->label, 2);
+    gtk_widget_set_no_show_all(hud->label, TRUE);
+    return hud;
+}
+
+GtkWidget* perf_hud_get_widget(PerfHud* hud)
+{
+    return hud->label;
+}
+
+void perf_hud_free(PerfHud* hud)
+{
+    if (!hud)
+        return;
+    stop_sampling(hud);
+    g_free(hud);
+}
+
+void perf_hud_set_visible(PerfHud* hud, gboolean visible)
+{
+    stop_sampling(hud);
+    if (!visible)
+    {
+        gtk_widget_hide(hud->label);
+        return;
+    }
+
+    // 帧时钟属于顶层窗口，窗口显示之后才存在
+    GdkFrameClock* clock = gtk_widget_get_frame_clock(hud->app->ui->text_view);
+    if (clock)
+    {
+        hud->frame_clock = g_object_ref(clock);
+        hud->before_paint_id = g_signal_connect(clock, "before-paint", G_CALLBACK(on_before_paint), hud);
+        hud->after_paint_id = g_signal_connect(clock, "after-paint", G_CALLBACK(on_after_paint), hud);
+        hud->view = g_object_ref(hud->app->ui->text_view);
+        hud->draw_id = g_signal_connect(hud->view, "draw", G_CALLBACK(on_view_draw), hud);
+    }
+    hud->frame_start = 0;
+    hud->view_drawn = FALSE;
+    hud->frames = 0;
+    hud->frame_total = 0;
+    hud->frame_max = 0;
+
+    refresh(hud);
+    hud->refresh_id = g_timeout_add(PERF_HUD_INTERVAL, on_refresh, hud);
+    gtk_widget_show(hud->label);
+}
+
+void perf_hud_record(PerfHud* hud, PerfTiming timing, gint64 start_time)
+{
+    if (hud)
+        hud->timings[timing] = g_get_monotonic_time() - start_time;
+}
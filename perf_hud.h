@@ -0,0 +1,34 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef PERF_HUD_H
+#define PERF_HUD_H
+
+#include <gtk/gtk.h>
+#include "notepad.h"
+
+#define PERF_HUD_INTERVAL 500   // 面板刷新间隔（毫秒），只在可见时刷新
+
+// 记录耗时的操作
+typedef enum
+{
+    PERF_TIMING_OPEN,
+    PERF_TIMING_SAVE,
+    PERF_TIMING_SEARCH,
+    PERF_TIMING_COUNT
+} PerfTiming;
+
+// 性能面板：显示文档字节数、撤销历史的条数和占用、进程常驻内存、最近一次打开/保存/查找的耗时，
+// 以及滚动和输入时的帧耗时。数据取自已有的计数和帧时钟，隐藏时不采样
+typedef struct PerfHud PerfHud;
+
+extern PerfHud* perf_hud_new(NotepadApp* app);              // 创建面板，默认隐藏
+extern GtkWidget* perf_hud_get_widget(PerfHud* hud);
+extern void perf_hud_free(PerfHud* hud);
+extern void perf_hud_set_visible(PerfHud* hud, gboolean visible);
+
+// 记录一次操作的耗时，start_time 为开始时的 g_get_monotonic_time()。hud 为 NULL 时忽略
+extern void perf_hud_record(PerfHud* hud, PerfTiming timing, gint64 start_time);
+
+#endif // PERF_HUD_H
@@ -0,0 +1,175 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "relayout.h"
+
+#define RELAYOUT_SLICE_BUDGET   4000    // 每次空闲回调最多占用的时间（微秒）
+#define RELAYOUT_CHUNK_LINES    2000    // 每次设置标签的行数
+
+struct Relayout
+{
+    GtkTextView* view;
+    GtkTextBuffer* buffer;
+    GtkTextTag* wrap_tag;
+    GtkTextTag* font_tags[2];   // 换字体时交替使用，新字体逐段替换旧字体
+    gint font_index;            // 当前字体所用的标签，-1 表示使用视图的默认字体
+    gboolean wrap;
+    GtkTextMark* cursor;        // 下一段的起点
+    GtkTextMark* limit;         // 从文档开头开始的第二轮处理到这里（可见区域的起点）为止
+    gboolean second_pass;
+    guint idle_id;
+    gulong insert_handler;
+};
+
+// 按当前设置给一段文本加上或去掉标签
+static void apply_state(Relayout* relayout, const GtkTextIter* start, const GtkTextIter* end)
+{
+    if (relayout->wrap)
+        gtk_text_buffer_apply_tag(relayout->buffer, relayout->wrap_tag, start, end);
+    else
+        gtk_text_buffer_remove_tag(relayout->buffer, relayout->wrap_tag, start, end);
+
+    for (gint i = 0; i < 2; i++)
+    {
+        if (i == relayout->font_index)
+            gtk_text_buffer_apply_tag(relayout->buffer, relayout->font_tags[i], start, end);
+        else
+            gtk_text_buffer_remove_tag(relayout->buffer, relayout->font_tags[i], start, end);
+    }
+}
+
+static gboolean relayout_idle(gpointer data)
+{
+    Relayout* relayout = (Relayout*)data;
+    gint64 deadline = g_get_monotonic_time() + RELAYOUT_SLICE_BUDGET;
+
+    do
+    {
+        GtkTextIter start, limit;
+        gtk_text_buffer_get_iter_at_mark(relayout->buffer, &start, relayout->cursor);
+        if (relayout->second_pass)
+            gtk_text_buffer_get_iter_at_mark(relayout->buffer, &limit, relayout->limit);
+        else
+            gtk_text_buffer_get_end_iter(relayout->buffer, &limit);
+
+        if (gtk_text_iter_compare(&start, &limit) >= 0)
+        {
+            if (relayout->second_pass)
+            {
+                relayout->idle_id = 0;
+                return G_SOURCE_REMOVE;
+            }
+
+            // 可见区域之后的部分已完成，再从文档开头处理到可见区域
+            relayout->second_pass = TRUE;
+            gtk_text_buffer_get_start_iter(relayout->buffer, &start);
+            gtk_text_buffer_move_mark(relayout->buffer, relayout->cursor, &start);
+            continue;
+        }
+
+        GtkTextIter end = start;
+        gtk_text_iter_forward_lines(&end, RELAYOUT_CHUNK_LINES);
+        if (gtk_text_iter_compare(&end, &limit) > 0)
+            end = limit;
+
+        apply_state(relayout, &start, &end);
+        gtk_text_buffer_move_mark(relayout->buffer, relayout->cursor, &end);
+    }
+    while (g_get_monotonic_time() < deadline);
+
+    return G_SOURCE_CONTINUE;
+}
+
+// 设置变化后重新开始：先处理可见区域，再安排空闲处理
+static void relayout_start(Relayout* relayout)
+{
+    GdkRectangle visible;
+    GtkTextIter first, last;
+    gtk_text_view_get_visible_rect(relayout->view, &visible);
+    gtk_text_view_get_line_at_y(relayout->view, &first, visible.y, NULL);
+    gtk_text_view_get_line_at_y(relayout->view, &last, visible.y + visible.height, NULL);
+    gtk_text_iter_forward_line(&last);
+
+    apply_state(relayout, &first, &last);
+
+    gtk_text_buffer_move_mark(relayout->buffer, relayout->cursor, &last);
+    gtk_text_buffer_move_mark(relayout->buffer, relayout->limit, &first);
+    relayout->second_pass = FALSE;
+    if (!relayout->idle_id)
+        relayout->idle_id = g_idle_add(relayout_idle, relayout);
+}
+
+// 新插入的文本不会继承标签，需要按当前设置补上
+static void on_insert_after(GtkTextBuffer* buffer, GtkTextIter* location, gchar* text, gint len, gpointer data)
+{
+    Relayout* relayout = (Relayout*)data;
+    if (!relayout->wrap && relayout->font_index < 0)
+        return;
+
+    gint offset = gtk_text_iter_get_offset(location);
+    GtkTextIter start = *location;
+    gtk_text_iter_backward_chars(&start, (gint)g_utf8_strlen(text, len));
+
+    if (relayout->wrap)
+        gtk_text_buffer_apply_tag(buffer, relayout->wrap_tag, &start, location);
+    if (relayout->font_index >= 0)
+        gtk_text_buffer_apply_tag(buffer, relayout->font_tags[relayout->font_index], &start, location);
+
+    // 设置标签会使迭代器失效，为后面的处理函数重新定位
+    gtk_text_buffer_get_iter_at_offset(buffer, location, offset);
+}
+
+Relayout* relayout_new(GtkTextView* view)
+{
+    Relayout* relayout = g_new0(Relayout, 1);
+    relayout->view = view;
+    relayout->buffer = g_object_ref(gtk_text_view_get_buffer(view));   // 窗口销毁后仍需断开信号
+    relayout->font_index = -1;
+
+    // 视图本身不换行，只有换行标签覆盖的文本才换行，关闭换行时行能真正展开
+    gtk_text_view_set_wrap_mode(view, GTK_WRAP_NONE);
+    relayout->wrap_tag = gtk_text_buffer_create_tag(relayout->buffer, "relayout-wrap",
+                                                    "wrap-mode", GTK_WRAP_WORD_CHAR, NULL);
+    relayout->font_tags[0] = gtk_text_buffer_create_tag(relayout->buffer, "relayout-font-0", NULL);
+    relayout->font_tags[1] = gtk_text_buffer_create_tag(relayout->buffer, "relayout-font-1", NULL);
+
+    GtkTextIter start;
+    gtk_text_buffer_get_start_iter(relayout->buffer, &start);
+    relayout->cursor = gtk_text_buffer_create_mark(relayout->buffer, NULL, &start, FALSE);
+    relayout->limit = gtk_text_buffer_create_mark(relayout->buffer, NULL, &start, TRUE);
+
+    relayout->insert_handler = g_signal_connect_after(relayout->buffer, "insert-text",
+                                                      G_CALLBACK(on_insert_after), relayout);
+    return relayout;
+}
+
+void relayout_free(Relayout* relayout)
+{
+    if (!relayout)
+        return;
+
+    if (relayout->idle_id)
+        g_source_remove(relayout->idle_id);
+    g_signal_handler_disconnect(relayout->buffer, relayout->insert_handler);
+    gtk_text_buffer_delete_mark(relayout->buffer, relayout->cursor);
+    gtk_text_buffer_delete_mark(relayout->buffer, relayout->limit);
+    g_object_unref(relayout->buffer);
+    g_free(relayout);
+}
+
+void relayout_set_wrap(Relayout* relayout, gboolean wrap)
+{
+    if (relayout->wrap == wrap)
+        return;
+    relayout->wrap = wrap;
+    relayout_start(relayout);
+}
+
+void relayout_set_font(Relayout* relayout, const PangoFontDescription* font)
+{
+    // 换用另一个标签，未处理到的部分暂时保持旧字体
+    relayout->font_index = relayout->font_index == 0 ? 1 : 0;
+    g_object_set(relayout->font_tags[relayout->font_index], "font-desc", font, NULL);
+    relayout_start(relayout);
+}
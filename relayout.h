@@ -0,0 +1,20 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef RELAYOUT_H
+#define RELAYOUT_H
+
+#include <gtk/gtk.h>
+
+// 自动换行和字体通过覆盖整个文档的标签实现，而不是直接设置在文本视图上。
+// 切换时先同步处理可见区域，其余部分在空闲时分段处理，避免一次重新排版整个文档；
+// 尚未排版的行由文本视图按估计高度显示滚动条
+typedef struct Relayout Relayout;
+
+extern Relayout* relayout_new(GtkTextView* view);
+extern void relayout_free(Relayout* relayout);
+extern void relayout_set_wrap(Relayout* relayout, gboolean wrap);
+extern void relayout_set_font(Relayout* relayout, const PangoFontDescription* font);
+
+#endif // RELAYOUT_H
@@ -0,0 +1,117 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "save_bench.h"
+#include "autosave.h"
+#include "settings.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define SAVE_BENCH_MODES (SAVE_IN_PLACE + 1)
+
+// 生成中英文混合的多行文本，每行不同
+static GBytes* bench_text(gsize size)
+{
+    GString* text = g_string_sized_new(size + 128);
+    for (guint line = 1; text->len < size; line++)
+        g_string_append_printf(text, "第 %u 行：The quick brown fox jumps over the lazy dog，敏捷的棕色狐狸跳过了懒狗。\n", line);
+    return g_string_free_to_bytes(text);
+}
+
+static gboolean fill_text(EncodingWriter* writer, gpointer data, GError** error)
+{
+    gsize length;
+    const gchar* text = g_bytes_get_data((GBytes*)data, &length);
+    return encoding_writer_write(writer, text, length, error);
+}
+
+static gint compare_latency(gconstpointer a, gconstpointer b)
+{
+    gint64 x = *(const gint64*)a, y = *(const gint64*)b;
+    return x < y ? -1 : x > y;
+}
+
+// 按一种保存方式保存 rounds 次，latencies 和 journal_latencies 返回每次的总耗时和其中写日志的耗时（微秒）
+static gboolean bench_mode(Autosave* autosave, const char* filename, GBytes* text, SaveDurability durability,
+                           guint rounds, GArray* latencies, GArray* journal_latencies)
+{
+    JournalState state = { 0, TRUE };
+    encoding_init_default(&state.encoding);
+    state.line_ending = LINE_ENDING_LF;
+
+    for (guint i = 0; i < rounds; i++)
+    {
+        gint64 start_time = g_get_monotonic_time();
+        if (durability != SAVE_ATOMIC_FSYNC)
+            autosave_write_now(autosave, filename, text, &state);
+        gint64 journal_time = g_get_monotonic_time() - start_time;
+
+        guint64 hash;
+        GError* error = NULL;
+        if (!encoding_save_file(filename, &state.encoding, state.line_ending, durability, fill_text, text,
+                                &hash, NULL, &error))
+        {
+            g_printerr("%s：无法保存 %s: %s\n", save_durability_label(durability), filename, error->message);
+            g_error_free(error);
+            return FALSE;
+        }
+        gint64 elapsed = g_get_monotonic_time() - start_time;
+        g_array_append_val(latencies, elapsed);
+        g_array_append_val(journal_latencies, journal_time);
+    }
+
+    // 这里不补做后台 fsync，各次保存互不影响
+    autosave_discard(autosave, filename);
+    return TRUE;
+}
+
+static void print_latencies(SaveDurability durability, GArray* latencies, GArray* journal_latencies)
+{
+    g_array_sort(latencies, compare_latency);
+    g_array_sort(journal_latencies, compare_latency);
+    gint64* values = (gint64*)latencies->data;
+    gint64* journal = (gint64*)journal_latencies->data;
+    guint n = latencies->len;
+    g_print("%-24s %8u %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT " %12" G_GINT64_FORMAT "\n",
+            save_durability_label(durability), n, values[n * 50 / 100], values[n * 90 / 100], values[n - 1],
+            journal[n * 50 / 100]);
+}
+
+int save_bench_run(int argc, char* argv[])
+{
+    const char* directory = argc > 0 ? argv[0] : g_get_tmp_dir();
+    guint size = argc > 1 ? (guint)g_ascii_strtoull(argv[1], NULL, 10) : SAVE_BENCH_DEFAULT_SIZE;
+    guint rounds = argc > 2 ? (guint)g_ascii_strtoull(argv[2], NULL, 10) : SAVE_BENCH_DEFAULT_ROUNDS;
+    if (!g_file_test(directory, G_FILE_TEST_IS_DIR) || size == 0 || rounds == 0)
+    {
+        g_printerr("用法：notepad --save-bench [目录] [大小(MB)] [次数]\n");
+        return 2;
+    }
+
+    gchar* basename = g_strdup_printf("notepad-save-bench-%08x.txt", g_random_int());
+    gchar* filename = g_build_filename(directory, basename, NULL);
+    g_free(basename);
+    GBytes* text = bench_text((gsize)size * 1024 * 1024);
+    Autosave* autosave = autosave_new();
+    g_print("保存方式基准测试：%s，%u MB，每种方式 %u 次\n", filename, size, rounds);
+    g_print("%-24s %8s %10s %10s %10s %12s\n", "保存方式", "次数", "p50(us)", "p90(us)", "最大(us)", "日志p50(us)");
+
+    gboolean ok = TRUE;
+    for (gint i = 0; ok && i < SAVE_BENCH_MODES; i++)
+    {
+        GArray* latencies = g_array_new(FALSE, FALSE, sizeof(gint64));
+        GArray* journal_latencies = g_array_new(FALSE, FALSE, sizeof(gint64));
+        ok = bench_mode(autosave, filename, text, (SaveDurability)i, rounds, latencies, journal_latencies);
+        if (ok)
+            print_latencies((SaveDurability)i, latencies, journal_latencies);
+        g_array_free(latencies, TRUE);
+        g_array_free(journal_latencies, TRUE);
+    }
+
+    autosave_free(autosave);
+    g_remove(filename);
+    g_free(filename);
+    g_bytes_unref(text);
+    return ok ? 0 : 1;
+}
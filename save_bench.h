@@ -0,0 +1,17 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef SAVE_BENCH_H
+#define SAVE_BENCH_H
+
+#define SAVE_BENCH_DEFAULT_SIZE   8     // 默认的文档大小（MB）
+#define SAVE_BENCH_DEFAULT_ROUNDS 20    // 默认每种保存方式的保存次数
+
+// 保存方式基准测试（命令行模式，不需要显示）：
+//   notepad --save-bench [目录] [大小(MB)] [次数]
+// 在目录（默认为临时目录）中按三种保存方式各保存同一文档若干次，输出每种方式的延迟分位数。
+// 不等待落盘的两种方式计入保存前同步写入自动保存日志的时间，与编辑器中一次保存的开销相同。成功时返回 0
+extern int save_bench_run(int argc, char* argv[]);
+
+#endif // SAVE_BENCH_H
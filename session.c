@@ -0,0 +1,584 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "session.h"
+#include "notepad.h"
+#include "file_operations.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SESSION_MAGIC "NPSS"
+
+// 背景设置的类型
+enum
+{
+    SESSION_BACKGROUND_NONE,
+    SESSION_BACKGROUND_COLOR,
+    SESSION_BACKGROUND_IMAGE
+};
+
+// 等待文档载入后恢复的状态
+typedef struct SessionDocument
+{
+    gchar* path;
+    FileFingerprint fingerprint;
+    gint32 cursor;              // 光标的字符偏移
+    gint32 top_line;            // 第一个可见行
+    UndoAction* undo_stack;     // 文件指纹一致时接到撤销栈，文本引用映射的会话文件
+    UndoAction* redo_stack;
+} SessionDocument;
+
+struct Session
+{
+    GThreadPool* pool;          // 只有一个线程，保证按提交顺序写入
+    guint64 written_hash;       // 最近一次提交的内容的哈希
+    guint64 state_key;          // 最近一次序列化时的状态，不变时不必再序列化
+    SessionDocument* pending;   // 上次的文档正在载入
+};
+
+// 按顺序读取映射的会话文件，越界或数据无效后 ok 为 FALSE，之后的读取都返回 0
+typedef struct SessionReader
+{
+    GBytes* bytes;
+    const guint8* data;
+    gsize length;
+    gsize pos;
+    gboolean ok;
+} SessionReader;
+
+static gchar* session_path(void)
+{
+    return g_build_filename(g_get_user_config_dir(), "notepad", "session.bin", NULL);
+}
+
+static void put_u8(GByteArray* out, guint8 value)
+{
+    g_byte_array_append(out, &value, 1);
+}
+
+static void put_u32(GByteArray* out, guint32 value)
+{
+    value = GUINT32_TO_LE(value);
+    g_byte_array_append(out, (const guint8*)&value, sizeof(value));
+}
+
+static void put_u64(GByteArray* out, guint64 value)
+{
+    value = GUINT64_TO_LE(value);
+    g_byte_array_append(out, (const guint8*)&value, sizeof(value));
+}
+
+static void put_double(GByteArray* out, gdouble value)
+{
+    guint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put_u64(out, bits);
+}
+
+static void put_blob(GByteArray* out, const void* data, gsize length)
+{
+    put_u32(out, (guint32)length);
+    g_byte_array_append(out, (const guint8*)data, (guint)length);
+}
+
+static void put_string(GByteArray* out, const char* text)
+{
+    put_blob(out, text ? text : "", text ? strlen(text) : 0);
+}
+
+static gsize action_size(const UndoAction* action)
+{
+    return g_bytes_get_size(action->text) + (action->replacement ? g_bytes_get_size(action->replacement) : 0);
+}
+
+// 从栈顶开始写入编号大于 base 的记录，超出字节数上限时丢弃更早的记录
+static void put_history(GByteArray* out, UndoAction* stack, guint64 base)
+{
+    guint32 count = 0;
+    gsize bytes = 0;
+    for (UndoAction* action = stack; action && action->serial > base; action = action->next)
+    {
+        if (bytes + action_size(action) > SESSION_MAX_HISTORY)
+            break;
+        bytes += action_size(action);
+        count++;
+    }
+
+    put_u32(out, count);
+    UndoAction* action = stack;
+    for (guint32 i = 0; i < count; i++, action = action->next)
+    {
+        gsize length;
+        const void* text = g_bytes_get_data(action->text, &length);
+        put_u8(out, (guint8)action->type);
+        put_u32(out, (guint32)action->position);
+        put_blob(out, text, length);
+        put_u8(out, action->replacement != NULL);
+        if (action->replacement)
+        {
+            text = g_bytes_get_data(action->replacement, &length);
+            put_blob(out, text, length);
+        }
+    }
+}
+
+// 只在文档处于保存点、且撤销位置不早于载入文件时保存历史
+static gboolean history_restorable(NotepadApp* app)
+{
+    guint64 top = app->ui->undo_stack ? app->ui->undo_stack->serial : 0;
+    return app->fingerprint.valid && !app->ui->paste && notepad_at_save_point(app) && top >= app->ui->history_base;
+}
+
+// 光标的字符偏移和第一个可见行
+static void document_position(NotepadApp* app, gint* cursor_offset, gint* top_line)
+{
+    GtkTextBuffer* buffer = app->ui->buffer;
+    GtkTextIter cursor, top;
+    gtk_text_buffer_get_iter_at_mark(buffer, &cursor, gtk_text_buffer_get_insert(buffer));
+    GdkRectangle visible;
+    gtk_text_view_get_visible_rect(GTK_TEXT_VIEW(app->ui->text_view), &visible);
+    gtk_text_view_get_line_at_y(GTK_TEXT_VIEW(app->ui->text_view), &top, visible.y, NULL);
+    *cursor_offset = gtk_text_iter_get_offset(&cursor);
+    *top_line = gtk_text_iter_get_line(&top);
+}
+
+static void hash_string(ContentHash* hash, const char* text)
+{
+    guint64 length = text ? strlen(text) : 0;
+    content_hash_update(hash, &length, sizeof(length));
+    if (text)
+        content_hash_update(hash, text, length);
+}
+
+// 会话内容取决于的全部状态：文档版本、撤销位置、光标、滚动位置和设置。
+// 只计算这些值的哈希，不涉及撤销历史的文本
+static guint64 session_state_key(NotepadApp* app)
+{
+    gint cursor = 0, top_line = 0;
+    if (app->filename)
+        document_position(app, &cursor, &top_line);
+
+    NotepadUI* ui = app->ui;
+    gdouble numbers[] = {
+        ui->background_opacity, ui->background_color.red, ui->background_color.green,
+        ui->background_color.blue, ui->background_color.alpha
+    };
+    guint64 values[] = {
+        app->content_generation,
+        ui->undo_stack ? ui->undo_stack->serial : 0,
+        ui->redo_stack ? ui->redo_stack->serial : 0,
+        ui->history_base,
+        app->filename && history_restorable(app),
+        app->fingerprint.valid, app->fingerprint.size, (guint64)app->fingerprint.mtime_usec,
+        app->fingerprint.inode, app->fingerprint.hash,
+        (guint64)cursor, (guint64)top_line, ui->has_background_color
+    };
+
+    ContentHash hash;
+    content_hash_init(&hash);
+    content_hash_update(&hash, values, sizeof(values));
+    content_hash_update(&hash, numbers, sizeof(numbers));
+    hash_string(&hash, app->filename);
+    hash_string(&hash, ui->primary_font);
+    hash_string(&hash, ui->fallback_font);
+    hash_string(&hash, ui->background_image);
+    return content_hash_finish(&hash);
+}
+
+static void put_document(GByteArray* out, NotepadApp* app)
+{
+    gint cursor, top_line;
+    document_position(app, &cursor, &top_line);
+
+    put_string(out, app->filename);
+    put_u64(out, app->fingerprint.size);
+    put_u64(out, (guint64)app->fingerprint.mtime_usec);
+    put_u64(out, app->fingerprint.inode);
+    put_u64(out, app->fingerprint.hash);
+    put_u32(out, (guint32)cursor);
+    put_u32(out, (guint32)top_line);
+
+    gboolean history = history_restorable(app);
+    put_u8(out, history);
+    if (history)
+    {
+        put_history(out, app->ui->undo_stack, app->ui->history_base);
+        put_history(out, app->ui->redo_stack, 0);
+    }
+}
+
+static GBytes* serialize_session(NotepadApp* app)
+{
+    GByteArray* out = g_byte_array_new();
+    g_byte_array_append(out, (const guint8*)SESSION_MAGIC, 4);
+    put_u32(out, SESSION_VERSION);
+
+    put_string(out, app->ui->primary_font);
+    put_string(out, app->ui->fallback_font);
+    if (app->ui->background_image)
+    {
+        put_u8(out, SESSION_BACKGROUND_IMAGE);
+        put_string(out, app->ui->background_image);
+        put_double(out, app->ui->background_opacity);
+    }
+    else if (app->ui->has_background_color)
+    {
+        put_u8(out, SESSION_BACKGROUND_COLOR);
+        put_double(out, app->ui->background_color.red);
+        put_double(out, app->ui->background_color.green);
+        put_double(out, app->ui->background_color.blue);
+        put_double(out, app->ui->background_color.alpha);
+    }
+    else
+    {
+        put_u8(out, SESSION_BACKGROUND_NONE);
+    }
+
+    // 未命名文档的内容由自动保存日志负责
+    put_u32(out, app->filename ? 1 : 0);
+    if (app->filename)
+        put_document(out, app);
+    return g_byte_array_free_to_bytes(out);
+}
+
+static gboolean reader_need(SessionReader* reader, gsize size)
+{
+    if (!reader->ok || reader->length - reader->pos < size)
+        reader->ok = FALSE;
+    return reader->ok;
+}
+
+static guint8 get_u8(SessionReader* reader)
+{
+    if (!reader_need(reader, 1))
+        return 0;
+    return reader->data[reader->pos++];
+}
+
+static guint32 get_u32(SessionReader* reader)
+{
+    guint32 value;
+    if (!reader_need(reader, sizeof(value)))
+        return 0;
+    memcpy(&value, reader->data + reader->pos, sizeof(value));
+    reader->pos += sizeof(value);
+    return GUINT32_FROM_LE(value);
+}
+
+static guint64 get_u64(SessionReader* reader)
+{
+    guint64 value;
+    if (!reader_need(reader, sizeof(value)))
+        return 0;
+    memcpy(&value, reader->data + reader->pos, sizeof(value));
+    reader->pos += sizeof(value);
+    return GUINT64_FROM_LE(value);
+}
+
+static gdouble get_double(SessionReader* reader)
+{
+    guint64 bits = get_u64(reader);
+    gdouble value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// 引用映射中的一段而不复制；内容不是有效的 UTF-8 时视为损坏
+static GBytes* get_text(SessionReader* reader)
+{
+    guint32 length = get_u32(reader);
+    if (!reader_need(reader, length))
+        return NULL;
+    if (!g_utf8_validate((const gchar*)reader->data + reader->pos, length, NULL))
+    {
+        reader->ok = FALSE;
+        return NULL;
+    }
+    GBytes* text = g_bytes_new_from_bytes(reader->bytes, reader->pos, length);
+    reader->pos += length;
+    return text;
+}
+
+static gchar* get_string(SessionReader* reader)
+{
+    guint32 length = get_u32(reader);
+    if (!reader_need(reader, length))
+        return NULL;
+    gchar* text = g_strndup((const gchar*)reader->data + reader->pos, length);
+    reader->pos += length;
+    return text;
+}
+
+// 按写入的顺序（栈顶在前）重建链表
+static UndoAction* get_history(SessionReader* reader)
+{
+    UndoAction* head = NULL;
+    UndoAction** tail = &head;
+    guint32 count = get_u32(reader);
+    for (guint32 i = 0; i < count && reader->ok; i++)
+    {
+        guint8 type = get_u8(reader);
+        gint32 position = (gint32)get_u32(reader);
+        GBytes* text = get_text(reader);
+        GBytes* replacement = get_u8(reader) ? get_text(reader) : NULL;
+        if (!reader->ok || type > UNDO_REPLACE || position < 0 || (type == UNDO_REPLACE) != (replacement != NULL))
+        {
+            reader->ok = FALSE;
+            if (text)
+                g_bytes_unref(text);
+            if (replacement)
+                g_bytes_unref(replacement);
+            break;
+        }
+
+        UndoAction* action = (UndoAction*)malloc(sizeof(UndoAction));
+        action->type = (UndoType)type;
+        action->position = position;
+        action->text = text;
+        action->replacement = replacement;
+        action->serial = 0;
+        action->next = NULL;
+        *tail = action;
+        tail = &action->next;
+    }
+    if (!reader->ok)
+        clear_undo_stack(&head);
+    return head;
+}
+
+static void session_document_free(SessionDocument* document)
+{
+    if (!document)
+        return;
+    g_free(document->path);
+    clear_undo_stack(&document->undo_stack);
+    clear_undo_stack(&document->redo_stack);
+    g_free(document);
+}
+
+static SessionDocument* get_document(SessionReader* reader)
+{
+    SessionDocument* document = g_new0(SessionDocument, 1);
+    document->path = get_string(reader);
+    document->fingerprint.size = get_u64(reader);
+    document->fingerprint.mtime_usec = (gint64)get_u64(reader);
+    document->fingerprint.inode = get_u64(reader);
+    document->fingerprint.hash = get_u64(reader);
+    document->fingerprint.valid = true;
+    document->cursor = (gint32)get_u32(reader);
+    document->top_line = (gint32)get_u32(reader);
+    if (get_u8(reader))
+    {
+        document->undo_stack = get_history(reader);
+        document->redo_stack = get_history(reader);
+    }
+
+    if (!reader->ok || !document->path || !*document->path)
+    {
+        session_document_free(document);
+        return NULL;
+    }
+    return document;
+}
+
+static void write_session(gpointer data, gpointer user_data)
+{
+    GBytes* bytes = (GBytes*)data;
+    gchar* path = session_path();
+    gchar* directory = g_path_get_dirname(path);
+    g_mkdir_with_parents(directory, 0700);
+
+    // 写入临时文件后改名，恢复时映射的旧文件不受影响
+    gsize length;
+    const gchar* content = g_bytes_get_data(bytes, &length);
+    GError* error = NULL;
+    if (!g_file_set_contents(path, content, (gssize)length, &error))
+    {
+        g_warning("无法保存会话 %s: %s", path, error->message);
+        g_error_free(error);
+    }
+
+    g_free(directory);
+    g_free(path);
+    g_bytes_unref(bytes);
+}
+
+Session* session_new(void)
+{
+    Session* session = g_new0(Session, 1);
+    session->pool = g_thread_pool_new(write_session, NULL, 1, FALSE, NULL);
+    return session;
+}
+
+void session_free(Session* session)
+{
+    if (!session)
+        return;
+    g_thread_pool_free(session->pool, FALSE, TRUE);
+    session_document_free(session->pending);
+    g_free(session);
+}
+
+void session_save(NotepadApp* app)
+{
+    // 文档正在载入时保留原来的会话文件；上次的文档没有载入成功时不再等待
+    Session* session = app->session;
+    if (app->load_cancellable || !app->ui->text_view)
+        return;
+    g_clear_pointer(&session->pending, session_document_free);
+
+    // 先比较状态，没有变化时不复制撤销历史的文本
+    guint64 key = session_state_key(app);
+    if (key == session->state_key)
+        return;
+    session->state_key = key;
+
+    GBytes* bytes = serialize_session(app);
+    gsize length;
+    const void* data = g_bytes_get_data(bytes, &length);
+    guint64 hash = content_hash_bytes(data, length);
+    if (hash == session->written_hash)
+    {
+        g_bytes_unref(bytes);
+        return;
+    }
+    session->written_hash = hash;
+    g_thread_pool_push(session->pool, bytes, NULL);
+}
+
+static void apply_settings(NotepadApp* app, gchar* primary_font, gchar* fallback_font)
+{
+    if (g_strcmp0(primary_font, app->ui->primary_font) != 0 || g_strcmp0(fallback_font, app->ui->fallback_font) != 0)
+    {
+        g_free(app->ui->primary_font);
+        g_free(app->ui->fallback_font);
+        app->ui->primary_font = g_strdup(primary_font);
+        app->ui->fallback_font = g_strdup(fallback_font);
+        apply_font_with_fallback(app, primary_font, fallback_font);
+    }
+}
+
+void session_restore(NotepadApp* app, gboolean open_document)
+{
+    gchar* path = session_path();
+    GMappedFile* file = g_mapped_file_new(path, FALSE, NULL);
+    g_free(path);
+    if (!file)
+        return;
+
+    SessionReader reader = { g_mapped_file_get_bytes(file), NULL, 0, 0, TRUE };
+    g_mapped_file_unref(file);
+    reader.data = g_bytes_get_data(reader.bytes, &reader.length);
+    if (reader_need(&reader, 4) && memcmp(reader.data, SESSION_MAGIC, 4) == 0)
+        reader.pos = 4;
+    else
+        reader.ok = FALSE;
+    if (get_u32(&reader) != SESSION_VERSION)
+        reader.ok = FALSE;
+
+    gchar* primary_font = get_string(&reader);
+    gchar* fallback_font = get_string(&reader);
+    guint8 background = get_u8(&reader);
+    gchar* image = NULL;
+    gdouble opacity = 1.0;
+    GdkRGBA color = { 0 };
+    if (background == SESSION_BACKGROUND_IMAGE)
+    {
+        image = get_string(&reader);
+        opacity = get_double(&reader);
+    }
+    else if (background == SESSION_BACKGROUND_COLOR)
+    {
+        color.red = get_double(&reader);
+        color.green = get_double(&reader);
+        color.blue = get_double(&reader);
+        color.alpha = get_double(&reader);
+    }
+    SessionDocument* document = get_u32(&reader) > 0 ? get_document(&reader) : NULL;
+
+    if (reader.ok)
+    {
+        apply_settings(app, primary_font, fallback_font);
+        if (image && g_file_test(image, G_FILE_TEST_EXISTS))
+            apply_background_image(app, image, opacity);
+        else if (background == SESSION_BACKGROUND_COLOR)
+            apply_background_color(app, &color);
+
+        // 先显示窗口，文档在后台载入，载入后再恢复光标和历史
+        if (open_document && document && g_file_test(document->path, G_FILE_TEST_IS_REGULAR))
+        {
+            app->session->pending = document;
+            document = NULL;
+            notepad_open_path(app, app->session->pending->path);
+        }
+    }
+
+    session_document_free(document);
+    g_free(image);
+    g_free(fallback_font);
+    g_free(primary_font);
+    g_bytes_unref(reader.bytes);
+}
+
+// 撤销栈从栈底开始编号，重做栈接在撤销栈顶之后，返回最大的编号
+static guint64 number_history(UndoAction* undo, UndoAction* redo)
+{
+    guint64 count = 0;
+    for (UndoAction* action = undo; action; action = action->next)
+        count++;
+
+    guint64 serial = count;
+    for (UndoAction* action = undo; action; action = action->next)
+        action->serial = serial--;
+    serial = count;
+    for (UndoAction* action = redo; action; action = action->next)
+        action->serial = ++serial;
+    return serial;
+}
+
+void session_document_loaded(NotepadApp* app)
+{
+    Session* session = app->session;
+    SessionDocument* document = session->pending;
+    session->pending = NULL;
+    if (!document || !app->filename || strcmp(app->filename, document->path) != 0)
+    {
+        session_document_free(document);
+        return;
+    }
+
+    // 文件自上次会话以来没有变化时，用保存的历史代替载入文件的记录，不能撤销到载入之前
+    if ((document->undo_stack || document->redo_stack) &&
+        file_fingerprint_same_identity(&document->fingerprint, &app->fingerprint) &&
+        document->fingerprint.hash == app->fingerprint.hash)
+    {
+        clear_undo_stack(&app->ui->undo_stack);
+        clear_undo_stack(&app->ui->redo_stack);
+        app->ui->undo_serial = number_history(document->undo_stack, document->redo_stack);
+        app->ui->undo_stack = document->undo_stack;
+        app->ui->redo_stack = document->redo_stack;
+        undo_history_recount(app);
+        document->undo_stack = NULL;
+        document->redo_stack = NULL;
+        app->ui->history_base = 0;
+        notepad_mark_saved(app);
+    }
+
+    // 偏移超出文档时定位到末尾
+    GtkTextBuffer* buffer = app->ui->buffer;
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_offset(buffer, &iter, document->cursor);
+    gtk_text_buffer_place_cursor(buffer, &iter);
+
+    gtk_text_buffer_get_iter_at_line(buffer, &iter, document->top_line);
+    GtkTextMark* top = gtk_text_buffer_get_mark(buffer, "session-top");
+    if (top)
+        gtk_text_buffer_move_mark(buffer, top, &iter);
+    else
+        top = gtk_text_buffer_create_mark(buffer, "session-top", &iter, TRUE);
+    gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(app->ui->text_view), top, 0.0, TRUE, 0.0, 0.0);
+
+    update_cursor_position(app);
+    session_document_free(document);
+}
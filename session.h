@@ -0,0 +1,27 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <glib.h>
+
+#define SESSION_VERSION         1                   // 会话文件格式的版本，不同版本的文件忽略
+#define SESSION_MAX_HISTORY     (16 * 1024 * 1024)  // 撤销和重做历史各自最多保存的字节数，超出时丢弃最早的记录
+
+// 会话：退出时和自动保存时把文档路径、文件指纹、光标、滚动位置、字体和背景设置以及撤销历史
+// 写入二进制会话文件（小端，带版本号）。启动时映射会话文件，先恢复字体和背景并在后台打开上次的文档，
+// 文档载入后文件指纹一致时才恢复撤销历史，历史中的文本直接引用映射的内容而不复制。
+// 只在文档处于保存点时保存撤销历史，此时磁盘上的文件就是历史的终点
+typedef struct Session Session;
+typedef struct NotepadApp NotepadApp;
+
+extern Session* session_new(void);
+extern void session_free(Session* session);                     // 等待队列中的写入完成后释放
+
+extern void session_save(NotepadApp* app);                      // 在后台写入会话文件，内容与上次相同时跳过
+extern void session_restore(NotepadApp* app, gboolean open_document); // 启动时调用，open_document 为 FALSE 时只恢复设置
+extern void session_document_loaded(NotepadApp* app);           // 文档载入并记录指纹后调用，恢复光标、滚动位置和撤销历史
+
+#endif // SESSION_H
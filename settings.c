@@ -0,0 +1,78 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "settings.h"
+#include <string.h>
+
+#define SAVE_DURABILITY_COUNT 3
+
+// 设置文件中的取值，按 SaveDurability 索引
+static const gchar* durability_keys[SAVE_DURABILITY_COUNT] = { "atomic-fsync", "atomic", "in-place" };
+static const gchar* durability_labels[SAVE_DURABILITY_COUNT] = { "安全替换（等待写入磁盘）", "快速替换", "直接覆盖" };
+
+static gchar* settings_path(void)
+{
+    return g_build_filename(g_get_user_config_dir(), "notepad", "settings.ini", NULL);
+}
+
+void settings_init_default(NotepadSettings* settings)
+{
+    settings->save_durability = SAVE_ATOMIC_FSYNC;
+    settings->word_wrap = FALSE;
+    settings->wrap_size_limit = 8 * 1024 * 1024;
+}
+
+void settings_load(NotepadSettings* settings)
+{
+    settings_init_default(settings);
+
+    gchar* path = settings_path();
+    GKeyFile* key_file = g_key_file_new();
+    if (g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, NULL))
+    {
+        gchar* durability = g_key_file_get_string(key_file, "save", "durability", NULL);
+        for (gint i = 0; durability && i < SAVE_DURABILITY_COUNT; i++)
+        {
+            if (strcmp(durability, durability_keys[i]) == 0)
+                settings->save_durability = (SaveDurability)i;
+        }
+        g_free(durability);
+
+        if (g_key_file_has_key(key_file, "view", "word_wrap", NULL))
+            settings->word_wrap = g_key_file_get_boolean(key_file, "view", "word_wrap", NULL);
+        if (g_key_file_has_key(key_file, "view", "wrap_size_limit", NULL))
+            settings->wrap_size_limit = g_key_file_get_int64(key_file, "view", "wrap_size_limit", NULL);
+    }
+    g_key_file_free(key_file);
+    g_free(path);
+}
+
+void settings_save(const NotepadSettings* settings)
+{
+    gchar* path = settings_path();
+    gchar* directory = g_path_get_dirname(path);
+    g_mkdir_with_parents(directory, 0700);
+
+    GKeyFile* key_file = g_key_file_new();
+    g_key_file_load_from_file(key_file, path, G_KEY_FILE_KEEP_COMMENTS, NULL);
+    g_key_file_set_string(key_file, "save", "durability", durability_keys[settings->save_durability]);
+    g_key_file_set_boolean(key_file, "view", "word_wrap", settings->word_wrap);
+    g_key_file_set_int64(key_file, "view", "wrap_size_limit", settings->wrap_size_limit);
+
+    GError* error = NULL;
+    if (!g_key_file_save_to_file(key_file, path, &error))
+    {
+        g_warning("无法保存设置 %s: %s", path, error->message);
+        g_error_free(error);
+    }
+
+    g_key_file_free(key_file);
+    g_free(directory);
+    g_free(path);
+}
+
+const gchar* save_durability_label(SaveDurability durability)
+{
+    return durability_labels[durability];
+}
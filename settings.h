@@ -0,0 +1,24 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include "encoding.h"
+
+// 跨会话保存的用户设置
+typedef struct NotepadSettings
+{
+    SaveDurability save_durability;     // 保存方式
+    gboolean word_wrap;                 // 是否自动换行
+    gint64 wrap_size_limit;             // 超过该大小（字节）的文件打开时不自动换行
+} NotepadSettings;
+
+extern void settings_init_default(NotepadSettings* settings);
+extern void settings_load(NotepadSettings* settings);          // 读取失败时保留默认值
+extern void settings_save(const NotepadSettings* settings);
+
+extern const gchar* save_durability_label(SaveDurability durability); // 菜单中显示的名称
+
+#endif // SETTINGS_H
@@ -0,0 +1,328 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "text_diff.h"
+#include "fingerprint.h"
+#include <string.h>
+
+// 每次查找中间蛇形时探索的最大编辑距离，超过后该段整体视为替换（只限制时间，空间与之无关）
+#define DIFF_MAX_EDIT_DISTANCE 8192
+
+// 线性空间差异的状态：两个方向的 V 数组在各层递归间复用，结果记录为每行是否改变
+typedef struct DiffContext
+{
+    const uint64_t* a;
+    const uint64_t* b;
+    guint8* old_changed;
+    guint8* new_changed;
+    gint* forward;
+    gint* backward;
+} DiffContext;
+
+// 与 GtkTextBuffer 的分行规则保持一致：\n、\r\n、\r 和 U+2029
+const char* text_find_line_break(const char* text, gsize length, gsize* break_length)
+{
+    for (gsize i = 0; i < length; i++)
+    {
+        char c = text[i];
+        if (c == '\n')
+        {
+            *break_length = 1;
+            return text + i;
+        }
+        if (c == '\r')
+        {
+            *break_length = (i + 1 < length && text[i + 1] == '\n') ? 2 : 1;
+            return text + i;
+        }
+        if ((guchar)c == 0xE2 && i + 2 < length &&
+            (guchar)text[i + 1] == 0x80 && (guchar)text[i + 2] == 0xA9)
+        {
+            *break_length = 3;
+            return text + i;
+        }
+    }
+    return NULL;
+}
+
+// 规则同上。按 \n 分段用 memchr 扫描，段内再找单独的 \r 和 U+2029
+guint text_count_line_breaks(const char* text, gsize length)
+{
+    guint count = 0;
+    const char* end = text + length;
+    while (text < end)
+    {
+        const char* newline = memchr(text, '\n', (gsize)(end - text));
+        const char* segment_end = newline ? newline : end;
+
+        for (const char* cr = text; (cr = memchr(cr, '\r', (gsize)(segment_end - cr))) != NULL; cr++)
+        {
+            if (!(newline && cr + 1 == newline))
+                count++;
+        }
+        for (const char* e2 = text; (e2 = memchr(e2, 0xE2, (gsize)(segment_end - e2))) != NULL; e2++)
+        {
+            if (end - e2 >= 3 && (guchar)e2[1] == 0x80 && (guchar)e2[2] == 0xA9)
+                count++;
+        }
+
+        if (!newline)
+            break;
+        count++;
+        text = newline + 1;
+    }
+    return count;
+}
+
+TextLines* text_lines_split(const char* text, gsize length)
+{
+    TextLines* lines = g_new0(TextLines, 1);
+    lines->text = text;
+    lines->length = length;
+
+    GArray* starts = g_array_new(FALSE, FALSE, sizeof(gsize));
+    gsize pos = 0;
+    g_array_append_val(starts, pos);
+
+    while (pos < length)
+    {
+        gsize break_length;
+        const char* line_break = text_find_line_break(text + pos, length - pos, &break_length);
+        pos = line_break ? (gsize)(line_break - text) + break_length : length;
+        g_array_append_val(starts, pos);
+    }
+
+    lines->count = starts->len - 1;
+    lines->starts = (gsize*)g_array_free(starts, FALSE);
+    lines->hashes = g_new(uint64_t, lines->count > 0 ? lines->count : 1);
+
+    for (guint i = 0; i < lines->count; i++)
+    {
+        lines->hashes[i] = content_hash_bytes(text + lines->starts[i],
+                                              lines->starts[i + 1] - lines->starts[i]);
+    }
+
+    return lines;
+}
+
+void text_lines_free(TextLines* lines)
+{
+    if (lines)
+    {
+        g_free(lines->starts);
+        g_free(lines->hashes);
+        g_free(lines);
+    }
+}
+
+static void append_hunk(GArray* hunks, guint old_start, guint old_count, guint new_start, guint new_count)
+{
+    if (old_count == 0 && new_count == 0)
+        return;
+
+    DiffHunk hunk = {old_start, old_count, new_start, new_count};
+    g_array_append_val(hunks, hunk);
+}
+
+// 在 a[a_lo, a_hi) 与 b[b_lo, b_hi) 之间同时从两端执行 Myers O(ND) 贪心算法，
+// 两个方向的路径重叠处即中间蛇形，返回其起点（相对偏移）作为分割点。两端首行必须不同
+static gboolean find_middle_snake(DiffContext* context, gint a_lo, gint a_hi, gint b_lo, gint b_hi,
+                                  gint* split_x, gint* split_y)
+{
+    const uint64_t* a = context->a + a_lo;
+    const uint64_t* b = context->b + b_lo;
+    gint n = a_hi - a_lo;
+    gint m = b_hi - b_lo;
+    gint max_d = MIN((n + m + 1) / 2, DIFF_MAX_EDIT_DISTANCE);
+    gint offset = max_d + 1;
+    gint length = 2 * max_d + 3;
+    gint* v1 = context->forward;
+    gint* v2 = context->backward;
+
+    for (gint i = 0; i < length; i++)
+    {
+        v1[i] = -1;
+        v2[i] = -1;
+    }
+    v1[offset + 1] = 0;
+    v2[offset + 1] = 0;
+
+    // 两个方向的对角线差值为奇数时在正向检查重叠，否则在反向检查
+    gint delta = n - m;
+    gboolean front = (delta & 1) != 0;
+    gint k1_start = 0, k1_end = 0, k2_start = 0, k2_end = 0;
+
+    for (gint d = 0; d < max_d; d++)
+    {
+        for (gint k1 = -d + k1_start; k1 <= d - k1_end; k1 += 2)
+        {
+            gint k1_offset = offset + k1;
+            gint x1;
+            if (k1 == -d || (k1 != d && v1[k1_offset - 1] < v1[k1_offset + 1]))
+                x1 = v1[k1_offset + 1];
+            else
+                x1 = v1[k1_offset - 1] + 1;
+
+            gint y1 = x1 - k1;
+            while (x1 < n && y1 < m && a[x1] == b[y1])
+            {
+                x1++;
+                y1++;
+            }
+            v1[k1_offset] = x1;
+
+            if (x1 > n)
+            {
+                k1_end += 2;    // 越过右边界，之后不再探索这一侧的对角线
+            }
+            else if (y1 > m)
+            {
+                k1_start += 2;  // 越过下边界
+            }
+            else if (front)
+            {
+                gint k2_offset = offset + delta - k1;
+                if (k2_offset >= 0 && k2_offset < length && v2[k2_offset] != -1 && x1 >= n - v2[k2_offset])
+                {
+                    *split_x = x1;
+                    *split_y = y1;
+                    return TRUE;
+                }
+            }
+        }
+
+        for (gint k2 = -d + k2_start; k2 <= d - k2_end; k2 += 2)
+        {
+            gint k2_offset = offset + k2;
+            gint x2;
+            if (k2 == -d || (k2 != d && v2[k2_offset - 1] < v2[k2_offset + 1]))
+                x2 = v2[k2_offset + 1];
+            else
+                x2 = v2[k2_offset - 1] + 1;
+
+            gint y2 = x2 - k2;
+            while (x2 < n && y2 < m && a[n - x2 - 1] == b[m - y2 - 1])
+            {
+                x2++;
+                y2++;
+            }
+            v2[k2_offset] = x2;
+
+            if (x2 > n)
+            {
+                k2_end += 2;
+            }
+            else if (y2 > m)
+            {
+                k2_start += 2;
+            }
+            else if (!front)
+            {
+                gint k1_offset = offset + delta - k2;
+                if (k1_offset >= 0 && k1_offset < length && v1[k1_offset] != -1)
+                {
+                    gint x1 = v1[k1_offset];
+                    if (x1 >= n - x2)
+                    {
+                        *split_x = x1;
+                        *split_y = offset + x1 - k1_offset;
+                        return TRUE;
+                    }
+                }
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+static void mark_changed(guint8* changed, gint start, gint end)
+{
+    if (end > start)
+        memset(changed + start, 1, (gsize)(end - start));
+}
+
+// 分治：在中间蛇形处一分为二，两半分别递归。空间只有 V 数组，与编辑距离的平方无关
+static void diff_range(DiffContext* context, gint a_lo, gint a_hi, gint b_lo, gint b_hi)
+{
+    // 去掉公共前缀和后缀，大文件的少量修改通常在这里就缩小到几行
+    while (a_lo < a_hi && b_lo < b_hi && context->a[a_lo] == context->b[b_lo])
+    {
+        a_lo++;
+        b_lo++;
+    }
+    while (a_lo < a_hi && b_lo < b_hi && context->a[a_hi - 1] == context->b[b_hi - 1])
+    {
+        a_hi--;
+        b_hi--;
+    }
+
+    if (a_lo == a_hi || b_lo == b_hi)
+    {
+        mark_changed(context->old_changed, a_lo, a_hi);
+        mark_changed(context->new_changed, b_lo, b_hi);
+        return;
+    }
+
+    gint x, y;
+    if (!find_middle_snake(context, a_lo, a_hi, b_lo, b_hi, &x, &y))
+    {
+        // 没有公共行，或差异过大，整体替换这一段
+        mark_changed(context->old_changed, a_lo, a_hi);
+        mark_changed(context->new_changed, b_lo, b_hi);
+        return;
+    }
+
+    diff_range(context, a_lo, a_lo + x, b_lo, b_lo + y);
+    diff_range(context, a_lo + x, a_hi, b_lo + y, b_hi);
+}
+
+GArray* text_diff_lines(const TextLines* old_lines, const TextLines* new_lines)
+{
+    GArray* hunks = g_array_new(FALSE, FALSE, sizeof(DiffHunk));
+    gint n = (gint)old_lines->count;
+    gint m = (gint)new_lines->count;
+    gint max_d = MIN((n + m + 1) / 2, DIFF_MAX_EDIT_DISTANCE);
+
+    DiffContext context;
+    context.a = old_lines->hashes;
+    context.b = new_lines->hashes;
+    context.old_changed = g_new0(guint8, n + 1);
+    context.new_changed = g_new0(guint8, m + 1);
+    context.forward = g_new(gint, 2 * max_d + 3);
+    context.backward = g_new(gint, 2 * max_d + 3);
+
+    diff_range(&context, 0, n, 0, m);
+
+    // 未改变的行两两对应，其间连续改变的行组成差异块
+    gint i = 0, j = 0;
+    while (i < n || j < m)
+    {
+        if (i < n && j < m && !context.old_changed[i] && !context.new_changed[j])
+        {
+            i++;
+            j++;
+            continue;
+        }
+
+        gint old_start = i, new_start = j;
+        while (i < n && context.old_changed[i])
+            i++;
+        while (j < m && context.new_changed[j])
+            j++;
+        if (i == old_start && j == new_start)
+        {
+            // 只有一侧剩下未改变的行，不应出现，剩余部分作为一个差异块
+            i = n;
+            j = m;
+        }
+        append_hunk(hunks, old_start, i - old_start, new_start, j - new_start);
+    }
+
+    g_free(context.old_changed);
+    g_free(context.new_changed);
+    g_free(context.forward);
+    g_free(context.backward);
+    return hunks;
+}
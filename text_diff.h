@@ -0,0 +1,40 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef TEXT_DIFF_H
+#define TEXT_DIFF_H
+
+#include <stdint.h>
+#include <glib.h>
+
+// 按行切分后的文本视图（不复制文本，只记录行首偏移和行哈希）
+typedef struct TextLines
+{
+    const char* text;
+    gsize length;
+    guint count;            // 行数（包含行尾换行符的完整行，最后一行可能没有换行符）
+    gsize* starts;          // count + 1 个偏移，starts[count] == length
+    uint64_t* hashes;       // 每行内容的哈希，相等视为同一行
+} TextLines;
+
+// 差异块：旧文本 [old_start, old_start + old_count) 行替换为新文本 [new_start, new_start + new_count) 行
+typedef struct DiffHunk
+{
+    guint old_start;
+    guint old_count;
+    guint new_start;
+    guint new_count;
+} DiffHunk;
+
+// 查找第一个换行（\n、\r\n、\r 或 U+2029），break_length 返回其字节数；没有换行时返回 NULL
+extern const char* text_find_line_break(const char* text, gsize length, gsize* break_length);
+// 统计换行个数，即 GtkTextBuffer 中这段文本跨过的行数
+extern guint text_count_line_breaks(const char* text, gsize length);
+extern TextLines* text_lines_split(const char* text, gsize length);
+extern void text_lines_free(TextLines* lines);
+
+// 计算行级差异，返回 DiffHunk 数组（按位置递增），调用者负责 g_array_unref
+extern GArray* text_diff_lines(const TextLines* old_lines, const TextLines* new_lines);
+
+#endif // TEXT_DIFF_H
@@ -0,0 +1,379 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "text_search.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXT_SEARCH_SSE2 1
+#endif
+
+#define SEARCH_BLOCK_SIZE   (256 * 1024)        // 每扫描一块检查一次取消和其他线程的结果
+#define SEARCH_MIN_CHUNK    (4 * 1024 * 1024)   // 小于该大小的范围不值得再拆给更多线程
+
+typedef struct SearchChunk
+{
+    const SearchPattern* pattern;
+    const char* text;
+    gsize text_length;
+    gsize start;            // 只接受起点位于 [start, end) 的匹配
+    gsize end;
+    gint index;
+    gint* best_index;       // 已找到匹配的最小块序号（查找第一个匹配时使用）
+    GCancellable* cancellable;
+    gboolean found;
+    gsize match;
+    GArray* matches;        // 查找全部匹配时使用，最多保存 limit 个
+    guint limit;
+    guint64 count;          // 块内的匹配总数，包括没有保存的
+    gsize last_end;         // 块内最后一个匹配的结尾
+} SearchChunk;
+
+void text_search_pattern_init(SearchPattern* pattern, const char* needle, gsize length, gboolean case_sensitive)
+{
+    pattern->needle = needle;
+    pattern->length = length;
+    pattern->case_sensitive = case_sensitive;
+
+    guchar first = length > 0 ? (guchar)needle[0] : 0;
+    guchar last = length > 0 ? (guchar)needle[length - 1] : 0;
+    pattern->fold_first = !case_sensitive && g_ascii_isalpha(first);
+    pattern->fold_last = !case_sensitive && g_ascii_isalpha(last);
+    pattern->first = pattern->fold_first ? (guchar)g_ascii_tolower(first) : first;
+    pattern->last = pattern->fold_last ? (guchar)g_ascii_tolower(last) : last;
+}
+
+gboolean text_search_pattern_supported(const char* needle, gboolean case_sensitive)
+{
+    if (case_sensitive)
+        return TRUE;
+
+    for (const guchar* p = (const guchar*)needle; *p; p++)
+    {
+        if (*p >= 0x80)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static inline gboolean verify_match(const SearchPattern* pattern, const char* candidate)
+{
+    if (pattern->case_sensitive)
+        return memcmp(candidate, pattern->needle, pattern->length) == 0;
+
+    for (gsize i = 0; i < pattern->length; i++)
+    {
+        if (g_ascii_tolower(candidate[i]) != g_ascii_tolower(pattern->needle[i]))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+// 先用首尾两个字节筛选候选位置（SSE2 一次比较 16 个位置），再逐个完整比较
+const char* text_search_find(const SearchPattern* pattern, const char* text, gsize length)
+{
+    gsize n = pattern->length;
+    if (n == 0 || length < n)
+        return NULL;
+
+    gsize last_start = length - n;
+    gsize i = 0;
+
+#ifdef TEXT_SEARCH_SSE2
+    const __m128i first = _mm_set1_epi8((char)pattern->first);
+    const __m128i last = _mm_set1_epi8((char)pattern->last);
+    const __m128i fold_first = _mm_set1_epi8(pattern->fold_first ? 0x20 : 0);
+    const __m128i fold_last = _mm_set1_epi8(pattern->fold_last ? 0x20 : 0);
+
+    while (i + 15 <= last_start)
+    {
+        __m128i block_first = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i block_last = _mm_loadu_si128((const __m128i*)(text + i + n - 1));
+        block_first = _mm_or_si128(block_first, fold_first);
+        block_last = _mm_or_si128(block_last, fold_last);
+
+        guint mask = (guint)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                                                            _mm_cmpeq_epi8(block_last, last)));
+        while (mask)
+        {
+            gint bit = g_bit_nth_lsf(mask, -1);
+            if (verify_match(pattern, text + i + bit))
+                return text + i + bit;
+            mask &= mask - 1;
+        }
+        i += 16;
+    }
+#endif
+
+    for (; i <= last_start; i++)
+    {
+        guchar c = (guchar)text[i];
+        guchar d = (guchar)text[i + n - 1];
+        if (pattern->fold_first)
+            c |= 0x20;
+        if (pattern->fold_last)
+            d |= 0x20;
+        if (c == pattern->first && d == pattern->last && verify_match(pattern, text + i))
+            return text + i;
+    }
+
+    return NULL;
+}
+
+static gpointer search_first_worker(gpointer data)
+{
+    SearchChunk* chunk = (SearchChunk*)data;
+    gsize n = chunk->pattern->length;
+
+    for (gsize pos = chunk->start; pos < chunk->end; pos += SEARCH_BLOCK_SIZE)
+    {
+        // 更靠前的块已经找到匹配，或者已被取消
+        if (g_atomic_int_get(chunk->best_index) < chunk->index ||
+            g_cancellable_is_cancelled(chunk->cancellable))
+            break;
+
+        gsize block_end = MIN(pos + SEARCH_BLOCK_SIZE, chunk->end);
+        gsize hay_end = MIN(block_end + n - 1, chunk->text_length);
+        const char* found = text_search_find(chunk->pattern, chunk->text + pos, hay_end - pos);
+        if (found)
+        {
+            chunk->found = TRUE;
+            chunk->match = (gsize)(found - chunk->text);
+
+            gint best = g_atomic_int_get(chunk->best_index);
+            while (chunk->index < best &&
+                   !g_atomic_int_compare_and_exchange(chunk->best_index, best, chunk->index))
+                best = g_atomic_int_get(chunk->best_index);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static gpointer search_all_worker(gpointer data)
+{
+    SearchChunk* chunk = (SearchChunk*)data;
+    gsize n = chunk->pattern->length;
+    gsize pos = chunk->start;
+
+    while (pos < chunk->end)
+    {
+        if (g_cancellable_is_cancelled(chunk->cancellable))
+            break;
+
+        gsize block_end = MIN(pos + SEARCH_BLOCK_SIZE, chunk->end);
+        gsize hay_end = MIN(block_end + n - 1, chunk->text_length);
+        const char* found = text_search_find(chunk->pattern, chunk->text + pos, hay_end - pos);
+        if (!found)
+        {
+            pos = block_end;
+            continue;
+        }
+
+        SearchMatch match;
+        match.start = (gsize)(found - chunk->text);
+        match.end = match.start + n;
+        if (chunk->matches->len < chunk->limit)
+            g_array_append_val(chunk->matches, match);
+        chunk->count++;
+        chunk->last_end = match.end;
+        pos = match.end;
+    }
+
+    return NULL;
+}
+
+// 把 [from, length) 切成若干块，块之间重叠 pattern 长度，交给多个线程并行执行
+static guint run_chunks(const SearchPattern* pattern, const char* text, gsize length, gsize from,
+                        GCancellable* cancellable, gint* best_index, GThreadFunc worker,
+                        guint limit, SearchChunk** out_chunks)
+{
+    gsize range = length - from;
+    guint threads = MAX(1, g_get_num_processors());
+    guint count = (guint)MIN((gsize)threads, MAX((gsize)1, range / SEARCH_MIN_CHUNK));
+    gsize chunk_size = range / count + 1;
+
+    SearchChunk* chunks = g_new0(SearchChunk, count);
+    for (guint i = 0; i < count; i++)
+    {
+        chunks[i].pattern = pattern;
+        chunks[i].text = text;
+        chunks[i].text_length = length;
+        chunks[i].start = MIN(from + i * chunk_size, length);
+        chunks[i].end = MIN(chunks[i].start + chunk_size, length);
+        chunks[i].index = (gint)i;
+        chunks[i].best_index = best_index;
+        chunks[i].cancellable = cancellable;
+        chunks[i].limit = limit;
+        if (limit > 0)
+            chunks[i].matches = g_array_new(FALSE, FALSE, sizeof(SearchMatch));
+    }
+
+    GThread** workers = g_new0(GThread*, count);
+    for (guint i = 1; i < count; i++)
+        workers[i] = g_thread_new("text-search", worker, &chunks[i]);
+
+    worker(&chunks[0]); // 第一块在当前线程执行
+
+    for (guint i = 1; i < count; i++)
+        g_thread_join(workers[i]);
+    g_free(workers);
+
+    *out_chunks = chunks;
+    return count;
+}
+
+gboolean text_search_parallel_first(const SearchPattern* pattern, const char* text, gsize length,
+                                    gsize from, GCancellable* cancellable, gsize* match)
+{
+    if (pattern->length == 0 || from >= length)
+        return FALSE;
+
+    gint best_index = G_MAXINT;
+    SearchChunk* chunks;
+    guint count = run_chunks(pattern, text, length, from, cancellable, &best_index,
+                             search_first_worker, 0, &chunks);
+
+    gboolean found = FALSE;
+    for (guint i = 0; i < count; i++)
+    {
+        if (chunks[i].found)
+        {
+            *match = chunks[i].match;
+            found = TRUE;
+            break;
+        }
+    }
+
+    g_free(chunks);
+    return found && !g_cancellable_is_cancelled(cancellable);
+}
+
+GArray* text_search_parallel_all(const SearchPattern* pattern, const char* text, gsize length, guint limit,
+                                 GCancellable* cancellable, guint64* count)
+{
+    GArray* result = g_array_new(FALSE, FALSE, sizeof(SearchMatch));
+    *count = 0;
+    if (pattern->length == 0 || length == 0)
+        return result;
+
+    gint unused = G_MAXINT;
+    SearchChunk* chunks;
+    guint chunk_count = run_chunks(pattern, text, length, 0, cancellable, &unused,
+                                   search_all_worker, limit, &chunks);
+
+    // 按顺序合并。若某块的第一个匹配与上一块最后一个匹配重叠，
+    // 从上一块匹配的结尾重新顺序扫描该块，保证结果与单线程一致
+    gsize previous_end = 0;
+    for (guint i = 0; i < chunk_count; i++)
+    {
+        SearchChunk* chunk = &chunks[i];
+        if (chunk->matches->len > 0 &&
+            g_array_index(chunk->matches, SearchMatch, 0).start < previous_end)
+        {
+            g_array_set_size(chunk->matches, 0);
+            chunk->count = 0;
+            chunk->start = previous_end;
+            search_all_worker(chunk);
+        }
+
+        guint room = limit - result->len;
+        g_array_append_vals(result, chunk->matches->data, MIN(chunk->matches->len, room));
+        *count += chunk->count;
+        if (chunk->count > 0)
+            previous_end = chunk->last_end;
+        g_array_free(chunk->matches, TRUE);
+    }
+    g_free(chunks);
+
+    return result;
+}
+
+gsize text_search_replace(const SearchPattern* pattern, const char* text, gsize length, gboolean at_end,
+                          const char* replacement, gsize replacement_length, GString* out, guint64* count)
+{
+    gsize pos = 0;
+    const char* found;
+    while ((found = text_search_find(pattern, text + pos, length - pos)) != NULL)
+    {
+        if (out)
+        {
+            g_string_append_len(out, text + pos, (gssize)(found - (text + pos)));
+            g_string_append_len(out, replacement, (gssize)replacement_length);
+        }
+        pos = (gsize)(found - text) + pattern->length;
+        (*count)++;
+    }
+
+    // 末尾不足一个 needle 的部分可能是跨块匹配的开头，留给下一块；退到字符边界，输出总是完整的字符
+    gsize safe_end = length;
+    if (!at_end)
+    {
+        safe_end = length - MIN(length - pos, pattern->length - 1);
+        while (safe_end > pos && ((guchar)text[safe_end] & 0xC0) == 0x80)
+            safe_end--;
+    }
+    if (out)
+        g_string_append_len(out, text + pos, (gssize)(safe_end - pos));
+    return safe_end;
+}
+
+// 统计 8 字节中 UTF-8 续字节（10xxxxxx）之外的字节数
+static inline guint count_char_starts(guint64 word)
+{
+    guint64 continuation = (word >> 7) & ~(word >> 6) & G_GUINT64_CONSTANT(0x0101010101010101);
+    return 8 - (guint)((continuation * G_GUINT64_CONSTANT(0x0101010101010101)) >> 56);
+}
+
+gsize text_search_char_offset(const char* text, gsize byte_offset)
+{
+    gsize count = 0;
+    gsize i = 0;
+
+    for (; i + 8 <= byte_offset; i += 8)
+    {
+        guint64 word;
+        memcpy(&word, text + i, 8);
+        count += count_char_starts(word);
+    }
+    for (; i < byte_offset; i++)
+    {
+        if (((guchar)text[i] & 0xC0) != 0x80)
+            count++;
+    }
+
+    return count;
+}
+
+gsize text_search_byte_offset(const char* text, gsize length, gsize char_offset)
+{
+    gsize count = 0;
+    gsize i = 0;
+
+    // 按 8 字节快速跳过，直到剩余字符数不足一个字
+    while (i + 8 <= length)
+    {
+        guint64 word;
+        memcpy(&word, text + i, 8);
+        guint starts = count_char_starts(word);
+        if (count + starts > char_offset)
+            break;
+        count += starts;
+        i += 8;
+    }
+
+    for (; i < length; i++)
+    {
+        if (((guchar)text[i] & 0xC0) != 0x80)
+        {
+            if (count == char_offset)
+                return i;
+            count++;
+        }
+    }
+
+    return length;
+}
@@ -0,0 +1,56 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef TEXT_SEARCH_H
+#define TEXT_SEARCH_H
+
+#include <gio/gio.h>
+
+// 预处理后的查找模式（按字节匹配，不区分大小写时只折叠 ASCII 字母）
+typedef struct SearchPattern
+{
+    const char* needle;
+    gsize length;
+    gboolean case_sensitive;
+    guchar first;           // 首字节（不区分大小写时为小写）
+    guchar last;            // 尾字节
+    gboolean fold_first;    // 首字节是否为字母，需要折叠比较
+    gboolean fold_last;
+} SearchPattern;
+
+// 匹配结果（字节偏移）
+typedef struct SearchMatch
+{
+    gsize start;
+    gsize end;
+} SearchMatch;
+
+extern void text_search_pattern_init(SearchPattern* pattern, const char* needle, gsize length, gboolean case_sensitive);
+
+// 该模式能否用字节匹配器处理（不区分大小写且含非 ASCII 字符时需要 Unicode 折叠，不支持）
+extern gboolean text_search_pattern_supported(const char* needle, gboolean case_sensitive);
+
+// 单线程查找 [text, text + length) 中第一个匹配，找不到返回 NULL
+extern const char* text_search_find(const SearchPattern* pattern, const char* text, gsize length);
+
+// 多线程分块查找 [from, length) 中的第一个匹配
+extern gboolean text_search_parallel_first(const SearchPattern* pattern, const char* text, gsize length,
+                                           gsize from, GCancellable* cancellable, gsize* match);
+
+// 多线程分块查找所有不重叠的匹配，返回按位置递增的 SearchMatch 数组，只保存最前面的 limit 个（至少为 1）。
+// count 返回匹配总数，大于数组长度时结果不完整
+extern GArray* text_search_parallel_all(const SearchPattern* pattern, const char* text, gsize length, guint limit,
+                                        GCancellable* cancellable, guint64* count);
+
+// 把 [text, text + length) 中所有不重叠的匹配替换为 replacement 追加到 out（out 为 NULL 时只计数），
+// count 累加匹配数，返回处理掉的字节数。at_end 为 FALSE 时末尾可能属于跨块匹配的几个字节不处理，
+// 调用者把它们与后续文本拼接后再次传入。全部替换和批处理共用
+extern gsize text_search_replace(const SearchPattern* pattern, const char* text, gsize length, gboolean at_end,
+                                 const char* replacement, gsize replacement_length, GString* out, guint64* count);
+
+// UTF-8 字节偏移与字符偏移互相转换
+extern gsize text_search_char_offset(const char* text, gsize byte_offset);
+extern gsize text_search_byte_offset(const char* text, gsize length, gsize char_offset);
+
+#endif // TEXT_SEARCH_H
@@ -5,23 +5,167 @@
 #include "ui.h"
 #include "file_operations.h"
 #include "output_exception.h"
+#include "text_search.h"
+#include "long_lines.h"
+#include "paste.h"
+#include "long_operation.h"
+#include "incremental_search.h"
+#include "line_ops.h"
+#include "perf_hud.h"
+#include "filter_view.h"
 #include <stdlib.h>
 #include <string.h>
 
+// 文档字符数超过该值时，查找改为在后台线程中对快照并行进行
+#define PARALLEL_SEARCH_THRESHOLD (8 * 1024 * 1024)
+
+// 后台查找任务
+typedef struct FindJob
+{
+    NotepadApp* app;
+    GBytes* snapshot;
+    guint generation;       // 快照对应的内容版本
+    gchar* needle;
+    gboolean case_sensitive;
+    gsize from;             // 起始字符偏移
+    gsize match_start;      // 结果（字符偏移）
+    gsize match_end;
+    LongOperation* operation;
+    gint64 start_time;      // 开始查找的时间，用于性能面板
+} FindJob;
+
+#define REPLACE_BLOCK_SIZE (1024 * 1024)   // 全部替换每次扫描的字节数，块之间报告进度并检查取消
+
+// 后台全部替换任务
+typedef struct ReplaceJob
+{
+    NotepadApp* app;
+    GBytes* snapshot;
+    guint generation;
+    gchar* needle;
+    gchar* replacement;
+    GString* result;        // 替换后的全文
+    guint64 count;
+    LongOperation* operation;
+} ReplaceJob;
+
+// 后台行操作任务，作用于选区所在的整行或整个文档
+typedef struct LineJob
+{
+    NotepadApp* app;
+    GBytes* snapshot;
+    guint generation;
+    LineOperation kind;
+    gchar* pattern;         // 保留/删除匹配的行时要匹配的文本
+    gboolean case_sensitive;
+    gint start;             // 处理范围（字符偏移）
+    gint end;
+    gsize start_byte;       // 处理范围（字节偏移），在工作线程中换算
+    gsize end_byte;
+    GBytes* result;
+    guint lines;            // 结果的行数
+    LongOperation* operation;
+} LineJob;
+
+#define FONT_PREVIEW_DELAY 150      // 字体预览的防抖间隔（毫秒）
+
+// 字体对话框的预览状态
+typedef struct FontPreview
+{
+    GtkWidget* text;
+    GtkWidget* primary_button;
+    GtkWidget* fallback_button;
+    GtkCssProvider* provider;   // 预览使用的唯一样式提供者，每次更新只重新加载内容
+    guint update_id;            // 等待中的防抖更新
+} FontPreview;
+
 // 撤销/重做相关函数
 void push_undo_action(NotepadApp* app, UndoType type, gint position, const gchar* text)
 {
     if (!app->ui->recording_changes) return;
 
+    GBytes* bytes = g_bytes_new(text, strlen(text));
+    push_undo_action_bytes(app, type, position, bytes);
+    g_bytes_unref(bytes);
+}
+
+// 一条撤销记录占用的字节数
+static gsize action_size(const UndoAction* action)
+{
+    gsize bytes = sizeof(UndoAction) + g_bytes_get_size(action->text);
+    if (action->replacement)
+        bytes += g_bytes_get_size(action->replacement);
+    return bytes;
+}
+
+void push_undo_action_bytes(NotepadApp* app, UndoType type, gint position, GBytes* text)
+{
+    if (!app->ui->recording_changes) return;
+
     UndoAction* action = (UndoAction*)malloc(sizeof(UndoAction));
     action->type = type;
     action->position = position;
-    action->text = g_strdup(text);
+    action->text = g_bytes_ref(text);
+    action->replacement = NULL;
+    action->serial = ++app->ui->undo_serial;
     action->next = app->ui->undo_stack;
     app->ui->undo_stack = action;
+    app->ui->undo_count++;
+    app->ui->undo_bytes += action_size(action);
 
     // 清空重做栈
     clear_undo_stack(&app->ui->redo_stack);
+    app->ui->redo_count = 0;
+    app->ui->redo_bytes = 0;
+}
+
+void push_undo_replace(NotepadApp* app, gint position, GBytes* text, GBytes* replacement)
+{
+    if (!app->ui->recording_changes) return;
+
+    push_undo_action_bytes(app, UNDO_REPLACE, position, text);
+    app->ui->undo_stack->replacement = g_bytes_ref(replacement);
+    app->ui->undo_bytes += g_bytes_get_size(replacement);
+}
+
+void replace_range_undoable(NotepadApp* app, gint start, gint end, GBytes* original, GBytes* replacement)
+{
+    // 暂停撤销记录和增量统计，调用者负责重新统计
+    GtkTextIter start_iter, end_iter;
+    gtk_text_buffer_get_iter_at_offset(app->ui->buffer, &start_iter, start);
+    gtk_text_buffer_get_iter_at_offset(app->ui->buffer, &end_iter, end);
+    gboolean stats_suspended = app->ui->stats_suspended;
+    app->ui->recording_changes = FALSE;
+    app->ui->stats_suspended = TRUE;
+    gtk_text_buffer_delete(app->ui->buffer, &start_iter, &end_iter);
+    gsize length;
+    const gchar* text = g_bytes_get_data(replacement, &length);
+    if (length > 0)
+        gtk_text_buffer_insert(app->ui->buffer, &start_iter, text, (gint)length);
+    app->ui->recording_changes = TRUE;
+    app->ui->stats_suspended = stats_suspended;
+
+    push_undo_replace(app, start, original, replacement);
+    notepad_update_modified(app);
+}
+
+gsize undo_stack_size(UndoAction* stack, guint* count)
+{
+    gsize bytes = 0;
+    for (UndoAction* action = stack; action; action = action->next)
+    {
+        (*count)++;
+        bytes += action_size(action);
+    }
+    return bytes;
+}
+
+void undo_history_recount(NotepadApp* app)
+{
+    app->ui->undo_count = 0;
+    app->ui->redo_count = 0;
+    app->ui->undo_bytes = undo_stack_size(app->ui->undo_stack, &app->ui->undo_count);
+    app->ui->redo_bytes = undo_stack_size(app->ui->redo_stack, &app->ui->redo_count);
 }
 
 void clear_undo_stack(UndoAction** stack)
@@ -30,33 +174,79 @@ void clear_undo_stack(UndoAction** stack)
     {
         UndoAction* action = *stack;
         *stack = action->next;
-        g_free(action->text);
+        g_bytes_unref(action->text);
+        if (action->replacement)
+            g_bytes_unref(action->replacement);
         free(action);
     }
 }
 
+// 迭代器前一个字符，位于文档开头时返回 0
+static gunichar char_before(const GtkTextIter* iter)
+{
+    GtkTextIter previous = *iter;
+    return gtk_text_iter_backward_char(&previous) ? gtk_text_iter_get_char(&previous) : 0;
+}
+
 void on_text_insert(GtkTextBuffer* buffer, GtkTextIter* location, gchar* text, gint len, gpointer data)
 {
     NotepadApp* app = (NotepadApp*)data;
+
+    // 粘贴或输入的 \r\n、\r 先统一为 \n，缓冲区内部只保存一种换行
+    if (memchr(text, '\r', (gsize)len))
+    {
+        gchar* normalized = g_strndup(text, len);
+        gsize normalized_length = (gsize)len;
+        line_ending_normalize(normalized, &normalized_length, app->line_ending);
+        g_signal_stop_emission_by_name(buffer, "insert-text");
+        gtk_text_buffer_insert(buffer, location, normalized, (gint)normalized_length);
+        g_free(normalized);
+        return;
+    }
+
     if (app->ui->recording_changes)
     {
         gint position = gtk_text_iter_get_offset(location);
-        gchar* text_copy = g_strndup(text, len);
-        push_undo_action(app, UNDO_DELETE, position, text_copy);
-        g_free(text_copy);
+        GBytes* inserted = g_bytes_new(text, (gsize)len);
+        push_undo_action_bytes(app, UNDO_DELETE, position, inserted);
+        g_bytes_unref(inserted);
+    }
+
+    // 只根据插入点两侧的字符和插入的文本更新统计
+    if (!app->ui->stats_suspended)
+    {
+        DocStats delta;
+        doc_stats_edit_delta(char_before(location), text, (gsize)len, gtk_text_iter_get_char(location), &delta);
+        doc_stats_add(&app->ui->stats, &delta, 1);
+        notepad_schedule_stats_update(app);
     }
 }
 
 void on_text_delete(GtkTextBuffer* buffer, GtkTextIter* start, GtkTextIter* end, gpointer data)
 {
     NotepadApp* app = (NotepadApp*)data;
+    gboolean update_stats = !app->ui->stats_suspended;
+    if (!app->ui->recording_changes && !update_stats)
+        return;
+
+    // 被删除的文本只取一次，撤销记录直接持有，统计共用
+    gchar* deleted_text = gtk_text_buffer_get_text(buffer, start, end, TRUE);
+    gsize deleted_length = strlen(deleted_text);
+    GBytes* deleted = g_bytes_new_take(deleted_text, deleted_length);
     if (app->ui->recording_changes)
     {
         gint position = gtk_text_iter_get_offset(start);
-        gchar* deleted_text = gtk_text_buffer_get_text(buffer, start, end, FALSE);
-        push_undo_action(app, UNDO_INSERT, position, deleted_text);
-        g_free(deleted_text);
+        push_undo_action_bytes(app, UNDO_INSERT, position, deleted);
     }
+
+    if (update_stats)
+    {
+        DocStats delta;
+        doc_stats_edit_delta(char_before(start), deleted_text, deleted_length, gtk_text_iter_get_char(end), &delta);
+        doc_stats_add(&app->ui->stats, &delta, -1);
+        notepad_schedule_stats_update(app);
+    }
+    g_bytes_unref(deleted);
 }
 
 void on_cursor_moved(GtkTextBuffer* buffer, GParamSpec* pspec, gpointer data)
@@ -65,6 +255,46 @@ void on_cursor_moved(GtkTextBuffer* buffer, GParamSpec* pspec, gpointer data)
     update_cursor_position(app);
 }
 
+void on_text_inserted(GtkTextBuffer* buffer, GtkTextIter* location, gchar* text, gint len, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+
+    // 粘贴进来的大段文本可能含有超长行，location 此时位于插入文本的末尾。
+    // 分块粘贴的某一行可能跨越多块，留到粘贴完成后统一折叠
+    if (len > LONG_LINE_THRESHOLD && !app->ui->paste && notepad_long_line_protection(app))
+    {
+        GtkTextIter start = *location;
+        gtk_text_iter_backward_chars(&start, (gint)g_utf8_strlen(text, len));
+        if (long_lines_collapse(buffer, gtk_text_iter_get_line(&start), gtk_text_iter_get_line(location)) > 0)
+            update_long_line_status(app);
+    }
+}
+
+void on_mark_set(GtkTextBuffer* buffer, GtkTextIter* location, GtkTextMark* mark, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+
+    // 光标进入超长行的折叠部分（行尾、查找结果等）时按需展开该行，离开后重新折叠，
+    // 之后的编辑不必每次都重新排版整个超长行
+    if (mark == gtk_text_buffer_get_insert(buffer))
+    {
+        gboolean changed = long_lines_collapse_left(buffer, location);
+
+        // 设置标签会使迭代器失效，从光标标记重新定位
+        GtkTextIter cursor;
+        gtk_text_buffer_get_iter_at_mark(buffer, &cursor, mark);
+        if (gtk_text_iter_get_line_offset(&cursor) > LONG_LINE_VISIBLE_CHARS &&
+            long_lines_expand_at(buffer, &cursor))
+            changed = TRUE;
+        if (changed)
+            update_long_line_status(app);
+    }
+
+    // 选区变化时延迟统计，拖动选择期间不会反复计算
+    if (mark == gtk_text_buffer_get_insert(buffer) || mark == gtk_text_buffer_get_selection_bound(buffer))
+        notepad_schedule_selection_stats(app);
+}
+
 void setup_main_window(NotepadApp* app)
 {
     app->ui->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
@@ -80,8 +310,8 @@ void setup_main_window(NotepadApp* app)
     gtk_container_add(GTK_CONTAINER(app->ui->window), vbox);
 
     // 创建工具栏（菜单栏）
-    GtkWidget* menu_bar = create_menu_bar(app, accel_group);
-    gtk_box_pack_start(GTK_BOX(vbox), menu_bar, FALSE, FALSE, 0);
+    app->ui->menu_bar = create_menu_bar(app, accel_group);
+    gtk_box_pack_start(GTK_BOX(vbox), app->ui->menu_bar, FALSE, FALSE, 0);
 
     const gchar* icon_path = "../notepad.png";
     gtk_window_set_icon_from_file(GTK_WINDOW(app->ui->window), icon_path, NULL);
@@ -92,15 +322,16 @@ void setup_main_window(NotepadApp* app)
     gtk_widget_set_no_show_all(app->ui->find_replace_bar, TRUE);
     app->ui->find_replace_visible = FALSE;
 
-    // 创建文本编辑区域
+    // 创建文本编辑区域，右侧为筛选行面板
+    GtkWidget* paned = gtk_paned_new(GTK_ORIENTATION_HORIZONTAL);
+    gtk_box_pack_start(GTK_BOX(vbox), paned, TRUE, TRUE, 0);
     GtkWidget* scrolled_window = gtk_scrolled_window_new(NULL, NULL);
     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window),
                                    GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
-    gtk_box_pack_start(GTK_BOX(vbox), scrolled_window, TRUE, TRUE, 0);
+    gtk_paned_pack1(GTK_PANED(paned), scrolled_window, TRUE, FALSE);
 
     app->ui->text_view = gtk_text_view_new();
     app->ui->buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(app->ui->text_view));
-    gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(app->ui->text_view), GTK_WRAP_WORD);
 
     // 为文本视图添加内边距
     gtk_text_view_set_left_margin(GTK_TEXT_VIEW(app->ui->text_view), 10);
@@ -110,6 +341,19 @@ void setup_main_window(NotepadApp* app)
 
     gtk_container_add(GTK_CONTAINER(scrolled_window), app->ui->text_view);
 
+    // 语法高亮（需要在文本视图放入滚动窗口之后创建）
+    app->ui->highlighter = highlighter_new(GTK_TEXT_VIEW(app->ui->text_view));
+    app->ui->relayout = relayout_new(GTK_TEXT_VIEW(app->ui->text_view));
+    app->ui->font_cache = font_cache_new();
+    relayout_set_wrap(app->ui->relayout, app->settings.word_wrap);
+    app->ui->incremental_search = incremental_search_new(app);
+    app->ui->filter_view = filter_view_new(app);
+    gtk_paned_pack2(GTK_PANED(paned), filter_view_get_widget(app->ui->filter_view), FALSE, FALSE);
+
+    // 性能面板位于状态栏上方，默认隐藏
+    app->ui->perf_hud = perf_hud_new(app);
+    gtk_box_pack_start(GTK_BOX(vbox), perf_hud_get_widget(app->ui->perf_hud), FALSE, FALSE, 0);
+
     // 创建状态栏
     app->ui->status_bar = create_status_bar(app);
     gtk_box_pack_start(GTK_BOX(vbox), app->ui->status_bar, FALSE, FALSE, 0);
@@ -119,7 +363,12 @@ void setup_main_window(NotepadApp* app)
     g_signal_connect(app->ui->buffer, "notify::cursor-position", G_CALLBACK(on_cursor_moved), app);
     g_signal_connect(app->ui->buffer, "insert-text", G_CALLBACK(on_text_insert), app);
     g_signal_connect(app->ui->buffer, "delete-range", G_CALLBACK(on_text_delete), app);
+    g_signal_connect_after(app->ui->buffer, "insert-text", G_CALLBACK(on_text_inserted), app);
+    g_signal_connect(app->ui->buffer, "mark-set", G_CALLBACK(on_mark_set), app);
+    g_signal_connect(app->ui->text_view, "paste-clipboard", G_CALLBACK(on_paste_clipboard), app);
+    g_signal_connect(app->ui->text_view, "drag-data-received", G_CALLBACK(on_drag_data_received), app);
     g_signal_connect(app->ui->window, "delete-event", G_CALLBACK(on_window_delete), app);
+    g_signal_connect(app->ui->window, "focus-in-event", G_CALLBACK(on_window_focus_in), app);
     g_signal_connect(app->ui->window, "destroy", G_CALLBACK(on_quit), NULL);
 
     // 初始化状态栏信息
@@ -141,6 +390,23 @@ GtkWidget* create_menu_bar(NotepadApp* app, GtkAccelGroup* accel_group)
     GtkWidget* open_item = gtk_menu_item_new_with_label("打开");
     GtkWidget* save_item = gtk_menu_item_new_with_label("保存");
     GtkWidget* save_as_item = gtk_menu_item_new_with_label("另存为");
+    GtkWidget* compare_item = gtk_menu_item_new_with_label("与文件比较");
+    GtkWidget* table_item = gtk_menu_item_new_with_label("以表格查看 CSV/TSV");
+
+    // 保存方式子菜单
+    GtkWidget* durability_item = gtk_menu_item_new_with_label("保存方式");
+    GtkWidget* durability_menu = gtk_menu_new();
+    gtk_menu_item_set_submenu(GTK_MENU_ITEM(durability_item), durability_menu);
+    GSList* durability_group = NULL;
+    for (gint i = SAVE_ATOMIC_FSYNC; i <= SAVE_IN_PLACE; i++)
+    {
+        GtkWidget* item = gtk_radio_menu_item_new_with_label(durability_group, save_durability_label((SaveDurability)i));
+        durability_group = gtk_radio_menu_item_get_group(GTK_RADIO_MENU_ITEM(item));
+        g_object_set_data(G_OBJECT(item), "durability", GINT_TO_POINTER(i));
+        gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(item), i == (gint)app->settings.save_durability);
+        g_signal_connect(item, "toggled", G_CALLBACK(on_save_durability_selected), app);
+        gtk_menu_shell_append(GTK_MENU_SHELL(durability_menu), item);
+    }
     GtkWidget* separator1 = gtk_separator_menu_item_new();
     GtkWidget* exit_item = gtk_menu_item_new_with_label("退出");
 
@@ -153,9 +419,40 @@ GtkWidget* create_menu_bar(NotepadApp* app, GtkAccelGroup* accel_group)
     GtkWidget* redo_item = gtk_menu_item_new_with_label("重做");
     GtkWidget* separator2 = gtk_separator_menu_item_new();
     GtkWidget* find_and_replace_item = gtk_menu_item_new_with_label("查找和替换");
+    GtkWidget* find_in_files_item = gtk_menu_item_new_with_label("在文件中查找");
     GtkWidget* goto_item = gtk_menu_item_new_with_label("转到行");
     GtkWidget* separator3 = gtk_separator_menu_item_new();
     GtkWidget* select_all_item = gtk_menu_item_new_with_label("全选");
+    GtkWidget* separator4 = gtk_separator_menu_item_new();
+
+    // 换行符子菜单，选中项决定保存时写出的行分隔符
+    GtkWidget* line_ending_item = gtk_menu_item_new_with_label("换行符");
+    GtkWidget* line_ending_menu = gtk_menu_new();
+    gtk_menu_item_set_submenu(GTK_MENU_ITEM(line_ending_item), line_ending_menu);
+    GSList* line_ending_group = NULL;
+    for (gint i = 0; i < 3; i++)
+    {
+        GtkWidget* item = gtk_radio_menu_item_new_with_label(line_ending_group, line_ending_name((LineEnding)i));
+        line_ending_group = gtk_radio_menu_item_get_group(GTK_RADIO_MENU_ITEM(item));
+        g_object_set_data(G_OBJECT(item), "line-ending", GINT_TO_POINTER(i));
+        gtk_menu_shell_append(GTK_MENU_SHELL(line_ending_menu), item);
+        app->ui->line_ending_items[i] = item;
+    }
+    gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(app->ui->line_ending_items[app->line_ending]), TRUE);
+
+    // 行子菜单：排序、去重和筛选
+    GtkWidget* lines_item = gtk_menu_item_new_with_label("行");
+    GtkWidget* lines_menu = gtk_menu_new();
+    gtk_menu_item_set_submenu(GTK_MENU_ITEM(lines_item), lines_menu);
+    for (gint i = 0; i < LINE_OPERATION_COUNT; i++)
+    {
+        if (i == LINE_UNIQUE || i == LINE_KEEP_MATCHING)
+            gtk_menu_shell_append(GTK_MENU_SHELL(lines_menu), gtk_separator_menu_item_new());
+        GtkWidget* item = gtk_menu_item_new_with_label(line_operation_name((LineOperation)i));
+        g_object_set_data(G_OBJECT(item), "line-operation", GINT_TO_POINTER(i));
+        g_signal_connect(item, "activate", G_CALLBACK(on_line_operation), app);
+        gtk_menu_shell_append(GTK_MENU_SHELL(lines_menu), item);
+    }
 
     // 视图菜单
     GtkWidget* view_item = gtk_menu_item_new_with_mnemonic("视图(_V)");
@@ -163,6 +460,16 @@ GtkWidget* create_menu_bar(NotepadApp* app, GtkAccelGroup* accel_group)
     gtk_menu_item_set_submenu(GTK_MENU_ITEM(view_item), view_menu);
 
     GtkWidget* word_wrap_item = gtk_check_menu_item_new_with_label("自动换行");
+    gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(word_wrap_item), app->settings.word_wrap);
+    app->ui->word_wrap_item = word_wrap_item;
+    GtkWidget* highlight_item = gtk_check_menu_item_new_with_label("语法高亮");
+    gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(highlight_item), TRUE);
+    app->ui->highlight_item = highlight_item;
+    GtkWidget* long_line_item = gtk_check_menu_item_new_with_label("长行保护");
+    gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(long_line_item), TRUE);
+    app->ui->long_line_item = long_line_item;
+    GtkWidget* perf_hud_item = gtk_check_menu_item_new_with_label("性能面板");
+    GtkWidget* filter_view_item = gtk_check_menu_item_new_with_label("筛选行");
     GtkWidget* font_item = gtk_menu_item_new_with_label("字体");
     GtkWidget* background_settings_item = gtk_menu_item_new_with_label("背景设置");
 
@@ -186,6 +493,10 @@ GtkWidget* create_menu_bar(NotepadApp* app, GtkAccelGroup* accel_group)
                                GDK_KEY_y, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
     gtk_widget_add_accelerator(find_and_replace_item, "activate", accel_group,
                                GDK_KEY_f, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
+    gtk_widget_add_accelerator(find_in_files_item, "activate", accel_group,
+                               GDK_KEY_f, GDK_CONTROL_MASK | GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
+    gtk_widget_add_accelerator(filter_view_item, "activate", accel_group,
+                               GDK_KEY_l, GDK_CONTROL_MASK | GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
     gtk_widget_add_accelerator(goto_item, "activate", accel_group,
                                GDK_KEY_g, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
     gtk_widget_add_accelerator(select_all_item, "activate", accel_group,
@@ -198,15 +509,24 @@ GtkWidget* create_menu_bar(NotepadApp* app, GtkAccelGroup* accel_group)
     g_signal_connect(open_item, "activate", G_CALLBACK(on_open_file), app);
     g_signal_connect(save_item, "activate", G_CALLBACK(on_save_file), app);
     g_signal_connect(save_as_item, "activate", G_CALLBACK(on_save_as_file), app);
+    g_signal_connect(compare_item, "activate", G_CALLBACK(on_compare_file), app);
+    g_signal_connect(table_item, "activate", G_CALLBACK(on_open_table), app);
     g_signal_connect(exit_item, "activate", G_CALLBACK(on_exit), app);
 
     // 连接编辑菜单信号
     g_signal_connect(revoke_item, "activate", G_CALLBACK(on_revoke), app);
     g_signal_connect(redo_item, "activate", G_CALLBACK(on_redo), app);
     g_signal_connect(find_and_replace_item, "activate", G_CALLBACK(on_find_replace), app);
+    g_signal_connect(find_in_files_item, "activate", G_CALLBACK(on_find_in_files), app);
     g_signal_connect(goto_item, "activate", G_CALLBACK(on_goto_line), app);
     g_signal_connect(select_all_item, "activate", G_CALLBACK(on_select_all), app);
+    for (gint i = 0; i < 3; i++)
+        g_signal_connect(app->ui->line_ending_items[i], "toggled", G_CALLBACK(on_line_ending_selected), app);
     g_signal_connect(word_wrap_item, "toggled", G_CALLBACK(on_word_wrap_toggle), app);
+    g_signal_connect(highlight_item, "toggled", G_CALLBACK(on_highlight_toggle), app);
+    g_signal_connect(long_line_item, "toggled", G_CALLBACK(on_long_line_toggle), app);
+    g_signal_connect(perf_hud_item, "toggled", G_CALLBACK(on_perf_hud_toggle), app);
+    g_signal_connect(filter_view_item, "toggled", G_CALLBACK(on_filter_view_toggle), app);
     g_signal_connect(font_item, "activate", G_CALLBACK(on_font_selection), app);
     g_signal_connect(background_settings_item, "activate", G_CALLBACK(on_background_settings), app);
     g_signal_connect(about_item, "activate", G_CALLBACK(on_about), app);
@@ -216,6 +536,9 @@ GtkWidget* create_menu_bar(NotepadApp* app, GtkAccelGroup* accel_group)
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), open_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), save_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), save_as_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), durability_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), compare_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), table_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), separator1);
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), exit_item);
 
@@ -223,11 +546,19 @@ GtkWidget* create_menu_bar(NotepadApp* app, GtkAccelGroup* accel_group)
     gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), redo_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), separator2);
     gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), find_and_replace_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), find_in_files_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), goto_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), separator3);
     gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), select_all_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), lines_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), separator4);
+    gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), line_ending_item);
 
     gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), word_wrap_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), highlight_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), long_line_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), perf_hud_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), filter_view_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), font_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), background_settings_item);
 
@@ -246,9 +577,21 @@ GtkWidget* create_status_bar(NotepadApp* app)
     GtkWidget* status_bar = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
     gtk_widget_set_size_request(status_bar, -1, 25);
 
-    // 添加填充空间
-    GtkWidget* filler = gtk_label_new("");
-    gtk_box_pack_start(GTK_BOX(status_bar), filler, TRUE, TRUE, 0);
+    // 通知和耗时操作的进度占据左侧的填充空间
+    GtkWidget* operation_bar = operation_bar_new(app);
+    gtk_box_pack_start(GTK_BOX(status_bar), operation_bar, TRUE, TRUE, 0);
+
+    // 文档统计标签
+    app->ui->stats_label = gtk_label_new("字符: 0  词: 0  行: 1  字节: 0  中日韩: 0");
+    gtk_widget_set_halign(app->ui->stats_label, GTK_ALIGN_END);
+    gtk_widget_set_margin_start(app->ui->stats_label, 10);
+    gtk_widget_set_margin_end(app->ui->stats_label, 10);
+
+    // 超长行折叠提示，没有折叠的行时隐藏
+    app->ui->long_line_label = gtk_label_new("");
+    gtk_widget_set_margin_start(app->ui->long_line_label, 10);
+    gtk_widget_set_margin_end(app->ui->long_line_label, 10);
+    gtk_widget_set_no_show_all(app->ui->long_line_label, TRUE);
 
     // 光标位置标签
     app->ui->cursor_label = gtk_label_new("行: 1, 列: 1");
@@ -274,8 +617,12 @@ GtkWidget* create_status_bar(NotepadApp* app)
     // 添加分隔符
     GtkWidget* separator1 = gtk_separator_new(GTK_ORIENTATION_VERTICAL);
     GtkWidget* separator2 = gtk_separator_new(GTK_ORIENTATION_VERTICAL);
+    GtkWidget* separator0 = gtk_separator_new(GTK_ORIENTATION_VERTICAL);
 
     // 将标签添加到状态栏
+    gtk_box_pack_start(GTK_BOX(status_bar), app->ui->long_line_label, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(status_bar), app->ui->stats_label, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(status_bar), separator0, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(status_bar), app->ui->cursor_label, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(status_bar), separator1, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(status_bar), app->ui->line_ending_label, FALSE, FALSE, 0);
@@ -300,6 +647,8 @@ GtkWidget* create_find_replace_bar(NotepadApp* app)
     GtkWidget* find_label = gtk_label_new("查找:");
     app->ui->find_entry = gtk_entry_new();
     gtk_widget_set_size_request(app->ui->find_entry, 150, -1);
+    app->ui->find_count_label = gtk_label_new("");
+    gtk_label_set_width_chars(GTK_LABEL(app->ui->find_count_label), 12);
 
     // 替换标签和输入框
     GtkWidget* replace_label = gtk_label_new("替换:");
@@ -319,6 +668,7 @@ GtkWidget* create_find_replace_bar(NotepadApp* app)
 
     // 连接信号
     g_signal_connect(find_next_button, "clicked", G_CALLBACK(on_find_next), app);
+    g_signal_connect(app->ui->find_entry, "activate", G_CALLBACK(on_find_next), app);
     g_signal_connect(replace_button, "clicked", G_CALLBACK(on_replace), app);
     g_signal_connect(replace_all_button, "clicked", G_CALLBACK(on_replace_all), app);
     g_signal_connect(close_button, "clicked", G_CALLBACK(on_close_find_replace), app);
@@ -326,6 +676,7 @@ GtkWidget* create_find_replace_bar(NotepadApp* app)
     // 添加到内部容器
     gtk_box_pack_start(GTK_BOX(bar), find_label, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(bar), app->ui->find_entry, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(bar), app->ui->find_count_label, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(bar), replace_label, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(bar), app->ui->replace_entry, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(bar), find_next_button, FALSE, FALSE, 0);
@@ -339,73 +690,113 @@ GtkWidget* create_find_replace_bar(NotepadApp* app)
     return outer_box;
 }
 
+// 把 iter 处内容为 current 的一段换成 target
+static void swap_range(NotepadApp* app, GtkTextIter* iter, GBytes* current, GBytes* target)
+{
+    gsize length;
+    const gchar* text = g_bytes_get_data(current, &length);
+    GtkTextIter end_iter = *iter;
+    gtk_text_iter_forward_chars(&end_iter, (gint)g_utf8_strlen(text, (gssize)length));
+    gtk_text_buffer_delete(app->ui->buffer, iter, &end_iter);
+
+    text = g_bytes_get_data(target, &length);
+    if (length > 0)
+        gtk_text_buffer_insert(app->ui->buffer, iter, text, (gint)length);
+}
+
 // 编辑功能实现
 void on_revoke(GtkWidget* widget, gpointer data)
 {
     NotepadApp* app = (NotepadApp*)data;
 
+    // 未完成的分块粘贴先插入完，撤销记录才是完整的
+    paste_finish(app);
     if (!app->ui->undo_stack) return;
 
     UndoAction* action = app->ui->undo_stack;
     app->ui->undo_stack = action->next;
+    app->ui->undo_count--;
+    app->ui->undo_bytes -= action_size(action);
 
     // 暂停记录变化
     app->ui->recording_changes = FALSE;
 
     GtkTextIter iter;
     gtk_text_buffer_get_iter_at_offset(app->ui->buffer, &iter, action->position);
+    gsize length;
+    const gchar* text = g_bytes_get_data(action->text, &length);
 
     if (action->type == UNDO_INSERT)
     {
-        gtk_text_buffer_insert(app->ui->buffer, &iter, action->text, -1);
+        gtk_text_buffer_insert(app->ui->buffer, &iter, text, (gint)length);
     }
-    else
-    { // UNDO_DELETE
+    else if (action->type == UNDO_DELETE)
+    {
         GtkTextIter end_iter = iter;
-        gtk_text_iter_forward_chars(&end_iter, g_utf8_strlen(action->text, -1));
+        gtk_text_iter_forward_chars(&end_iter, (gint)g_utf8_strlen(text, (gssize)length));
         gtk_text_buffer_delete(app->ui->buffer, &iter, &end_iter);
     }
+    else
+    { // UNDO_REPLACE
+        swap_range(app, &iter, action->replacement, action->text);
+    }
 
     // 移动到重做栈
     action->next = app->ui->redo_stack;
     app->ui->redo_stack = action;
+    app->ui->redo_count++;
+    app->ui->redo_bytes += action_size(action);
 
-    // 恢复记录变化
+    // 恢复记录变化，撤销回到保存点时不再算作修改
     app->ui->recording_changes = TRUE;
+    notepad_update_modified(app);
 }
 
 void on_redo(GtkWidget* widget, gpointer data)
 {
     NotepadApp* app = (NotepadApp*)data;
 
+    paste_finish(app);
     if (!app->ui->redo_stack) return;
 
     UndoAction* action = app->ui->redo_stack;
     app->ui->redo_stack = action->next;
+    app->ui->redo_count--;
+    app->ui->redo_bytes -= action_size(action);
 
     // 暂停记录变化
     app->ui->recording_changes = FALSE;
 
     GtkTextIter iter;
     gtk_text_buffer_get_iter_at_offset(app->ui->buffer, &iter, action->position);
+    gsize length;
+    const gchar* text = g_bytes_get_data(action->text, &length);
 
+    // 重做执行与撤销相反的操作
     if (action->type == UNDO_INSERT)
     {
-        gtk_text_buffer_insert(app->ui->buffer, &iter, action->text, -1);
-    }
-    else
-    { // UNDO_DELETE
         GtkTextIter end_iter = iter;
-        gtk_text_iter_forward_chars(&end_iter, g_utf8_strlen(action->text, -1));
+        gtk_text_iter_forward_chars(&end_iter, (gint)g_utf8_strlen(text, (gssize)length));
         gtk_text_buffer_delete(app->ui->buffer, &iter, &end_iter);
     }
+    else if (action->type == UNDO_DELETE)
+    {
+        gtk_text_buffer_insert(app->ui->buffer, &iter, text, (gint)length);
+    }
+    else
+    { // UNDO_REPLACE
+        swap_range(app, &iter, action->text, action->replacement);
+    }
 
     // 移动到撤销栈
     action->next = app->ui->undo_stack;
     app->ui->undo_stack = action;
+    app->ui->undo_count++;
+    app->ui->undo_bytes += action_size(action);
 
     // 恢复记录变化
     app->ui->recording_changes = TRUE;
+    notepad_update_modified(app);
 }
 
 void on_find_replace(GtkWidget* widget, gpointer data)
@@ -415,6 +806,7 @@ void on_find_replace(GtkWidget* widget, gpointer data)
     {
         gtk_widget_hide(app->ui->find_replace_bar);
         app->ui->find_replace_visible = FALSE;
+        incremental_search_clear(app->ui->incremental_search);
         gtk_widget_grab_focus(app->ui->text_view);
     }
     else
@@ -500,6 +892,110 @@ void on_select_all(GtkWidget* widget, gpointer data)
 }
 
 // 查找替换功能
+static void select_and_show_match(NotepadApp* app, GtkTextIter* match_start, GtkTextIter* match_end)
+{
+    gtk_text_buffer_select_range(app->ui->buffer, match_start, match_end);
+    gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(app->ui->text_view), match_start, 0.0, FALSE, 0.0, 0.0);
+}
+
+static void find_job_free(FindJob* job)
+{
+    g_bytes_unref(job->snapshot);
+    g_free(job->needle);
+    g_free(job);
+}
+
+static void find_job_thread(GTask* task, gpointer source, gpointer task_data, GCancellable* cancellable)
+{
+    FindJob* job = (FindJob*)task_data;
+    gsize length;
+    const char* text = (const char*)g_bytes_get_data(job->snapshot, &length);
+    gsize needle_length = strlen(job->needle);
+
+    SearchPattern pattern;
+    text_search_pattern_init(&pattern, job->needle, needle_length, job->case_sensitive);
+
+    gsize from = text_search_byte_offset(text, length, job->from);
+    gsize match;
+    gboolean found = text_search_parallel_first(&pattern, text, length, from, cancellable, &match);
+
+    // 到末尾仍未找到，从文档开头查找到起始位置为止
+    if (!found && !g_cancellable_is_cancelled(cancellable))
+        found = text_search_parallel_first(&pattern, text, MIN(from + needle_length - 1, length), 0,
+                                           cancellable, &match);
+
+    if (found)
+    {
+        job->match_start = text_search_char_offset(text, match);
+        job->match_end = job->match_start + g_utf8_strlen(text + match, (gssize)needle_length);
+    }
+    g_task_return_boolean(task, found);
+}
+
+static void find_job_done(GObject* source, GAsyncResult* result, gpointer data)
+{
+    FindJob* job = (FindJob*)data;
+    NotepadApp* app = job->app;
+    GError* error = NULL;
+    gboolean found = g_task_propagate_boolean(G_TASK(result), &error);
+    const gchar* message = NULL;
+
+    if (error)
+    {
+        // 被新的查找取代时静默忽略
+        if (app->ui->search_cancellable == long_operation_get_cancellable(job->operation))
+            message = "已取消查找";
+        g_error_free(error);
+    }
+    else if (job->generation != app->content_generation)
+    {
+        // 查找期间文档已被修改，结果位置不再可靠
+    }
+    else if (found)
+    {
+        GtkTextIter match_start, match_end;
+        gtk_text_buffer_get_iter_at_offset(app->ui->buffer, &match_start, (gint)job->match_start);
+        gtk_text_buffer_get_iter_at_offset(app->ui->buffer, &match_end, (gint)job->match_end);
+        select_and_show_match(app, &match_start, &match_end);
+        perf_hud_record(app->ui->perf_hud, PERF_TIMING_SEARCH, job->start_time);
+    }
+    else
+    {
+        message = "找不到匹配项";
+        perf_hud_record(app->ui->perf_hud, PERF_TIMING_SEARCH, job->start_time);
+    }
+
+    long_operation_end(job->operation, message);
+    find_job_free(job);
+}
+
+// 大文档在后台线程中并行查找，界面保持响应
+static void start_parallel_find(NotepadApp* app, const gchar* search_text, gboolean case_sensitive, gint from)
+{
+    if (app->ui->search_cancellable)
+    {
+        g_cancellable_cancel(app->ui->search_cancellable);
+        g_object_unref(app->ui->search_cancellable);
+    }
+
+    // 并行查找不报告位置，状态栏显示不确定的进度
+    FindJob* job = g_new0(FindJob, 1);
+    job->operation = long_operation_begin(app, "正在查找", LONG_OPERATION_CANCELLABLE);
+    app->ui->search_cancellable = g_object_ref(long_operation_get_cancellable(job->operation));
+    job->app = app;
+    job->start_time = g_get_monotonic_time();
+    job->snapshot = notepad_get_snapshot(app);
+    job->generation = app->content_generation;
+    job->needle = g_strdup(search_text);
+    job->case_sensitive = case_sensitive;
+    job->from = (gsize)from;
+
+    GTask* task = g_task_new(NULL, app->ui->search_cancellable, find_job_done, job);
+    g_task_set_task_data(task, job, NULL);
+    g_task_run_in_thread(task, find_job_thread);
+    g_object_unref(task);
+}
+
 void on_find_next(GtkWidget* widget, gpointer data)
 {
     NotepadApp* app = (NotepadApp*)data;
@@ -512,7 +1008,7 @@ void on_find_next(GtkWidget* widget, gpointer data)
 
     if (g_utf8_strlen(search_text, -1) == 0)
     {
-        show_info_dialog(GTK_WINDOW(app->ui->window), "查找", "请输入要查找的内容。");
+        notepad_notify(app, "请输入要查找的内容");
         return;
     }
 
@@ -526,12 +1022,19 @@ void on_find_next(GtkWidget* widget, gpointer data)
         // 从选中区域结束位置开始
     }
 
+    if (gtk_text_buffer_get_char_count(app->ui->buffer) >= PARALLEL_SEARCH_THRESHOLD &&
+        text_search_pattern_supported(search_text, case_sensitive))
+    {
+        start_parallel_find(app, search_text, case_sensitive, gtk_text_iter_get_offset(&start));
+        return;
+    }
+
     // 从当前位置向前搜索
+    gint64 start_time = g_get_monotonic_time();
     if (gtk_text_iter_forward_search(&start, search_text, flags,
                                      &match_start, &match_end, NULL))
     {
-        gtk_text_buffer_select_range(app->ui->buffer, &match_start, &match_end);
-        gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(app->ui->text_view), &match_start, 0.0, FALSE, 0.0, 0.0);
+        select_and_show_match(app, &match_start, &match_end);
     }
     else
     {
@@ -540,14 +1043,14 @@ void on_find_next(GtkWidget* widget, gpointer data)
         if (gtk_text_iter_forward_search(&start, search_text, flags,
                                          &match_start, &match_end, NULL))
         {
-            gtk_text_buffer_select_range(app->ui->buffer, &match_start, &match_end);
-            gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(app->ui->text_view), &match_start, 0.0, FALSE, 0.0, 0.0);
+            select_and_show_match(app, &match_start, &match_end);
         }
         else
         {
-            show_info_dialog(GTK_WINDOW(app->ui->window), "查找", "找不到匹配项。");
+            notepad_notify(app, "找不到匹配项");
         }
     }
+    perf_hud_record(app->ui->perf_hud, PERF_TIMING_SEARCH, start_time);
 }
 
 void on_replace(GtkWidget* widget, gpointer data)
@@ -556,10 +1059,13 @@ void on_replace(GtkWidget* widget, gpointer data)
     const gchar* search_text = gtk_entry_get_text(GTK_ENTRY(app->ui->find_entry));
     const gchar* replace_text = gtk_entry_get_text(GTK_ENTRY(app->ui->replace_entry));
 
+    // 先完成分块粘贴，替换不能穿插在粘贴的各块之间
+    paste_finish(app);
+
     GtkTextIter start, end;
     if (gtk_text_buffer_get_selection_bounds(app->ui->buffer, &start, &end))
     {
-        gchar* selected_text = gtk_text_buffer_get_text(app->ui->buffer, &start, &end, FALSE);
+        gchar* selected_text = gtk_text_buffer_get_text(app->ui->buffer, &start, &end, TRUE);
         if (g_strcmp0(selected_text, search_text) == 0)
         {
             gtk_text_buffer_delete(app->ui->buffer, &start, &end);
@@ -571,6 +1077,87 @@ void on_replace(GtkWidget* widget, gpointer data)
     on_find_next(widget, data);
 }
 
+static void replace_job_free(ReplaceJob* job)
+{
+    if (job->result)
+        g_string_free(job->result, TRUE);
+    g_bytes_unref(job->snapshot);
+    g_free(job->needle);
+    g_free(job->replacement);
+    g_free(job);
+}
+
+// 在快照上生成替换后的全文。按块扫描，跨块的匹配由下一块从上一块留下的位置开始覆盖
+static void replace_job_thread(GTask* task, gpointer source, gpointer task_data, GCancellable* cancellable)
+{
+    ReplaceJob* job = (ReplaceJob*)task_data;
+    gsize length;
+    const char* text = (const char*)g_bytes_get_data(job->snapshot, &length);
+    gsize needle_length = strlen(job->needle);
+    gsize replacement_length = strlen(job->replacement);
+
+    SearchPattern pattern;
+    text_search_pattern_init(&pattern, job->needle, needle_length, TRUE);
+
+    job->result = g_string_sized_new(length + 1);
+    gsize pos = 0;
+    while (pos < length)
+    {
+        if (g_cancellable_is_cancelled(cancellable))
+        {
+            g_task_return_error_if_cancelled(task);
+            return;
+        }
+
+        gsize window_end = MIN(pos + REPLACE_BLOCK_SIZE + needle_length, length);
+        pos += text_search_replace(&pattern, text + pos, window_end - pos, window_end == length,
+                                   job->replacement, replacement_length, job->result, &job->count);
+        long_operation_report(job->operation, pos, length);
+    }
+    g_task_return_boolean(task, TRUE);
+}
+
+static void replace_job_done(GObject* source, GAsyncResult* result, gpointer data)
+{
+    ReplaceJob* job = (ReplaceJob*)data;
+    NotepadApp* app = job->app;
+    GError* error = NULL;
+
+    if (!g_task_propagate_boolean(G_TASK(result), &error))
+    {
+        g_error_free(error);
+        long_operation_end(job->operation, "已取消替换，文档未修改");
+        replace_job_free(job);
+        return;
+    }
+
+    // 替换期间编辑器已锁定，文档仍被修改（例如重新加载）时结果作废
+    if (job->generation != app->content_generation)
+    {
+        long_operation_end(job->operation, "文档已被修改，未执行替换");
+        replace_job_free(job);
+        return;
+    }
+    long_operation_end(job->operation, NULL);
+
+    if (job->count > 0)
+    {
+        // 整个缓冲区作为一步撤销替换，原文直接引用快照，并在后台重新统计
+        GBytes* replacement = g_string_free_to_bytes(job->result);
+        job->result = NULL;
+        gint end = gtk_text_buffer_get_char_count(app->ui->buffer);
+        replace_range_undoable(app, 0, end, job->snapshot, replacement);
+        notepad_rebuild_stats(app, replacement);
+        g_bytes_unref(replacement);
+    }
+
+    gchar* message = g_strdup_printf("已替换 %" G_GUINT64_FORMAT " 个匹配项", job->count);
+    notepad_notify(app, message);
+    g_free(message);
+    replace_job_free(job);
+}
+
+// 在后台线程中对快照生成替换结果，期间锁定编辑器，完成后一次载入缓冲区
 void on_replace_all(GtkWidget* widget, gpointer data)
 {
     NotepadApp* app = (NotepadApp*)data;
@@ -579,51 +1166,200 @@ void on_replace_all(GtkWidget* widget, gpointer data)
 
     if (g_utf8_strlen(search_text, -1) == 0)
     {
-        show_info_dialog(GTK_WINDOW(app->ui->window), "替换", "请输入要查找的内容。");
+        notepad_notify(app, "请输入要查找的内容");
         return;
     }
 
-    gint count = 0;
-    size_t search_len = strlen(search_text);
+    paste_finish(app);
+
+    ReplaceJob* job = g_new0(ReplaceJob, 1);
+    job->app = app;
+    job->snapshot = notepad_get_snapshot(app);
+    job->generation = app->content_generation;
+    job->needle = g_strdup(search_text);
+    job->replacement = g_strdup(replace_text);
+    job->operation = long_operation_begin(app, "正在替换",
+                                          LONG_OPERATION_CANCELLABLE | LONG_OPERATION_LOCK_EDITOR);
+
+    GTask* task = g_task_new(NULL, long_operation_get_cancellable(job->operation), replace_job_done, job);
+    g_task_set_task_data(task, job, NULL);
+    g_task_run_in_thread(task, replace_job_thread);
+    g_object_unref(task);
+}
 
-    // 暂停撤销记录
-    app->ui->recording_changes = FALSE;
+static void line_job_free(LineJob* job)
+{
+    g_bytes_unref(job->snapshot);
+    if (job->result)
+        g_bytes_unref(job->result);
+    g_free(job->pattern);
+    g_free(job);
+}
 
-    // 获取所有文本
-    GtkTextIter start, end;
-    gtk_text_buffer_get_bounds(app->ui->buffer, &start, &end);
-    gchar* text = gtk_text_buffer_get_text(app->ui->buffer, &start, &end, FALSE);
+static void line_job_thread(GTask* task, gpointer source, gpointer task_data, GCancellable* cancellable)
+{
+    LineJob* job = (LineJob*)task_data;
+    gsize length;
+    const char* text = (const char*)g_bytes_get_data(job->snapshot, &length);
+
+    job->start_byte = text_search_byte_offset(text, length, (gsize)job->start);
+    job->end_byte = job->start_byte + text_search_byte_offset(text + job->start_byte, length - job->start_byte,
+                                                              (gsize)(job->end - job->start));
+    job->result = line_ops_apply(job->kind, text + job->start_byte, job->end_byte - job->start_byte,
+                                 job->pattern, job->case_sensitive, cancellable, &job->lines);
+    if (!g_task_return_error_if_cancelled(task))
+        g_task_return_boolean(task, TRUE);
+}
 
-    // 使用字符串替换避免迭代器问题
-    GString* new_text = g_string_new("");
-    gchar* pos = text;
-    gchar* found;
+static void line_job_done(GObject* source, GAsyncResult* result, gpointer data)
+{
+    LineJob* job = (LineJob*)data;
+    NotepadApp* app = job->app;
+    GError* error = NULL;
 
-    while ((found = strstr(pos, search_text)) != NULL)
+    if (!g_task_propagate_boolean(G_TASK(result), &error))
     {
-        // 添加找到位置之前的文本
-        g_string_append_len(new_text, pos, (gssize)(found - pos));
-        // 添加替换文本
-        g_string_append(new_text, replace_text);
-        // 移动到下一个搜索位置
-        pos = found + search_len;
-        count++;
+        g_error_free(error);
+        long_operation_end(job->operation, "已取消，文档未修改");
+        line_job_free(job);
+        return;
+    }
+    if (job->generation != app->content_generation)
+    {
+        long_operation_end(job->operation, "文档已被修改，未执行行操作");
+        line_job_free(job);
+        return;
+    }
+    long_operation_end(job->operation, NULL);
+
+    // 原文放进撤销记录：处理了大部分内容时直接引用快照，只处理一小段时复制出来，
+    // 避免撤销记录让整个快照一直留在内存中
+    gsize slice = job->end_byte - job->start_byte;
+    gsize snapshot_size;
+    const gchar* snapshot = g_bytes_get_data(job->snapshot, &snapshot_size);
+    GBytes* original = slice * 2 < snapshot_size ? g_bytes_new(snapshot + job->start_byte, slice)
+                                                 : g_bytes_new_from_bytes(job->snapshot, job->start_byte, slice);
+    if (g_bytes_equal(original, job->result))
+    {
+        notepad_notify(app, "行的内容没有变化");
+        g_bytes_unref(original);
+        line_job_free(job);
+        return;
     }
-    // 添加剩余文本
-    g_string_append(new_text, pos);
 
-    // 替换整个缓冲区内容
-    gtk_text_buffer_set_text(app->ui->buffer, new_text->str, -1);
+    replace_range_undoable(app, job->start, job->end, original, job->result);
+    g_bytes_unref(original);
 
-    g_string_free(new_text, TRUE);
-    g_free(text);
+    GBytes* stats_text = notepad_get_snapshot(app);
+    notepad_rebuild_stats(app, stats_text);
+    g_bytes_unref(stats_text);
 
-    // 恢复撤销记录
-    app->ui->recording_changes = TRUE;
+    // 选中处理后的行，便于接着执行下一个行操作
+    GtkTextIter start, end;
+    gsize length;
+    const gchar* text = g_bytes_get_data(job->result, &length);
+    gtk_text_buffer_get_iter_at_offset(app->ui->buffer, &start, job->start);
+    end = start;
+    gtk_text_iter_forward_chars(&end, (gint)g_utf8_strlen(text, (gssize)length));
+    gtk_text_buffer_select_range(app->ui->buffer, &start, &end);
 
-    gchar* message = g_strdup_printf("已替换 %d 个匹配项", count);
-    show_info_dialog(GTK_WINDOW(app->ui->window), "替换完成", message);
+    gchar* message = g_strdup_printf("%s：剩余 %u 行", line_operation_name(job->kind), job->lines);
+    notepad_notify(app, message);
     g_free(message);
+    line_job_free(job);
+}
+
+// 询问保留或删除哪些行，取消时返回 NULL
+static gchar* ask_line_pattern(NotepadApp* app, LineOperation operation, gboolean* case_sensitive)
+{
+    GtkWidget* dialog = gtk_dialog_new_with_buttons(line_operation_name(operation),
+                                                    GTK_WINDOW(app->ui->window),
+                                                    GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                                    "取消", GTK_RESPONSE_CANCEL,
+                                                    "确定", GTK_RESPONSE_OK,
+                                                    NULL);
+
+    GtkWidget* content_area = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    GtkWidget* hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+    gtk_widget_set_margin_start(hbox, 10);
+    gtk_widget_set_margin_end(hbox, 10);
+    gtk_widget_set_margin_top(hbox, 10);
+    gtk_widget_set_margin_bottom(hbox, 10);
+
+    GtkWidget* label = gtk_label_new("包含:");
+    GtkWidget* entry = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(entry), gtk_entry_get_text(GTK_ENTRY(app->ui->find_entry)));
+    gtk_entry_set_activates_default(GTK_ENTRY(entry), TRUE);
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_OK);
+    GtkWidget* check = gtk_check_button_new_with_label("区分大小写");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check),
+                                 gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(app->ui->case_sensitive_check)));
+
+    gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(hbox), entry, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(hbox), check, FALSE, FALSE, 0);
+    gtk_container_add(GTK_CONTAINER(content_area), hbox);
+
+    gtk_widget_show_all(dialog);
+    gtk_widget_grab_focus(entry);
+
+    gchar* pattern = NULL;
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_OK && *gtk_entry_get_text(GTK_ENTRY(entry)))
+    {
+        pattern = g_strdup(gtk_entry_get_text(GTK_ENTRY(entry)));
+        *case_sensitive = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(check));
+    }
+    gtk_widget_destroy(dialog);
+    return pattern;
+}
+
+// 对选区所在的整行（没有选区时为整个文档）执行行操作。后台处理快照，期间锁定编辑器，完成后一次替换
+void on_line_operation(GtkWidget* widget, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+    LineOperation operation = (LineOperation)GPOINTER_TO_INT(g_object_get_data(G_OBJECT(widget), "line-operation"));
+
+    gchar* pattern = NULL;
+    gboolean case_sensitive = TRUE;
+    if (line_operation_needs_pattern(operation) && !(pattern = ask_line_pattern(app, operation, &case_sensitive)))
+        return;
+
+    paste_finish(app);
+
+    // 选区扩展到整行，结束于行首时不包含该行
+    GtkTextIter start, end;
+    if (gtk_text_buffer_get_selection_bounds(app->ui->buffer, &start, &end))
+    {
+        gtk_text_iter_set_line_offset(&start, 0);
+        if (!gtk_text_iter_starts_line(&end))
+            gtk_text_iter_forward_line(&end);
+    }
+    else
+    {
+        gtk_text_buffer_get_bounds(app->ui->buffer, &start, &end);
+    }
+    if (gtk_text_iter_equal(&start, &end))
+    {
+        g_free(pattern);
+        return;
+    }
+
+    LineJob* job = g_new0(LineJob, 1);
+    job->app = app;
+    job->snapshot = notepad_get_snapshot(app);
+    job->generation = app->content_generation;
+    job->kind = operation;
+    job->pattern = pattern;
+    job->case_sensitive = case_sensitive;
+    job->start = gtk_text_iter_get_offset(&start);
+    job->end = gtk_text_iter_get_offset(&end);
+    job->operation = long_operation_begin(app, line_operation_name(operation),
+                                                   LONG_OPERATION_CANCELLABLE | LONG_OPERATION_LOCK_EDITOR);
+
+    GTask* task = g_task_new(NULL, long_operation_get_cancellable(job->operation), line_job_done, job);
+    g_task_set_task_data(task, job, NULL);
+    g_task_run_in_thread(task, line_job_thread);
+    g_object_unref(task);
 }
 
 void on_close_find_replace(GtkWidget* widget, gpointer data)
@@ -632,9 +1368,37 @@ void on_close_find_replace(GtkWidget* widget, gpointer data)
     gtk_widget_hide(app->ui->find_replace_bar);
     gtk_widget_set_no_show_all(app->ui->find_replace_bar, TRUE);
     app->ui->find_replace_visible = FALSE;
+    incremental_search_clear(app->ui->incremental_search);
     gtk_widget_grab_focus(app->ui->text_view);
 }
 
+// 用当前选择的两种字体重新渲染预览，始终复用同一个样式提供者
+static void update_font_preview(FontPreview* preview)
+{
+    PangoFontDescription* primary_desc = gtk_font_chooser_get_font_desc(GTK_FONT_CHOOSER(preview->primary_button));
+    PangoFontDescription* fallback_desc = gtk_font_chooser_get_font_desc(GTK_FONT_CHOOSER(preview->fallback_button));
+
+    gchar* css_data = g_strdup_printf(
+        "textview { font-family: \"%s\", \"%s\"; font-size: %dpx; }",
+        pango_font_description_get_family(primary_desc),
+        pango_font_description_get_family(fallback_desc),
+        pango_font_description_get_size(primary_desc) / PANGO_SCALE
+    );
+    gtk_css_provider_load_from_data(preview->provider, css_data, -1, NULL);
+
+    g_free(css_data);
+    pango_font_description_free(primary_desc);
+    pango_font_description_free(fallback_desc);
+}
+
+static gboolean font_preview_timeout(gpointer data)
+{
+    FontPreview* preview = (FontPreview*)data;
+    preview->update_id = 0;
+    update_font_preview(preview);
+    return G_SOURCE_REMOVE;
+}
+
 void on_font_selection(GtkWidget* widget, gpointer data)
 {
     NotepadApp* app = (NotepadApp*)data;
@@ -730,14 +1494,20 @@ void on_font_selection(GtkWidget* widget, gpointer data)
 
     gtk_container_add(GTK_CONTAINER(content_area), main_box);
 
+    // 对话框是模态的，预览状态在本函数返回前一直有效
+    FontPreview preview = { preview_text, primary_font_button, fallback_font_button, gtk_css_provider_new(), 0 };
+    gtk_style_context_add_provider(gtk_widget_get_style_context(preview_text),
+                                   GTK_STYLE_PROVIDER(preview.provider),
+                                   GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
     // 字体变化时更新预览
     g_signal_connect(primary_font_button, "font-set",
-                     G_CALLBACK(on_font_preview_update), preview_text);
+                     G_CALLBACK(on_font_preview_update), &preview);
     g_signal_connect(fallback_font_button, "font-set",
-                     G_CALLBACK(on_font_preview_update), preview_text);
+                     G_CALLBACK(on_font_preview_update), &preview);
 
     // 初始预览更新
-    update_font_preview(preview_text, primary_font_button, fallback_font_button);
+    update_font_preview(&preview);
 
     gtk_widget_show_all(dialog);
 
@@ -772,83 +1542,19 @@ void on_font_selection(GtkWidget* widget, gpointer data)
         pango_font_description_free(fallback_desc);
     }
 
+    if (preview.update_id)
+        g_source_remove(preview.update_id);
     gtk_widget_destroy(dialog);
+    g_object_unref(preview.provider);
 }
 
-// 字体预览更新回调
+// 字体预览更新回调：连续选择时只在停下来后渲染一次
 void on_font_preview_update(GtkWidget* font_button, gpointer data)
 {
-    GtkWidget* preview_text = (GtkWidget*)data;
-
-    // 获取对话框
-    GtkWidget* dialog = gtk_widget_get_toplevel(font_button);
-
-    // 找到两个字体按钮
-    GtkWidget* content_area = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
-    GList* children = gtk_container_get_children(GTK_CONTAINER(content_area));
-    GtkWidget* main_box = GTK_WIDGET(children->data);
-    g_list_free(children);
-
-    children = gtk_container_get_children(GTK_CONTAINER(main_box));
-    GtkWidget* primary_font_button = NULL;
-    GtkWidget* fallback_font_button = NULL;
-
-    // 遍历找到字体按钮
-    for (GList* iter = children; iter != NULL; iter = iter->next)
-    {
-        if (GTK_IS_FONT_BUTTON(iter->data))
-        {
-            if (primary_font_button == NULL)
-            {
-                primary_font_button = GTK_WIDGET(iter->data);
-            }
-            else
-            {
-                fallback_font_button = GTK_WIDGET(iter->data);
-                break;
-            }
-        }
-    }
-    g_list_free(children);
-
-    if (primary_font_button && fallback_font_button)
-    {
-        update_font_preview(preview_text, primary_font_button, fallback_font_button);
-    }
-}
-
-// 更新预览
-void update_font_preview(GtkWidget* preview_text, GtkWidget* primary_button, GtkWidget* fallback_button)
-{
-    PangoFontDescription* primary_desc = gtk_font_chooser_get_font_desc(GTK_FONT_CHOOSER(primary_button));
-    PangoFontDescription* fallback_desc = gtk_font_chooser_get_font_desc(GTK_FONT_CHOOSER(fallback_button));
-
-    // 创建字体列表字符串
-    gchar* primary_font = pango_font_description_to_string(primary_desc);
-    gchar* fallback_font = pango_font_description_to_string(fallback_desc);
-
-    // 创建CSS样式提供者
-    GtkCssProvider* css_provider = gtk_css_provider_new();
-    gchar* css_data = g_strdup_printf(
-        "textview { font-family: \"%s\", \"%s\"; font-size: %dpx; }",
-        pango_font_description_get_family(primary_desc),
-        pango_font_description_get_family(fallback_desc),
-        pango_font_description_get_size(primary_desc) / PANGO_SCALE
-    );
-
-    gtk_css_provider_load_from_data(css_provider, css_data, -1, NULL);
-
-    GtkStyleContext* style_context = gtk_widget_get_style_context(preview_text);
-    gtk_style_context_add_provider(style_context,
-                                   GTK_STYLE_PROVIDER(css_provider),
-                                   GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-
-    g_free(primary_font);
-    g_free(fallback_font);
-    g_free(css_data);
-    pango_font_description_free(primary_desc);
-    pango_font_description_free(fallback_desc);
-    g_object_unref(css_provider);
+    FontPreview* preview = (FontPreview*)data;
+    if (preview->update_id)
+        g_source_remove(preview->update_id);
+    preview->update_id = g_timeout_add(FONT_PREVIEW_DELAY, font_preview_timeout, preview);
 }
 
 // 应用字体并设置备选
@@ -862,83 +1568,68 @@ void apply_font_with_fallback(NotepadApp* app, const gchar* primary_font, const
     const gchar* primary_family = pango_font_description_get_family(primary_desc);
     const gchar* fallback_family = pango_font_description_get_family(fallback_desc);
 
-    // 创建CSS样式提供者，包含中文字体支持
-    GtkCssProvider* css_provider = gtk_css_provider_new();
-    gchar* css_data = g_strdup_printf(
-        "textview { "
-        "font-family: \"%s\", \"%s\", \"Microsoft YaHei\", \"SimSun\", \"Arial Unicode MS\", sans-serif; "
-        "font-size: %dpx; "
-        "font-weight: %d; "
-        "font-style: %s; "
-        "}",
+    // 字体族列表，包含中文字体支持。未安装的字体族直接从列表中去掉（查缓存）
+    const gchar* candidates[] = {
         primary_family ? primary_family : "Microsoft YaHei",
         fallback_family ? fallback_family : "SimSun",
-        pango_font_description_get_size(primary_desc) / PANGO_SCALE,
-        pango_font_description_get_weight(primary_desc),
-        pango_font_description_get_style(primary_desc) == PANGO_STYLE_ITALIC ? "italic" : "normal"
-    );
-
-    gtk_css_provider_load_from_data(css_provider, css_data, -1, NULL);
-
-    // 应用到文本视图
-    GtkStyleContext* style_context = gtk_widget_get_style_context(app->ui->text_view);
+        "Microsoft YaHei", "SimSun", "Arial Unicode MS"
+    };
+    GString* families = g_string_new(NULL);
+    for (gsize i = 0; i < G_N_ELEMENTS(candidates); i++)
+    {
+        if (font_cache_has_family(app->ui->font_cache, candidates[i]))
+            g_string_append_printf(families, "%s,", candidates[i]);
+    }
+    g_string_append(families, "sans-serif");
 
-    // 移除之前的字体样式提供者
-    gtk_style_context_remove_provider_for_screen(gdk_screen_get_default(),
-                                                 GTK_STYLE_PROVIDER(css_provider));
+    PangoFontDescription* font_desc = pango_font_description_new();
+    pango_font_description_set_family(font_desc, families->str);
+    pango_font_description_set_size(font_desc, pango_font_description_get_size(primary_desc));
+    pango_font_description_set_weight(font_desc, pango_font_description_get_weight(primary_desc));
+    pango_font_description_set_style(font_desc, pango_font_description_get_style(primary_desc));
 
-    gtk_style_context_add_provider(style_context,
-                                   GTK_STYLE_PROVIDER(css_provider),
-                                   GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+    // 通过字体标签分段应用，大文档不会因重新排版而停顿
+    relayout_set_font(app->ui->relayout, font_desc);
 
     // 验证字体应用结果
     validate_font_application(app, primary_font, fallback_font);
 
-    g_free(css_data);
+    g_string_free(families, TRUE);
+    pango_font_description_free(font_desc);
     pango_font_description_free(primary_desc);
     pango_font_description_free(fallback_desc);
-    g_object_unref(css_provider);
 }
 
-// 验证字体应用
+// 验证字体应用（只查缓存，不再创建字体）
 void validate_font_application(NotepadApp* app, const gchar* primary_font, const gchar* fallback_font)
 {
+    // 缓存尚未就绪时交给 Pango 自行回退
+    if (!font_cache_ready(app->ui->font_cache))
+        return;
+
     PangoFontDescription* primary_desc = pango_font_description_from_string(primary_font);
+    PangoFontDescription* fallback_desc = pango_font_description_from_string(fallback_font);
     const gchar* primary_family = pango_font_description_get_family(primary_desc);
+    const gchar* fallback_family = pango_font_description_get_family(fallback_desc);
 
-    // 获取实际应用的字体
-    PangoContext* context = gtk_widget_get_pango_context(app->ui->text_view);
-    PangoFontDescription* current_font = pango_context_get_font_description(context);
-
-    gchar* message;
-    if (current_font)
+    gchar* message = NULL;
+    if (!font_cache_has_family(app->ui->font_cache, primary_family))
     {
-        const gchar* current_family = pango_font_description_get_family(current_font);
-
-        if (current_family && primary_family && strcmp(current_family, primary_family) == 0)
-        {
-            message = g_strdup_printf("已应用首要字体: %s", primary_family);
-        }
-        else
-        {
-            PangoFontDescription* fallback_desc = pango_font_description_from_string(fallback_font);
-            const gchar* fallback_family = pango_font_description_get_family(fallback_desc);
-            message = g_strdup_printf("首要字体不可用，已使用备选字体: %s",
-                                      fallback_family ? fallback_family : "默认字体");
-            pango_font_description_free(fallback_desc);
-            output_exception_message(EXCEPTION_WARNING, message);
-        }
+        message = g_strdup_printf("首要字体不可用，已使用备选字体: %s",
+                                  fallback_family ? fallback_family : "默认字体");
     }
-    else
+    else if (!font_cache_has_cjk(app->ui->font_cache, primary_family) &&
+             !font_cache_has_cjk(app->ui->font_cache, fallback_family))
     {
-        message = g_strdup("字体设置已应用");
+        message = g_strdup_printf("字体 %s 不包含中文字符，中文将使用系统默认字体显示", primary_family);
     }
 
-    // show_info_dialog(GTK_WINDOW(app->ui->window), "字体设置", message);
-
+    if (message)
+        output_exception_message(EXCEPTION_WARNING, message);
 
     g_free(message);
     pango_font_description_free(primary_desc);
+    pango_font_description_free(fallback_desc);
 }
 
 void on_word_wrap_toggle(GtkWidget* widget, gpointer data)
@@ -946,15 +1637,72 @@ void on_word_wrap_toggle(GtkWidget* widget, gpointer data)
     NotepadApp* app = (NotepadApp*)data;
     gboolean active = gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(widget));
 
-    if (active)
+    // 不直接设置视图的换行模式（会同步重新排版整个文档），改为分段设置换行标签
+    relayout_set_wrap(app->ui->relayout, active);
+
+    // 用户的选择作为之后打开文件的默认设置
+    if (!app->ui->updating_word_wrap_item)
     {
-        // 使用 GTK_WRAP_WORD_CHAR 来支持所有字符的换行
-        gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(app->ui->text_view), GTK_WRAP_WORD_CHAR);
+        app->settings.word_wrap = active;
+        settings_save(&app->settings);
     }
+}
+
+void on_highlight_toggle(GtkWidget* widget, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+    update_highlight_language(app);
+}
+
+void on_long_line_toggle(GtkWidget* widget, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+
+    if (gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(widget)))
+        long_lines_collapse(app->ui->buffer, 0, gtk_text_buffer_get_line_count(app->ui->buffer) - 1);
     else
-    {
-        gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(app->ui->text_view), GTK_WRAP_NONE);
-    }
+        long_lines_expand_all(app->ui->buffer);
+    update_long_line_status(app);
+}
+
+void on_perf_hud_toggle(GtkWidget* widget, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+    perf_hud_set_visible(app->ui->perf_hud, gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(widget)));
+}
+
+void on_filter_view_toggle(GtkWidget* widget, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+    filter_view_set_visible(app->ui->filter_view, gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(widget)));
+}
+
+void on_line_ending_selected(GtkWidget* widget, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+
+    // 单选组中取消选中的一项也会收到 toggled
+    if (app->ui->updating_line_ending_menu || !gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(widget)))
+        return;
+
+    LineEnding line_ending = (LineEnding)GPOINTER_TO_INT(g_object_get_data(G_OBJECT(widget), "line-ending"));
+    if (line_ending == app->line_ending)
+        return;
+
+    // 缓冲区内容不变，只在保存时按新的行分隔符写出
+    app->line_ending = line_ending;
+    notepad_update_modified(app);
+    update_line_ending_type(app);
+}
+
+void on_save_durability_selected(GtkWidget* widget, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+    if (!gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(widget)))
+        return;
+
+    app->settings.save_durability = (SaveDurability)GPOINTER_TO_INT(g_object_get_data(G_OBJECT(widget), "durability"));
+    settings_save(&app->settings);
 }
 
 void on_background_settings(GtkWidget* widget, gpointer data)
@@ -1182,6 +1930,12 @@ void apply_background_color(NotepadApp* app, const GdkRGBA* color)
                                    GTK_STYLE_PROVIDER(css_provider),
                                    GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
 
+    // 记录到会话中
+    app->ui->has_background_color = TRUE;
+    app->ui->background_color = *color;
+    g_free(app->ui->background_image);
+    app->ui->background_image = NULL;
+
     g_free(css_data);
     g_object_unref(css_provider);
 }
@@ -1249,9 +2003,15 @@ void apply_background_image(NotepadApp* app, const gchar* image_path, gdouble op
                                    GTK_STYLE_PROVIDER(css_provider),
                                    GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
 
+    // 记录到会话中
+    gchar* path = g_strdup(image_path);
+    g_free(app->ui->background_image);
+    app->ui->background_image = path;
+    app->ui->background_opacity = opacity;
+
     // 显示成功信息
     gchar* success_msg = g_strdup_printf("背景图片已设置为: %s", image_path);
-    show_info_dialog(GTK_WINDOW(app->ui->window), "设置成功", success_msg);
+    notepad_notify(app, success_msg);
 
     g_free(success_msg);
     g_free(css_data);
@@ -1320,13 +2080,31 @@ void on_about(GtkWidget* widget, gpointer data)
 void on_text_changed(GtkTextBuffer* buffer, gpointer data)
 {
     NotepadApp* app = (NotepadApp*)data;
-    notepad_set_modified(app, TRUE);
+    app->content_generation++;
+    app->ui->selection_generation++;    // 后台选区统计的偏移对应编辑前的文本
+    if (app->snapshot)
+    {
+        // 旧快照不再有用，后台任务持有自己的引用
+        g_bytes_unref(app->snapshot);
+        app->snapshot = NULL;
+    }
+    // 撤销、重做和整体替换由调用者自行更新修改状态
+    if (app->ui->recording_changes)
+        notepad_update_modified(app);
 }
 
 gboolean on_window_delete(GtkWidget* widget, GdkEvent* event, gpointer data)
 {
     NotepadApp* app = (NotepadApp*)data;
-    return !notepad_check_save_changes(app);
+    return !notepad_prepare_quit(app);
+}
+
+gboolean on_window_focus_in(GtkWidget* widget, GdkEventFocus* event, gpointer data)
+{
+    NotepadApp* app = (NotepadApp*)data;
+    // 窗口重新获得焦点时检查文件是否被其他程序修改
+    notepad_check_external_change(app);
+    return FALSE;
 }
 
 void on_quit(GtkWidget* widget, gpointer data)
@@ -3,6 +3,11 @@
 
 #include <stdint.h>
 #include <gtk/gtk.h>
+#include "doc_stats.h"
+#include "highlight.h"
+#include "find_in_files.h"
+#include "relayout.h"
+#include "font_cache.h"
 
 // 前向声明
 typedef struct NotepadApp NotepadApp;
@@ -11,7 +16,8 @@ typedef struct NotepadApp NotepadApp;
 typedef enum
 {
     UNDO_INSERT,
-    UNDO_DELETE
+    UNDO_DELETE,
+    UNDO_REPLACE    // 整段替换：text 为原文，replacement 为替换后的文本
 } UndoType;
 
 // 撤销操作结构（内部逻辑使用标准类型）
@@ -19,33 +25,77 @@ typedef struct UndoAction
 {
     UndoType type;
     int32_t position;       // 使用标准int32_t
-    char* text;             // 使用标准char*
+    GBytes* text;           // 插入或删除的文本，大段粘贴时与粘贴内容共用
+    GBytes* replacement;    // UNDO_REPLACE 替换后的文本，其他类型为 NULL
+    guint64 serial;         // 递增的编号，用于与保存点比较
     struct UndoAction* next;
 } UndoAction;
 
 typedef struct NotepadUI
 {
     GtkWidget* window;
+    GtkWidget* menu_bar;
     GtkWidget* text_view;
     GtkTextBuffer* buffer;
     GtkWidget* status_bar;
     GtkWidget* cursor_label;
     GtkWidget* line_ending_label;
     GtkWidget* encoding_label;
+    GtkWidget* stats_label;
+    GtkWidget* long_line_label;
     GtkWidget* find_replace_bar;
     GtkWidget* find_entry;
     GtkWidget* replace_entry;
     GtkWidget* case_sensitive_check;
+    GtkWidget* find_count_label;        // 边输入边查找的匹配计数
     gboolean find_replace_visible;
+    GCancellable* search_cancellable;   // 正在进行的后台查找
+    Highlighter* highlighter;           // 语法高亮
+    GtkWidget* highlight_item;          // 视图菜单中的语法高亮开关
+    GtkWidget* long_line_item;          // 视图菜单中的长行保护开关
+    GtkWidget* line_ending_items[3];    // 换行符菜单，按 LineEnding 索引
+    gboolean updating_line_ending_menu; // 正在按文档同步菜单，忽略切换回调
+    FindInFiles* find_in_files;         // 在文件中查找面板，首次使用时创建
+    Relayout* relayout;                 // 自动换行和字体的分段重新排版
+    FontCache* font_cache;              // 已安装字体族的缓存
+    GtkWidget* word_wrap_item;          // 视图菜单中的自动换行开关
+    gboolean updating_word_wrap_item;   // 按文档大小切换换行，不作为用户的默认设置
+    struct PasteJob* paste;             // 正在分块插入的大段粘贴
+    struct OperationBar* operation_bar; // 状态栏上的耗时操作进度和通知
+    struct IncrementalSearch* incremental_search; // 边输入边查找
+    struct PerfHud* perf_hud;           // 性能面板，隐藏时仍记录操作耗时
+    struct FilterView* filter_view;     // 编辑区右侧的筛选行面板
 
     // 撤销/重做相关
     UndoAction* undo_stack;
     UndoAction* redo_stack;
     gboolean recording_changes;
+    guint64 undo_serial;        // 最近一次分配的撤销编号
+    guint64 save_serial;        // 保存时撤销栈顶的编号（栈空为 0），无法回到保存状态时为 G_MAXUINT64
+    guint64 history_base;       // 载入文件后撤销栈顶的编号，会话只保存之后的撤销记录
+    guint undo_count, redo_count;   // 撤销栈和重做栈的条数，随入栈、出栈和清空维护
+    gsize undo_bytes, redo_bytes;   // 撤销栈和重做栈占用的字节数
+
+    // 文档统计（字符数和行数直接取自缓冲区，其余增量维护）
+    DocStats stats;
+    gboolean stats_pending;     // 后台全量统计尚未完成
+    gboolean stats_suspended;   // 整体替换文本期间暂停增量统计
+    guint stats_generation;     // 每次发起全量统计递增，用于丢弃过期结果
+    guint stats_update_id;      // 刷新状态栏的空闲回调
+    guint selection_stats_id;   // 选区统计的延迟回调
+    guint selection_generation; // 每次重新统计选区递增，用于丢弃过期的后台选区统计
+    gboolean has_selection_stats;
+    DocStats selection_stats;
 
     // 字体设置
     gchar* primary_font;    // 首要字体
     gchar* fallback_font;   // 备选字体
+
+    // 背景设置，保存到会话中
+    gboolean has_background_color;
+    GdkRGBA background_color;
+    gchar* background_image;        // 图片背景的路径，没有时为 NULL
+    gdouble background_opacity;
 } NotepadUI;
 
 extern void setup_main_window(NotepadApp* app);
@@ -62,8 +112,14 @@ extern void on_text_changed(GtkTextBuffer* buffer, gpointer data);
 
 extern void on_cursor_moved(GtkTextBuffer* buffer, GParamSpec* pspec, gpointer data);
 
+extern void on_text_inserted(GtkTextBuffer* buffer, GtkTextIter* location, gchar* text, gint len, gpointer data);
+
+extern void on_mark_set(GtkTextBuffer* buffer, GtkTextIter* location, GtkTextMark* mark, gpointer data);
+
 extern gboolean on_window_delete(GtkWidget* widget, GdkEvent* event, gpointer data);
 
+extern gboolean on_window_focus_in(GtkWidget* widget, GdkEventFocus* event, gpointer data);
+
 // 编辑功能
 extern void on_revoke(GtkWidget* widget, gpointer data);
 
@@ -77,6 +133,18 @@ extern void on_select_all(GtkWidget* widget, gpointer data);
 
 extern void on_word_wrap_toggle(GtkWidget* widget, gpointer data);
 
+extern void on_highlight_toggle(GtkWidget* widget, gpointer data);
+
+extern void on_long_line_toggle(GtkWidget* widget, gpointer data);
+
+extern void on_perf_hud_toggle(GtkWidget* widget, gpointer data);
+
+extern void on_filter_view_toggle(GtkWidget* widget, gpointer data);
+
+extern void on_line_ending_selected(GtkWidget* widget, gpointer data);
+
+extern void on_save_durability_selected(GtkWidget* widget, gpointer data);
+
 // 查找替换相关
 extern void on_find_next(GtkWidget* widget, gpointer data);
 
@@ -86,9 +154,21 @@ extern void on_replace_all(GtkWidget* widget, gpointer data);
 
 extern void on_close_find_replace(GtkWidget* widget, gpointer data);
 
+extern void on_line_operation(GtkWidget* widget, gpointer data);   // 编辑→行 菜单，操作类型在 "line-operation" 数据中
+
 // 撤销/重做相关（内部逻辑使用标准类型）
 extern void push_undo_action(NotepadApp* app, UndoType type, int32_t position, const char* text);
 
+extern void push_undo_action_bytes(NotepadApp* app, UndoType type, int32_t position, GBytes* text); // 引用而不复制 text
+
+extern void push_undo_replace(NotepadApp* app, int32_t position, GBytes* text, GBytes* replacement); // 一步撤销的整段替换
+
+// 把 [start, end) 字符替换为 replacement 并记录为一步撤销，original 为被替换的原文（引用而不复制）
+extern void replace_range_undoable(NotepadApp* app, int32_t start, int32_t end, GBytes* original, GBytes* replacement);
+
+extern gsize undo_stack_size(UndoAction* stack, guint* count); // 遍历撤销栈统计占用的字节数，count 累加条数
+extern void undo_history_recount(NotepadApp* app);              // 整体换掉撤销栈和重做栈后重新统计条数和字节数
+
 extern void clear_undo_stack(UndoAction** stack);
 
 extern void on_text_insert(GtkTextBuffer* buffer, GtkTextIter* location, gchar* text, gint len, gpointer data);
@@ -98,8 +178,6 @@ extern void on_text_delete(GtkTextBuffer* buffer, GtkTextIter* start, GtkTextIte
 // 字体设置相关
 extern void on_font_selection(GtkWidget* widget, gpointer data);
 
-extern void update_font_preview(GtkWidget* preview_text, GtkWidget* primary_button, GtkWidget* fallback_button);
-
 extern void apply_font_with_fallback(NotepadApp* app, const gchar* primary_font, const gchar* fallback_font);
 
 extern void on_font_preview_update(GtkWidget* font_button, gpointer data);
@@ -0,0 +1,278 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#include "undo_stress.h"
+#include "notepad.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum
+{
+    STRESS_INSERT,
+    STRESS_DELETE,
+    STRESS_PASTE,
+    STRESS_REPLACE_ALL,
+    STRESS_UNDO,
+    STRESS_REDO,
+    STRESS_OP_COUNT
+} StressOp;
+
+static const char* op_names[STRESS_OP_COUNT] = { "输入", "删除", "粘贴", "全部替换", "撤销", "重做" };
+
+// 参考模型中的一步编辑：在字节偏移 position 处把 removed 换成 inserted
+typedef struct RefEdit
+{
+    gsize position;
+    gchar* removed;
+    gchar* inserted;
+} RefEdit;
+
+typedef struct Stress
+{
+    NotepadApp* app;
+    GRand* rand;
+    GString* reference;         // 参考文本，独立于缓冲区和撤销栈按字节维护
+    GArray* edits;              // RefEdit，按执行顺序
+    GArray* latencies[STRESS_OP_COUNT]; // 每次操作的耗时（微秒）
+} Stress;
+
+// 随机字符：ASCII、换行、中日韩汉字和四字节的表情符号
+static void append_random_char(GRand* rand, GString* text)
+{
+    gint kind = g_rand_int_range(rand, 0, 100);
+    if (kind < 50)
+        g_string_append_c(text, (gchar)g_rand_int_range(rand, 'a', 'z' + 1));
+    else if (kind < 60)
+        g_string_append_c(text, kind < 55 ? ' ' : '\n');
+    else if (kind < 95)
+        g_string_append_unichar(text, (gunichar)g_rand_int_range(rand, 0x4E00, 0x9FA6));
+    else
+        g_string_append_unichar(text, (gunichar)g_rand_int_range(rand, 0x1F600, 0x1F650));
+}
+
+static gchar* random_text(GRand* rand, gint chars)
+{
+    GString* text = g_string_sized_new((gsize)chars * 3);
+    for (gint i = 0; i < chars; i++)
+        append_random_char(rand, text);
+    return g_string_free(text, FALSE);
+}
+
+static gsize byte_offset(const GString* text, glong chars)
+{
+    return (gsize)(g_utf8_offset_to_pointer(text->str, chars) - text->str);
+}
+
+static void ref_replace(GString* reference, gsize position, const gchar* removed, const gchar* inserted)
+{
+    g_string_erase(reference, (gssize)position, (gssize)strlen(removed));
+    g_string_insert(reference, (gssize)position, inserted);
+}
+
+static gboolean verify(Stress* stress, const char* phase, guint step)
+{
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds(stress->app->ui->buffer, &start, &end);
+    gchar* text = gtk_text_buffer_get_text(stress->app->ui->buffer, &start, &end, TRUE);
+    gboolean same = strcmp(text, stress->reference->str) == 0;
+    if (!same)
+    {
+        gsize i = 0;
+        while (text[i] && text[i] == stress->reference->str[i])
+            i++;
+        g_printerr("%s第 %u 步后内容不一致：字节 %" G_GSIZE_FORMAT " 处开始不同（缓冲区 %" G_GSIZE_FORMAT
+                   " 字节，参考 %" G_GSIZE_FORMAT " 字节）\n",
+                   phase, step, i, strlen(text), stress->reference->len);
+    }
+    g_free(text);
+    return same;
+}
+
+static void record_latency(Stress* stress, StressOp op, gint64 start_time)
+{
+    gint64 elapsed = g_get_monotonic_time() - start_time;
+    g_array_append_val(stress->latencies[op], elapsed);
+}
+
+// 执行一步随机编辑，同时记录参考模型的变化。空文档只能输入或粘贴
+static void random_edit(Stress* stress)
+{
+    NotepadApp* app = stress->app;
+    GtkTextBuffer* buffer = app->ui->buffer;
+    glong chars = g_utf8_strlen(stress->reference->str, (gssize)stress->reference->len);
+    gint kind = g_rand_int_range(stress->rand, 0, 100);
+    StressOp op = kind < 45 ? STRESS_INSERT : kind < 80 ? STRESS_DELETE : kind < 95 ? STRESS_PASTE : STRESS_REPLACE_ALL;
+    if (chars == 0 && (op == STRESS_DELETE || op == STRESS_REPLACE_ALL))
+        op = STRESS_INSERT;
+
+    RefEdit edit = { 0, NULL, NULL };
+    GtkTextIter start, end;
+    gint64 start_time;
+
+    if (op == STRESS_INSERT || op == STRESS_PASTE)
+    {
+        glong position = g_rand_int_range(stress->rand, 0, (gint32)chars + 1);
+        gint length = op == STRESS_INSERT ? g_rand_int_range(stress->rand, 1, 17) : g_rand_int_range(stress->rand, 200, 4001);
+        edit.position = byte_offset(stress->reference, position);
+        edit.removed = g_strdup("");
+        edit.inserted = random_text(stress->rand, length);
+
+        start_time = g_get_monotonic_time();
+        gtk_text_buffer_get_iter_at_offset(buffer, &start, (gint)position);
+        gtk_text_buffer_insert(buffer, &start, edit.inserted, -1);
+        record_latency(stress, op, start_time);
+    }
+    else if (op == STRESS_DELETE)
+    {
+        glong position = g_rand_int_range(stress->rand, 0, (gint32)chars);
+        glong length = MIN(chars - position, g_rand_int_range(stress->rand, 1, 33));
+        edit.position = byte_offset(stress->reference, position);
+        gsize end_byte = byte_offset(stress->reference, position + length);
+        edit.removed = g_strndup(stress->reference->str + edit.position, end_byte - edit.position);
+        edit.inserted = g_strdup("");
+
+        start_time = g_get_monotonic_time();
+        gtk_text_buffer_get_iter_at_offset(buffer, &start, (gint)position);
+        gtk_text_buffer_get_iter_at_offset(buffer, &end, (gint)(position + length));
+        gtk_text_buffer_delete(buffer, &start, &end);
+        record_latency(stress, op, start_time);
+    }
+    else
+    {
+        // 把文档中随机一个字符的所有出现替换为随机文本，整个文档作为一步撤销
+        const gchar* pick = g_utf8_offset_to_pointer(stress->reference->str, g_rand_int_range(stress->rand, 0, (gint32)chars));
+        gchar* needle = g_strndup(pick, (gsize)(g_utf8_next_char(pick) - pick));
+        gchar* replacement = random_text(stress->rand, g_rand_int_range(stress->rand, 0, 4));
+        gchar** parts = g_strsplit(stress->reference->str, needle, -1);
+        edit.removed = g_strdup(stress->reference->str);
+        edit.inserted = g_strjoinv(replacement, parts);
+        g_strfreev(parts);
+        g_free(replacement);
+        g_free(needle);
+
+        GBytes* original = g_bytes_new(edit.removed, strlen(edit.removed));
+        GBytes* result = g_bytes_new(edit.inserted, strlen(edit.inserted));
+        start_time = g_get_monotonic_time();
+        replace_range_undoable(app, 0, gtk_text_buffer_get_char_count(buffer), original, result);
+        record_latency(stress, op, start_time);
+        g_bytes_unref(original);
+        g_bytes_unref(result);
+    }
+
+    ref_replace(stress->reference, edit.position, edit.removed, edit.inserted);
+    g_array_append_val(stress->edits, edit);
+}
+
+static gint compare_latency(gconstpointer a, gconstpointer b)
+{
+    gint64 x = *(const gint64*)a, y = *(const gint64*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_latencies(Stress* stress)
+{
+    g_print("%-10s %8s %10s %10s %10s %10s\n", "操作", "次数", "p50(us)", "p90(us)", "p99(us)", "最大(us)");
+    for (gint i = 0; i < STRESS_OP_COUNT; i++)
+    {
+        GArray* samples = stress->latencies[i];
+        if (samples->len == 0)
+            continue;
+        g_array_sort(samples, compare_latency);
+        gint64* values = (gint64*)samples->data;
+        guint n = samples->len;
+        g_print("%-10s %8u %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT "\n",
+                op_names[i], n, values[n * 50 / 100], values[n * 90 / 100], values[n * 99 / 100], values[n - 1]);
+    }
+}
+
+static void print_undo_memory(NotepadApp* app, const char* when)
+{
+    gchar* size = g_format_size(app->ui->undo_bytes + app->ui->redo_bytes);
+    g_print("%s：撤销 %u 项，重做 %u 项，占用 %s\n", when, app->ui->undo_count, app->ui->redo_count, size);
+    g_free(size);
+}
+
+int undo_stress_run(int argc, char* argv[])
+{
+    guint32 seed = argc > 0 ? (guint32)g_ascii_strtoull(argv[0], NULL, 10) : (guint32)g_get_real_time();
+    guint steps = argc > 1 ? (guint)g_ascii_strtoull(argv[1], NULL, 10) : UNDO_STRESS_DEFAULT_STEPS;
+    g_print("撤销/重做压力测试：种子 %u，%u 步\n", seed, steps);
+
+    // 只有缓冲区和撤销记录，不创建窗口；暂停增量统计，不需要主循环
+    NotepadApp* app = notepad_app_new();
+    app->ui->buffer = gtk_text_buffer_new(NULL);
+    app->ui->stats_suspended = TRUE;
+    g_signal_connect(app->ui->buffer, "changed", G_CALLBACK(on_text_changed), app);
+    g_signal_connect(app->ui->buffer, "insert-text", G_CALLBACK(on_text_insert), app);
+    g_signal_connect(app->ui->buffer, "delete-range", G_CALLBACK(on_text_delete), app);
+
+    Stress stress = { app, g_rand_new_with_seed(seed), g_string_new(NULL), g_array_new(FALSE, FALSE, sizeof(RefEdit)) };
+    for (gint i = 0; i < STRESS_OP_COUNT; i++)
+        stress.latencies[i] = g_array_new(FALSE, FALSE, sizeof(gint64));
+
+    gboolean ok = TRUE;
+    for (guint i = 0; ok && i < steps; i++)
+    {
+        random_edit(&stress);
+        ok = verify(&stress, "编辑", i + 1);
+    }
+    if (ok)
+        print_undo_memory(app, "编辑后");
+
+    // 全部撤销，参考模型反向应用同一步编辑
+    for (guint i = stress.edits->len; ok && i > 0; i--)
+    {
+        RefEdit* edit = &g_array_index(stress.edits, RefEdit, i - 1);
+        gint64 start_time = g_get_monotonic_time();
+        on_revoke(NULL, app);
+        record_latency(&stress, STRESS_UNDO, start_time);
+        ref_replace(stress.reference, edit->position, edit->inserted, edit->removed);
+        ok = verify(&stress, "撤销", stress.edits->len - i + 1);
+    }
+    if (ok && (app->ui->undo_stack || !notepad_at_save_point(app)))
+    {
+        g_printerr("全部撤销后撤销栈不为空或未回到保存点\n");
+        ok = FALSE;
+    }
+
+    // 全部重做
+    for (guint i = 0; ok && i < stress.edits->len; i++)
+    {
+        RefEdit* edit = &g_array_index(stress.edits, RefEdit, i);
+        gint64 start_time = g_get_monotonic_time();
+        on_redo(NULL, app);
+        record_latency(&stress, STRESS_REDO, start_time);
+        ref_replace(stress.reference, edit->position, edit->removed, edit->inserted);
+        ok = verify(&stress, "重做", i + 1);
+    }
+    if (ok && app->ui->redo_stack)
+    {
+        g_printerr("全部重做后重做栈不为空\n");
+        ok = FALSE;
+    }
+
+    if (ok)
+        print_undo_memory(app, "重做后");
+    print_latencies(&stress);
+    if (ok)
+        g_print("通过\n");
+    else
+        g_print("失败（种子 %u）\n", seed);
+
+    for (guint i = 0; i < stress.edits->len; i++)
+    {
+        RefEdit* edit = &g_array_index(stress.edits, RefEdit, i);
+        g_free(edit->removed);
+        g_free(edit->inserted);
+    }
+    g_array_free(stress.edits, TRUE);
+    for (gint i = 0; i < STRESS_OP_COUNT; i++)
+        g_array_free(stress.latencies[i], TRUE);
+    g_string_free(stress.reference, TRUE);
+    g_rand_free(stress.rand);
+    g_object_unref(app->ui->buffer);
+    app->ui->buffer = NULL;
+    notepad_app_free(app);
+    return ok ? 0 : 1;
+}
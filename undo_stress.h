@@ -0,0 +1,17 @@
+//
+// Created by ganyu on 2025/8/16.
+//
+
+#ifndef UNDO_STRESS_H
+#define UNDO_STRESS_H
+
+#define UNDO_STRESS_DEFAULT_STEPS 2000  // 默认的随机编辑步数
+
+// 撤销/重做压力测试（命令行模式，不需要显示）：
+//   notepad --undo-stress [种子] [步数]
+// 按种子生成随机的输入、删除、粘贴和全部替换脚本（包含中日韩和四字节字符），依次执行，
+// 然后全部撤销、再全部重做，每一步都与按字节维护的参考文本比较。
+// 最后输出各类操作的延迟分位数和撤销历史占用的内存。全部一致时返回 0
+extern int undo_stress_run(int argc, char* argv[]);
+
+#endif // UNDO_STRESS_H